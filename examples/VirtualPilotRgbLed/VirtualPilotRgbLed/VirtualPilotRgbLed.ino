@@ -98,6 +98,8 @@ void setup() {
 
   // Set callback function for pilot wire mode change and power state change
   zbPilot.onPilotWireModeChange (setPilotWire);
+  // Drive the heater with the saved mode before the network is up
+  zbPilot.restore();
 
   zbPilot.begin ();
   zbPilot.enableNvs (true); // restore pilot wire mode, energy summation from NVS
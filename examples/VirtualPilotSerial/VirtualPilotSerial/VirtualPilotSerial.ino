@@ -77,6 +77,8 @@ void setup() {
 
   // Set callback function for pilot wire mode change and power state change
   zbPilot.onPilotWireModeChange (setPilotWire);
+  // Drive the heater with the saved mode before the network is up
+  zbPilot.restore();
 
   // Initialize the Pilot Wire Control endpoint
   zbPilot.begin ();
@@ -112,6 +112,7 @@ void setup() {
 
   // Initialize the Pilot Wire Control endpoint with current temperature and power meter reading
   zbPilot.begin (temperature, powerW);
+  zbPilot.enableEnergyIntegration (true); // energy summation is integrated from the power by the library
   // zbPilot.enableNvs (true); // restore pilot wire mode, energy summation from NVS
 
   // Add endpoint to Zigbee Core
@@ -200,10 +201,9 @@ void loop() {
       Serial.println ("Failed to set Pilot Wire power metering");
     }
 
-    uint64_t energyWh = zbPilot.energyWh() + (powerW * (t - lastUpdate)) / 3600000; // Wh = W * h
-    // Update energy summation
-    if (zbPilot.setEnergyWh (energyWh)) {
-      Serial.printf ("Pilot Wire energy summation set to %llu Wh\n", energyWh);
+    // Update energy summation, the previous power was integrated by setPowerW()
+    if (zbPilot.integrateEnergy()) {
+      Serial.printf ("Pilot Wire energy summation is %llu Wh\n", zbPilot.energyWh());
       // Force report of energy summation
       if (!zbPilot.reportEnergyWh()) {
         Serial.println ("Failed to report Pilot Wire energy summation");
@@ -7,6 +7,9 @@ logger.info("✅ EpsilonRT Pilot Wire quirk loaded for model ERT-MPZ-0X")
 from zigpy.quirks import CustomCluster
 from zigpy.quirks.v2 import EntityType, QuirkBuilder
 import zigpy.types as t
+from zigpy.zcl.clusters.general import OnOff
+from zigpy.zcl.clusters.measurement import TemperatureMeasurement
+from zigpy.zcl.clusters.smartenergy import Metering
 from zigpy.zcl.foundation import BaseAttributeDefs, DataTypeId, ZCLAttributeDef
 
 EPSILONRT = "EpsilonRT"
@@ -14,6 +17,13 @@ EPSILONRT_MANUFACTURER_ID = 0x1234  # Used by Home Assistant to control custom c
 EPSILONRT_PILOT_WIRE_CLUSTER_ID = 0xFC00  # 64512
 EPSILONRT_PILOT_WIRE_MODEL = "ERT-MPZ-03"
 
+# Packed status (PILOT_WIRE_STATUS_ATTR_ID), the later versions append fields
+STATUS_MIN_VERSION = 1
+STATUS_SIZE = 14
+STATUS_FLAG_ON = 0x01
+STATUS_FLAG_TEMPERATURE = 0x02
+STATUS_FLAG_METERING = 0x04
+
 class EpsilonRTPilotWireMode(t.enum8):
     """Pilot wire mode."""
     Off = 0x00
@@ -38,6 +48,146 @@ class EpsilonRTPilotWireCluster(CustomCluster):
             zcl_type=DataTypeId.uint8,
             is_manufacturer_specific=True,
         )
+        # Snapshot of the live state, published with enableStatusAttribute(true),
+        # decoded into the attributes of the other clusters
+        status = ZCLAttributeDef(
+            id=0x0002,
+            type=t.LVBytes,
+            access="rp",
+            is_manufacturer_specific=True,
+        )
+        # Telemetry history, published with enableHistory(true):
+        # write the offset in hours, then read the chunk
+        history_chunk = ZCLAttributeDef(
+            id=0x0300,
+            type=t.LVBytes,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+        history_offset = ZCLAttributeDef(
+            id=0x0301,
+            type=t.uint16_t,
+            is_manufacturer_specific=True,
+        )
+        # Whole-house power budget, published with enablePowerBudget(true)
+        power_budget = ZCLAttributeDef(
+            id=0x0200,
+            type=t.int32s,
+            is_manufacturer_specific=True,
+        )
+        house_power = ZCLAttributeDef(
+            id=0x0201,
+            type=t.int32s,
+            is_manufacturer_specific=True,
+        )
+        # Performance counters, published with enableDiagnostics(true)
+        reports_sent = ZCLAttributeDef(
+            id=0x0100,
+            type=t.uint32_t,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+        reports_failed = ZCLAttributeDef(
+            id=0x0101,
+            type=t.uint32_t,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+        attribute_set_failures = ZCLAttributeDef(
+            id=0x0102,
+            type=t.uint32_t,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+        lock_wait_total_ms = ZCLAttributeDef(
+            id=0x0103,
+            type=t.uint32_t,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+        lock_wait_max_us = ZCLAttributeDef(
+            id=0x0104,
+            type=t.uint32_t,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+        nvs_writes = ZCLAttributeDef(
+            id=0x0105,
+            type=t.uint32_t,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+        callback_max_us = ZCLAttributeDef(
+            id=0x0106,
+            type=t.uint32_t,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+        callback_avg_us = ZCLAttributeDef(
+            id=0x0107,
+            type=t.uint32_t,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+        writes_absorbed = ZCLAttributeDef(
+            id=0x0108,
+            type=t.uint32_t,
+            access="r",
+            is_manufacturer_specific=True,
+        )
+
+    def _update_attribute(self, attrid, value):
+        super()._update_attribute(attrid, value)
+        if attrid == self.AttributeDefs.status.id:
+            self._decode_status(bytes(value))
+
+    def _decode_status(self, data):
+        """Update the mode, On/Off, temperature and metering attributes from the packed status."""
+        if len(data) < STATUS_SIZE or data[0] < STATUS_MIN_VERSION:
+            logger.debug("Ignoring pilot wire status %s", data.hex())
+            return
+
+        flags = data[1]
+        try:
+            mode = EpsilonRTPilotWireMode(data[2])
+        except ValueError:
+            logger.debug("Unknown pilot wire mode %d in status", data[2])
+        else:
+            super()._update_attribute(self.AttributeDefs.pilot_wire_mode.id, mode)
+
+        clusters = self.endpoint.in_clusters
+        if OnOff.cluster_id in clusters:
+            clusters[OnOff.cluster_id]._update_attribute(
+                OnOff.AttributeDefs.on_off.id, bool(flags & STATUS_FLAG_ON)
+            )
+        if flags & STATUS_FLAG_TEMPERATURE and TemperatureMeasurement.cluster_id in clusters:
+            clusters[TemperatureMeasurement.cluster_id]._update_attribute(
+                TemperatureMeasurement.AttributeDefs.measured_value.id,
+                int.from_bytes(data[3:5], "little", signed=True),
+            )
+        if flags & STATUS_FLAG_METERING and Metering.cluster_id in clusters:
+            metering = clusters[Metering.cluster_id]
+            metering._update_attribute(
+                Metering.AttributeDefs.instantaneous_demand.id,
+                int.from_bytes(data[5:8], "little", signed=True),
+            )
+            metering._update_attribute(
+                Metering.AttributeDefs.current_summ_delivered.id,
+                int.from_bytes(data[8:14], "little"),
+            )
+
+
+DIAGNOSTIC_COUNTERS = (
+    ("reports_sent", "Reports sent"),
+    ("reports_failed", "Reports failed"),
+    ("attribute_set_failures", "Attribute set failures"),
+    ("lock_wait_total_ms", "Lock wait total"),
+    ("lock_wait_max_us", "Lock wait max"),
+    ("nvs_writes", "NVS writes"),
+    ("callback_max_us", "Callback max time"),
+    ("callback_avg_us", "Callback average time"),
+    ("writes_absorbed", "Writes absorbed"),
+)
 
 epsilonrt = (
     QuirkBuilder(EPSILONRT, EPSILONRT_PILOT_WIRE_MODEL)
@@ -52,4 +202,27 @@ epsilonrt = (
     )
 )
 
+epsilonrt = epsilonrt.number(
+    attribute_name=EpsilonRTPilotWireCluster.AttributeDefs.power_budget.name,
+    cluster_id=EpsilonRTPilotWireCluster.cluster_id,
+    min_value=0,
+    max_value=36000,
+    step=100,
+    unit="W",
+    entity_type=EntityType.CONFIG,
+    translation_key="power_budget",
+    fallback_name="Power budget",
+    initially_disabled=True,
+)
+
+for attribute_name, fallback_name in DIAGNOSTIC_COUNTERS:
+    epsilonrt = epsilonrt.sensor(
+        attribute_name=attribute_name,
+        cluster_id=EpsilonRTPilotWireCluster.cluster_id,
+        entity_type=EntityType.DIAGNOSTIC,
+        translation_key=attribute_name,
+        fallback_name=fallback_name,
+        initially_disabled=True,
+    )
+
 epsilonrt.add_to_registry()
\ No newline at end of file
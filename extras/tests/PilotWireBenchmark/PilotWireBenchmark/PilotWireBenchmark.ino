@@ -0,0 +1,200 @@
+/*
+  SPDX-License-Identifier: BSD-3-Clause
+  SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+  Before Compile/Verify with Arduino IDE:
+  - Select the correct board: `Tools -> Board`.
+  - Select the End device Zigbee mode: `Tools -> Zigbee mode: Zigbee ZCZR (coordinator/router)`.
+  - Select Tools / USB CDC On Boot: "Enabled"
+  - Select Partition Scheme for Zigbee: `Tools -> Partition Scheme: Zigbee ZCZR 4MB with spiffs`
+  - Select the COM port: `Tools -> Port: xxx` where the `xxx` is the detected COM port.
+  - Set debug level to errors: `Tools -> Core Debug Level: Error`.
+
+  With PlatformIO, choose the appropriate environment in platformio.ini.
+
+  This sketch measures the cost of the hot paths of the ZigbeePilotWireControl class:
+  - zbAttributeSet() dispatch of a mode written by the network
+  - reportAttributes(), full and batched
+  - Zigbee lock acquisitions per operation
+  - NVS writes per operation
+  - time and heap taken by begin()
+  .
+  The results are printed on the serial port once the device joined the network.
+*/
+#include <Arduino.h>
+
+#ifndef ZIGBEE_MODE_ZCZR
+#error "Zigbee coordinator mode is not selected in Tools->Zigbee mode"
+#endif
+
+#include <Zigbee.h>
+#include <ZigbeePilotWireControl.h>
+
+const uint16_t ZbeeEndPoint = 1;
+const uint16_t Iterations = 100;
+
+// Gives access to the dispatch method called by the Zigbee stack
+class BenchPilotWireControl : public ZigbeePilotWireControl {
+  public:
+    BenchPilotWireControl (uint8_t endpoint, float tempMin, float tempMax, uint32_t meteringMultiplier) :
+      ZigbeePilotWireControl (endpoint, tempMin, tempMax, meteringMultiplier) {}
+
+    void writeMode (uint8_t mode) {
+      esp_zb_zcl_set_attr_value_message_t message = {};
+
+      message.info.status = ESP_ZB_ZCL_STATUS_SUCCESS;
+      message.info.dst_endpoint = _endpoint;
+      message.info.cluster = PILOT_WIRE_CLUSTER_ID;
+      message.attribute.id = PILOT_WIRE_MODE_ATTR_ID;
+      message.attribute.data.type = ESP_ZB_ZCL_ATTR_TYPE_U8;
+      message.attribute.data.size = sizeof (mode);
+      message.attribute.data.value = &mode;
+      zbAttributeSet (&message);
+    }
+};
+
+BenchPilotWireControl zbPilot (ZbeeEndPoint, -10.0f, 80.0f, 1);
+
+struct BenchResult {
+  uint32_t count;
+  int64_t sumUs;
+  int64_t maxUs;
+  uint32_t locks;
+  uint32_t nvsWrites;
+};
+
+void
+setPilotWire (ZigbeePilotWireMode mode) {
+  // nothing to do, only the cost of the library is measured
+}
+
+// Runs an operation Iterations times and records its cost
+template<typename F> BenchResult
+bench (F operation) {
+  BenchResult r = {};
+  uint32_t locks = ZigbeePilotWireControl::zbLockCount();
+  uint32_t nvs = zbPilot.nvsCommitCount();
+
+  for (uint16_t i = 0; i < Iterations; i++) {
+    int64_t t = esp_timer_get_time();
+
+    operation (i);
+    t = esp_timer_get_time() - t;
+    r.sumUs += t;
+    if (t > r.maxUs) {
+      r.maxUs = t;
+    }
+    r.count++;
+  }
+  r.locks = ZigbeePilotWireControl::zbLockCount() - locks;
+  r.nvsWrites = zbPilot.nvsCommitCount() - nvs;
+  return r;
+}
+
+void
+printResult (const char *name, const BenchResult &r) {
+
+  Serial.printf ("%-28s %6lu %9lu %9lu %9.2f %8.2f\n", name,
+                 (unsigned long) r.count,
+                 (unsigned long) (r.sumUs / r.count),
+                 (unsigned long) r.maxUs,
+                 (float) r.locks / r.count,
+                 (float) r.nvsWrites / r.count);
+}
+
+uint8_t
+alternateMode (uint16_t i) {
+  return (i & 1) ? PILOTWIRE_MODE_ECO : PILOTWIRE_MODE_COMFORT;
+}
+
+void
+runBenchmarks() {
+  BenchResult r;
+  ZigbeePilotWireBeginStats b = zbPilot.beginStats();
+
+  Serial.printf ("begin(): %lu us, %lu heap bytes, largest free block -%lu bytes, %u attributes\n",
+                 (unsigned long) b.durationUs, (unsigned long) b.heapUsed,
+                 (unsigned long) b.largestBlockDrop, b.attributes);
+  Serial.printf ("%-28s %6s %9s %9s %9s %8s\n", "operation", "n", "avg us", "max us", "locks/op", "nvs/op");
+
+  zbPilot.setNvsCommitDelay (0, 0);
+  r = bench ([] (uint16_t i) {
+    zbPilot.writeMode (alternateMode (i));
+  });
+  printResult ("set mode (write-through)", r);
+
+  zbPilot.setNvsCommitDelay (PILOT_WIRE_NVS_MODE_DELAY_MS, PILOT_WIRE_NVS_SUMMATION_DELAY_MS);
+  r = bench ([] (uint16_t i) {
+    zbPilot.writeMode (alternateMode (i));
+  });
+  printResult ("set mode (deferred)", r);
+
+  zbPilot.enableCommandQueue (true);
+  r = bench ([] (uint16_t i) {
+    zbPilot.writeMode (alternateMode (i));
+    zbPilot.process();
+  });
+  printResult ("set mode (queued)", r);
+  zbPilot.enableCommandQueue (false);
+
+  r = bench ([] (uint16_t i) {
+    zbPilot.setPilotWireMode (static_cast<ZigbeePilotWireMode> (alternateMode (i)));
+  });
+  printResult ("setPilotWireMode()", r);
+
+  r = bench ([] (uint16_t i) {
+    zbPilot.reportAttributes();
+  });
+  printResult ("reportAttributes()", r);
+
+  r = bench ([] (uint16_t i) {
+    zbPilot.reportAttributes (PILOTWIRE_ATTR_ALL);
+  });
+  printResult ("reportAttributes(all)", r);
+
+  r = bench ([] (uint16_t i) {
+    zbPilot.reportAttributes (PILOTWIRE_ATTR_ALL, nullptr, true);
+  });
+  printResult ("reportAttributes(changed)", r);
+
+  r = bench ([] (uint16_t i) {
+    zbPilot.setPowerW (1000 + i);
+    zbPilot.integrateEnergy();
+  });
+  printResult ("setPowerW() + integrate", r);
+
+  zbPilot.commitNvs();
+  Serial.printf ("NVS: %lu commits, %lu bytes written\n",
+                 (unsigned long) zbPilot.nvsCommitCount(), (unsigned long) zbPilot.nvsBytesWritten());
+}
+
+void setup() {
+  Serial.begin (115200);
+  delay (2000);
+
+  Serial.println ("Zigbee Pilot Wire Control benchmark starting...");
+
+  zbPilot.onPilotWireModeChange (setPilotWire);
+  zbPilot.begin (20.0f, 0);
+  zbPilot.enableEnergyIntegration (true);
+  Zigbee.addEndpoint (&zbPilot);
+
+  if (!Zigbee.begin (ZIGBEE_ROUTER)) {
+    Serial.println ("Zigbee failed to start! Rebooting...");
+    ESP.restart();
+  }
+
+  Serial.print ("Connecting to network");
+  while (!Zigbee.connected()) {
+
+    Serial.print (".");
+    delay (500);
+  }
+  Serial.println ("\nZigbee connected to network.");
+
+  runBenchmarks();
+}
+
+void loop() {
+  delay (1000);
+}
@@ -140,6 +140,7 @@ void setup() {
   }
 
   zbPilot.enableNvs (true); // restore pilot wire mode, energy summation from NVS
+  zbPilot.enableEnergyIntegration (true); // energy summation is integrated from the power by the library
 
   zbPilot.printClusterInfo();
 
@@ -231,8 +232,7 @@ void loop() {
     }
 
     float w = zbPilot.powerW(); // get current power in W
-    float wh  = static_cast<float> (zbPilot.energyWh()) + ( (w * delta) / 3600000.0f); // Wh = W * h
-    log_i ("Pilot Wire temperature reported, updating metering: Power=%.1f W, Energy=%.1f Wh", w, wh);
+    log_i ("Pilot Wire temperature reported, updating metering: Power=%.1f W", w);
 
     w += powerStep; // increment power, if powerStep is negative, power will decrease
     if (w >= PowerMax || w <= PowerMin) {
@@ -240,7 +240,7 @@ void loop() {
       powerStep = -powerStep;
     }
 
-    if (zbPilot.setPowerW (static_cast<int32_t> (w))) { // set new power value
+    if (zbPilot.setPowerW (static_cast<int32_t> (w))) { // set new power value, the previous one is integrated
 
       log_i ("Pilot Wire instantaneous demand set to %d W", zbPilot.powerW());
       if (!zbPilot.reportPowerW()) { // Force report of power
@@ -253,7 +253,7 @@ void loop() {
       log_w ("Failed to set Pilot Wire instantaneous demand");
     }
 
-    if (zbPilot.setEnergyWh (static_cast<uint64_t> (wh + 0.5f))) { // set new energy value with rounding
+    if (zbPilot.integrateEnergy()) { // update energy value with the integrated power
 
       log_i ("Pilot Wire summation delivered set to %llu Wh", zbPilot.energyWh());
       if (!zbPilot.reportEnergyWh()) { // Force report of energy
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-3-Clause
+# SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+"""Build the binary delta of a firmware image for PilotWirePatcher.
+
+The patch rebuilds TARGET from SOURCE, the firmware running on the modules:
+    pilot_wire_delta.py -s old.bin new.bin new.pwd
+Without a source, the patch is a run-length compressed full image:
+    pilot_wire_delta.py new.bin new.pwd
+A patch is checked by rebuilding the target before it is written, and can be
+applied on the host with --apply:
+    pilot_wire_delta.py --apply -s old.bin new.pwd rebuilt.bin
+
+The format is described in src/PilotWirePatch.h.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b"PWD1"
+OP_END = 0x00
+OP_COPY = 0x01
+OP_ADD = 0x02
+OP_FILL = 0x03
+
+BLOCK = 16          # bytes hashed to find a match in the source
+STEP = 4            # one source position out of STEP is indexed
+MIN_COPY = 24       # shorter matches are cheaper as literals
+MIN_FILL = 8        # shorter runs are cheaper as literals
+MAX_CANDIDATES = 8  # source positions kept for a block
+
+
+def varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def zigzag(value):
+    return ((value << 1) ^ (value >> 31)) & 0xFFFFFFFF
+
+
+class Encoder:
+    """Operations of a patch, the literal bytes are merged in Add operations."""
+
+    def __init__(self):
+        self.ops = bytearray()
+        self.literal = bytearray()
+        self.copy_end = 0
+        self.stats = {"copy": 0, "add": 0, "fill": 0}
+
+    def flush(self):
+        if self.literal:
+            self.ops += bytes([OP_ADD]) + varint(len(self.literal)) + self.literal
+            self.stats["add"] += len(self.literal)
+            self.literal = bytearray()
+
+    def copy(self, offset, length):
+        self.flush()
+        self.ops += bytes([OP_COPY]) + varint(zigzag(offset - self.copy_end)) + varint(length)
+        self.copy_end = offset + length
+        self.stats["copy"] += length
+
+    def fill(self, value, length):
+        self.flush()
+        self.ops += bytes([OP_FILL]) + varint(length) + varint(value)
+        self.stats["fill"] += length
+
+
+def index(source):
+    table = {}
+    for i in range(0, len(source) - BLOCK + 1, STEP):
+        positions = table.setdefault(source[i:i + BLOCK], [])
+        if len(positions) < MAX_CANDIDATES:
+            positions.append(i)
+    return table
+
+
+def match_length(source, i, target, j):
+    length = 0
+    limit = min(len(source) - i, len(target) - j)
+    # compare by slices first, then byte by byte
+    while length + 256 <= limit and source[i + length:i + length + 256] == target[j + length:j + length + 256]:
+        length += 256
+    while length < limit and source[i + length] == target[j + length]:
+        length += 1
+    return length
+
+
+def diff(source, target):
+    enc = Encoder()
+    table = index(source) if source else {}
+    j = 0
+    n = len(target)
+
+    while j < n:
+        run = 1
+        while j + run < n and target[j + run] == target[j]:
+            run += 1
+        if run >= MIN_FILL:
+            enc.fill(target[j], run)
+            j += run
+            continue
+
+        best_len, best_off = 0, 0
+        if j + BLOCK <= n:
+            candidates = list(table.get(target[j:j + BLOCK], ()))
+            # the source following the previous copy, shifted by the pending literal
+            expected = enc.copy_end + len(enc.literal)
+            if expected < len(source):
+                candidates.insert(0, expected)
+            for i in candidates:
+                length = match_length(source, i, target, j)
+                if length > best_len:
+                    best_len, best_off = length, i
+
+        if best_len >= MIN_COPY:
+            # the literal may end with the beginning of the match
+            while enc.literal and best_off > 0 and source[best_off - 1] == enc.literal[-1]:
+                enc.literal.pop()
+                best_off -= 1
+                best_len += 1
+                j -= 1
+            enc.copy(best_off, best_len)
+            j += best_len
+        else:
+            enc.literal.append(target[j])
+            j += 1
+
+    enc.flush()
+    enc.ops.append(OP_END)
+    header = MAGIC + struct.pack("<IIII", len(source), zlib.crc32(source) if source else 0,
+                                 len(target), zlib.crc32(target))
+    return header + bytes(enc.ops), enc.stats
+
+
+def apply(source, patch):
+    """Rebuild the target of a patch, same checks as PilotWirePatcher."""
+
+    if patch[:4] != MAGIC:
+        raise ValueError("bad header")
+    source_size, source_crc, target_size, target_crc = struct.unpack_from("<IIII", patch, 4)
+    if source_size and (len(source) < source_size or zlib.crc32(source[:source_size]) != source_crc):
+        raise ValueError("source mismatch")
+    source = source[:source_size]
+
+    def arg(pos):
+        value, shift = 0, 0
+        while True:
+            b = patch[pos]
+            pos += 1
+            value |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return value, pos
+
+    out = bytearray()
+    copy_end = 0
+    pos = 20
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            delta, pos = arg(pos)
+            length, pos = arg(pos)
+            offset = copy_end + ((delta >> 1) ^ -(delta & 1))
+            if offset < 0 or offset + length > source_size:
+                raise ValueError("copy out of the source")
+            out += source[offset:offset + length]
+            copy_end = offset + length
+        elif op == OP_ADD:
+            length, pos = arg(pos)
+            out += patch[pos:pos + length]
+            pos += length
+        elif op == OP_FILL:
+            length, pos = arg(pos)
+            value, pos = arg(pos)
+            out += bytes([value]) * length
+        else:
+            raise ValueError("unknown opcode 0x%02X" % op)
+    if len(out) != target_size or zlib.crc32(out) != target_crc:
+        raise ValueError("target mismatch")
+    return bytes(out)
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-s", "--source", help="image running on the modules, none for a compressed full image")
+    parser.add_argument("--apply", action="store_true", help="rebuild OUTPUT from the patch INPUT")
+    parser.add_argument("input", help="new image, or the patch with --apply")
+    parser.add_argument("output", help="patch, or the rebuilt image with --apply")
+    args = parser.parse_args()
+
+    source = read(args.source) if args.source else b""
+    data = read(args.input)
+    try:
+        if args.apply:
+            result = apply(source, data)
+        else:
+            result, stats = diff(source, data)
+            if apply(source, result) != data:
+                raise ValueError("the patch does not rebuild the target")
+            print("%s: %d bytes, %.1f %% of %d bytes (copy %d, add %d, fill %d)" %
+                  (args.output, len(result), 100.0 * len(result) / max(len(data), 1), len(data),
+                   stats["copy"], stats["add"], stats["fill"]))
+    except ValueError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    with open(args.output, "wb") as f:
+        f.write(result)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
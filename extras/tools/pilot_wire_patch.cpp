@@ -0,0 +1,61 @@
+/// @file pilot_wire_patch.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Applies a patch with PilotWirePatcher on a host, the images are files.
+/// The patch is pushed in blocks of the size of an OTA transfer, as on the module.
+///
+/// g++ -std=c++17 -I../../src -o pilot_wire_patch pilot_wire_patch.cpp ../../src/PilotWirePatch.cpp
+/// ./pilot_wire_patch old.bin new.pwd rebuilt.bin
+/// ./pilot_wire_patch - new.pwd rebuilt.bin   # patch without source
+
+#include <PilotWirePatch.h>
+#include <string.h>
+
+// Payload of an OTA Image Block Response
+#define BLOCK_SIZE  64
+
+static const char *ErrorNames[] = {
+  "none", "bad header", "source mismatch", "corrupt", "read error", "write error", "target mismatch"
+};
+
+int
+main (int argc, char **argv) {
+
+  if (argc != 4) {
+
+    fprintf (stderr, "usage: %s source|- patch output\n", argv[0]);
+    return 2;
+  }
+
+  FILE *patch = fopen (argv[2], "rb");
+  if (patch == nullptr) {
+
+    perror (argv[2]);
+    return 1;
+  }
+
+  PilotWireFilePatchSource source (strcmp (argv[1], "-") == 0 ? "/dev/null" : argv[1]);
+  PilotWireFilePatchTarget target (argv[3]);
+  PilotWirePatcher patcher (source, target);
+  uint8_t block[BLOCK_SIZE];
+  size_t len;
+
+  while ( (len = fread (block, 1, sizeof (block), patch)) > 0) {
+
+    if (patcher.write (block, len) == false) {
+      break;
+    }
+  }
+  fclose (patch);
+
+  if (patcher.finished() == false) {
+
+    fprintf (stderr, "%s: %s, %u/%u bytes written\n", argv[2],
+             patcher.error() != PilotWirePatcher::None ? ErrorNames[patcher.error()] : "truncated patch",
+             patcher.written(), patcher.targetSize());
+    return 1;
+  }
+  printf ("%s: %u bytes\n", argv[3], patcher.written());
+  return 0;
+}
@@ -0,0 +1,79 @@
+/// @file PilotWireFilter.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "PilotWireFilter.h"
+
+// ----------------------------------------------------------------------------
+void
+PilotWireFilter::begin (Type type, uint8_t param) {
+
+  _type = type;
+  if (type == Median) {
+
+    _param = (param < 1) ? 1 : (param > PILOT_WIRE_FILTER_MEDIAN_MAX) ? PILOT_WIRE_FILTER_MEDIAN_MAX : param;
+  }
+  else if (type == Ema) {
+
+    _param = (param < 1) ? 1 : (param > 8) ? 8 : param;
+  }
+  else {
+
+    _param = 0;
+  }
+  _value = 0;
+  _ema = 0;
+  reset();
+}
+
+// ----------------------------------------------------------------------------
+int32_t
+PilotWireFilter::push (int32_t sample) {
+
+  switch (_type) {
+
+    case Median: {
+      int32_t sorted[PILOT_WIRE_FILTER_MEDIAN_MAX];
+
+      _window[_index] = sample;
+      _index = (_index + 1) % _param;
+      if (_count < _param) {
+        _count++;
+      }
+
+      // insertion sort, the window is small
+      for (uint8_t i = 0; i < _count; i++) {
+        int32_t v = _window[i];
+        uint8_t j = i;
+
+        while (j > 0 && sorted[j - 1] > v) {
+          sorted[j] = sorted[j - 1];
+          j--;
+        }
+        sorted[j] = v;
+      }
+      _value = sorted[_count / 2];
+    }
+    break;
+
+    case Ema:
+      if (_count == 0) {
+
+        _ema = sample * 256;
+        _count = 1;
+      }
+      else {
+
+        _ema += (sample * 256 - _ema) / (1 << _param);
+      }
+      // round to the nearest integer
+      _value = (_ema >= 0) ? (_ema + 128) / 256 : (_ema - 128) / 256;
+      break;
+
+    default:
+      _value = sample;
+      _count = 1;
+      break;
+  }
+  return _value;
+}
@@ -0,0 +1,91 @@
+/// @file PilotWireFilter.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <stdint.h>
+
+/**
+   @brief Maximum window of the median filter.
+*/
+#ifndef PILOT_WIRE_FILTER_MEDIAN_MAX
+#define PILOT_WIRE_FILTER_MEDIAN_MAX  9
+#endif
+
+/**
+   @brief Fixed-point filter of integer samples (e.g. temperatures in 0.01 °C).
+
+   - None: the output is the last sample
+   - Median: the output is the median of the last samples, rejects spikes
+   - Ema: exponential moving average with a smoothing factor of 1/2^shift,
+     computed with 8 fractional bits
+   .
+*/
+class PilotWireFilter {
+  public:
+    /**
+       @brief Filter types.
+    */
+    enum Type : uint8_t {
+      None = 0, ///< No filtering
+      Median,   ///< Median of a sliding window
+      Ema       ///< Exponential moving average
+    };
+
+    /**
+       @brief Constructor, no filtering.
+    */
+    PilotWireFilter() {
+      begin (None, 0);
+    }
+
+    /**
+       @brief Configure the filter and clear its state.
+       @param type The filter type.
+       @param param The window of the median filter, from 1 to PILOT_WIRE_FILTER_MEDIAN_MAX,
+       or the shift of the EMA, from 1 (factor 1/2) to 8 (factor 1/256). Ignored by None.
+    */
+    void begin (Type type, uint8_t param);
+
+    /**
+       @brief Clear the state of the filter, the next sample initializes it.
+    */
+    void reset() {
+      _count = 0;
+      _index = 0;
+    }
+
+    /**
+       @brief Add a sample.
+       @param sample The sample.
+       @return the filtered value.
+    */
+    int32_t push (int32_t sample);
+
+    /**
+       @brief Get the filtered value, 0 if no sample was pushed.
+    */
+    int32_t value() const {
+      return _value;
+    }
+
+    /**
+       @brief Check if at least one sample was pushed since the last reset.
+    */
+    bool ready() const {
+      return _count != 0;
+    }
+
+    Type type() const {
+      return _type;
+    }
+
+  private:
+    Type _type;
+    uint8_t _param;
+    uint8_t _count;
+    uint8_t _index;
+    int32_t _value;
+    int32_t _ema;  // EMA state with 8 fractional bits
+    int32_t _window[PILOT_WIRE_FILTER_MEDIAN_MAX];
+};
@@ -0,0 +1,260 @@
+/// @file PilotWireHistory.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "PilotWireHistory.h"
+#include <string.h>
+
+// Largest encoded record: 3 varints of 5 bytes max, the mode mask and a byte per mode
+static const size_t MaxRecordBytes = 3 * 5 + 1 + PILOTWIRE_MODE_COUNT;
+// Header of a chunk: offset, count and pending samples
+static const size_t ChunkHeaderBytes = 4;
+
+static_assert (PILOT_WIRE_HISTORY_SAMPLES < 128, "the samples of a mode are stored in one byte");
+
+// ----------------------------------------------------------------------------
+static size_t
+putVarint (uint8_t *out, int32_t value) {
+  uint32_t v = (static_cast<uint32_t> (value) << 1) ^ static_cast<uint32_t> (value >> 31); // zigzag
+  size_t len = 0;
+
+  while (v >= 0x80) {
+
+    out[len++] = static_cast<uint8_t> (v) | 0x80;
+    v >>= 7;
+  }
+  out[len++] = static_cast<uint8_t> (v);
+  return len;
+}
+
+// ----------------------------------------------------------------------------
+static size_t
+getVarint (const uint8_t *in, int32_t &value) {
+  uint32_t v = 0;
+  size_t len = 0;
+
+  do {
+
+    v |= static_cast<uint32_t> (in[len] & 0x7F) << (7 * len);
+  }
+  while (in[len++] & 0x80);
+  value = static_cast<int32_t> (v >> 1) ^ -static_cast<int32_t> (v & 1);
+  return len;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireHistory::clear() {
+
+  _used = 0;
+  _count = 0;
+  memset (&_base, 0, sizeof (_base));
+  _last = _base;
+  _samples = 0;
+  _power_sum = 0;
+  _temperature_sum = 0;
+  _temperature_samples = 0;
+  _energy_start = 0;
+  memset (_mode_samples, 0, sizeof (_mode_samples));
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireHistory::sample (uint8_t mode, int32_t powerW, int16_t temperature, uint64_t energyWh) {
+
+  if (_samples == 0) {
+
+    _energy_start = energyWh;
+  }
+  _samples++;
+  _power_sum += powerW;
+  if (temperature != NoTemperature) {
+
+    _temperature_sum += temperature;
+    _temperature_samples++;
+  }
+  if (mode < PILOTWIRE_MODE_COUNT) {
+    _mode_samples[mode]++;
+  }
+
+  if (_samples < PILOT_WIRE_HISTORY_SAMPLES) {
+    return false;
+  }
+
+  PilotWireHistoryRecord record;
+  // the summation may have been reset during the hour
+  record.energyWh = (energyWh >= _energy_start) ? static_cast<uint32_t> (energyWh - _energy_start) : static_cast<uint32_t> (energyWh);
+  record.powerW = static_cast<int32_t> (_power_sum / _samples);
+  record.temperature = (_temperature_samples != 0) ? static_cast<int16_t> (_temperature_sum / _temperature_samples) : NoTemperature;
+  memcpy (record.modeSamples, _mode_samples, sizeof (record.modeSamples));
+  push (record);
+
+  _samples = 0;
+  _power_sum = 0;
+  _temperature_sum = 0;
+  _temperature_samples = 0;
+  memset (_mode_samples, 0, sizeof (_mode_samples));
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireHistory::push (const PilotWireHistoryRecord &record) {
+  uint8_t encoded[MaxRecordBytes];
+  size_t len = encode (record, _last, encoded);
+
+  // drop the oldest records, the next one becomes relative to the new base
+  size_t dropped = 0;
+  while (_used - dropped + len > sizeof (_buffer) && _count != 0) {
+    PilotWireHistoryRecord oldest;
+
+    dropped += decode (&_buffer[dropped], _base, oldest);
+    _base = oldest;
+    _count--;
+  }
+  if (dropped != 0) {
+
+    memmove (_buffer, &_buffer[dropped], _used - dropped);
+    _used -= dropped;
+  }
+
+  memcpy (&_buffer[_used], encoded, len);
+  _used += len;
+  _count++;
+  _last = record;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t
+PilotWireHistory::read (uint16_t offset, PilotWireHistoryRecord *records, uint8_t n) const {
+  PilotWireHistoryRecord record = _base;
+  size_t pos = 0;
+
+  if (offset >= _count) {
+    return 0;
+  }
+  if (n > _count - offset) {
+    n = _count - offset;
+  }
+
+  // records are stored the oldest first, the window ends offset records before the last one
+  uint16_t first = _count - offset - n;
+  for (uint16_t i = 0; i < first + n; i++) {
+    PilotWireHistoryRecord previous = record;
+
+    pos += decode (&_buffer[pos], previous, record);
+    if (i >= first) {
+
+      records[first + n - 1 - i] = record;
+    }
+  }
+  return n;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t
+PilotWireHistory::profile (uint16_t offset, uint8_t periods, uint32_t *intervals) const {
+  PilotWireHistoryRecord records[8];
+  uint8_t done = 0;
+
+  while (done < periods) {
+    uint8_t n = periods - done;
+
+    n = read (offset + done, records, (n < 8) ? n : 8);
+    if (n == 0) {
+      break;
+    }
+    for (uint8_t i = 0; i < n; i++) {
+
+      intervals[done + i] = records[i].energyWh;
+    }
+    done += n;
+  }
+  return done;
+}
+
+// ----------------------------------------------------------------------------
+size_t
+PilotWireHistory::encodeChunk (uint16_t offset, uint8_t *out, size_t size) const {
+  PilotWireHistoryRecord records[PILOT_WIRE_HISTORY_CHUNK / 4];
+  PilotWireHistoryRecord previous;
+  uint8_t encoded[MaxRecordBytes];
+
+  if (size > PILOT_WIRE_HISTORY_CHUNK) {
+    size = PILOT_WIRE_HISTORY_CHUNK;
+  }
+  if (size < ChunkHeaderBytes) {
+    return 0;
+  }
+
+  // a record takes at least 4 bytes
+  uint8_t n = read (offset, records, (size - ChunkHeaderBytes) / 4);
+  size_t len = ChunkHeaderBytes;
+  uint8_t count = 0;
+
+  memset (&previous, 0, sizeof (previous));
+  while (count < n) {
+    size_t rlen = encode (records[count], previous, encoded);
+
+    if (len + rlen > size) {
+      break;
+    }
+    memcpy (&out[len], encoded, rlen);
+    len += rlen;
+    previous = records[count++];
+  }
+
+  out[0] = static_cast<uint8_t> (offset);
+  out[1] = static_cast<uint8_t> (offset >> 8);
+  out[2] = count;
+  out[3] = _samples;
+  return len;
+}
+
+// ----------------------------------------------------------------------------
+// private
+size_t
+PilotWireHistory::encode (const PilotWireHistoryRecord &record, const PilotWireHistoryRecord &previous, uint8_t *out) {
+  size_t len = 0;
+  uint8_t mask = 0;
+
+  len += putVarint (&out[len], static_cast<int32_t> (record.energyWh - previous.energyWh));
+  len += putVarint (&out[len], record.powerW - previous.powerW);
+  len += putVarint (&out[len], static_cast<int32_t> (record.temperature) - previous.temperature);
+  for (uint8_t m = 0; m < PILOTWIRE_MODE_COUNT; m++) {
+
+    if (record.modeSamples[m] != 0) {
+      mask |= 1 << m;
+    }
+  }
+  out[len++] = mask;
+  for (uint8_t m = 0; m < PILOTWIRE_MODE_COUNT; m++) {
+
+    if (mask & (1 << m)) {
+      out[len++] = record.modeSamples[m];
+    }
+  }
+  return len;
+}
+
+// ----------------------------------------------------------------------------
+// private
+size_t
+PilotWireHistory::decode (const uint8_t *in, const PilotWireHistoryRecord &previous, PilotWireHistoryRecord &record) {
+  size_t len = 0;
+  int32_t delta;
+  uint8_t mask;
+
+  len += getVarint (&in[len], delta);
+  record.energyWh = previous.energyWh + static_cast<uint32_t> (delta);
+  len += getVarint (&in[len], delta);
+  record.powerW = previous.powerW + delta;
+  len += getVarint (&in[len], delta);
+  record.temperature = static_cast<int16_t> (previous.temperature + delta);
+  mask = in[len++];
+  for (uint8_t m = 0; m < PILOTWIRE_MODE_COUNT; m++) {
+
+    record.modeSamples[m] = (mask & (1 << m)) ? in[len++] : 0;
+  }
+  return len;
+}
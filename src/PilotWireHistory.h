@@ -0,0 +1,150 @@
+/// @file PilotWireHistory.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "PilotWireMode.h"
+
+/**
+   @brief Size in bytes of the compressed history, about 8 bytes per hour.
+*/
+#ifndef PILOT_WIRE_HISTORY_BYTES
+#define PILOT_WIRE_HISTORY_BYTES  1024
+#endif
+
+/**
+   @brief Number of samples closing an hour of history.
+*/
+#ifndef PILOT_WIRE_HISTORY_SAMPLES
+#define PILOT_WIRE_HISTORY_SAMPLES  60
+#endif
+
+/**
+   @brief Maximum size in bytes of a chunk of history read over Zigbee.
+*/
+#ifndef PILOT_WIRE_HISTORY_CHUNK
+#define PILOT_WIRE_HISTORY_CHUNK  64
+#endif
+
+/**
+   @brief An hour of history.
+*/
+struct PilotWireHistoryRecord {
+  uint32_t energyWh;                         ///< Energy delivered during the hour in Wh
+  int32_t powerW;                            ///< Mean power in W
+  int16_t temperature;                       ///< Mean temperature in 0.01 °C, PilotWireHistory::NoTemperature if unknown
+  uint8_t modeSamples[PILOTWIRE_MODE_COUNT]; ///< Number of samples spent in each mode
+};
+
+/**
+   @brief Hourly history of energy, power, temperature and modes.
+
+   sample() is called every minute (PILOT_WIRE_HISTORY_SAMPLES per hour), each
+   hour is closed in a record appended to a RAM buffer of PILOT_WIRE_HISTORY_BYTES.
+   The records are delta-compressed: each field is the zigzag varint of its
+   difference with the previous record, and only the modes with samples are
+   stored, so a steady hour takes about 6 bytes. The oldest records are dropped
+   when the buffer is full.
+
+   encodeChunk() builds the content of the history attribute of the Pilot Wire
+   cluster, so the coordinator can backfill many hours in a few reads after an outage.
+*/
+class PilotWireHistory {
+  public:
+    static const int16_t NoTemperature = INT16_MIN; ///< Temperature of a record without measurement
+
+    PilotWireHistory() {
+      clear();
+    }
+
+    /**
+       @brief Drop all the records and the current hour.
+    */
+    void clear();
+
+    /**
+       @brief Add a sample to the current hour.
+       @param mode The current mode.
+       @param powerW The current power in W.
+       @param temperature The current temperature in 0.01 °C, NoTemperature if unknown.
+       @param energyWh The energy delivered since the start in Wh, as the metering summation.
+       @return true if the sample closed an hour, false otherwise.
+    */
+    bool sample (uint8_t mode, int32_t powerW, int16_t temperature, uint64_t energyWh);
+
+    /**
+       @brief Append a record, dropping the oldest ones if the buffer is full.
+    */
+    void push (const PilotWireHistoryRecord &record);
+
+    /**
+       @brief Number of records stored.
+    */
+    uint16_t count() const {
+      return _count;
+    }
+
+    /**
+       @brief Number of bytes used by the compressed records.
+    */
+    size_t bytesUsed() const {
+      return _used;
+    }
+
+    /**
+       @brief Number of samples of the current hour.
+    */
+    uint8_t pendingSamples() const {
+      return _samples;
+    }
+
+    /**
+       @brief Read records, the most recent first.
+       @param offset Number of most recent records to skip, 0 starts with the last closed hour.
+       @param records Destination of the records.
+       @param n Maximum number of records to read.
+       @return the number of records read.
+    */
+    uint8_t read (uint16_t offset, PilotWireHistoryRecord *records, uint8_t n) const;
+
+    /**
+       @brief Energy per hour in the layout of the Metering GetProfile response.
+       @param offset Number of most recent hours to skip.
+       @param periods Maximum number of intervals.
+       @param intervals Destination of the energy of each hour in Wh, the most recent first.
+       @return the number of intervals written.
+    */
+    uint8_t profile (uint16_t offset, uint8_t periods, uint32_t *intervals) const;
+
+    /**
+       @brief Encode a chunk of records, the most recent first.
+       The chunk starts with the offset (U16 LE), the number of records (U8) and the
+       number of samples of the current hour (U8), followed by the records. The first
+       record is encoded against zero, the next ones against the previous one in the chunk.
+       @param offset Number of most recent records to skip.
+       @param out Destination of the chunk.
+       @param size Size of the destination, at most PILOT_WIRE_HISTORY_CHUNK bytes are used.
+       @return the number of bytes written.
+    */
+    size_t encodeChunk (uint16_t offset, uint8_t *out, size_t size) const;
+
+  private:
+    static size_t encode (const PilotWireHistoryRecord &record, const PilotWireHistoryRecord &previous, uint8_t *out);
+    static size_t decode (const uint8_t *in, const PilotWireHistoryRecord &previous, PilotWireHistoryRecord &record);
+
+    uint8_t _buffer[PILOT_WIRE_HISTORY_BYTES];
+    size_t _used;
+    uint16_t _count;
+    PilotWireHistoryRecord _base; // record preceding the oldest one stored
+    PilotWireHistoryRecord _last; // most recent record stored
+
+    // current hour
+    uint8_t _samples;
+    int64_t _power_sum;
+    int32_t _temperature_sum;
+    uint8_t _temperature_samples;
+    uint64_t _energy_start;
+    uint8_t _mode_samples[PILOTWIRE_MODE_COUNT];
+};
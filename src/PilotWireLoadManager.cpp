@@ -0,0 +1,323 @@
+/// @file PilotWireLoadManager.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "PilotWireLoadManager.h"
+#include <esp_mac.h>
+
+// FNV-1a offset basis, seed used until begin() is called
+#define LOAD_DEFAULT_SEED  0x811C9DC5UL
+// Salts of the hashes, so the transition and the cycle stagger are independent
+#define SALT_TRANSITION  0
+#define SALT_SHEDDING    1
+#define SALT_CYCLE       2
+// Index of the module in the hashes, the zones use 0 to PILOT_WIRE_LOAD_MAX_ZONES - 1
+#define MODULE_INDEX     0xFF
+
+// Modes by level of load, from Off to Comfort
+static const ZigbeePilotWireMode LevelModes[] = {
+  PILOTWIRE_MODE_OFF,
+  PILOTWIRE_MODE_FROST_PROTECTION,
+  PILOTWIRE_MODE_ECO,
+  PILOTWIRE_MODE_COMFORT_MINUS_2,
+  PILOTWIRE_MODE_COMFORT_MINUS_1,
+  PILOTWIRE_MODE_COMFORT
+};
+
+// ----------------------------------------------------------------------------
+PilotWireLoadManager::PilotWireLoadManager() :
+  _seed (LOAD_DEFAULT_SEED), _count (0),
+  _window_us (static_cast<int64_t> (PILOT_WIRE_LOAD_STAGGER_MS) * 1000),
+  _settle_us (static_cast<int64_t> (PILOT_WIRE_LOAD_SETTLE_MS) * 1000),
+  _next_step_us (0), _stats() {
+
+  _stats.loadW = -1;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireLoadManager::begin() {
+  uint8_t ieee[8];
+
+  if (esp_read_mac (ieee, ESP_MAC_IEEE802154) != ESP_OK) {
+
+    log_w ("Failed to read the IEEE address, the stagger uses the default seed");
+    return false;
+  }
+  begin (ieee);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireLoadManager::begin (const uint8_t ieee[8]) {
+
+  _seed = LOAD_DEFAULT_SEED;
+  for (uint8_t i = 0; i < 8; i++) {
+
+    _seed = (_seed ^ ieee[i]) * 16777619UL; // FNV-1a
+  }
+  restagger();
+  log_i ("Load manager seed 0x%08lX", (unsigned long) _seed);
+}
+
+// ----------------------------------------------------------------------------
+// private, the endpoint is accessed through the getters of its instantiation
+int
+PilotWireLoadManager::addZone (const void *control, const ZoneAccess *access, uint8_t endpoint,
+                               PilotWireOutput *output, int32_t ratedPowerW) {
+
+  if (output == nullptr) {
+
+    log_e ("EP %d has no output to manage", endpoint);
+    return -1;
+  }
+  if (_count >= PILOT_WIRE_LOAD_MAX_ZONES) {
+
+    log_e ("Too many zones, limited to %d", PILOT_WIRE_LOAD_MAX_ZONES);
+    return -1;
+  }
+
+  Zone &z = _zones[_count];
+  z.control = control;
+  z.access = access;
+  z.endpoint = endpoint;
+  z.output = output;
+  z.rated_w = ratedPowerW;
+  z.applied = output->mode();
+  z.cap = Unlimited;
+  z.stagger_us = static_cast<int64_t> (stagger (_count)) * 1000;
+  z.pending_us = 0;
+  output->setCycleOffset (hash (_count, SALT_CYCLE) % PILOT_WIRE_CYCLE_PERIOD_MS);
+  return _count++;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+PilotWireLoadManager::stagger (uint8_t index) const {
+  uint32_t window_ms = static_cast<uint32_t> (_window_us / 1000);
+
+  return (window_ms != 0) ? hash (index, SALT_TRANSITION) % window_ms : 0;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireLoadManager::update() {
+
+  return update (esp_timer_get_time());
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireLoadManager::update (int64_t nowUs) {
+  bool changed = false;
+
+  balance (nowUs);
+  for (uint8_t i = 0; i < _count; i++) {
+    Zone &z = _zones[i];
+    ZigbeePilotWireMode target = capMode (z.access->mode (z.control), z.cap);
+
+    if (target == z.applied) {
+
+      z.pending_us = 0;
+      continue;
+    }
+
+    if (level (target) > level (z.applied) && _window_us > 0) {
+
+      // load increase, applied at the stagger of the zone
+      if (z.pending_us == 0) {
+
+        z.pending_us = nowUs + z.stagger_us;
+        _stats.staggered++;
+      }
+      if (nowUs < z.pending_us) {
+        continue;
+      }
+    }
+
+    z.applied = target;
+    z.pending_us = 0;
+    z.output->setMode (target);
+    changed = true;
+  }
+  return changed;
+}
+
+// ----------------------------------------------------------------------------
+PilotWireLoadManager::Stats
+PilotWireLoadManager::stats() const {
+  Stats s = _stats;
+
+  s.shedZones = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+
+    if (_zones[i].cap != Unlimited) {
+      s.shedZones++;
+    }
+  }
+  return s;
+}
+
+// ----------------------------------------------------------------------------
+// private
+uint8_t
+PilotWireLoadManager::level (ZigbeePilotWireMode mode) {
+
+  for (uint8_t i = 0; i < sizeof (LevelModes); i++) {
+
+    if (LevelModes[i] == mode) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+// private
+ZigbeePilotWireMode
+PilotWireLoadManager::capMode (ZigbeePilotWireMode mode, uint8_t cap) {
+
+  return (level (mode) > cap) ? LevelModes[cap] : mode;
+}
+
+// ----------------------------------------------------------------------------
+// private, deterministic for a module, a zone and a salt
+uint32_t
+PilotWireLoadManager::hash (uint8_t index, uint8_t salt) const {
+  uint32_t h = _seed ^ (static_cast<uint32_t> (index) * 0x9E3779B9UL) ^ (static_cast<uint32_t> (salt) << 24);
+
+  // murmur3 finalizer
+  h ^= h >> 16;
+  h *= 0x85EBCA6BUL;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35UL;
+  h ^= h >> 16;
+  return h;
+}
+
+// ----------------------------------------------------------------------------
+// private, the staggers depend on the seed and the window, the cycle offsets on the seed
+void
+PilotWireLoadManager::restagger() {
+
+  for (uint8_t i = 0; i < _count; i++) {
+
+    _zones[i].stagger_us = static_cast<int64_t> (stagger (i)) * 1000;
+    _zones[i].output->setCycleOffset (hash (i, SALT_CYCLE) % PILOT_WIRE_CYCLE_PERIOD_MS);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private, whole-house power if known, power of the zones otherwise
+int32_t
+PilotWireLoadManager::load() const {
+  int32_t house = _zones[0].access->housePowerW (_zones[0].control);
+
+  if (house >= 0) {
+    return house;
+  }
+
+  int32_t total = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    const Zone &z = _zones[i];
+    int32_t p = z.access->powerW (z.control);
+
+    if (p <= 0 && level (z.applied) > EcoLevel) {
+      // no measurement, a heater in a comfort mode is counted at its rated power
+      p = z.rated_w;
+    }
+    total += p;
+  }
+  return total;
+}
+
+// ----------------------------------------------------------------------------
+// private, steps one zone down or up when the budget requires it
+bool
+PilotWireLoadManager::balance (int64_t now) {
+
+  if (_count == 0) {
+    return false;
+  }
+
+  int32_t budget = _zones[0].access->powerBudget (_zones[0].control);
+  if (budget <= 0) {
+
+    // no budget, all the zones are released, their increases are still staggered
+    for (uint8_t i = 0; i < _count; i++) {
+
+      _zones[i].cap = Unlimited;
+    }
+    _next_step_us = 0;
+    _stats.loadW = -1;
+    return false;
+  }
+
+  int32_t load_w = load();
+  _stats.loadW = load_w;
+
+  // the zone to restore is the first shed one, the zones are shed from the last one
+  int restore = -1;
+  for (uint8_t i = 0; i < _count && restore < 0; i++) {
+
+    if (_zones[i].cap != Unlimited) {
+      restore = i;
+    }
+  }
+
+  bool shed = (load_w > budget);
+  if (shed == false && restore >= 0) {
+    int32_t margin = (_zones[restore].rated_w > 0) ? _zones[restore].rated_w : PILOT_WIRE_LOAD_MARGIN_W;
+
+    if (load_w + margin > budget) {
+      restore = -1;
+    }
+  }
+
+  if (shed == false && restore < 0) {
+
+    _next_step_us = 0;
+    return false;
+  }
+
+  int64_t module_stagger_us = (_window_us > 0) ? static_cast<int64_t> (hash (MODULE_INDEX, SALT_SHEDDING) % (_window_us / 1000)) * 1000 : 0;
+  if (_next_step_us == 0) {
+
+    // the other modules of the fleet see the same power, wait for their steps first
+    _next_step_us = now + module_stagger_us;
+  }
+  if (now < _next_step_us) {
+    return false;
+  }
+
+  bool stepped = false;
+  if (shed) {
+
+    for (int i = _count - 1; i >= 0 && stepped == false; i--) {
+      Zone &z = _zones[i];
+      uint8_t current = level (capMode (z.access->mode (z.control), z.cap));
+
+      if (current > FrostLevel) {
+
+        z.cap = (current > EcoLevel) ? EcoLevel : FrostLevel;
+        _stats.shedSteps++;
+        stepped = true;
+        log_i ("Load %ld W over budget %ld W, EP %d shed to %d", (long) load_w, (long) budget,
+               z.endpoint, LevelModes[z.cap]);
+      }
+    }
+  }
+  else {
+    Zone &z = _zones[restore];
+
+    z.cap = (z.cap == FrostLevel) ? EcoLevel : Unlimited;
+    _stats.restoreSteps++;
+    stepped = true;
+    log_i ("Load %ld W under budget %ld W, EP %d restored", (long) load_w, (long) budget, z.endpoint);
+  }
+
+  // let the power measurement settle before the next step
+  _next_step_us = now + _settle_us + module_stagger_us;
+  return stepped;
+}
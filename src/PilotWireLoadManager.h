@@ -0,0 +1,225 @@
+/// @file PilotWireLoadManager.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include "ZigbeePilotWireControl.h"
+
+/**
+   @brief Maximum number of zones handled by a load manager.
+*/
+#ifndef PILOT_WIRE_LOAD_MAX_ZONES
+#define PILOT_WIRE_LOAD_MAX_ZONES  PILOT_WIRE_STORE_MAX_SLOTS
+#endif
+
+/**
+   @brief Default window in milliseconds over which the load increases of the fleet are spread.
+*/
+#ifndef PILOT_WIRE_LOAD_STAGGER_MS
+#define PILOT_WIRE_LOAD_STAGGER_MS  60000UL
+#endif
+
+/**
+   @brief Default time in milliseconds left to the power measurement between two shedding steps.
+*/
+#ifndef PILOT_WIRE_LOAD_SETTLE_MS
+#define PILOT_WIRE_LOAD_SETTLE_MS  30000UL
+#endif
+
+/**
+   @brief Default margin in watts under the budget required to restore a zone of unknown power.
+*/
+#ifndef PILOT_WIRE_LOAD_MARGIN_W
+#define PILOT_WIRE_LOAD_MARGIN_W  500
+#endif
+
+/**
+   @brief Load management of the zones of a module.
+
+   The manager sits between the mode of the zones, decided by the network, the
+   schedule or the thermostat, and their pilot wire outputs:
+   - the increases of load (e.g. Eco to Comfort at 06:00) are delayed by a
+   deterministic stagger derived from the IEEE address of the module and the
+   zone index, so a fleet receiving the same order switches over the window
+   instead of at once. The decreases are applied immediately.
+   - the Comfort-1 and Comfort-2 cycles of the outputs are shifted by the same
+   stagger, so their comfort pulses do not line up.
+   - when the whole-house power exceeds the budget, the zones are stepped down
+   locally (Comfort, Comfort-1, Comfort-2 to Eco, then Frost protection), the
+   last added zone first, and restored in the reverse order when the power
+   goes back under the budget. Each module waits its own stagger before a step,
+   so the fleet sees the effect of the first steps before shedding more.
+   .
+   The whole-house power and the budget are read from the attributes of the first
+   zone (see ZigbeePilotWireControl::enablePowerBudget()), usually written to a group
+   by the coordinator. When the whole-house power is unknown, the power of the
+   zones of the module is used.
+*/
+class PilotWireLoadManager {
+  public:
+    /**
+       @brief Load management statistics.
+    */
+    struct Stats {
+      uint32_t shedSteps;     ///< Number of zones stepped down
+      uint32_t restoreSteps;  ///< Number of zones stepped up
+      uint32_t staggered;     ///< Number of load increases delayed by the stagger
+      uint8_t shedZones;      ///< Number of zones currently shed
+      int32_t loadW;          ///< Last power compared to the budget, -1 if unknown
+    };
+
+    PilotWireLoadManager();
+
+    /**
+       @brief Seed the stagger with the IEEE 802.15.4 address of the module.
+       @return true if the address was read, false if the default seed is used.
+    */
+    bool begin();
+
+    /**
+       @brief Seed the stagger with an IEEE address.
+       @param ieee The 8 bytes of the IEEE address.
+    */
+    void begin (const uint8_t ieee[8]);
+
+    /**
+       @brief Add a zone to the manager.
+       The output attached to the zone with ZigbeePilotWireControl::setOutput() is
+       detached from it and driven by the manager, its Comfort-1 and Comfort-2 cycles
+       are shifted by the stagger of the zone.
+       @param zone The Pilot Wire Control endpoint of the zone, with an attached output.
+       @param ratedPowerW The power of the heater in watts (W), used when the zone has no metering, 0 if unknown.
+       @return the zone index, -1 if the zone has no output or there is no room left.
+       @note Any ZigbeePilotWireControlT endpoint can be a zone, e.g. a zone of a ZigbeePilotWireBank.
+    */
+    template <bool WithTemperature, bool WithMetering>
+    int addZone (ZigbeePilotWireControlT<WithTemperature, WithMetering> &zone, int32_t ratedPowerW = 0) {
+      int index = addZone (&zone, ZoneAccess::of<WithTemperature, WithMetering>(),
+                           zone.getEndpoint(), zone.output(), ratedPowerW);
+
+      if (index >= 0) {
+        // the manager drives the output from now on
+        zone.setOutput (nullptr);
+      }
+      return index;
+    }
+
+    /**
+       @brief Get the number of zones.
+    */
+    uint8_t count() const {
+      return _count;
+    }
+
+    /**
+       @brief Set the window over which the load increases are spread.
+       @param windowMs The window in milliseconds, 0 to apply the increases immediately.
+    */
+    void setStaggerWindow (uint32_t windowMs) {
+      _window_us = static_cast<int64_t> (windowMs) * 1000;
+      restagger();
+    }
+
+    /**
+       @brief Set the minimum time between two shedding steps of the module.
+       @param settleMs The time in milliseconds, longer than the measurement window of the power.
+    */
+    void setSettleTime (uint32_t settleMs) {
+      _settle_us = static_cast<int64_t> (settleMs) * 1000;
+    }
+
+    /**
+       @brief Get the stagger of a zone, in milliseconds within the window.
+       @param index The zone index, from 0 to count() - 1.
+    */
+    uint32_t stagger (uint8_t index) const;
+
+    /**
+       @brief Get the mode applied to the output of a zone, after the stagger and the shedding.
+       @param index The zone index, from 0 to count() - 1.
+    */
+    ZigbeePilotWireMode appliedMode (uint8_t index) const {
+      return _zones[index].applied;
+    }
+
+    /**
+       @brief Check if a zone is shed.
+       @param index The zone index, from 0 to count() - 1.
+    */
+    bool isShed (uint8_t index) const {
+      return _zones[index].cap != Unlimited;
+    }
+
+    /**
+       @brief Apply the modes of the zones, call it periodically from loop().
+       @return true if an output changed, false otherwise.
+    */
+    bool update();
+
+    /**
+       @brief Apply the modes of the zones at a given time, for simulation.
+       @param nowUs The current time in microseconds, monotonic.
+       @return true if an output changed, false otherwise.
+    */
+    bool update (int64_t nowUs);
+
+    /**
+       @brief Get the load management statistics.
+    */
+    Stats stats() const;
+
+  private:
+    // levels of load of the modes, from Off (0) to Comfort (5)
+    static const uint8_t Unlimited = 5;
+    static const uint8_t EcoLevel = 2;
+    static const uint8_t FrostLevel = 1;
+
+    // Getters of the endpoint of a zone, whatever its clusters
+    struct ZoneAccess {
+      ZigbeePilotWireMode (*mode) (const void *control);
+      int32_t (*powerW) (const void *control);
+      int32_t (*housePowerW) (const void *control);
+      int32_t (*powerBudget) (const void *control);
+
+      template <bool WithTemperature, bool WithMetering>
+      static const ZoneAccess *of() {
+        typedef ZigbeePilotWireControlT<WithTemperature, WithMetering> Control;
+        static const ZoneAccess access = {
+          [] (const void *control) { return static_cast<const Control *> (control)->pilotWireMode(); },
+          [] (const void *control) { return static_cast<const Control *> (control)->powerW(); },
+          [] (const void *control) { return static_cast<const Control *> (control)->housePowerW(); },
+          [] (const void *control) { return static_cast<const Control *> (control)->powerBudget(); }
+        };
+        return &access;
+      }
+    };
+
+    struct Zone {
+      const void *control;
+      const ZoneAccess *access;
+      uint8_t endpoint;
+      PilotWireOutput *output;
+      int32_t rated_w;
+      int64_t stagger_us;  // delay of the load increases, cached from the seed and the window
+      ZigbeePilotWireMode applied;
+      uint8_t cap;         // highest load level allowed by the shedding
+      int64_t pending_us;  // time at which a delayed increase is applied, 0 if none
+    };
+
+    int addZone (const void *control, const ZoneAccess *access, uint8_t endpoint,
+                 PilotWireOutput *output, int32_t ratedPowerW);
+    static uint8_t level (ZigbeePilotWireMode mode);
+    static ZigbeePilotWireMode capMode (ZigbeePilotWireMode mode, uint8_t cap);
+    uint32_t hash (uint8_t index, uint8_t salt) const;
+    void restagger();
+    int32_t load() const;
+    bool balance (int64_t now);
+
+    uint32_t _seed;
+    uint8_t _count;
+    int64_t _window_us;
+    int64_t _settle_us;
+    int64_t _next_step_us; // time of the next shedding step, 0 if no step is armed
+    Stats _stats;
+    Zone _zones[PILOT_WIRE_LOAD_MAX_ZONES];
+};
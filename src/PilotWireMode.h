@@ -0,0 +1,37 @@
+/// @file PilotWireMode.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <stdint.h>
+
+/**
+   @brief Enum representing the different Pilot Wire modes.
+   These modes correspond to standard pilot wire control modes for electric heaters.
+*/
+enum ZigbeePilotWireMode : uint8_t {
+  PILOTWIRE_MODE_OFF = 0, ///< Heater Off
+  PILOTWIRE_MODE_COMFORT, ///< Comfort Mode
+  PILOTWIRE_MODE_ECO, ///< Eco Mode
+  PILOTWIRE_MODE_FROST_PROTECTION, ///< Frost Protection Mode
+  PILOTWIRE_MODE_COMFORT_MINUS_1, ///< Comfort Minus 1 Mode
+  PILOTWIRE_MODE_COMFORT_MINUS_2 ///< Comfort Minus 2 Mode
+};
+
+/**
+   @brief Minimum and maximum values for ZigbeePilotWireMode enum.
+   These constants can be used for validation or iteration over the enum values.
+*/
+const ZigbeePilotWireMode PILOTWIRE_MODE_MIN = PILOTWIRE_MODE_OFF;
+
+/**
+   @brief Maximum value for ZigbeePilotWireMode enum.
+   This constant can be used for validation or iteration over the enum values.
+*/
+const ZigbeePilotWireMode PILOTWIRE_MODE_MAX = PILOTWIRE_MODE_COMFORT_MINUS_2;
+
+/**
+   @brief Total number of modes defined in ZigbeePilotWireMode enum.
+   This constant can be used for validation or iteration over the enum values.
+*/
+const uint8_t PILOTWIRE_MODE_COUNT = (PILOTWIRE_MODE_COMFORT_MINUS_2 - PILOTWIRE_MODE_OFF + 1);
@@ -0,0 +1,266 @@
+/// @file PilotWireOutput.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "PilotWireOutput.h"
+#include <mutex>
+
+// serializes setMode() and tick(), which run in different tasks
+static std::mutex s_output_mutex;
+
+// ----------------------------------------------------------------------------
+PilotWireOutput::PilotWireOutput (PilotWireOutputBackend &backend) :
+  _backend (backend), _mode (PILOTWIRE_MODE_COMFORT), _running (false),
+  _positive (false), _negative (false), _offset_ms (0),
+  _cycle_origin_us (0), _scheduled_us (-1) {
+
+  resetJitterStats();
+  _backend.attach (this);
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireOutput::begin (ZigbeePilotWireMode mode) {
+  std::lock_guard<std::mutex> lock (s_output_mutex);
+
+  _running = true;
+  _mode = mode;
+  _cycle_origin_us = _backend.now() - static_cast<int64_t> (_offset_ms) * 1000;
+  update (_backend.now());
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireOutput::end() {
+  std::lock_guard<std::mutex> lock (s_output_mutex);
+
+  _running = false;
+  _backend.cancel();
+  _scheduled_us = -1;
+  _positive = _negative = false;
+  _backend.write (false, false);
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireOutput::setMode (ZigbeePilotWireMode mode) {
+  std::lock_guard<std::mutex> lock (s_output_mutex);
+
+  if (mode != _mode) {
+    int64_t now = _backend.now();
+
+    _mode = mode;
+    // a new cycle starts with its comfort pulse
+    _cycle_origin_us = now - static_cast<int64_t> (_offset_ms) * 1000;
+    if (_running) {
+
+      update (now);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireOutput::setCycleOffset (uint32_t offsetMs) {
+  std::lock_guard<std::mutex> lock (s_output_mutex);
+
+  _offset_ms = offsetMs % PILOT_WIRE_CYCLE_PERIOD_MS;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireOutput::tick() {
+  std::lock_guard<std::mutex> lock (s_output_mutex);
+  int64_t now = _backend.now();
+
+  if (_scheduled_us >= 0) {
+    int32_t delay = static_cast<int32_t> (now - _scheduled_us);
+
+    if (_jitter_count == 0 || delay < _jitter_min_us) {
+      _jitter_min_us = delay;
+    }
+    if (_jitter_count == 0 || delay > _jitter_max_us) {
+      _jitter_max_us = delay;
+    }
+    _jitter_sum_us += delay;
+    _jitter_count++;
+    _scheduled_us = -1;
+  }
+
+  if (_running) {
+
+    update (now);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private, computes the outputs at now and schedules the next edge
+void
+PilotWireOutput::update (int64_t now) {
+  bool positive = false;
+  bool negative = false;
+  uint32_t pulse_ms = 0;
+
+  switch (_mode) {
+    case PILOTWIRE_MODE_ECO:
+      positive = negative = true;
+      break;
+    case PILOTWIRE_MODE_FROST_PROTECTION:
+      negative = true;
+      break;
+    case PILOTWIRE_MODE_OFF:
+      positive = true;
+      break;
+    case PILOTWIRE_MODE_COMFORT_MINUS_1:
+      pulse_ms = PILOT_WIRE_COMFORT_MINUS_1_PULSE_MS;
+      break;
+    case PILOTWIRE_MODE_COMFORT_MINUS_2:
+      pulse_ms = PILOT_WIRE_COMFORT_MINUS_2_PULSE_MS;
+      break;
+    case PILOTWIRE_MODE_COMFORT:
+    default:
+      break;
+  }
+
+  if (pulse_ms != 0) {
+    const int64_t period_us = static_cast<int64_t> (PILOT_WIRE_CYCLE_PERIOD_MS) * 1000;
+    const int64_t pulse_us = static_cast<int64_t> (pulse_ms) * 1000;
+    int64_t elapsed = now - _cycle_origin_us;
+    int64_t cycle_start = now - (elapsed % period_us);
+    int64_t phase = now - cycle_start;
+
+    if (phase < pulse_us) {
+
+      // full wave during the comfort pulse, ends at cycle_start + pulse_us
+      positive = negative = true;
+      _scheduled_us = cycle_start + pulse_us;
+    }
+    else {
+
+      // no signal until the next cycle
+      _scheduled_us = cycle_start + period_us;
+    }
+    _backend.schedule (_scheduled_us);
+  }
+  else {
+
+    _scheduled_us = -1;
+    _backend.cancel();
+  }
+
+  _positive = positive;
+  _negative = negative;
+  _backend.write (positive, negative);
+}
+
+// ----------------------------------------------------------------------------
+PilotWireJitterStats
+PilotWireOutput::jitterStats() const {
+  PilotWireJitterStats stats;
+
+  stats.count = _jitter_count;
+  stats.minUs = _jitter_min_us;
+  stats.maxUs = _jitter_max_us;
+  stats.avgUs = (_jitter_count != 0) ? static_cast<int32_t> (_jitter_sum_us / _jitter_count) : 0;
+  return stats;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireOutput::resetJitterStats() {
+
+  _jitter_count = 0;
+  _jitter_min_us = 0;
+  _jitter_max_us = 0;
+  _jitter_sum_us = 0;
+}
+
+#if defined(ESP_PLATFORM)
+#include <Arduino.h>
+
+// ----------------------------------------------------------------------------
+PilotWireTimerBackend::PilotWireTimerBackend (uint8_t pinPositive, uint8_t pinNegative, bool activeHigh) :
+  _pin_positive (pinPositive), _pin_negative (pinNegative), _active_high (activeHigh),
+  _initialized (false), _timer (nullptr) {
+}
+
+// ----------------------------------------------------------------------------
+PilotWireTimerBackend::~PilotWireTimerBackend() {
+
+  if (_timer != nullptr) {
+
+    esp_timer_stop (_timer);
+    esp_timer_delete (_timer);
+  }
+}
+
+// ----------------------------------------------------------------------------
+int64_t
+PilotWireTimerBackend::now() {
+
+  return esp_timer_get_time();
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireTimerBackend::write (bool positive, bool negative) {
+
+  if (_initialized == false) {
+
+    // GPIOs are configured on first use, the constructor may run before the core is ready
+    pinMode (_pin_positive, OUTPUT);
+    pinMode (_pin_negative, OUTPUT);
+    _initialized = true;
+  }
+  digitalWrite (_pin_positive, (positive == _active_high) ? HIGH : LOW);
+  digitalWrite (_pin_negative, (negative == _active_high) ? HIGH : LOW);
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireTimerBackend::schedule (int64_t at_us) {
+  int64_t delay = at_us - esp_timer_get_time();
+
+  if (_timer == nullptr) {
+    const esp_timer_create_args_t args = {
+      .callback = timerCallback,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "pw_output",
+      .skip_unhandled_events = false
+    };
+
+    if (esp_timer_create (&args, &_timer) != ESP_OK) {
+
+      log_e ("Failed to create pilot wire output timer");
+      _timer = nullptr;
+      return;
+    }
+  }
+
+  esp_timer_stop (_timer);
+  esp_timer_start_once (_timer, (delay > 0) ? static_cast<uint64_t> (delay) : 0);
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireTimerBackend::cancel() {
+
+  if (_timer != nullptr) {
+
+    esp_timer_stop (_timer);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private, called from the esp_timer task
+void
+PilotWireTimerBackend::timerCallback (void *arg) {
+  PilotWireTimerBackend *backend = static_cast<PilotWireTimerBackend *> (arg);
+
+  if (backend->_output != nullptr) {
+
+    backend->_output->tick();
+  }
+}
+#endif
@@ -0,0 +1,293 @@
+/// @file PilotWireOutput.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <stdint.h>
+#include "PilotWireMode.h"
+
+/**
+   @brief Period of the Comfort-1 and Comfort-2 cycles in milliseconds.
+*/
+#ifndef PILOT_WIRE_CYCLE_PERIOD_MS
+#define PILOT_WIRE_CYCLE_PERIOD_MS  300000UL
+#endif
+
+/**
+   @brief Duration of the comfort pulse of the Comfort-1 order in milliseconds.
+*/
+#ifndef PILOT_WIRE_COMFORT_MINUS_1_PULSE_MS
+#define PILOT_WIRE_COMFORT_MINUS_1_PULSE_MS  3000UL
+#endif
+
+/**
+   @brief Duration of the comfort pulse of the Comfort-2 order in milliseconds.
+*/
+#ifndef PILOT_WIRE_COMFORT_MINUS_2_PULSE_MS
+#define PILOT_WIRE_COMFORT_MINUS_2_PULSE_MS  7000UL
+#endif
+
+class PilotWireOutput;
+
+/**
+   @brief Clock, timer and GPIO backend of a PilotWireOutput.
+
+   The output engine never polls: it asks the backend to call
+   PilotWireOutput::tick() at the time of the next edge of the signal.
+   PilotWireTimerBackend drives two GPIOs from a hardware timer,
+   PilotWireSimBackend simulates the clock and the GPIOs on a host.
+*/
+class PilotWireOutputBackend {
+  public:
+    virtual ~PilotWireOutputBackend() {}
+
+    /**
+       @brief Attach the output to notify when a scheduled time is reached.
+    */
+    void attach (PilotWireOutput *output) {
+      _output = output;
+    }
+
+    /**
+       @brief Current time in microseconds, monotonic.
+    */
+    virtual int64_t now() = 0;
+
+    /**
+       @brief Drive the two half-wave outputs.
+       @param positive true to let the positive half-wave through.
+       @param negative true to let the negative half-wave through.
+    */
+    virtual void write (bool positive, bool negative) = 0;
+
+    /**
+       @brief Call PilotWireOutput::tick() at an absolute time, replacing any pending call.
+       @param at_us The time in microseconds, as returned by now().
+    */
+    virtual void schedule (int64_t at_us) = 0;
+
+    /**
+       @brief Cancel the pending call, if any.
+    */
+    virtual void cancel() = 0;
+
+  protected:
+    PilotWireOutputBackend() : _output (nullptr) {}
+    PilotWireOutput *_output;
+};
+
+/**
+   @brief Jitter statistics of the scheduled edges, in microseconds.
+*/
+struct PilotWireJitterStats {
+  uint32_t count; ///< Number of scheduled edges
+  int32_t minUs;  ///< Minimum delay between the scheduled time and the edge
+  int32_t maxUs;  ///< Maximum delay between the scheduled time and the edge
+  int32_t avgUs;  ///< Average delay between the scheduled time and the edge
+};
+
+/**
+   @brief Pilot wire signal generator.
+
+   Drives the pilot wire of an electric heater with two opto-triacs, one
+   for each half-wave of the mains:
+   - Comfort: no signal
+   - Eco: full wave
+   - Frost protection: negative half-wave
+   - Off: positive half-wave
+   - Comfort-1: full wave during 3 s every 300 s, no signal otherwise
+   - Comfort-2: full wave during 7 s every 300 s, no signal otherwise
+   .
+
+   The edges of the Comfort-1 and Comfort-2 cycles are scheduled by the backend
+   timer, not by the application loop, and the delay of each edge is recorded.
+*/
+class PilotWireOutput {
+  public:
+    /**
+       @brief Constructor for PilotWireOutput.
+       The output starts in Comfort mode (no signal) until begin() is called.
+       @param backend The clock, timer and GPIO backend.
+    */
+    PilotWireOutput (PilotWireOutputBackend &backend);
+
+    /**
+       @brief Start the output in a mode.
+       @param mode The initial mode.
+    */
+    void begin (ZigbeePilotWireMode mode = PILOTWIRE_MODE_COMFORT);
+
+    /**
+       @brief Stop the output, no signal is applied.
+    */
+    void end();
+
+    /**
+       @brief Set the mode, the signal changes immediately.
+       A Comfort-1 or Comfort-2 cycle starts with its comfort pulse, shifted by the cycle offset.
+       This method can be used directly as the body of the mode change callback.
+       @param mode The new mode.
+    */
+    void setMode (ZigbeePilotWireMode mode);
+
+    ZigbeePilotWireMode mode() const {
+      return _mode;
+    }
+
+    /**
+       @brief Shift the Comfort-1 and Comfort-2 cycles.
+       Used to spread the comfort pulses of several heaters over the cycle.
+       @param offsetMs The offset in milliseconds, modulo the cycle period.
+    */
+    void setCycleOffset (uint32_t offsetMs);
+
+    uint32_t cycleOffset() const {
+      return _offset_ms;
+    }
+
+    /**
+       @brief Current level of the positive half-wave output.
+    */
+    bool positive() const {
+      return _positive;
+    }
+
+    /**
+       @brief Current level of the negative half-wave output.
+    */
+    bool negative() const {
+      return _negative;
+    }
+
+    /**
+       @brief Called by the backend at the scheduled time.
+    */
+    void tick();
+
+    /**
+       @brief Get the jitter statistics of the scheduled edges.
+    */
+    PilotWireJitterStats jitterStats() const;
+
+    /**
+       @brief Reset the jitter statistics.
+    */
+    void resetJitterStats();
+
+  private:
+    void update (int64_t now);
+
+    PilotWireOutputBackend &_backend;
+    volatile ZigbeePilotWireMode _mode;
+    bool _running;
+    bool _positive;
+    bool _negative;
+    uint32_t _offset_ms;
+    int64_t _cycle_origin_us;
+    int64_t _scheduled_us;
+    uint32_t _jitter_count;
+    int32_t _jitter_min_us;
+    int32_t _jitter_max_us;
+    int64_t _jitter_sum_us;
+};
+
+/**
+   @brief Simulated backend to run a PilotWireOutput on a host.
+   The clock only moves when advance() is called, the scheduled ticks are
+   dispatched on time and the number of output transitions is recorded.
+*/
+class PilotWireSimBackend : public PilotWireOutputBackend {
+  public:
+    PilotWireSimBackend() :
+      _now_us (0), _at_us (-1), _positive (false), _negative (false), _transitions (0) {}
+
+    int64_t now() override {
+      return _now_us;
+    }
+
+    void write (bool positive, bool negative) override {
+      if (positive != _positive || negative != _negative) {
+        _transitions++;
+      }
+      _positive = positive;
+      _negative = negative;
+    }
+
+    void schedule (int64_t at_us) override {
+      _at_us = at_us;
+    }
+
+    void cancel() override {
+      _at_us = -1;
+    }
+
+    /**
+       @brief Move the simulated clock forward, dispatching the scheduled ticks.
+       @param us The duration in microseconds.
+       @param latencyUs Simulated delay applied to each dispatched tick.
+    */
+    void advance (int64_t us, int64_t latencyUs = 0) {
+      int64_t end = _now_us + us;
+
+      while (_at_us >= 0 && _at_us + latencyUs <= end) {
+        _now_us = _at_us + latencyUs;
+        _at_us = -1;
+        if (_output != nullptr) {
+          _output->tick();
+        }
+      }
+      _now_us = end;
+    }
+
+    bool positive() const {
+      return _positive;
+    }
+
+    bool negative() const {
+      return _negative;
+    }
+
+    uint32_t transitions() const {
+      return _transitions;
+    }
+
+  private:
+    int64_t _now_us;
+    int64_t _at_us;
+    bool _positive;
+    bool _negative;
+    uint32_t _transitions;
+};
+
+#if defined(ESP_PLATFORM) || defined(DOXYGEN)
+#include <esp_timer.h>
+
+/**
+   @brief Backend driving two GPIOs from a hardware timer (esp_timer).
+*/
+class PilotWireTimerBackend : public PilotWireOutputBackend {
+  public:
+    /**
+       @brief Constructor for PilotWireTimerBackend.
+       @param pinPositive GPIO of the opto-triac letting the positive half-wave through.
+       @param pinNegative GPIO of the opto-triac letting the negative half-wave through.
+       @param activeHigh true if the opto-triacs are driven by a high level.
+    */
+    PilotWireTimerBackend (uint8_t pinPositive, uint8_t pinNegative, bool activeHigh = true);
+    ~PilotWireTimerBackend();
+
+    int64_t now() override;
+    void write (bool positive, bool negative) override;
+    void schedule (int64_t at_us) override;
+    void cancel() override;
+
+  private:
+    static void timerCallback (void *arg);
+
+    uint8_t _pin_positive;
+    uint8_t _pin_negative;
+    bool _active_high;
+    bool _initialized;
+    esp_timer_handle_t _timer;
+};
+#endif
@@ -0,0 +1,501 @@
+/// @file PilotWirePatch.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "PilotWirePatch.h"
+#include <string.h>
+
+// Opcodes of the patch operations
+#define OP_END   0x00
+#define OP_COPY  0x01
+#define OP_ADD   0x02
+#define OP_FILL  0x03
+
+static const uint8_t Magic[4] = { 'P', 'W', 'D', '1' };
+
+// CRC-32 by nibble, reflected polynomial 0xEDB88320
+static const uint32_t CrcTable[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// ----------------------------------------------------------------------------
+static uint32_t
+getU32 (const uint8_t *in) {
+
+  return static_cast<uint32_t> (in[0]) | (static_cast<uint32_t> (in[1]) << 8) |
+         (static_cast<uint32_t> (in[2]) << 16) | (static_cast<uint32_t> (in[3]) << 24);
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+PilotWirePatcher::crc32 (uint32_t crc, const uint8_t *data, size_t len) {
+
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+
+    crc = CrcTable[ (crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+    crc = CrcTable[ (crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+// ----------------------------------------------------------------------------
+PilotWirePatcher::PilotWirePatcher (PilotWirePatchSource &source, PilotWirePatchTarget &target) :
+  _source (source), _target (target), _target_open (false) {
+
+  begin();
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWirePatcher::begin() {
+
+  if (_target_open) {
+
+    _target.abort();
+    _target_open = false;
+  }
+  _state = Header;
+  _error = None;
+  _header_len = 0;
+  _source_size = 0;
+  _source_crc = 0;
+  _target_size = 0;
+  _target_crc = 0;
+  _opcode = OP_END;
+  _arg_count = 0;
+  _arg_needed = 0;
+  _varint = 0;
+  _shift = 0;
+  _literal = 0;
+  _copy_end = 0;
+  _written = 0;
+  _crc = 0;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWirePatcher::write (const uint8_t *data, size_t len) {
+  size_t i = 0;
+
+  while (i < len) {
+
+    switch (_state) {
+
+      case Header: {
+        size_t n = HeaderSize - _header_len;
+
+        if (n > len - i) {
+          n = len - i;
+        }
+        memcpy (&_header[_header_len], &data[i], n);
+        _header_len += n;
+        i += n;
+        if (_header_len == HeaderSize && parseHeader() == false) {
+          return false;
+        }
+      }
+      break;
+
+      case Opcode:
+        _opcode = data[i++];
+        _arg_count = 0;
+        _varint = 0;
+        _shift = 0;
+        if (_opcode == OP_END) {
+
+          if (_written != _target_size || _crc != _target_crc) {
+            return fail (TargetMismatch);
+          }
+          _target_open = false;
+          if (_target.finish() == false) {
+            return fail (WriteError);
+          }
+          _state = Done;
+        }
+        else if (_opcode == OP_COPY || _opcode == OP_FILL) {
+
+          _arg_needed = 2;
+          _state = Argument;
+        }
+        else if (_opcode == OP_ADD) {
+
+          _arg_needed = 1;
+          _state = Argument;
+        }
+        else {
+
+          return fail (Corrupt);
+        }
+        break;
+
+      case Argument: {
+        uint8_t b = data[i++];
+
+        if (_shift > 28) {
+          return fail (Corrupt);
+        }
+        _varint |= static_cast<uint32_t> (b & 0x7F) << _shift;
+        _shift += 7;
+        if ( (b & 0x80) == 0) {
+
+          _args[_arg_count++] = _varint;
+          _varint = 0;
+          _shift = 0;
+          if (_arg_count == _arg_needed && execute() == false) {
+            return false;
+          }
+        }
+      }
+      break;
+
+      case Literal: {
+        size_t n = _literal;
+
+        if (n > len - i) {
+          n = len - i;
+        }
+        if (emit (&data[i], n) == false) {
+          return false;
+        }
+        _literal -= n;
+        i += n;
+        if (_literal == 0) {
+          _state = Opcode;
+        }
+      }
+      break;
+
+      case Done:
+        // padding of the transfer after the End operation
+        return true;
+
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// private
+bool
+PilotWirePatcher::fail (Error error) {
+
+  _error = error;
+  _state = Failed;
+  if (_target_open) {
+
+    _target.abort();
+    _target_open = false;
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// private
+bool
+PilotWirePatcher::parseHeader() {
+
+  if (memcmp (_header, Magic, sizeof (Magic)) != 0) {
+    return fail (BadHeader);
+  }
+  _source_size = getU32 (&_header[4]);
+  _source_crc = getU32 (&_header[8]);
+  _target_size = getU32 (&_header[12]);
+  _target_crc = getU32 (&_header[16]);
+
+  if (_source_size != 0 && checkSource() == false) {
+    return false;
+  }
+  if (_target.begin (_target_size) == false) {
+    return fail (WriteError);
+  }
+  _target_open = true;
+  _state = Opcode;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// private, the patch must not be applied to another firmware
+bool
+PilotWirePatcher::checkSource() {
+  uint32_t crc = 0;
+
+  if (_source.begin() == false) {
+    return fail (ReadError);
+  }
+  if (_source_size > _source.size()) {
+    return fail (SourceMismatch);
+  }
+  for (uint32_t offset = 0; offset < _source_size;) {
+    size_t n = _source_size - offset;
+
+    if (n > sizeof (_buffer)) {
+      n = sizeof (_buffer);
+    }
+    if (_source.read (offset, _buffer, n) == false) {
+      return fail (ReadError);
+    }
+    crc = crc32 (crc, _buffer, n);
+    offset += n;
+  }
+  return (crc == _source_crc) ? true : fail (SourceMismatch);
+}
+
+// ----------------------------------------------------------------------------
+// private, all the arguments of the operation were received
+bool
+PilotWirePatcher::execute() {
+
+  _state = Opcode;
+  if (_opcode == OP_COPY) {
+    // zigzag offset, relative to the end of the previous copy
+    int32_t delta = static_cast<int32_t> (_args[0] >> 1) ^ -static_cast<int32_t> (_args[0] & 1);
+    uint32_t offset = _copy_end + static_cast<uint32_t> (delta);
+    uint32_t length = _args[1];
+
+    if (offset > _source_size || length > _source_size - offset) {
+      return fail (Corrupt);
+    }
+    while (length != 0) {
+      size_t n = (length < sizeof (_buffer)) ? length : sizeof (_buffer);
+
+      if (_source.read (offset, _buffer, n) == false) {
+        return fail (ReadError);
+      }
+      if (emit (_buffer, n) == false) {
+        return false;
+      }
+      offset += n;
+      length -= n;
+    }
+    _copy_end = offset;
+  }
+  else if (_opcode == OP_ADD) {
+
+    _literal = _args[0];
+    if (_literal != 0) {
+      _state = Literal;
+    }
+  }
+  else {
+    uint32_t length = _args[0];
+
+    if (_args[1] > 0xFF) {
+      return fail (Corrupt);
+    }
+    memset (_buffer, _args[1], sizeof (_buffer));
+    while (length != 0) {
+      size_t n = (length < sizeof (_buffer)) ? length : sizeof (_buffer);
+
+      if (emit (_buffer, n) == false) {
+        return false;
+      }
+      length -= n;
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// private, appends bytes to the target
+bool
+PilotWirePatcher::emit (const uint8_t *data, size_t len) {
+
+  if (len > _target_size - _written) {
+    return fail (Corrupt);
+  }
+  if (_target.write (data, len) == false) {
+    return fail (WriteError);
+  }
+  _crc = crc32 (_crc, data, len);
+  _written += len;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+PilotWireFilePatchSource::~PilotWireFilePatchSource() {
+
+  if (_file != nullptr) {
+    fclose (_file);
+  }
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireFilePatchSource::begin() {
+
+  if (_file == nullptr) {
+
+    _file = fopen (_path, "rb");
+    if (_file == nullptr) {
+      return false;
+    }
+  }
+  if (fseek (_file, 0, SEEK_END) != 0) {
+    return false;
+  }
+  long size = ftell (_file);
+  _size = (size > 0) ? static_cast<uint32_t> (size) : 0;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireFilePatchSource::read (uint32_t offset, uint8_t *data, size_t len) {
+
+  if (_file == nullptr || fseek (_file, offset, SEEK_SET) != 0) {
+    return false;
+  }
+  return fread (data, 1, len, _file) == len;
+}
+
+// ----------------------------------------------------------------------------
+PilotWireFilePatchTarget::~PilotWireFilePatchTarget() {
+
+  if (_file != nullptr) {
+    fclose (_file);
+  }
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireFilePatchTarget::begin (uint32_t /* size */) {
+
+  if (_file != nullptr) {
+    fclose (_file);
+  }
+  _file = fopen (_path, "wb");
+  return _file != nullptr;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireFilePatchTarget::write (const uint8_t *data, size_t len) {
+
+  return _file != nullptr && fwrite (data, 1, len, _file) == len;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireFilePatchTarget::finish() {
+  bool status = (_file != nullptr) && (fclose (_file) == 0);
+
+  _file = nullptr;
+  return status;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireFilePatchTarget::abort() {
+
+  if (_file != nullptr) {
+
+    fclose (_file);
+    _file = nullptr;
+    remove (_path);
+  }
+}
+
+#if defined(ESP_PLATFORM)
+#include <esp32-hal-log.h>
+
+// ----------------------------------------------------------------------------
+bool
+PilotWirePartitionSource::begin() {
+
+  _partition = esp_ota_get_running_partition();
+  if (_partition == nullptr) {
+
+    log_e ("Running partition not found");
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+PilotWirePartitionSource::size() {
+
+  return (_partition != nullptr) ? _partition->size : 0;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWirePartitionSource::read (uint32_t offset, uint8_t *data, size_t len) {
+
+  return _partition != nullptr && esp_partition_read (_partition, offset, data, len) == ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireOtaTarget::begin (uint32_t size) {
+  esp_err_t err;
+
+  _partition = esp_ota_get_next_update_partition (nullptr);
+  if (_partition == nullptr) {
+
+    log_e ("No OTA partition to update");
+    return false;
+  }
+  if (size > _partition->size) {
+
+    log_e ("Image of %lu bytes too large for partition %s", (unsigned long) size, _partition->label);
+    return false;
+  }
+  err = esp_ota_begin (_partition, size, &_handle);
+  if (err != ESP_OK) {
+
+    log_e ("Failed to begin OTA on partition %s: 0x%x: %s", _partition->label, err, esp_err_to_name (err));
+    _handle = 0;
+    return false;
+  }
+  log_i ("Patching partition %s, %lu bytes", _partition->label, (unsigned long) size);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireOtaTarget::write (const uint8_t *data, size_t len) {
+  esp_err_t err = esp_ota_write (_handle, data, len);
+
+  if (err != ESP_OK) {
+
+    log_e ("Failed to write OTA partition: 0x%x: %s", err, esp_err_to_name (err));
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireOtaTarget::finish() {
+  esp_err_t err = esp_ota_end (_handle);
+
+  _handle = 0;
+  if (err == ESP_OK) {
+
+    err = esp_ota_set_boot_partition (_partition);
+  }
+  if (err != ESP_OK) {
+
+    log_e ("Failed to validate the patched image: 0x%x: %s", err, esp_err_to_name (err));
+    return false;
+  }
+  log_i ("Patched image valid, partition %s boots next", _partition->label);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireOtaTarget::abort() {
+
+  if (_handle != 0) {
+
+    esp_ota_abort (_handle);
+    _handle = 0;
+  }
+}
+#endif
@@ -0,0 +1,296 @@
+/// @file PilotWirePatch.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+   @brief Size in bytes of the buffer used to copy and fill the target.
+*/
+#ifndef PILOT_WIRE_PATCH_BUFFER
+#define PILOT_WIRE_PATCH_BUFFER  256
+#endif
+
+/**
+   @brief Image read by a PilotWirePatcher, usually the running firmware.
+*/
+class PilotWirePatchSource {
+  public:
+    virtual ~PilotWirePatchSource() {}
+
+    /**
+       @brief Open the image.
+       @return true if the image can be read, false otherwise.
+    */
+    virtual bool begin() = 0;
+
+    /**
+       @brief Size of the image in bytes, an upper bound if the exact size is unknown.
+    */
+    virtual uint32_t size() = 0;
+
+    /**
+       @brief Read bytes of the image.
+       @return true if the len bytes at offset were read, false otherwise.
+    */
+    virtual bool read (uint32_t offset, uint8_t *data, size_t len) = 0;
+};
+
+/**
+   @brief Image written by a PilotWirePatcher, usually the next OTA partition.
+*/
+class PilotWirePatchTarget {
+  public:
+    virtual ~PilotWirePatchTarget() {}
+
+    /**
+       @brief Open the image for writing.
+       @param size The size of the image in bytes.
+       @return true if the image can be written, false otherwise.
+    */
+    virtual bool begin (uint32_t size) = 0;
+
+    /**
+       @brief Append bytes to the image.
+       @return true if the bytes were written, false otherwise.
+    */
+    virtual bool write (const uint8_t *data, size_t len) = 0;
+
+    /**
+       @brief Close the image once it is complete and verified.
+       @return true if the image was committed, false otherwise.
+    */
+    virtual bool finish() = 0;
+
+    /**
+       @brief Drop an incomplete or corrupted image.
+    */
+    virtual void abort() {}
+};
+
+/**
+   @brief Streaming decoder of the binary delta of a firmware image.
+
+   A patch rebuilds a target image from a source image, usually the running
+   firmware, so only the differences travel over the network. It starts with
+   a 20-byte header:
+   - the magic "PWD1",
+   - the size and the CRC-32 of the source (U32 LE), a size of 0 needs no source,
+   - the size and the CRC-32 of the target (U32 LE),
+   .
+   followed by operations, each an opcode and varint arguments:
+   - Copy (0x01): offset and length, the bytes of the source are appended to the
+   target. The offset is zigzag encoded relative to the end of the previous copy,
+   so a code block shifted by an insertion costs a few bytes.
+   - Add (0x02): length, followed by the bytes to append.
+   - Fill (0x03): length and value, a run of the same byte (erased flash, zero padding).
+   - End (0x00): the target is complete.
+   .
+   A patch against an empty source is a run-length compressed full image.
+
+   The patch is pushed in chunks of any size with write(), e.g. as the blocks of
+   an OTA transfer arrive, and is never stored. The CRC of the source is checked
+   before anything is written, the CRC of the target before finish() commits it.
+   extras/tools/pilot_wire_delta.py builds the patches, and the engine runs on a
+   host with PilotWireFilePatchSource and PilotWireFilePatchTarget.
+*/
+class PilotWirePatcher {
+  public:
+    static const size_t HeaderSize = 20; ///< Size of the patch header in bytes
+
+    /**
+       @brief Error of a patch.
+    */
+    enum Error : uint8_t {
+      None = 0,       ///< No error
+      BadHeader,      ///< The patch does not start with a valid header
+      SourceMismatch, ///< The source is not the image the patch was built against
+      Corrupt,        ///< Unknown opcode, or an operation out of the source or the target
+      ReadError,      ///< The source could not be read
+      WriteError,     ///< The target could not be opened or written
+      TargetMismatch  ///< The CRC or the size of the rebuilt image is wrong
+    };
+
+    /**
+       @brief Constructor for PilotWirePatcher.
+       @param source The image the patch was built against.
+       @param target The image to rebuild.
+    */
+    PilotWirePatcher (PilotWirePatchSource &source, PilotWirePatchTarget &target);
+
+    /**
+       @brief Prepare a new patch.
+       The source is checked and the target opened when the header is received.
+    */
+    void begin();
+
+    /**
+       @brief Push the next bytes of the patch.
+       @return false if the patch failed, see error().
+    */
+    bool write (const uint8_t *data, size_t len);
+
+    /**
+       @brief Check if the target was rebuilt, verified and committed.
+    */
+    bool finished() const {
+      return _state == Done;
+    }
+
+    /**
+       @brief Get the error of the patch, None while it is in progress or finished.
+    */
+    Error error() const {
+      return _error;
+    }
+
+    /**
+       @brief Number of bytes of the target written.
+    */
+    uint32_t written() const {
+      return _written;
+    }
+
+    /**
+       @brief Size of the target, 0 before the header is received.
+    */
+    uint32_t targetSize() const {
+      return _target_size;
+    }
+
+    /**
+       @brief Update a CRC-32 (IEEE 802.3, the one of zlib) with bytes.
+       @param crc The CRC of the previous bytes, 0 to start.
+    */
+    static uint32_t crc32 (uint32_t crc, const uint8_t *data, size_t len);
+
+  private:
+    enum State : uint8_t {
+      Header,
+      Opcode,
+      Argument,
+      Literal,
+      Done,
+      Failed
+    };
+
+    bool fail (Error error);
+    bool parseHeader();
+    bool checkSource();
+    bool execute();
+    bool emit (const uint8_t *data, size_t len);
+
+    PilotWirePatchSource &_source;
+    PilotWirePatchTarget &_target;
+    State _state;
+    Error _error;
+    uint8_t _header[HeaderSize];
+    uint8_t _header_len;
+    uint32_t _source_size;
+    uint32_t _source_crc;
+    uint32_t _target_size;
+    uint32_t _target_crc;
+    bool _target_open;
+
+    // current operation
+    uint8_t _opcode;
+    uint8_t _arg_count;  // arguments received
+    uint8_t _arg_needed; // arguments of the opcode
+    uint32_t _args[2];
+    uint32_t _varint;
+    uint8_t _shift;
+    uint32_t _literal;   // bytes of an Add still to receive
+
+    uint32_t _copy_end;  // end of the previous copy in the source
+    uint32_t _written;
+    uint32_t _crc;       // CRC of the bytes written
+    uint8_t _buffer[PILOT_WIRE_PATCH_BUFFER];
+};
+
+/**
+   @brief Patch source read from a file, to run the patcher on a host or from a file system.
+*/
+class PilotWireFilePatchSource : public PilotWirePatchSource {
+  public:
+    /**
+       @brief Constructor for PilotWireFilePatchSource.
+       @param path The path of the image, kept by reference.
+    */
+    explicit PilotWireFilePatchSource (const char *path) :
+      _path (path), _file (nullptr), _size (0) {}
+    ~PilotWireFilePatchSource();
+
+    bool begin() override;
+    uint32_t size() override {
+      return _size;
+    }
+    bool read (uint32_t offset, uint8_t *data, size_t len) override;
+
+  private:
+    const char *_path;
+    FILE *_file;
+    uint32_t _size;
+};
+
+/**
+   @brief Patch target written to a file, to run the patcher on a host or from a file system.
+*/
+class PilotWireFilePatchTarget : public PilotWirePatchTarget {
+  public:
+    /**
+       @brief Constructor for PilotWireFilePatchTarget.
+       @param path The path of the image, kept by reference, the file is replaced.
+    */
+    explicit PilotWireFilePatchTarget (const char *path) :
+      _path (path), _file (nullptr) {}
+    ~PilotWireFilePatchTarget();
+
+    bool begin (uint32_t size) override;
+    bool write (const uint8_t *data, size_t len) override;
+    bool finish() override;
+    void abort() override;
+
+  private:
+    const char *_path;
+    FILE *_file;
+};
+
+#if defined(ESP_PLATFORM) || defined(DOXYGEN)
+#include <esp_ota_ops.h>
+
+/**
+   @brief Patch source reading the running firmware partition.
+*/
+class PilotWirePartitionSource : public PilotWirePatchSource {
+  public:
+    PilotWirePartitionSource() : _partition (nullptr) {}
+
+    bool begin() override;
+    uint32_t size() override;
+    bool read (uint32_t offset, uint8_t *data, size_t len) override;
+
+  private:
+    const esp_partition_t *_partition;
+};
+
+/**
+   @brief Patch target writing the next OTA partition, selected for the next boot by finish().
+   The image is validated by esp_ota_end() before the boot partition is changed.
+*/
+class PilotWireOtaTarget : public PilotWirePatchTarget {
+  public:
+    PilotWireOtaTarget() : _partition (nullptr), _handle (0) {}
+
+    bool begin (uint32_t size) override;
+    bool write (const uint8_t *data, size_t len) override;
+    bool finish() override;
+    void abort() override;
+
+  private:
+    const esp_partition_t *_partition;
+    esp_ota_handle_t _handle;
+};
+#endif
@@ -0,0 +1,180 @@
+/// @file PilotWirePulseMeter.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "PilotWirePulseMeter.h"
+
+// 1 Wh = 3600 s * 1000 mW
+#define MWS_PER_WH  3600000LL
+
+// ----------------------------------------------------------------------------
+PilotWirePulseMeter::PilotWirePulseMeter (PilotWirePulseSource &source, float wsPerPulse) :
+  _source (source), _mws_per_pulse (0),
+  _window_us (static_cast<int64_t> (PILOT_WIRE_PULSE_WINDOW_MS) * 1000),
+  _last_us (0), _last_count (0), _power_w (0), _residual_mws (0) {
+
+  setCalibration (wsPerPulse);
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWirePulseMeter::begin() {
+
+  if (_source.begin() == false) {
+    return false;
+  }
+  _last_us = _source.now();
+  _last_count = _source.count();
+  _power_w = 0;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWirePulseMeter::setCalibration (float wsPerPulse) {
+
+  _mws_per_pulse = (wsPerPulse > 0.0f) ? static_cast<uint32_t> (wsPerPulse * 1000.0f + 0.5f) : 0;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWirePulseMeter::update() {
+  int64_t now = _source.now();
+  int64_t elapsed = now - _last_us;
+
+  if (elapsed < _window_us || elapsed <= 0) {
+    return false;
+  }
+
+  uint32_t count = _source.count();
+  uint32_t pulses = count - _last_count; // unsigned arithmetic handles the wrap-around
+  int64_t mws = static_cast<int64_t> (pulses) * _mws_per_pulse;
+
+  _last_us = now;
+  _last_count = count;
+  _residual_mws += mws;
+  // W = mW.s * 1000 / us
+  _power_w = static_cast<int32_t> ( (mws * 1000 + elapsed / 2) / elapsed);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+PilotWirePulseMeter::takeEnergyWh() {
+  int64_t wh = _residual_mws / MWS_PER_WH;
+
+  _residual_mws -= wh * MWS_PER_WH;
+  return static_cast<uint32_t> (wh);
+}
+
+#if defined(ESP_PLATFORM) && SOC_PCNT_SUPPORTED
+#include <esp_timer.h>
+#include <esp32-hal-log.h>
+
+// The hardware counter is 16-bit, the driver accumulates its overflows in an int
+#define PCNT_HIGH_LIMIT  32767
+// The accumulated count is cleared before it overflows
+#define PCNT_CLEAR_LIMIT  (1 << 30)
+
+// ----------------------------------------------------------------------------
+PilotWirePcntSource::PilotWirePcntSource (uint8_t pin, uint32_t glitchNs) :
+  _pin (pin), _glitch_ns (glitchNs), _base (0), _unit (nullptr), _channel (nullptr) {
+}
+
+// ----------------------------------------------------------------------------
+PilotWirePcntSource::~PilotWirePcntSource() {
+
+  if (_unit != nullptr) {
+
+    pcnt_unit_stop (_unit);
+    pcnt_unit_disable (_unit);
+    if (_channel != nullptr) {
+      pcnt_del_channel (_channel);
+    }
+    pcnt_del_unit (_unit);
+  }
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWirePcntSource::begin() {
+  pcnt_unit_config_t unit_config = {};
+  pcnt_chan_config_t chan_config = {};
+  esp_err_t err;
+
+  if (_unit != nullptr) {
+    return true;
+  }
+
+  unit_config.low_limit = -1;
+  unit_config.high_limit = PCNT_HIGH_LIMIT;
+  unit_config.flags.accum_count = 1;
+  err = pcnt_new_unit (&unit_config, &_unit);
+  if (err != ESP_OK) {
+
+    log_e ("Failed to create pulse counter unit: %s", esp_err_to_name (err));
+    _unit = nullptr;
+    return false;
+  }
+
+  chan_config.edge_gpio_num = _pin;
+  chan_config.level_gpio_num = -1;
+  err = pcnt_new_channel (_unit, &chan_config, &_channel);
+  if (err == ESP_OK) {
+    // count the rising edges only
+    err = pcnt_channel_set_edge_action (_channel, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_HOLD);
+  }
+  if (err == ESP_OK && _glitch_ns != 0) {
+    pcnt_glitch_filter_config_t filter_config = {
+      .max_glitch_ns = _glitch_ns
+    };
+    err = pcnt_unit_set_glitch_filter (_unit, &filter_config);
+  }
+  if (err == ESP_OK) {
+    // the overflows are accumulated by the driver when the watch point is reached
+    err = pcnt_unit_add_watch_point (_unit, PCNT_HIGH_LIMIT);
+  }
+  if (err == ESP_OK) {
+    err = pcnt_unit_enable (_unit);
+  }
+  if (err == ESP_OK) {
+    err = pcnt_unit_clear_count (_unit);
+  }
+  if (err == ESP_OK) {
+    err = pcnt_unit_start (_unit);
+  }
+  if (err != ESP_OK) {
+
+    log_e ("Failed to start pulse counter on GPIO %d: %s", _pin, esp_err_to_name (err));
+    return false;
+  }
+  log_i ("Pulse counter started on GPIO %d", _pin);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+PilotWirePcntSource::count() {
+  int value = 0;
+
+  if (_unit == nullptr || pcnt_unit_get_count (_unit, &value) != ESP_OK) {
+    return _base;
+  }
+  if (value >= PCNT_CLEAR_LIMIT) {
+
+    // the pulses between the read and the clear are lost, once every 2^30 pulses
+    _base += static_cast<uint32_t> (value);
+    pcnt_unit_clear_count (_unit);
+    value = 0;
+  }
+  return _base + static_cast<uint32_t> (value);
+}
+
+// ----------------------------------------------------------------------------
+int64_t
+PilotWirePcntSource::now() {
+
+  return esp_timer_get_time();
+}
+
+#endif
@@ -0,0 +1,210 @@
+/// @file PilotWirePulseMeter.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <stdint.h>
+
+/**
+   @brief Minimum measurement window of the pulse meter in milliseconds.
+   The power is the energy of the pulses counted during the window divided by
+   its duration, a longer window gives a better resolution at low power.
+*/
+#ifndef PILOT_WIRE_PULSE_WINDOW_MS
+#define PILOT_WIRE_PULSE_WINDOW_MS  10000UL
+#endif
+
+/**
+   @brief Counter of the pulses of an energy metering chip.
+
+   The chip (BL0937, HLW8012, CSE7759...) outputs a pulse train whose frequency
+   is proportional to the active power. PilotWirePcntSource counts the pulses with
+   the hardware pulse counter, without interrupt per pulse, PilotWireSimPulseSource
+   simulates a pulse train on a host.
+*/
+class PilotWirePulseSource {
+  public:
+    virtual ~PilotWirePulseSource() {}
+
+    /**
+       @brief Start counting.
+       @return true if the counter was started successfully, false otherwise.
+    */
+    virtual bool begin() = 0;
+
+    /**
+       @brief Number of pulses counted since begin(), wraps around at 2^32.
+    */
+    virtual uint32_t count() = 0;
+
+    /**
+       @brief Current time in microseconds, monotonic.
+    */
+    virtual int64_t now() = 0;
+};
+
+/**
+   @brief Converts the pulses of a PilotWirePulseSource to power and energy.
+
+   The calibration constant is the energy of one pulse, which is also the power
+   giving a 1 Hz pulse train. The energy is accumulated in a fixed-point residual
+   with a resolution of 1 mW.s, so no pulse is lost in the rounding to Wh.
+*/
+class PilotWirePulseMeter {
+  public:
+    /**
+       @brief Constructor for PilotWirePulseMeter.
+       @param source The pulse counter.
+       @param wsPerPulse The energy of one pulse in W.s, e.g. 1.2 W.s for a chip giving 1 kHz at 1200 W.
+    */
+    PilotWirePulseMeter (PilotWirePulseSource &source, float wsPerPulse);
+
+    /**
+       @brief Start the pulse counter.
+       @return true if the counter was started successfully, false otherwise.
+    */
+    bool begin();
+
+    /**
+       @brief Set the energy of one pulse in W.s.
+    */
+    void setCalibration (float wsPerPulse);
+
+    float calibration() const {
+      return static_cast<float> (_mws_per_pulse) / 1000.0f;
+    }
+
+    /**
+       @brief Set the minimum measurement window.
+       @param windowMs The window in milliseconds.
+    */
+    void setWindow (uint32_t windowMs) {
+      _window_us = static_cast<int64_t> (windowMs) * 1000;
+    }
+
+    /**
+       @brief Close the measurement window if it is elapsed.
+       @return true if a new power was measured, false if the window is not elapsed.
+    */
+    bool update();
+
+    /**
+       @brief Power measured over the last window, in watts (W).
+    */
+    int32_t powerW() const {
+      return _power_w;
+    }
+
+    /**
+       @brief Take the whole Wh counted since the last call.
+       The remaining energy is kept for the next call.
+    */
+    uint32_t takeEnergyWh();
+
+    /**
+       @brief Number of pulses counted since begin().
+    */
+    uint32_t pulses() const {
+      return _last_count;
+    }
+
+  private:
+    PilotWirePulseSource &_source;
+    uint32_t _mws_per_pulse;
+    int64_t _window_us;
+    int64_t _last_us;
+    uint32_t _last_count;
+    int32_t _power_w;
+    int64_t _residual_mws; // mW.s not yet taken as Wh
+};
+
+/**
+   @brief Simulated pulse source to run a PilotWirePulseMeter on a host.
+   The clock only moves when advance() is called, the pulses are generated
+   at the configured frequency.
+*/
+class PilotWireSimPulseSource : public PilotWirePulseSource {
+  public:
+    PilotWireSimPulseSource() :
+      _now_us (0), _count (0), _frequency_mhz (0), _phase (0) {}
+
+    bool begin() override {
+      return true;
+    }
+
+    uint32_t count() override {
+      return _count;
+    }
+
+    int64_t now() override {
+      return _now_us;
+    }
+
+    /**
+       @brief Set the frequency of the simulated pulse train.
+       @param hz The frequency in hertz.
+    */
+    void setFrequency (float hz) {
+      _frequency_mhz = (hz > 0.0f) ? static_cast<uint32_t> (hz * 1000.0f + 0.5f) : 0;
+    }
+
+    /**
+       @brief Move the simulated clock forward, generating the pulses.
+       @param us The duration in microseconds.
+    */
+    void advance (int64_t us) {
+      // pulses in 1e-9 unit: mHz * us
+      _phase += static_cast<int64_t> (_frequency_mhz) * us;
+      _count += static_cast<uint32_t> (_phase / 1000000000LL);
+      _phase %= 1000000000LL;
+      _now_us += us;
+    }
+
+    /**
+       @brief Add pulses without moving the clock (e.g. a burst).
+    */
+    void inject (uint32_t pulses) {
+      _count += pulses;
+    }
+
+  private:
+    int64_t _now_us;
+    uint32_t _count;
+    uint32_t _frequency_mhz;
+    int64_t _phase;
+};
+
+#if defined(ESP_PLATFORM) || defined(DOXYGEN)
+#include <soc/soc_caps.h>
+
+#if SOC_PCNT_SUPPORTED || defined(DOXYGEN)
+#include <driver/pulse_cnt.h>
+
+/**
+   @brief Pulse source counting the edges of a GPIO with the hardware pulse counter (PCNT).
+   The counter only interrupts the CPU when its 16-bit hardware count overflows,
+   the overflows are accumulated by the driver.
+*/
+class PilotWirePcntSource : public PilotWirePulseSource {
+  public:
+    /**
+       @brief Constructor for PilotWirePcntSource.
+       @param pin GPIO receiving the CF output of the metering chip.
+       @param glitchNs Pulses shorter than this duration are ignored, 0 to disable the filter.
+    */
+    PilotWirePcntSource (uint8_t pin, uint32_t glitchNs = 1000);
+    ~PilotWirePcntSource();
+
+    bool begin() override;
+    uint32_t count() override;
+    int64_t now() override;
+
+  private:
+    uint8_t _pin;
+    uint32_t _glitch_ns;
+    uint32_t _base; // pulses counted before the last clear of the unit
+    pcnt_unit_handle_t _unit;
+    pcnt_channel_handle_t _channel;
+};
+#endif
+#endif
@@ -0,0 +1,75 @@
+/// @file PilotWireRing.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/**
+   @brief Bounded lock-free single-producer/single-consumer ring buffer.
+
+   push() must only be called from one task (the producer) and pop() from
+   one other task (the consumer). No lock is taken, so the producer never
+   waits for the consumer.
+   @tparam T Type of the elements, must be trivially copyable.
+   @tparam N Capacity of the ring, must be a power of two.
+*/
+template <typename T, size_t N>
+class PilotWireRing {
+    static_assert (N >= 2 && (N & (N - 1)) == 0, "PilotWireRing capacity must be a power of two");
+
+  public:
+    PilotWireRing() : _head (0), _tail (0) {}
+
+    /**
+       @brief Append an element, producer side.
+       @return false if the ring is full, the element is not appended.
+    */
+    bool push (const T &item) {
+      size_t head = _head.load (std::memory_order_relaxed);
+
+      if (head - _tail.load (std::memory_order_acquire) >= N) {
+        return false;
+      }
+      _items[head & (N - 1)] = item;
+      _head.store (head + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+       @brief Remove the oldest element, consumer side.
+       @return false if the ring is empty.
+    */
+    bool pop (T &item) {
+      size_t tail = _tail.load (std::memory_order_relaxed);
+
+      if (tail == _head.load (std::memory_order_acquire)) {
+        return false;
+      }
+      item = _items[tail & (N - 1)];
+      _tail.store (tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+       @brief Number of elements in the ring.
+    */
+    size_t size() const {
+      return _head.load (std::memory_order_acquire) - _tail.load (std::memory_order_acquire);
+    }
+
+    bool empty() const {
+      return size() == 0;
+    }
+
+    static constexpr size_t capacity() {
+      return N;
+    }
+
+  private:
+    T _items[N];
+    std::atomic<size_t> _head;
+    std::atomic<size_t> _tail;
+};
@@ -0,0 +1,100 @@
+/// @file PilotWireSchedule.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "PilotWireSchedule.h"
+#include <string.h>
+
+// ----------------------------------------------------------------------------
+void
+PilotWireSchedule::clear() {
+
+  // all the slots to Hold (0b111)
+  memset (_data, 0xFF, sizeof (_data));
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireSchedule::isEmpty() const {
+
+  for (uint8_t d = 0; d < 7; d++) {
+    for (uint8_t s = 0; s < SlotsPerDay; s++) {
+
+      if (slot (d, s) != Hold) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t
+PilotWireSchedule::slot (uint8_t wday, uint8_t slot) const {
+
+  if (wday > 6 || slot >= SlotsPerDay) {
+    return Hold;
+  }
+
+  // slots are packed on 3 bits, little-endian, a slot may span two bytes
+  size_t bit = wday * DayBytes * 8 + slot * 3;
+  uint16_t word = _data[bit / 8];
+  if ( (bit % 8) > 5) {
+    word |= static_cast<uint16_t> (_data[bit / 8 + 1]) << 8;
+  }
+  return (word >> (bit % 8)) & 0x07;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireSchedule::setSlot (uint8_t wday, uint8_t slot, uint8_t mode) {
+
+  if (wday > 6 || slot >= SlotsPerDay) {
+    return;
+  }
+
+  size_t bit = wday * DayBytes * 8 + slot * 3;
+  for (uint8_t i = 0; i < 3; i++, bit++) {
+    uint8_t mask = 1 << (bit % 8);
+
+    if (mode & (1 << i)) {
+      _data[bit / 8] |= mask;
+    }
+    else {
+      _data[bit / 8] &= ~mask;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireSchedule::setRange (uint8_t wday, uint16_t fromMinutes, uint16_t toMinutes, uint8_t mode) {
+
+  for (uint16_t s = fromMinutes / SlotMinutes; s < SlotsPerDay && s * SlotMinutes < toMinutes; s++) {
+
+    setSlot (wday, s, mode);
+  }
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireSchedule::load (const uint8_t *data, size_t len) {
+  PilotWireSchedule tmp;
+
+  if (len != Size) {
+    return false;
+  }
+
+  memcpy (tmp._data, data, Size);
+  for (uint8_t d = 0; d < 7; d++) {
+    for (uint8_t s = 0; s < SlotsPerDay; s++) {
+      uint8_t mode = tmp.slot (d, s);
+
+      if (mode != Hold && mode > PILOTWIRE_MODE_MAX) {
+        return false;
+      }
+    }
+  }
+  memcpy (_data, data, Size);
+  return true;
+}
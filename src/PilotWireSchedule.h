@@ -0,0 +1,95 @@
+/// @file PilotWireSchedule.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "PilotWireMode.h"
+
+/**
+   @brief Weekly program of Pilot Wire modes.
+
+   Each day is divided in 48 slots of 30 minutes, each slot holds a mode
+   on 3 bits, or PILOTWIRE_SCHEDULE_HOLD to keep the current mode.
+   The whole week fits in 126 bytes, which are uploaded in one transfer
+   through the schedule attribute of the Pilot Wire cluster.
+*/
+class PilotWireSchedule {
+  public:
+    static const uint8_t SlotsPerDay = 48;                  ///< Number of slots per day
+    static const uint16_t SlotMinutes = 24 * 60 / SlotsPerDay; ///< Duration of a slot in minutes
+    static const size_t DayBytes = SlotsPerDay * 3 / 8;     ///< Size of a day in bytes
+    static const size_t Size = 7 * DayBytes;                ///< Size of the week in bytes
+    static const uint8_t Hold = 0x07;                       ///< Slot value keeping the current mode
+
+    /**
+       @brief Constructor, all the slots hold the current mode.
+    */
+    PilotWireSchedule() {
+      clear();
+    }
+
+    /**
+       @brief Set all the slots to Hold.
+    */
+    void clear();
+
+    /**
+       @brief Check if at least one slot holds a mode.
+    */
+    bool isEmpty() const;
+
+    /**
+       @brief Get the value of a slot.
+       @param wday Day of the week, 0 is Sunday as in struct tm.
+       @param slot Slot index in the day, from 0 to SlotsPerDay - 1.
+       @return the mode of the slot, or Hold.
+    */
+    uint8_t slot (uint8_t wday, uint8_t slot) const;
+
+    /**
+       @brief Set the value of a slot.
+       @param wday Day of the week, 0 is Sunday as in struct tm.
+       @param slot Slot index in the day, from 0 to SlotsPerDay - 1.
+       @param mode The mode of the slot, or Hold.
+    */
+    void setSlot (uint8_t wday, uint8_t slot, uint8_t mode);
+
+    /**
+       @brief Set the value of consecutive slots of a day.
+       @param wday Day of the week, 0 is Sunday as in struct tm.
+       @param fromMinutes Start of the range in minutes since midnight, included.
+       @param toMinutes End of the range in minutes since midnight, excluded.
+       @param mode The mode of the range, or Hold.
+    */
+    void setRange (uint8_t wday, uint16_t fromMinutes, uint16_t toMinutes, uint8_t mode);
+
+    /**
+       @brief Get the slot value at a local time.
+       @param local The local time, as returned by gmtime_r() on a local timestamp.
+       @return the mode of the slot, or Hold.
+    */
+    uint8_t at (const struct tm &local) const {
+      return slot (local.tm_wday, (local.tm_hour * 60 + local.tm_min) / SlotMinutes);
+    }
+
+    /**
+       @brief Get the packed week, Size bytes.
+    */
+    const uint8_t *data() const {
+      return _data;
+    }
+
+    /**
+       @brief Load a packed week.
+       @param data The packed week.
+       @param len The length of data, must be Size.
+       @return true if the week was loaded, false if the length or a slot value is invalid.
+    */
+    bool load (const uint8_t *data, size_t len);
+
+  private:
+    uint8_t _data[Size];
+};
@@ -0,0 +1,354 @@
+/// @file PilotWireStore.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "PilotWireStore.h"
+#include "PilotWireTrace.h"
+#include <string.h>
+#include <esp_system.h>
+#include <esp32-hal-log.h>
+
+static const char RecordKey[] = "state";
+static const uint8_t RecordVersion = 1;
+
+// list of opened stores, shared by name and committed by the shutdown handler
+static PilotWireStore *s_stores = nullptr;
+static bool s_shutdown_registered = false;
+
+// ----------------------------------------------------------------------------
+PilotWireStore::PilotWireStore() :
+  _users (0), _count (0), _dirty (0),
+  _mux (portMUX_INITIALIZER_UNLOCKED), _timer (nullptr), _deadline_us (0),
+  _mode_delay_ms (PILOT_WIRE_NVS_MODE_DELAY_MS),
+  _summation_delay_ms (PILOT_WIRE_NVS_SUMMATION_DELAY_MS),
+  _commit_count (0), _bytes_written (0), _coalesced_count (0), _next (nullptr) {
+
+  _name[0] = '\0';
+  memset (_records, 0, sizeof (_records));
+}
+
+// ----------------------------------------------------------------------------
+PilotWireStore::~PilotWireStore() {
+
+  if (_timer != nullptr) {
+
+    esp_timer_delete (_timer);
+  }
+}
+
+// ----------------------------------------------------------------------------
+PilotWireStore *
+PilotWireStore::acquire (const char *name) {
+
+  for (PilotWireStore *p = s_stores; p != nullptr; p = p->_next) {
+
+    if (strncmp (p->_name, name, sizeof (p->_name)) == 0) {
+
+      p->_users++;
+      return p;
+    }
+  }
+
+  PilotWireStore *store = new PilotWireStore();
+  if (store->begin (name) == false) {
+
+    delete store;
+    return nullptr;
+  }
+  store->_users = 1;
+  return store;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireStore::release (PilotWireStore *store) {
+
+  if (store != nullptr && --store->_users == 0) {
+
+    store->end();
+    delete store;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private
+bool
+PilotWireStore::begin (const char *name) {
+
+  if (_prefs.begin (name, false) == false) {
+
+    log_e ("Failed to open NVS namespace %s", name);
+    return false;
+  }
+  strncpy (_name, name, sizeof (_name) - 1);
+  _name[sizeof (_name) - 1] = '\0';
+
+  const esp_timer_create_args_t args = {
+    .callback = timerCallback,
+    .arg = this,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "pw_nvs",
+    .skip_unhandled_events = true
+  };
+  if (esp_timer_create (&args, &_timer) != ESP_OK) {
+
+    log_w ("Failed to create NVS commit timer, falling back to write-through");
+    _timer = nullptr;
+  }
+
+  size_t len = _prefs.getBytesLength (RecordKey);
+  if (len != 0 && (len % sizeof (Record)) == 0 && len <= sizeof (_records) &&
+      _prefs.getBytes (RecordKey, _records, len) == len &&
+      _records[0].version == RecordVersion) {
+
+    _count = len / sizeof (Record);
+    _dirty = 0;
+  }
+  else {
+
+    // Migrate keys written by previous versions of the library,
+    // the record will be claimed by the first endpoint attached.
+    memset (_records, 0, sizeof (_records));
+    _records[0].version = RecordVersion;
+    _records[0].mode = static_cast<uint8_t> (_prefs.getInt ("mode", 0));
+    _records[0].flags = _prefs.getBool ("restore") ? 0x01 : 0x00;
+    _records[0].summation = _prefs.getULong64 ("summation");
+    _count = 1;
+    _dirty = DirtyMode | DirtyRestore | DirtySummation;
+    if (commit()) {
+
+      _prefs.remove ("mode");
+      _prefs.remove ("restore");
+      _prefs.remove ("summation");
+      log_i ("NVS state migrated to packed record");
+    }
+  }
+
+  _next = s_stores;
+  s_stores = this;
+  if (s_shutdown_registered == false) {
+
+    s_shutdown_registered = (esp_register_shutdown_handler (shutdownHandler) == ESP_OK);
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// private
+void
+PilotWireStore::end() {
+
+  if (_timer != nullptr) {
+
+    esp_timer_stop (_timer);
+  }
+  commit();
+  _prefs.end();
+
+  // unlink from the list of opened stores
+  for (PilotWireStore **p = &s_stores; *p != nullptr; p = & (*p)->_next) {
+    if (*p == this) {
+
+      *p = _next;
+      break;
+    }
+  }
+  _next = nullptr;
+}
+
+// ----------------------------------------------------------------------------
+int
+PilotWireStore::attach (uint8_t endpoint) {
+  int unclaimed = -1;
+
+  for (int i = 0; i < _count; i++) {
+
+    if (_records[i].endpoint == endpoint) {
+      return i;
+    }
+    if (_records[i].endpoint == 0 && unclaimed < 0) {
+      unclaimed = i;
+    }
+  }
+
+  if (unclaimed < 0) {
+
+    if (_count >= PILOT_WIRE_STORE_MAX_SLOTS) {
+
+      log_e ("No free NVS slot for endpoint %d", endpoint);
+      return -1;
+    }
+    unclaimed = _count;
+    portENTER_CRITICAL (&_mux);
+    _records[unclaimed] = {RecordVersion, 0, 0, 0, 0};
+    _count++;
+    portEXIT_CRITICAL (&_mux);
+  }
+
+  portENTER_CRITICAL (&_mux);
+  _records[unclaimed].endpoint = endpoint;
+  portEXIT_CRITICAL (&_mux);
+  markDirty (DirtyRestore, _mode_delay_ms);
+  return unclaimed;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireStore::setCommitDelay (uint32_t modeDelayMs, uint32_t summationDelayMs) {
+
+  _mode_delay_ms = modeDelayMs;
+  _summation_delay_ms = summationDelayMs;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireStore::setMode (int slot, uint8_t mode) {
+
+  if (mode != _records[slot].mode) {
+
+    portENTER_CRITICAL (&_mux);
+    _records[slot].mode = mode;
+    portEXIT_CRITICAL (&_mux);
+    markDirty (DirtyMode, _mode_delay_ms);
+  }
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireStore::setRestore (int slot, bool enable) {
+
+  if (enable != restore (slot)) {
+
+    portENTER_CRITICAL (&_mux);
+    _records[slot].flags = enable ? (_records[slot].flags | 0x01) : (_records[slot].flags & ~0x01);
+    portEXIT_CRITICAL (&_mux);
+    markDirty (DirtyRestore, _mode_delay_ms);
+  }
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireStore::setSummation (int slot, uint64_t summation) {
+
+  if (summation != _records[slot].summation) {
+
+    portENTER_CRITICAL (&_mux);
+    _records[slot].summation = summation;
+    portEXIT_CRITICAL (&_mux);
+    markDirty (DirtySummation, _summation_delay_ms);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private
+void
+PilotWireStore::markDirty (uint8_t flags, uint32_t delayMs) {
+  bool pending;
+
+  portENTER_CRITICAL (&_mux);
+  pending = (_dirty != 0);
+  _dirty |= flags;
+  if (pending) {
+
+    // the pending commit will take this change with it
+    _coalesced_count++;
+  }
+  portEXIT_CRITICAL (&_mux);
+
+  if (delayMs == 0 || _timer == nullptr) {
+
+    commit();
+    return;
+  }
+
+  int64_t deadline = esp_timer_get_time() + static_cast<int64_t> (delayMs) * 1000;
+  if (pending && esp_timer_is_active (_timer) && deadline >= _deadline_us) {
+    return;
+  }
+
+  // no commit pending or this change needs an earlier one
+  esp_timer_stop (_timer);
+  _deadline_us = deadline;
+  esp_timer_start_once (_timer, static_cast<uint64_t> (delayMs) * 1000);
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireStore::commit() {
+  Record records[PILOT_WIRE_STORE_MAX_SLOTS];
+  size_t len;
+
+  // a commit started later must not be overtaken by an older snapshot,
+  // the counters are only updated under this lock too
+  std::lock_guard<std::mutex> lock (_commit_mutex);
+  if (_dirty == 0) {
+    return true;
+  }
+
+  portENTER_CRITICAL (&_mux);
+  len = _count * sizeof (Record);
+  memcpy (records, _records, len);
+  _dirty = 0;
+  portEXIT_CRITICAL (&_mux);
+
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_NVS_BEGIN, 0, len);
+  bool written = (_prefs.putBytes (RecordKey, records, len) == len);
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_NVS_END, 0, len);
+  if (written == false) {
+
+    log_e ("Failed to commit Pilot Wire state to NVS");
+    portENTER_CRITICAL (&_mux);
+    _dirty |= DirtyMode | DirtyRestore | DirtySummation;
+    portEXIT_CRITICAL (&_mux);
+    return false;
+  }
+
+  _commit_count++;
+  _bytes_written += len;
+  log_v ("Pilot Wire state committed to NVS (%u commits)", _commit_count);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireStore::putBlob (const char *key, const void *data, size_t len) {
+  std::lock_guard<std::mutex> lock (_commit_mutex);
+
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_NVS_BEGIN, 0, len);
+  bool written = (_prefs.putBytes (key, data, len) == len);
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_NVS_END, 0, len);
+  if (written == false) {
+
+    log_e ("Failed to write %s to NVS", key);
+    return false;
+  }
+  _commit_count++;
+  _bytes_written += len;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool
+PilotWireStore::getBlob (const char *key, void *data, size_t len) {
+
+  return _prefs.getBytesLength (key) == len && _prefs.getBytes (key, data, len) == len;
+}
+
+// ----------------------------------------------------------------------------
+// private, called from the esp_timer task
+void
+PilotWireStore::timerCallback (void *arg) {
+
+  static_cast<PilotWireStore *> (arg)->commit();
+}
+
+// ----------------------------------------------------------------------------
+// private, called by esp_restart()
+void
+PilotWireStore::shutdownHandler() {
+
+  for (PilotWireStore *p = s_stores; p != nullptr; p = p->_next) {
+
+    p->commit();
+  }
+}
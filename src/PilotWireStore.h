@@ -0,0 +1,203 @@
+/// @file PilotWireStore.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <mutex>
+
+/**
+   @brief Default delay in milliseconds before a dirty mode or restore flag is committed to NVS.
+   A mode change is rare but must survive a power cut, so it is committed quickly.
+*/
+#ifndef PILOT_WIRE_NVS_MODE_DELAY_MS
+#define PILOT_WIRE_NVS_MODE_DELAY_MS  2000
+#endif
+
+/**
+   @brief Default delay in milliseconds before a dirty energy summation is committed to NVS.
+   The summation changes often, successive updates within this window are coalesced
+   into a single flash write.
+*/
+#ifndef PILOT_WIRE_NVS_SUMMATION_DELAY_MS
+#define PILOT_WIRE_NVS_SUMMATION_DELAY_MS  (15UL * 60UL * 1000UL)
+#endif
+
+/**
+   @brief Maximum number of endpoints sharing a store.
+*/
+#ifndef PILOT_WIRE_STORE_MAX_SLOTS
+#define PILOT_WIRE_STORE_MAX_SLOTS  8
+#endif
+
+/**
+   @brief Write-behind persistence of the Pilot Wire state in NVS.
+
+   The mode, the restore flag and the energy summation of each endpoint are
+   packed in a record, the records of all the endpoints sharing a NVS namespace
+   are stored under one NVS key. Setters only update the records in RAM and
+   mark the changed fields dirty, the records are written later by a one-shot
+   timer, when commit() is called (e.g. from a power-fail hook) or when the
+   system restarts. Several changes during the commit delay, on any endpoint,
+   cost one flash write.
+
+   Stores are shared: acquire() returns the store already opened on a namespace,
+   so several endpoints on the same board never overwrite each other's state.
+
+   This class only depends on the Preferences and esp_timer APIs, so it can be
+   exercised on a host with stubs of these two interfaces.
+*/
+class PilotWireStore {
+  public:
+    /**
+       @brief Packed record stored in NVS, one per endpoint.
+    */
+    struct __attribute__ ( (packed)) Record {
+      uint8_t version;    ///< Record layout version
+      uint8_t mode;       ///< Last Pilot Wire mode
+      uint8_t flags;      ///< Bit 0: restore state on startup
+      uint8_t endpoint;   ///< Owner endpoint, 0 if not yet claimed
+      uint64_t summation; ///< Energy summation delivered in Wh
+    };
+
+    /**
+       @brief Dirty flags of the record fields.
+    */
+    enum : uint8_t {
+      DirtyMode = 0x01,      ///< Mode changed
+      DirtyRestore = 0x02,   ///< Restore flag changed
+      DirtySummation = 0x04  ///< Energy summation changed
+    };
+
+    /**
+       @brief Get the store opened on a NVS namespace, open it if needed.
+       Each call must be balanced by a call to release().
+       @param name NVS namespace to use, at most 15 characters.
+       @return the shared store, nullptr if the namespace could not be opened.
+    */
+    static PilotWireStore *acquire (const char *name = "PilotWire");
+
+    /**
+       @brief Release a store returned by acquire().
+       The store is committed, closed and deleted when its last user releases it.
+    */
+    static void release (PilotWireStore *store);
+
+    /**
+       @brief Get the slot of an endpoint, claim a free one if needed.
+       @param endpoint The Zigbee endpoint number.
+       @return the slot index, -1 if all the slots are used.
+    */
+    int attach (uint8_t endpoint);
+
+    /**
+       @brief Set the commit delays.
+       @param modeDelayMs Delay before a dirty mode or restore flag is written, 0 for write-through.
+       @param summationDelayMs Delay before a dirty summation is written, 0 for write-through.
+    */
+    void setCommitDelay (uint32_t modeDelayMs, uint32_t summationDelayMs);
+
+    /**
+       @brief Write the records to NVS if some fields are dirty.
+       This is the method to call from a power-fail hook. Commits from the timer,
+       the application and the shutdown handler are serialized, so a record is
+       never overwritten by an older snapshot.
+       @return true if the records are clean after the call, false if the write failed.
+    */
+    bool commit();
+
+    uint8_t mode (int slot) const {
+      return _records[slot].mode;
+    }
+
+    bool restore (int slot) const {
+      return (_records[slot].flags & 0x01) != 0;
+    }
+
+    uint64_t summation (int slot) const {
+      return _records[slot].summation;
+    }
+
+    void setMode (int slot, uint8_t mode);
+    void setRestore (int slot, bool enable);
+    void setSummation (int slot, uint64_t summation);
+
+    /**
+       @brief Write an auxiliary blob (e.g. a weekly schedule) immediately.
+       Blobs are rarely written, they bypass the write-behind records but are counted.
+       @param key NVS key of the blob, at most 15 characters.
+       @param data The blob.
+       @param len The length of the blob.
+       @return true if the blob was written, false otherwise.
+    */
+    bool putBlob (const char *key, const void *data, size_t len);
+
+    /**
+       @brief Read an auxiliary blob.
+       @param key NVS key of the blob.
+       @param data Buffer receiving the blob.
+       @param len The size of the buffer, the blob is only read if its length is len.
+       @return true if the blob was read, false if it does not exist or its length differs.
+    */
+    bool getBlob (const char *key, void *data, size_t len);
+
+    /**
+       @brief Check if the records have pending changes.
+       @return a combination of the Dirty flags, 0 if the records are clean.
+    */
+    uint8_t dirty() const {
+      return _dirty;
+    }
+
+    /**
+       @brief Number of NVS commits since the store was opened.
+    */
+    uint32_t commitCount() const {
+      return _commit_count;
+    }
+
+    /**
+       @brief Number of bytes written in NVS since the store was opened.
+    */
+    uint32_t bytesWritten() const {
+      return _bytes_written;
+    }
+
+    /**
+       @brief Number of changes absorbed by an already pending commit since the store was opened.
+    */
+    uint32_t coalescedCount() const {
+      return _coalesced_count;
+    }
+
+  private:
+    PilotWireStore();
+    ~PilotWireStore();
+    PilotWireStore (const PilotWireStore &) = delete;
+    PilotWireStore &operator= (const PilotWireStore &) = delete;
+
+    bool begin (const char *name);
+    void end();
+    void markDirty (uint8_t flags, uint32_t delayMs);
+    static void timerCallback (void *arg);
+    static void shutdownHandler();
+
+    Preferences _prefs;
+    char _name[16];
+    uint8_t _users;
+    uint8_t _count;
+    Record _records[PILOT_WIRE_STORE_MAX_SLOTS];
+    volatile uint8_t _dirty;
+    portMUX_TYPE _mux;
+    std::mutex _commit_mutex; // serializes the NVS writes and their counters
+    esp_timer_handle_t _timer;
+    int64_t _deadline_us;
+    uint32_t _mode_delay_ms;
+    uint32_t _summation_delay_ms;
+    uint32_t _commit_count;
+    uint32_t _bytes_written;
+    uint32_t _coalesced_count;
+    PilotWireStore *_next;
+};
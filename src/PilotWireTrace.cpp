@@ -0,0 +1,139 @@
+/// @file PilotWireTrace.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "PilotWireTrace.h"
+#include <Arduino.h>
+
+#if PILOT_WIRE_TRACE
+#include <atomic>
+#include <esp_cpu.h>
+
+static_assert ( (PILOT_WIRE_TRACE_SIZE & (PILOT_WIRE_TRACE_SIZE - 1)) == 0, "PILOT_WIRE_TRACE_SIZE must be a power of two");
+
+static const char *const EventNames[PILOTWIRE_TRACE_EVENT_COUNT] = {
+  "attr set", "callback >", "callback <", "nvs >", "nvs <",
+  "lock ?", "lock >", "lock <", "report >", "report <"
+};
+
+// Stages measured by print(), between a begin and an end event
+static const struct {
+  uint8_t begin;
+  uint8_t end;
+  const char *name;
+} Stages[] = {
+  { PILOTWIRE_TRACE_ATTR_SET, PILOTWIRE_TRACE_CALLBACK_ENTER, "command" },
+  { PILOTWIRE_TRACE_CALLBACK_ENTER, PILOTWIRE_TRACE_CALLBACK_EXIT, "callback" },
+  { PILOTWIRE_TRACE_NVS_BEGIN, PILOTWIRE_TRACE_NVS_END, "nvs" },
+  { PILOTWIRE_TRACE_LOCK_REQUEST, PILOTWIRE_TRACE_LOCK_ACQUIRED, "lock wait" },
+  { PILOTWIRE_TRACE_LOCK_ACQUIRED, PILOTWIRE_TRACE_LOCK_RELEASE, "lock hold" },
+  { PILOTWIRE_TRACE_REPORT_BEGIN, PILOTWIRE_TRACE_REPORT_END, "report" }
+};
+static const size_t StageCount = sizeof (Stages) / sizeof (Stages[0]);
+
+static PilotWireTrace::Entry s_ring[PILOT_WIRE_TRACE_SIZE];
+static std::atomic<uint32_t> s_head (0);
+
+// ----------------------------------------------------------------------------
+void
+PilotWireTrace::record (uint8_t event, uint8_t endpoint, uint16_t arg) {
+  uint32_t cycles = esp_cpu_get_cycle_count();
+  Entry &e = s_ring[s_head.fetch_add (1, std::memory_order_relaxed) & (PILOT_WIRE_TRACE_SIZE - 1)];
+
+  e.cycles = cycles;
+  e.event = event;
+  e.endpoint = endpoint;
+  e.arg = arg;
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireTrace::clear() {
+
+  s_head.store (0);
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireTrace::print (Print &out, uint16_t events) {
+  uint32_t head = s_head.load();
+  uint32_t count = (head < PILOT_WIRE_TRACE_SIZE) ? head : PILOT_WIRE_TRACE_SIZE;
+  uint32_t mhz = getCpuFrequencyMhz();
+  uint32_t pending[StageCount];
+  bool started[StageCount] = {};
+  uint32_t n[StageCount] = {};
+  uint32_t min[StageCount] = {};
+  uint32_t max[StageCount] = {};
+  uint64_t sum[StageCount] = {};
+
+  // Events are replayed in order, each end event closes the last begin of its stage
+  for (uint32_t i = head - count; i != head; i++) {
+    const Entry &e = s_ring[i & (PILOT_WIRE_TRACE_SIZE - 1)];
+
+    for (size_t s = 0; s < StageCount; s++) {
+
+      if (e.event == Stages[s].end && started[s]) {
+        uint32_t d = e.cycles - pending[s];
+
+        if (n[s] == 0 || d < min[s]) {
+          min[s] = d;
+        }
+        if (d > max[s]) {
+          max[s] = d;
+        }
+        sum[s] += d;
+        n[s]++;
+        started[s] = false;
+      }
+      if (e.event == Stages[s].begin) {
+
+        pending[s] = e.cycles;
+        started[s] = true;
+      }
+    }
+  }
+
+  if (events > count) {
+    events = count;
+  }
+  out.printf ("Pilot Wire trace, %lu events, last %u:\n", (unsigned long) head, events);
+  for (uint32_t i = head - events; i != head; i++) {
+    const Entry &e = s_ring[i & (PILOT_WIRE_TRACE_SIZE - 1)];
+    const Entry &p = s_ring[ (i - 1) & (PILOT_WIRE_TRACE_SIZE - 1)];
+    uint32_t delta = (i == head - events) ? 0 : (e.cycles - p.cycles) / mhz;
+
+    out.printf ("  +%8lu us  %-10s ep %3u  0x%04X\n", (unsigned long) delta,
+                (e.event < PILOTWIRE_TRACE_EVENT_COUNT) ? EventNames[e.event] : "?",
+                e.endpoint, e.arg);
+  }
+
+  out.printf ("  %-10s %6s %9s %9s %9s\n", "stage", "n", "min us", "avg us", "max us");
+  for (size_t s = 0; s < StageCount; s++) {
+
+    out.printf ("  %-10s %6lu %9lu %9lu %9lu\n", Stages[s].name, (unsigned long) n[s],
+                (unsigned long) (min[s] / mhz),
+                (unsigned long) ( (n[s] != 0) ? sum[s] / n[s] / mhz : 0),
+                (unsigned long) (max[s] / mhz));
+  }
+}
+
+#else
+
+// ----------------------------------------------------------------------------
+void
+PilotWireTrace::record (uint8_t, uint8_t, uint16_t) {
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireTrace::clear() {
+}
+
+// ----------------------------------------------------------------------------
+void
+PilotWireTrace::print (Print &out, uint16_t) {
+
+  out.println ("Pilot Wire trace disabled, build with -DPILOT_WIRE_TRACE=1");
+}
+
+#endif
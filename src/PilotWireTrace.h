@@ -0,0 +1,95 @@
+/// @file PilotWireTrace.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include <stdint.h>
+
+/**
+   @brief Enable the hot-path trace recorder.
+   When 0 (default), the trace points are removed at compile time and cost nothing.
+   Define it to 1 in the build flags (e.g. -DPILOT_WIRE_TRACE=1) to record them.
+*/
+#ifndef PILOT_WIRE_TRACE
+#define PILOT_WIRE_TRACE  0
+#endif
+
+/**
+   @brief Number of events kept in the trace ring, must be a power of two.
+*/
+#ifndef PILOT_WIRE_TRACE_SIZE
+#define PILOT_WIRE_TRACE_SIZE  256
+#endif
+
+/**
+   @brief Events recorded by the trace points.
+   Events come in pairs delimiting a stage, except PILOTWIRE_TRACE_ATTR_SET
+   which starts the command-to-callback latency.
+*/
+enum PilotWireTraceEvent : uint8_t {
+  PILOTWIRE_TRACE_ATTR_SET = 0,   ///< zbAttributeSet() entry
+  PILOTWIRE_TRACE_CALLBACK_ENTER, ///< Mode change callback entry
+  PILOTWIRE_TRACE_CALLBACK_EXIT,  ///< Mode change callback exit
+  PILOTWIRE_TRACE_NVS_BEGIN,      ///< NVS write start
+  PILOTWIRE_TRACE_NVS_END,        ///< NVS write end
+  PILOTWIRE_TRACE_LOCK_REQUEST,   ///< Zigbee lock requested
+  PILOTWIRE_TRACE_LOCK_ACQUIRED,  ///< Zigbee lock acquired
+  PILOTWIRE_TRACE_LOCK_RELEASE,   ///< Zigbee lock released
+  PILOTWIRE_TRACE_REPORT_BEGIN,   ///< esp_zb_zcl_report_attr_cmd_req() call
+  PILOTWIRE_TRACE_REPORT_END,     ///< esp_zb_zcl_report_attr_cmd_req() return
+  PILOTWIRE_TRACE_EVENT_COUNT
+};
+
+class Print;
+
+/**
+   @brief Hot-path trace recorder.
+
+   The trace points record the CPU cycle counter in a fixed-size RAM ring,
+   from any task, without lock. print() dumps the last events and the
+   min/avg/max duration of each stage:
+   - command: zbAttributeSet() entry to callback entry
+   - callback: callback entry to exit
+   - nvs: NVS write
+   - lock wait: lock request to acquisition
+   - lock hold: lock acquisition to release
+   - report: report request to the Zigbee stack
+   .
+   When a radiator switches late, this tells whether the delay came from the
+   stack task, the user callback, an NVS commit or the lock.
+*/
+class PilotWireTrace {
+  public:
+    /**
+       @brief An event of the trace ring.
+    */
+    struct Entry {
+      uint32_t cycles;  ///< CPU cycle counter
+      uint8_t event;    ///< PilotWireTraceEvent
+      uint8_t endpoint; ///< Endpoint, 0 if not related to an endpoint
+      uint16_t arg;     ///< Event argument (attribute ID, mode...)
+    };
+
+    /**
+       @brief Record an event, use the PILOT_WIRE_TRACE_EVENT() macro instead.
+    */
+    static void record (uint8_t event, uint8_t endpoint = 0, uint16_t arg = 0);
+
+    /**
+       @brief Print the last events and the statistics of each stage.
+       @param out The Print object to output the trace to.
+       @param events The maximum number of events to print, 0 for the statistics only.
+    */
+    static void print (Print &out, uint16_t events = 32);
+
+    /**
+       @brief Clear the trace ring.
+    */
+    static void clear();
+};
+
+#if PILOT_WIRE_TRACE
+#define PILOT_WIRE_TRACE_EVENT(...)  PilotWireTrace::record (__VA_ARGS__)
+#else
+#define PILOT_WIRE_TRACE_EVENT(...)  do {} while (0)
+#endif
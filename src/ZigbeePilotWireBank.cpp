@@ -0,0 +1,167 @@
+/// @file ZigbeePilotWireBank.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+
+#include "ZigbeePilotWireBank.h"
+#include <ZigbeeCore.h>
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::ZigbeePilotWireBankT (uint8_t firstEndpoint, uint8_t count,
+    float tempMin, float tempMax, uint32_t meteringMultiplier) :
+  _first_endpoint (firstEndpoint), _count (count) {
+
+  if (_count > PILOT_WIRE_BANK_MAX_ZONES) {
+
+    log_w ("Too many zones, limited to %d", PILOT_WIRE_BANK_MAX_ZONES);
+    _count = PILOT_WIRE_BANK_MAX_ZONES;
+  }
+
+  for (uint8_t i = 0; i < _count; i++) {
+
+    _zones[i] = new Zone (_first_endpoint + i, tempMin, tempMax, meteringMultiplier);
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::~ZigbeePilotWireBankT() {
+
+  for (uint8_t i = 0; i < _count; i++) {
+
+    delete _zones[i];
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+int
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::zoneOf (uint8_t endpoint) const {
+
+  if (endpoint >= _first_endpoint && endpoint < _first_endpoint + _count) {
+
+    return endpoint - _first_endpoint;
+  }
+  return -1;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::onPilotWireModeChange (void (*callback) (uint8_t endpoint, ZigbeePilotWireMode mode)) {
+
+  for (uint8_t i = 0; i < _count; i++) {
+
+    _zones[i]->onPilotWireModeChange (callback);
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::begin() {
+
+  for (uint8_t i = 0; i < _count; i++) {
+
+    Zone *z = _zones[i];
+    bool status;
+
+    if (z->temperatureEnabled() && z->meteringEnabled()) {
+      status = z->begin (NAN, 0);
+    }
+    else if (z->temperatureEnabled()) {
+      status = z->begin (NAN);
+    }
+    else if (z->meteringEnabled()) {
+      status = z->begin (static_cast<int32_t> (0));
+    }
+    else {
+      status = z->begin();
+    }
+
+    if (status == false) {
+
+      log_e ("Failed to initialize zone %d on EP %d", i, _first_endpoint + i);
+      return false;
+    }
+  }
+  log_i ("%d Pilot Wire zones initialized from EP %d", _count, _first_endpoint);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::addEndpoints() {
+  bool status = true;
+
+  for (uint8_t i = 0; i < _count; i++) {
+
+    if (Zigbee.addEndpoint (_zones[i]) == false) {
+
+      log_e ("Failed to add zone %d endpoint to Zigbee Core", i);
+      status = false;
+    }
+  }
+  return status;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::enableNvs (bool enable) {
+
+  for (uint8_t i = 0; i < _count; i++) {
+
+    _zones[i]->enableNvs (enable);
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::setNvsCommitDelay (uint32_t modeDelayMs, uint32_t summationDelayMs) {
+
+  // the store is shared, the first zone is enough
+  if (_count > 0) {
+
+    _zones[0]->setNvsCommitDelay (modeDelayMs, summationDelayMs);
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::commitNvs() {
+
+  return (_count > 0) ? _zones[0]->commitNvs() : true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireBankT<WithTemperature, WithMetering>::reportAttributes() {
+  bool status = true;
+
+  // The callbacks are invoked outside of the Zigbee lock
+  for (uint8_t i = 0; i < _count; i++) {
+
+    _zones[i]->pilotWireModeChanged();
+  }
+
+  ZigbeePilotWireLock::zbLock();
+  for (uint8_t i = 0; i < _count; i++) {
+
+    if (_zones[i]->reportAttributesLocked() == false) {
+      status = false;
+    }
+  }
+  ZigbeePilotWireLock::zbUnlock();
+  return status;
+}
+
+// Every combination is instantiated, the unused ones are discarded by the linker
+template class ZigbeePilotWireBankT<false, false>;
+template class ZigbeePilotWireBankT<true, false>;
+template class ZigbeePilotWireBankT<false, true>;
+template class ZigbeePilotWireBankT<true, true>;
@@ -0,0 +1,142 @@
+/// @file ZigbeePilotWireBank.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include "ZigbeePilotWireControl.h"
+
+/**
+   @brief Maximum number of zones in a bank.
+*/
+#ifndef PILOT_WIRE_BANK_MAX_ZONES
+#define PILOT_WIRE_BANK_MAX_ZONES  PILOT_WIRE_STORE_MAX_SLOTS
+#endif
+
+/**
+   @brief Class template of a bank of Pilot Wire Control endpoints driven by a single module.
+
+   Each zone is a ZigbeePilotWireControlT<WithTemperature, WithMetering> endpoint
+   with its own mode and persisted state. All the zones share one NVS store, so a
+   burst of changes on several zones costs a single flash write, and
+   reportAttributes() updates all the zones with a single acquisition of the Zigbee lock.
+   @tparam WithTemperature true to build the temperature measurement cluster of the zones.
+   @tparam WithMetering true to build the simple metering cluster of the zones.
+*/
+template <bool WithTemperature, bool WithMetering>
+class ZigbeePilotWireBankT {
+  public:
+    /**
+       @brief Pilot Wire Control endpoint of a zone.
+    */
+    using Zone = ZigbeePilotWireControlT<WithTemperature, WithMetering>;
+
+    /**
+       @brief Constructor for ZigbeePilotWireBank.
+       You must call begin() after constructing the object to initialize the endpoints.
+       @param firstEndpoint The Zigbee endpoint number of the first zone,
+        the following zones use the next endpoint numbers.
+       @param count The number of zones, at most PILOT_WIRE_BANK_MAX_ZONES.
+       @param tempMin The minimum temperature of the zones in degrees Celsius, NAN to disable
+        the temperature measurement cluster.
+       @param tempMax The maximum temperature of the zones in degrees Celsius, NAN to disable
+        the temperature measurement cluster.
+       @param meteringMultiplier The multiplier of the metering cluster of the zones, 0 to disable it.
+    */
+    ZigbeePilotWireBankT (uint8_t firstEndpoint, uint8_t count,
+                          float tempMin = NAN, float tempMax = NAN, uint32_t meteringMultiplier = 0);
+
+    /**
+       @brief Destructor for ZigbeePilotWireBank.
+       The zones must have been removed from the Zigbee core before.
+    */
+    ~ZigbeePilotWireBankT();
+
+    /**
+       @brief Get the number of zones.
+    */
+    uint8_t count() const {
+      return _count;
+    }
+
+    /**
+       @brief Get a zone.
+       @param index The zone index, from 0 to count() - 1.
+       @return the Pilot Wire Control endpoint of the zone.
+    */
+    Zone &zone (uint8_t index) {
+      return *_zones[index];
+    }
+
+    Zone &operator[] (uint8_t index) {
+      return *_zones[index];
+    }
+
+    /**
+       @brief Get the zone index of an endpoint.
+       @param endpoint The Zigbee endpoint number, as received by the callback.
+       @return the zone index, -1 if the endpoint does not belong to the bank.
+    */
+    int zoneOf (uint8_t endpoint) const;
+
+    /**
+       @brief Set a callback function to be called when the Pilot Wire mode of a zone changes.
+       This function must be called before to call begin().
+       @param callback A function pointer to the callback function.
+       The callback function should have the following signature:
+       void callback(uint8_t endpoint, ZigbeePilotWireMode mode);
+       Use zoneOf() to get the zone index from the endpoint number.
+    */
+    void onPilotWireModeChange (void (*callback) (uint8_t endpoint, ZigbeePilotWireMode mode));
+
+    /**
+       @brief Initialize the endpoints of all the zones.
+       The temperature measurement and metering clusters enabled by the constructor
+       are created with an unknown temperature and no power, update them per zone.
+       @return true if the initialization was successful, false otherwise.
+       @note This method must be called before to add the endpoints to the Zigbee core.
+    */
+    bool begin();
+
+    /**
+       @brief Add the endpoints of all the zones to the Zigbee core.
+       @return true if all the endpoints were added, false otherwise.
+    */
+    bool addEndpoints();
+
+    /**
+       @brief Enable or disable restore mode on all the zones.
+       @param enable true to enable restore mode, false to disable.
+    */
+    void enableNvs (bool enable);
+
+    /**
+       @brief Set the delays before pending changes are committed to NVS.
+       The delays apply to the store shared by all the zones.
+       @see ZigbeePilotWireControl::setNvsCommitDelay()
+    */
+    void setNvsCommitDelay (uint32_t modeDelayMs, uint32_t summationDelayMs);
+
+    /**
+       @brief Write pending changes of all the zones to NVS immediately, with a single commit.
+       @return true if NVS is up to date, false if the write failed.
+    */
+    bool commitNvs();
+
+    /**
+       @brief Report the current attributes of all the zones to the Zigbee network.
+       The callbacks are invoked first, then all the attributes are updated
+       with a single acquisition of the Zigbee lock.
+       @return true if the attributes were reported successfully, false otherwise.
+    */
+    bool reportAttributes();
+
+  private:
+    uint8_t _first_endpoint;
+    uint8_t _count;
+    Zone *_zones[PILOT_WIRE_BANK_MAX_ZONES];
+};
+
+/**
+   @brief Bank of zones with the temperature measurement and metering clusters, enabled by its constructor.
+*/
+using ZigbeePilotWireBank = ZigbeePilotWireBankT<true, true>;
@@ -3,6 +3,8 @@
 /// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
 
 #include "ZigbeePilotWireControl.h"
+#include <esp_heap_caps.h>
+#include <ZigbeeCore.h>
 
 // ----------------------------------------------------------------------------
 static int16_t
@@ -11,7 +13,7 @@ zb_float_to_s16 (float temp) {
   if (isnan (temp)) {
     return ESP_ZB_ZCL_TEMP_MEASUREMENT_MEASURED_VALUE_DEFAULT; // valeur invalide normalisée ZCL
   }
-  return (int16_t) (temp * 100.0f);
+  return (int16_t) lroundf (temp * 100.0f);
 }
 
 // ----------------------------------------------------------------------------
@@ -70,31 +72,107 @@ static inline esp_zb_uint24_t u32_to_esp_zb_uint24 (uint32_t v) {
   return out;
 }
 
+// Cluster and attribute of each ZigbeePilotWireAttribute
+static const struct {
+  uint16_t cluster_id;
+  uint16_t attr_id;
+  uint16_t manuf_code;
+} ReportTargets[PILOTWIRE_ATTR_COUNT] = {
+  { PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MODE_ATTR_ID, PILOT_WIRE_MANUF_CODE },
+  { ESP_ZB_ZCL_CLUSTER_ID_ON_OFF, ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC },
+  { ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC },
+  { ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC },
+  { ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC }
+};
+
+// Instantaneous demand formatting (U8, 0x0304), 2 digits before decimal, 3 digits after decimal
+static uint8_t DemandFormatting = ESP_ZB_ZCL_METERING_FORMATTING_SET (false, 2, 3);
+
+// Initial value of the history chunk (octet string), its length sets the size allocated by the stack
+static uint8_t HistoryChunkInit[1 + PILOT_WIRE_HISTORY_CHUNK] = { PILOT_WIRE_HISTORY_CHUNK };
+
+// Initial value of the delta block, its length makes the stack allocate the largest block
+static uint8_t DeltaBlockInit[1 + 4 + PILOT_WIRE_DELTA_BLOCK] = { 4 + PILOT_WIRE_DELTA_BLOCK };
+
+// Version of the exported reporting table
+static const uint8_t ReportingVersion = 1;
+
+// Attributes whose reporting can be widened by the governor
+static const uint32_t GovernedAttributes = PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_TEMPERATURE) |
+                                           PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_ENERGY) |
+                                           PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_POWER);
+
+TaskHandle_t ZigbeePilotWireLock::_lock_owner = nullptr;
+uint16_t ZigbeePilotWireLock::_lock_depth = 0;
+uint32_t ZigbeePilotWireLock::_lock_count = 0;
+uint64_t ZigbeePilotWireLock::_lock_wait_total_us = 0;
+uint32_t ZigbeePilotWireLock::_lock_wait_max_us = 0;
+
 // ----------------------------------------------------------------------------
-ZigbeePilotWireControl::ZigbeePilotWireControl (uint8_t endpoint, float tempMin, float tempMax,
-                                                uint32_t meteringMultiplier) :
-  ZigbeeEP (endpoint), _current_mode (PILOTWIRE_MODE_OFF),
-  _state_on_mode (PILOTWIRE_MODE_COMFORT), _on_mode_change (nullptr),
-  _current_state (false), _current_state_changed (true), _nvs_enabled (false),
+ZigbeePilotWireTemperature<true>::ZigbeePilotWireTemperature (float tempMin, float tempMax) :
   _temperature_enabled (isnan (tempMin) == false && isnan (tempMax) == false),
   _temperature_cfg ({
   .measured_value = ESP_ZB_ZCL_TEMP_MEASUREMENT_MEASURED_VALUE_DEFAULT, // Invalid value
   .min_value = zb_float_to_s16 (tempMin),
   .max_value = zb_float_to_s16 (tempMax),
 }),
-_temperature_value (NAN),
-                   _metering_enabled (meteringMultiplier != 0),
-                   _summationDelivered (u64_to_esp_zb_uint48 (0)),
-                   _instantaneousDemand (i32_to_esp_zb_sint24 (0)),
-                   _multiplier (u32_to_esp_zb_uint24 (meteringMultiplier)),
-                   _divisor (u32_to_esp_zb_uint24 (1000)),
+_temperature_value (NAN), _temperature_delta (0), _temperature_threshold (50),
+_temperature_written (ESP_ZB_ZCL_TEMP_MEASUREMENT_MEASURED_VALUE_DEFAULT), _temperature_samples (0), _temperature_writes (0) {
+}
+
+// ----------------------------------------------------------------------------
+ZigbeePilotWireMetering<true>::ZigbeePilotWireMetering (uint32_t meteringMultiplier) :
+  _metering_enabled (meteringMultiplier != 0),
+  _summationDelivered (u64_to_esp_zb_uint48 (0)),
+  _instantaneousDemand (i32_to_esp_zb_sint24 (0)),
+  _multiplier (u32_to_esp_zb_uint24 (meteringMultiplier)),
+  _divisor (u32_to_esp_zb_uint24 (1000)),
 _metering_cfg ({
   .current_summation_delivered = _summationDelivered, // 0x0000 U48 Current summation delivered Wh
   .status = ESP_ZB_ZCL_METERING_STATUS_DEFAULT_VALUE, // 0x0200 MAP8 Metering status
   .uint_of_measure = ESP_ZB_ZCL_METERING_UNIT_KW_KWH_BINARY,       // 0x0300 MAP8 kWh/kW
   .summation_formatting = ESP_ZB_ZCL_METERING_FORMATTING_SET (false, 7, 3), // 0x0303 MAP8 Summation formatting, 7 digits before decimal, 3 digits after decimal
   .metering_device_type = ESP_ZB_ZCL_METERING_ELECTRIC_METERING    // 0x0306 MAP8 Electric Energy Meter
-}) {
+}),
+_energy_integration (false), _power_estimation (false), _energy_last_ms (0), _energy_residual (0),
+_energy_mux (portMUX_INITIALIZER_UNLOCKED), _nominal_power(), _pulse_meter (nullptr) {
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::ZigbeePilotWireControlT (uint8_t endpoint, float tempMin, float tempMax,
+                                                uint32_t meteringMultiplier) :
+  ZigbeeEP (endpoint),
+  ZigbeePilotWireTemperature<WithTemperature> (tempMin, tempMax),
+  ZigbeePilotWireMetering<WithMetering> (meteringMultiplier),
+  _current_mode (PILOTWIRE_MODE_OFF),
+  _state_on_mode (PILOTWIRE_MODE_COMFORT), _on_mode_change (nullptr), _on_endpoint_mode_change (nullptr),
+  _output (nullptr),
+  _current_state (false), _current_state_changed (true), _nvs_enabled (false),
+  _store (nullptr), _store_slot (-1), _last_reported(), _reported_mask (0),
+  _queue_enabled (false), _queue (nullptr),
+  _settle_window_ms (PILOT_WIRE_SETTLE_MS), _settle_timer (nullptr), _settle_open (false),
+  _settle_mode (PILOTWIRE_MODE_OFF), _settle_on_mode (PILOTWIRE_MODE_COMFORT), _settle_count (0), _settle_stats(),
+  _settled_pending (false), _settled_mode (PILOTWIRE_MODE_OFF), _settled_on_mode (PILOTWIRE_MODE_COMFORT),
+  _settle_mux (portMUX_INITIALIZER_UNLOCKED),
+  _schedule_enabled (false), _schedule (nullptr), _schedule_timer (nullptr),
+  _schedule_mux (portMUX_INITIALIZER_UNLOCKED),
+  _reporting(), _reporting_mask (0), _reporting_pending (0),
+  _governor_enabled (false), _governor_budget (PILOT_WIRE_GOVERNOR_BUDGET), _governor (nullptr),
+  _history_enabled (false), _history (nullptr), _history_offset (0), _history_timer (nullptr),
+  _history_mux (portMUX_INITIALIZER_UNLOCKED),
+  _status_enabled (false), _status_attr(), _groups_enabled (false),
+  _ota_enabled (false), _ota_file_version (0), _ota_hw_version (0),
+  _delta_patcher (nullptr), _delta_block (nullptr), _delta_ready (false), _delta_offset (0), _delta_status (0),
+  _budget_enabled (false), _power_budget (0), _house_power (-1), _house_power_us (0),
+  _diag_enabled (false), _diag(), _diag_attr (nullptr), _callback_count (0), _callback_total_us (0),
+  _pending (0), _pending_reports (0), _deferred_stats(), _local_pending (PilotWireSchedule::Hold),
+  _stack_work_posted (false), _stack_retry_timer (nullptr), _next_endpoint (nullptr),
+  _thermostat_enabled (false), _occupied_setpoint (2000), _unoccupied_setpoint (1600),
+  _system_mode (ESP_ZB_ZCL_THERMOSTAT_SYSTEM_MODE_HEAT), _occupancy (1), _heating_demand (0),
+  _thermostat_step (50), _thermostat_hysteresis (20), _thermostat_level (-1),
+  _begin_stats(), _begin_start_us (0), _begin_free_heap (0), _begin_largest_block (0),
+  _boot_stats() {
 
   _device_id = ESP_ZB_HA_SMART_PLUG_DEVICE_ID;
 
@@ -105,32 +183,114 @@ _metering_cfg ({
     .app_device_id = ESP_ZB_HA_SMART_PLUG_DEVICE_ID,
     .app_device_version = 0
   };
+
+  portENTER_CRITICAL (&_endpoints_mux);
+  _next_endpoint = _first_endpoint;
+  _first_endpoint = this;
+  portEXIT_CRITICAL (&_endpoints_mux);
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::~ZigbeePilotWireControlT() {
+
+  end();
+
+  // no alarm can find the endpoint from now on
+  portENTER_CRITICAL (&_endpoints_mux);
+  for (ZigbeePilotWireControlT **ep = &_first_endpoint; *ep != nullptr; ep = & (*ep)->_next_endpoint) {
+
+    if (*ep == this) {
+
+      *ep = _next_endpoint;
+      break;
+    }
+  }
+  portEXIT_CRITICAL (&_endpoints_mux);
+
+  delete _queue;
+  delete _schedule;
+  delete _governor;
+  delete[] _diag_attr;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::ZigbeePilotWireControlT (uint8_t endpoint) :
+  ZigbeePilotWireControlT (endpoint, NAN, NAN, 0) {
 }
 
 // ----------------------------------------------------------------------------
-ZigbeePilotWireControl::ZigbeePilotWireControl (uint8_t endpoint) :
-  ZigbeePilotWireControl (endpoint, NAN, NAN, 0) {
+template <bool WithTemperature, bool WithMetering>
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::ZigbeePilotWireControlT (uint8_t endpoint, float tempMin, float tempMax) :
+  ZigbeePilotWireControlT (endpoint, tempMin, tempMax, 0) {
 }
 
 // ----------------------------------------------------------------------------
-ZigbeePilotWireControl::ZigbeePilotWireControl (uint8_t endpoint, float tempMin, float tempMax) :
-  ZigbeePilotWireControl (endpoint, tempMin, tempMax, 0) {
+template <bool WithTemperature, bool WithMetering>
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::ZigbeePilotWireControlT (uint8_t endpoint, uint32_t meteringMultiplier) :
+  ZigbeePilotWireControlT (endpoint, NAN, NAN, meteringMultiplier) {
 }
 
 // ----------------------------------------------------------------------------
-ZigbeePilotWireControl::ZigbeePilotWireControl (uint8_t endpoint, uint32_t meteringMultiplier) :
-  ZigbeePilotWireControl (endpoint, NAN, NAN, meteringMultiplier) {
+// protected method, adds the attributes of a descriptor table to a cluster
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::buildAttributes (esp_zb_attribute_list_t *list, uint16_t cluster_id, uint16_t manuf_code,
+    const AttributeDesc *table, size_t count) {
+
+  for (size_t i = 0; i < count; i++) {
+    const AttributeDesc &desc = table[i];
+
+    for (uint8_t index = 0; index < desc.count; index++) {
+      uint16_t attr_id = desc.id + index;
+      esp_err_t err;
+
+      if (desc.storage == nullptr) {
+        esp_zb_attribute_list_t *p = list;
+
+        // attribute created with the cluster, only its access is completed
+        while (p != nullptr && (p->attribute.type == ESP_ZB_ZCL_ATTR_TYPE_NULL || p->attribute.id != attr_id)) {
+          p = p->next;
+        }
+        if (p == nullptr) {
+          log_e ("Attribute 0x%04X not found in cluster 0x%04X", attr_id, cluster_id);
+          return false;
+        }
+        p->attribute.access |= desc.access;
+      }
+      else {
+        void *value = desc.storage (this, index);
+
+        if (manuf_code == ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC) {
+
+          err = esp_zb_cluster_add_attr (list, cluster_id, attr_id, desc.type, desc.access, value);
+        }
+        else {
+
+          err = esp_zb_cluster_add_manufacturer_attr (list, cluster_id, attr_id, manuf_code, desc.type, desc.access, value);
+        }
+        if (err != ESP_OK) {
+          log_e ("Failed to add attribute 0x%04X to cluster 0x%04X: %s", attr_id, cluster_id, esp_err_to_name (err));
+          return false;
+        }
+      }
+      _begin_stats.attributes++;
+    }
+  }
+  return true;
 }
 
 // ----------------------------------------------------------------------------
 // protected methods
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::createPilotWireCluster() {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::createPilotWireCluster() {
   esp_err_t err;
 
   if (_nvs_enabled) {
 
-    _current_mode = _prefs.getInt ("mode", PILOTWIRE_MODE_OFF);
+    _current_mode = _store->mode (_store_slot);
     log_i ("Restored mode from NVS: %d", _current_mode);
   }
   else {
@@ -182,6 +342,28 @@ ZigbeePilotWireControl::createPilotWireCluster() {
     return false;
   }
 
+  if (_groups_enabled) {
+
+    // a single groupcast frame reaches all the endpoints of a group,
+    // and the On/Off state can be recalled by a scene
+    err = esp_zb_cluster_list_add_groups_cluster (_cluster_list,
+                                                  esp_zb_groups_cluster_create (NULL),
+                                                  ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    if (err != ESP_OK) {
+      log_e ("Failed to add Groups cluster to Pilot Wire Control endpoint");
+      return false;
+    }
+
+    err = esp_zb_cluster_list_add_scenes_cluster (_cluster_list,
+                                                  esp_zb_scenes_cluster_create (NULL),
+                                                  ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    if (err != ESP_OK) {
+      log_e ("Failed to add Scenes cluster to Pilot Wire Control endpoint");
+      return false;
+    }
+    log_i ("Groups and Scenes clusters added on EP %d", _endpoint);
+  }
+
   // Create custom Pilot Wire cluster with manufacturer-specific attribute
   esp_zb_attribute_list_t *pilot_wire_cluster = esp_zb_zcl_attr_list_create (PILOT_WIRE_CLUSTER_ID);
   if (pilot_wire_cluster == nullptr) {
@@ -189,21 +371,132 @@ ZigbeePilotWireControl::createPilotWireCluster() {
     return false;
   }
 
-  // Add manufacturer-specific attribute for Pilot Wire mode
-  err = esp_zb_cluster_add_manufacturer_attr (
-          pilot_wire_cluster,
-          PILOT_WIRE_CLUSTER_ID,
-          PILOT_WIRE_MODE_ATTR_ID,
-          PILOT_WIRE_MANUF_CODE,
-          ESP_ZB_ZCL_ATTR_TYPE_U8,
-          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
-          &_current_mode
-        );
-  if (err != ESP_OK) {
-    log_e ("Failed to add Pilot Wire mode attribute to Pilot Wire cluster");
+  // Manufacturer-specific attributes
+  static constexpr AttributeDesc ModeAttributes[] = {
+    {
+      PILOT_WIRE_MODE_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U8,
+      ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_current_mode; }
+    }
+  };
+  static constexpr AttributeDesc StatusAttributes[] = {
+    {
+      PILOT_WIRE_STATUS_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+      ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return ep->_status_attr; }
+    }
+  };
+  static constexpr AttributeDesc DiagAttributes[] = {
+    {
+      PILOT_WIRE_DIAG_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U32, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, PILOT_WIRE_DIAG_COUNT,
+      [] (ZigbeePilotWireControlT * ep, uint8_t i) -> void * { return &ep->_diag_attr[i]; }
+    }
+  };
+  static constexpr AttributeDesc ScheduleAttributes[] = {
+    {
+      PILOT_WIRE_SCHEDULE_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return ep->_schedule->attr; }
+    }
+  };
+  static constexpr AttributeDesc HistoryAttributes[] = {
+    {
+      PILOT_WIRE_HISTORY_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, 1,
+      [] (ZigbeePilotWireControlT *, uint8_t) -> void * { return HistoryChunkInit; }
+    },
+    {
+      PILOT_WIRE_HISTORY_OFFSET_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_history_offset; }
+    }
+  };
+  static constexpr AttributeDesc DeltaAttributes[] = {
+    {
+      PILOT_WIRE_DELTA_BLOCK_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, 1,
+      [] (ZigbeePilotWireControlT *, uint8_t) -> void * { return DeltaBlockInit; }
+    },
+    {
+      PILOT_WIRE_DELTA_OFFSET_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U32,
+      ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_delta_offset; }
+    },
+    {
+      PILOT_WIRE_DELTA_STATUS_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U8,
+      ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_delta_status; }
+    }
+  };
+  static constexpr AttributeDesc BudgetAttributes[] = {
+    {
+      PILOT_WIRE_BUDGET_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_S32, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_power_budget; }
+    },
+    {
+      PILOT_WIRE_HOUSE_POWER_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_S32, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_house_power; }
+    }
+  };
+
+  if (buildAttributes (pilot_wire_cluster, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MANUF_CODE, ModeAttributes) == false) {
     return false;
   }
 
+  if (_status_enabled) {
+
+    // Packed status, the snapshot is taken when the stack runs
+    _status_attr[0] = PILOT_WIRE_STATUS_SIZE;
+    _status_attr[1] = PILOT_WIRE_STATUS_VERSION;
+    if (buildAttributes (pilot_wire_cluster, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MANUF_CODE, StatusAttributes) == false) {
+      return false;
+    }
+  }
+
+  if (_diag_enabled) {
+    ZigbeePilotWireDiagnostics diag = diagnostics();
+
+    // Performance counters
+    memcpy (_diag_attr, &diag, PILOT_WIRE_DIAG_COUNT * sizeof (uint32_t));
+    if (buildAttributes (pilot_wire_cluster, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MANUF_CODE, DiagAttributes) == false) {
+      return false;
+    }
+  }
+
+  if (_schedule_enabled) {
+
+    // Weekly schedule
+    _schedule->attr[0] = PilotWireSchedule::Size;
+    memcpy (&_schedule->attr[1], _schedule->week.data(), PilotWireSchedule::Size);
+    if (buildAttributes (pilot_wire_cluster, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MANUF_CODE, ScheduleAttributes) == false) {
+      return false;
+    }
+  }
+
+  if (_history_enabled) {
+
+    // Telemetry history, the chunk is allocated by the stack at its full size
+    if (buildAttributes (pilot_wire_cluster, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MANUF_CODE, HistoryAttributes) == false) {
+      return false;
+    }
+  }
+
+  if (_delta_patcher != nullptr) {
+
+    // Delta OTA, one block at a time between the stack task and updateDeltaOta()
+    if (_delta_block == nullptr) {
+
+      _delta_block = new DeltaBlock();
+    }
+    if (buildAttributes (pilot_wire_cluster, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MANUF_CODE, DeltaAttributes) == false) {
+      return false;
+    }
+  }
+
+  if (_budget_enabled) {
+
+    // Whole-house power budget
+    if (buildAttributes (pilot_wire_cluster, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MANUF_CODE, BudgetAttributes) == false) {
+      return false;
+    }
+  }
+
   // Add custom Pilot Wire cluster to cluster list
   err = esp_zb_cluster_list_add_custom_cluster (_cluster_list,
                                                 pilot_wire_cluster,
@@ -219,163 +512,446 @@ ZigbeePilotWireControl::createPilotWireCluster() {
 
 // ----------------------------------------------------------------------------
 // protected methods
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::createTemperatureMeasurementCluster (float currentTemperature) {
-  esp_err_t err;
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::createTemperatureMeasurementCluster (float currentTemperature) {
 
-  // Set current temperature value
-  _temperature_value = currentTemperature;
-  _temperature_cfg.measured_value = zb_float_to_s16 (currentTemperature);
+  if constexpr (WithTemperature) {
+
+    esp_err_t err;
+
+    // Set current temperature value
+    this->_temperature_value = currentTemperature;
+    this->_temperature_cfg.measured_value = zb_float_to_s16 (currentTemperature);
+
+    // Create a standard temperature measurement cluster attribute list.
+    // This only contains the mandatory attribute: measured value, min measured value, max measured value
+    // Add Temperature measurement cluster (attribute list) in a cluster list.
+    err = esp_zb_cluster_list_add_temperature_meas_cluster (_cluster_list,
+                                                            esp_zb_temperature_meas_cluster_create (&this->_temperature_cfg),
+                                                            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    if (err != ESP_OK) {
+      log_e ("Failed to add Temperature Measurement cluster to Pilot Wire Control endpoint");
+      return false;
+    }
+    log_i ("Temperature Measurement cluster (0x0402) added on EP %d", _endpoint);
+    return true;
+  }
+  else {
 
-  // Create a standard temperature measurement cluster attribute list.
-  // This only contains the mandatory attribute: measured value, min measured value, max measured value
-  // Add Temperature measurement cluster (attribute list) in a cluster list.
-  err = esp_zb_cluster_list_add_temperature_meas_cluster (_cluster_list,
-                                                          esp_zb_temperature_meas_cluster_create (&_temperature_cfg),
-                                                          ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
-  if (err != ESP_OK) {
-    log_e ("Failed to add Temperature Measurement cluster to Pilot Wire Control endpoint");
     return false;
   }
-  log_i ("Temperature Measurement cluster (0x0402) added on EP %d", _endpoint);
-  return true;
 }
 
 // ----------------------------------------------------------------------------
 // Create and attach Metering cluster (0x0702)
 // protected methods
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::createMeteringCluster (int32_t currentPower, uint32_t meteringMultiplier) {
-  esp_err_t err;
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::createMeteringCluster (int32_t currentPower, uint32_t meteringMultiplier) {
 
-  if (_nvs_enabled) {
+  if constexpr (WithMetering) {
+
+    esp_err_t err;
+
+    if (_nvs_enabled) {
+
+      this->_summationDelivered = u64_to_esp_zb_uint48 (_store->summation (_store_slot));
+      log_i ("Restored summation from NVS: %llu Wh", energyWh());
+    }
+
+    if (meteringMultiplier != 0) {
+      this->_multiplier = u32_to_esp_zb_uint24 (meteringMultiplier);
+    }
+    this->_instantaneousDemand = i32_to_esp_zb_sint24 (currentPower);
+    this->_metering_cfg.current_summation_delivered = this->_summationDelivered; // 0x0000 U48 Current summation delivered Wh
+
+    static constexpr AttributeDesc Attributes[] = {
+      // created by esp_zb_metering_cluster_create(), only made reportable
+      { ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID, ESP_ZB_ZCL_ATTR_TYPE_U48, ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1, nullptr },
+      { ESP_ZB_ZCL_ATTR_METERING_STATUS_ID, ESP_ZB_ZCL_ATTR_TYPE_8BITMAP, ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1, nullptr },
+      // Historical Consumption Attribute Set
+      {
+        ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID, ESP_ZB_ZCL_ATTR_TYPE_S24, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1,
+        [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_instantaneousDemand; }
+      },
+      // Formatting Attribute Set
+      {
+        ESP_ZB_ZCL_ATTR_METERING_MULTIPLIER_ID, ESP_ZB_ZCL_ATTR_TYPE_U24, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, 1,
+        [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_multiplier; }
+      },
+      {
+        ESP_ZB_ZCL_ATTR_METERING_DIVISOR_ID, ESP_ZB_ZCL_ATTR_TYPE_U24, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, 1,
+        [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_divisor; }
+      },
+      {
+        ESP_ZB_ZCL_ATTR_METERING_DEMAND_FORMATTING_ID, ESP_ZB_ZCL_ATTR_TYPE_8BITMAP, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, 1,
+        [] (ZigbeePilotWireControlT *, uint8_t) -> void * { return &DemandFormatting; }
+      }
+    };
+
+    esp_zb_attribute_list_t *metering_cluster = esp_zb_metering_cluster_create (&this->_metering_cfg); // just to ensure default values are set
+    if (metering_cluster == nullptr) {
+      log_e ("Failed to create Metering cluster attribute list");
+      return false;
+    }
+    if (buildAttributes (metering_cluster, ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC, Attributes) == false) {
+      return false;
+    }
+
+    // Add Metering cluster to cluster list
+    err = esp_zb_cluster_list_add_metering_cluster (_cluster_list,
+                                                    metering_cluster,
+                                                    ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+    if (err != ESP_OK) {
+      log_e ("Failed to add Metering cluster to cluster list");
+      return false;
+    }
+
+    log_i ("Metering cluster (0x0702) added on EP %d", _endpoint);
+    return true;
+  }
+  else {
+
+    return false;
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::begin () {
+
+  _begin_start_us = esp_timer_get_time();
+  _begin_free_heap = heap_caps_get_free_size (MALLOC_CAP_8BIT);
+  _begin_largest_block = heap_caps_get_largest_free_block (MALLOC_CAP_8BIT);
+  _begin_stats = {};
+
+  // Init NVS, the store is shared by all the endpoints
+  _nvs_enabled = openStore() ? _store->restore (_store_slot) : false;
+
+  if (_schedule_enabled && _store != nullptr) {
+    uint8_t week[PilotWireSchedule::Size];
+    char key[8];
 
-    _summationDelivered = u64_to_esp_zb_uint48 (_prefs.getULong64 ("summation"));
-    log_i ("Restored summation from NVS: %llu Wh", _summationDelivered);
+    snprintf (key, sizeof (key), "sch%u", _endpoint);
+    if (_store->getBlob (key, week, sizeof (week)) && _schedule->week.load (week, sizeof (week))) {
+
+      log_i ("Restored weekly schedule from NVS");
+    }
   }
+  loadReporting();
 
-  if (meteringMultiplier != 0) {
-    _multiplier = u32_to_esp_zb_uint24 (meteringMultiplier);
+  if (createPilotWireCluster() == false) {
+    return false;
+  }
+  if (_diag_enabled && createDiagnosticsCluster() == false) {
+    return false;
+  }
+  if (_thermostat_enabled && createThermostatCluster() == false) {
+    return false;
+  }
+  if (_schedule_enabled && createScheduleSupport() == false) {
+    return false;
+  }
+  if (_history_enabled && createHistorySupport() == false) {
+    return false;
   }
-  _instantaneousDemand = i32_to_esp_zb_sint24 (currentPower);
-  _metering_cfg.current_summation_delivered = _summationDelivered; // 0x0000 U48 Current summation delivered Wh
+  if (_ota_enabled && addOTAClient (_ota_file_version, _ota_file_version, _ota_hw_version,
+                                    PILOT_WIRE_MANUF_CODE, PILOT_WIRE_OTA_IMAGE_TYPE) == false) {
 
-  esp_zb_attribute_list_t *metering_cluster = esp_zb_metering_cluster_create (&_metering_cfg); // just to ensure default values are set
-  if (metering_cluster == nullptr) {
-    log_e ("Failed to create Metering cluster attribute list");
+    log_e ("Failed to add OTA Upgrade client cluster");
     return false;
   }
+  updateBeginStats();
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// private method, opens the NVS store shared by all the endpoints
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::openStore() {
 
-  // --- Enable reporting on CurrentSummationDelivered and Status attribute ---
-  esp_zb_attribute_list_t *p = metering_cluster;
-  while (p != nullptr) {
+  if (_store == nullptr) {
 
-    if (p->attribute.type != ESP_ZB_ZCL_ATTR_TYPE_NULL) {
-      if (p->attribute.id == ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID || // 0x0000
-          p->attribute.id == ESP_ZB_ZCL_ATTR_METERING_STATUS_ID) { // 0x0200
+    _store = PilotWireStore::acquire ("PilotWire"); // namespace "PilotWire"
+    if (_store != nullptr) {
 
-        p->attribute.access |= ESP_ZB_ZCL_ATTR_ACCESS_REPORTING;
-        log_i ("Enabled reporting on Metering attribute 0x%04X", p->attribute.id);
+      _store_slot = _store->attach (_endpoint);
+      if (_store_slot < 0) {
+
+        PilotWireStore::release (_store);
+        _store = nullptr;
       }
     }
-    p = p->next;
   }
+  return _store != nullptr;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::restore() {
 
-  // --- Historical Consumption Attribute Set ---
+  if (openStore() == false) {
 
-  // InstantaneousDemand attribute
-  err = esp_zb_cluster_add_attr (
-          metering_cluster,
-          ESP_ZB_ZCL_CLUSTER_ID_METERING,
-          ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID, // 0x0400
-          ESP_ZB_ZCL_ATTR_TYPE_S24,
-          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING,
-          &_instantaneousDemand
-        );
-  if (err != ESP_OK) {
-    log_e ("Failed to add InstantaneousDemand attribute to Metering cluster");
+    log_e ("Failed to open NVS, nothing to restore");
     return false;
   }
 
-  // --- Formatting Attribute Set ---
+  _nvs_enabled = _store->restore (_store_slot);
+  if (_nvs_enabled) {
+
+    // drive the heater now, the Zigbee stack is not started yet
+    _current_mode = _store->mode (_store_slot);
+    _current_state = (_current_mode != PILOTWIRE_MODE_OFF);
+    if (_output != nullptr) {
 
-  // Multiplier attribute
-  err = esp_zb_cluster_add_attr (
-          metering_cluster,
-          ESP_ZB_ZCL_CLUSTER_ID_METERING,
-          ESP_ZB_ZCL_ATTR_METERING_MULTIPLIER_ID, // 0x0301
-          ESP_ZB_ZCL_ATTR_TYPE_U24,
-          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
-          &_multiplier
-        );
+      _output->setMode (static_cast<ZigbeePilotWireMode> (_current_mode));
+    }
+    invokeModeCallbacks();
+  }
+  _boot_stats.restoreUs = static_cast<uint32_t> (esp_timer_get_time());
+  log_i ("EP %d early restore %s, mode %d at %lu us", _endpoint, _nvs_enabled ? "done" : "disabled",
+         _current_mode, (unsigned long) _boot_stats.restoreUs);
+  return _nvs_enabled;
+}
+
+// ----------------------------------------------------------------------------
+// private method, measures begin() from its start, called again by the overloads
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::updateBeginStats() {
+  size_t free_heap = heap_caps_get_free_size (MALLOC_CAP_8BIT);
+  size_t largest_block = heap_caps_get_largest_free_block (MALLOC_CAP_8BIT);
+
+  _begin_stats.durationUs = static_cast<uint32_t> (esp_timer_get_time() - _begin_start_us);
+  _begin_stats.heapUsed = (_begin_free_heap > free_heap) ? _begin_free_heap - free_heap : 0;
+  _begin_stats.largestBlockDrop = (_begin_largest_block > largest_block) ? _begin_largest_block - largest_block : 0;
+  _boot_stats.beginUs = static_cast<uint32_t> (esp_timer_get_time());
+  log_i ("EP %d begin: %lu us, %lu heap bytes, %u attributes from tables", _endpoint,
+         (unsigned long) _begin_stats.durationUs, (unsigned long) _begin_stats.heapUsed, _begin_stats.attributes);
+}
+
+// ----------------------------------------------------------------------------
+// protected method, adds the Diagnostics cluster
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::createDiagnosticsCluster() {
+  esp_err_t err;
+
+  err = esp_zb_cluster_list_add_diagnostics_cluster (_cluster_list,
+                                                     esp_zb_diagnostics_cluster_create (NULL),
+                                                     ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
   if (err != ESP_OK) {
-    log_e ("Failed to add Multiplier attribute to Metering cluster");
+    log_e ("Failed to add Diagnostics cluster to Pilot Wire Control endpoint");
     return false;
   }
+  log_i ("Diagnostics cluster (0x0B05) added on EP %d", _endpoint);
+  return true;
+}
 
-  // Divisor attribute
-  err = esp_zb_cluster_add_attr (
-          metering_cluster,
-          ESP_ZB_ZCL_CLUSTER_ID_METERING,
-          ESP_ZB_ZCL_ATTR_METERING_DIVISOR_ID, // 0x0302
-          ESP_ZB_ZCL_ATTR_TYPE_U24,
-          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
-          &_divisor
-        );
-  if (err != ESP_OK) {
-    log_e ("Failed to add Divisor attribute to Metering cluster");
+// ----------------------------------------------------------------------------
+// protected method, adds the Thermostat cluster
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::createThermostatCluster() {
+  esp_zb_thermostat_cluster_cfg_t cfg = {
+    .local_temperature = zb_float_to_s16 (temperature()),
+    .occupied_cooling_setpoint = 2600,
+    .occupied_heating_setpoint = _occupied_setpoint,
+    .control_sequence_of_operation = ESP_ZB_ZCL_THERMOSTAT_CONTROL_SEQ_OF_OPERATION_HEATING_ONLY,
+    .system_mode = _system_mode
+  };
+  esp_err_t err;
+
+  static constexpr AttributeDesc Attributes[] = {
+    // created by esp_zb_thermostat_cluster_create(), only made reportable
+    { ESP_ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16, ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1, nullptr },
+    { ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID, ESP_ZB_ZCL_ATTR_TYPE_S16, ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1, nullptr },
+    { ESP_ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID, ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM, ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1, nullptr },
+    {
+      ESP_ZB_ZCL_ATTR_THERMOSTAT_UNOCCUPIED_HEATING_SETPOINT_ID, ESP_ZB_ZCL_ATTR_TYPE_S16, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_unoccupied_setpoint; }
+    },
+    {
+      ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPANCY_ID, ESP_ZB_ZCL_ATTR_TYPE_8BITMAP, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_occupancy; }
+    },
+    {
+      ESP_ZB_ZCL_ATTR_THERMOSTAT_PI_HEATING_DEMAND_ID, ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, 1,
+      [] (ZigbeePilotWireControlT * ep, uint8_t) -> void * { return &ep->_heating_demand; }
+    }
+  };
+
+  esp_zb_attribute_list_t *thermostat_cluster = esp_zb_thermostat_cluster_create (&cfg);
+  if (thermostat_cluster == nullptr) {
+    log_e ("Failed to create Thermostat cluster attribute list");
+    return false;
+  }
+  if (buildAttributes (thermostat_cluster, ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC, Attributes) == false) {
     return false;
   }
 
-  // DemandFormatting attribute
-  static uint8_t  demandFormatting =
-    ESP_ZB_ZCL_METERING_FORMATTING_SET (false, 2, 3);   // Instantaneous demand formatting (U8, 0x0304), 2 digits before decimal, 3 digits after decimal
-  err = esp_zb_cluster_add_attr (
-          metering_cluster,
-          ESP_ZB_ZCL_CLUSTER_ID_METERING,
-          ESP_ZB_ZCL_ATTR_METERING_DEMAND_FORMATTING_ID, // 0x304
-          ESP_ZB_ZCL_ATTR_TYPE_8BITMAP,
-          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY,
-          &demandFormatting
-        );
+  err = esp_zb_cluster_list_add_thermostat_cluster (_cluster_list,
+                                                    thermostat_cluster,
+                                                    ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
   if (err != ESP_OK) {
-    log_e ("Failed to add DemandFormatting attribute to Metering cluster");
+    log_e ("Failed to add Thermostat cluster to Pilot Wire Control endpoint");
     return false;
   }
+  log_i ("Thermostat cluster (0x0201) added on EP %d", _endpoint);
+  return true;
+}
 
-  // Add Metering cluster to cluster list
-  err = esp_zb_cluster_list_add_metering_cluster (_cluster_list,
-                                                  metering_cluster,
-                                                  ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
-  if (err != ESP_OK) {
-    log_e ("Failed to add Metering cluster to cluster list");
+// ----------------------------------------------------------------------------
+// protected method, adds the Time cluster and starts the schedule evaluation timer
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::createScheduleSupport() {
+
+  if (addTimeCluster() == false) {
+
+    log_e ("Failed to add Time cluster to Pilot Wire Control endpoint");
     return false;
   }
 
-  log_i ("Metering cluster (0x0702) added on EP %d", _endpoint);
+  if (_schedule_timer == nullptr) {
+    const esp_timer_create_args_t args = {
+      .callback = scheduleTimerCallback,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "pw_schedule",
+      .skip_unhandled_events = true
+    };
+
+    if (esp_timer_create (&args, &_schedule_timer) != ESP_OK) {
+
+      log_e ("Failed to create schedule timer");
+      _schedule_timer = nullptr;
+      return false;
+    }
+  }
+  esp_timer_stop (_schedule_timer);
+  esp_timer_start_periodic (_schedule_timer, static_cast<uint64_t> (PILOT_WIRE_SCHEDULE_PERIOD_MS) * 1000);
+  log_i ("Time cluster and weekly schedule added on EP %d", _endpoint);
   return true;
 }
 
 // ----------------------------------------------------------------------------
+// protected method, allocates the history and starts the sampling timer
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::begin () {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::createHistorySupport() {
+
+  if (_history == nullptr) {
+
+    _history = new PilotWireHistory();
+  }
+
+  if (_history_timer == nullptr) {
+    const esp_timer_create_args_t args = {
+      .callback = historyTimerCallback,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "pw_history",
+      .skip_unhandled_events = true
+    };
+
+    if (esp_timer_create (&args, &_history_timer) != ESP_OK) {
+
+      log_e ("Failed to create history timer");
+      _history_timer = nullptr;
+      return false;
+    }
+  }
+  esp_timer_stop (_history_timer);
+  esp_timer_start_periodic (_history_timer, static_cast<uint64_t> (PILOT_WIRE_HISTORY_PERIOD_MS) * 1000);
+  log_i ("Telemetry history of %u bytes added on EP %d", PILOT_WIRE_HISTORY_BYTES, _endpoint);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::end() {
+
+  if (_schedule_timer != nullptr) {
+
+    esp_timer_stop (_schedule_timer);
+    esp_timer_delete (_schedule_timer);
+    _schedule_timer = nullptr;
+  }
+  if (_history_timer != nullptr) {
+
+    esp_timer_stop (_history_timer);
+    esp_timer_delete (_history_timer);
+    _history_timer = nullptr;
+  }
+  if (_settle_timer != nullptr) {
+
+    esp_timer_stop (_settle_timer);
+    esp_timer_delete (_settle_timer);
+    _settle_timer = nullptr;
+    _settle_open = false;
+  }
+  if (_stack_retry_timer != nullptr) {
+
+    esp_timer_stop (_stack_retry_timer);
+    esp_timer_delete (_stack_retry_timer);
+    _stack_retry_timer = nullptr;
+  }
+  _stack_work_posted = false;
+  delete _history;
+  _history = nullptr;
+  _delta_ready = false;
+  delete _delta_block;
+  _delta_block = nullptr;
+  if (_store != nullptr) {
+
+    PilotWireStore::release (_store);
+    _store = nullptr;
+    _store_slot = -1;
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::enableNvs (bool enable) {
+
+  _nvs_enabled = enable;
+  if (_store != nullptr) {
+
+    _store->setRestore (_store_slot, enable);
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setNvsCommitDelay (uint32_t modeDelayMs, uint32_t summationDelayMs) {
 
-  // Init NVS
-  _prefs.begin ("PilotWire", false); // namespace "PilotWire"
-  _nvs_enabled = _prefs.getBool ("restore");
+  if (_store != nullptr) {
 
-  return createPilotWireCluster();
+    _store->setCommitDelay (modeDelayMs, summationDelayMs);
+  }
 }
 
 // ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::begin (float currentTemperature) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::begin (float currentTemperature) {
 
   if (begin()) {
 
-    if (_temperature_enabled) {
+    if (temperatureEnabled()) {
 
-      return createTemperatureMeasurementCluster (currentTemperature);
+      bool status = createTemperatureMeasurementCluster (currentTemperature);
+
+      updateBeginStats();
+      return status;
     }
     else {
 
@@ -387,14 +963,18 @@ ZigbeePilotWireControl::begin (float currentTemperature) {
 }
 
 // ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::begin (int32_t currentPower, uint32_t meteringMultiplier) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::begin (int32_t currentPower, uint32_t meteringMultiplier) {
 
   if (begin()) {
 
-    if (_metering_enabled) {
+    if (meteringEnabled()) {
+
+      bool status = createMeteringCluster (currentPower, meteringMultiplier);
 
-      return createMeteringCluster (currentPower, meteringMultiplier);
+      updateBeginStats();
+      return status;
     }
     else {
 
@@ -406,14 +986,18 @@ ZigbeePilotWireControl::begin (int32_t currentPower, uint32_t meteringMultiplier
 }
 
 // ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::begin (float currentTemperature, int32_t currentPower, uint32_t meteringMultiplier) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::begin (float currentTemperature, int32_t currentPower, uint32_t meteringMultiplier) {
 
   if (begin (currentTemperature)) {
 
-    if (_metering_enabled) {
+    if (meteringEnabled()) {
 
-      return createMeteringCluster (currentPower, meteringMultiplier);
+      bool status = createMeteringCluster (currentPower, meteringMultiplier);
+
+      updateBeginStats();
+      return status;
     }
     else {
 
@@ -424,331 +1008,2451 @@ ZigbeePilotWireControl::begin (float currentTemperature, int32_t currentPower, u
   return false;
 }
 
-// -----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::setEnergyWh (uint64_t summation_wh) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setEnergyWh (uint64_t summation_wh) {
 
-  _summationDelivered = u64_to_esp_zb_uint48 (summation_wh);
-  if (_nvs_enabled) {
+  storeEnergy (summation_wh);
+  return writeAttributes (PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_ENERGY));
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::trySetEnergyWh (uint64_t summation_wh, TickType_t timeout) {
+
+  storeEnergy (summation_wh);
+  return tryWriteAttributes (PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_ENERGY), timeout);
+}
+
+// ----------------------------------------------------------------------------
+// private method, updates the summation and its NVS record, not the stack attribute
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::storeEnergy (uint64_t summation_wh) {
+
+  if constexpr (WithMetering) {
 
-    // Save to NVS
-    _prefs.putULong64 ("summation", summation_wh);
+    this->_summationDelivered = u64_to_esp_zb_uint48 (summation_wh);
+    if (_nvs_enabled && _store != nullptr) {
+
+      // Save to NVS, written later by the store
+      _store->setSummation (_store_slot, summation_wh);
+    }
   }
+}
 
-  esp_zb_lock_acquire (portMAX_DELAY);
-  esp_zb_zcl_status_t ret = esp_zb_zcl_set_attribute_val (
-                              _endpoint,
-                              ESP_ZB_ZCL_CLUSTER_ID_METERING,
-                              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-                              ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID,
-                              &_summationDelivered,
-                              false // do not check access rights
-                            );
-  esp_zb_lock_release();
-  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+// ----------------------------------------------------------------------------
+// private method, adds energy to the summation, the integrator and the pulse meter
+// may run in different tasks so the read-modify-write is done under _energy_mux
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::addEnergy (uint64_t wh) {
+
+  if constexpr (WithMetering) {
+    uint64_t summation_wh;
+
+    portENTER_CRITICAL (&this->_energy_mux);
+    summation_wh = esp_zb_uint48_to_u64 (this->_summationDelivered) + wh;
+    this->_summationDelivered = u64_to_esp_zb_uint48 (summation_wh);
+    portEXIT_CRITICAL (&this->_energy_mux);
+
+    if (_nvs_enabled && _store != nullptr) {
+
+      // Save to NVS, written later by the store
+      _store->setSummation (_store_slot, summation_wh);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setPowerW (int32_t demand_w) {
+
+  if constexpr (WithMetering) {
+
+    // the previous power applies until now
+    integrateEnergy();
+
+    this->_instantaneousDemand = i32_to_esp_zb_sint24 (demand_w);
+    return writeAttributes (PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_POWER));
+  }
+  else {
 
-    log_e ("Failed to set CurrentSummationDelivered: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
     return false;
   }
-  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::trySetPowerW (int32_t demand_w, TickType_t timeout) {
+
+  if constexpr (WithMetering) {
+
+    uint32_t mask = PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_POWER);
+
+    // the previous power applies until now
+    if (accumulateEnergy()) {
+
+      mask |= PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_ENERGY);
+    }
+
+    this->_instantaneousDemand = i32_to_esp_zb_sint24 (demand_w);
+    return tryWriteAttributes (mask, timeout);
+  }
+  else {
+
+    return false;
+  }
+}
+
+// -----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::enableEnergyIntegration (bool enable) {
+
+  if constexpr (WithMetering) {
+
+    portENTER_CRITICAL (&this->_energy_mux);
+    if (enable && !this->_energy_integration) {
+
+      this->_energy_last_ms = millis();
+      this->_energy_residual = 0;
+    }
+    this->_energy_integration = enable;
+    portEXIT_CRITICAL (&this->_energy_mux);
+  }
 }
 
 // -----------------------------------------------------------------------------
+// 1 Wh = 3600 s * 1000 ms * 1 W
+#define WMS_PER_WH  3600000LL
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::setPowerW (int32_t demand_w) {
-
-  _instantaneousDemand = i32_to_esp_zb_sint24 (demand_w);
-  esp_zb_lock_acquire (portMAX_DELAY);
-  esp_zb_zcl_status_t ret = esp_zb_zcl_set_attribute_val (
-                              _endpoint,
-                              ESP_ZB_ZCL_CLUSTER_ID_METERING,
-                              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-                              ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID,
-                              &_instantaneousDemand,
-                              false // do not check access rights
-                            );
-  esp_zb_lock_release();
-  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::integrateEnergy() {
+
+  return accumulateEnergy() ? writeAttributes (PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_ENERGY)) : true;
+}
+
+// ----------------------------------------------------------------------------
+// private method, integrates the power since the last call
+// returns true if the summation changed and its attribute must be written
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::accumulateEnergy() {
 
-    log_e ("Failed to set InstantaneousDemand: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+  if constexpr (WithMetering) {
+
+    if (this->_energy_integration == false) {
+
+      return false;
+    }
+
+    int32_t power = powerW();
+    int64_t wh = 0;
+
+    // called from the application and from the Zigbee task (mode changes)
+    portENTER_CRITICAL (&this->_energy_mux);
+    uint32_t now = millis();
+    uint32_t elapsed = now - this->_energy_last_ms; // unsigned arithmetic handles millis() wrap-around
+
+    this->_energy_last_ms = now;
+    if (power > 0) {
+
+      this->_energy_residual += static_cast<int64_t> (power) * elapsed;
+    }
+
+    if (this->_energy_residual >= WMS_PER_WH) {
+
+      wh = this->_energy_residual / WMS_PER_WH;
+      this->_energy_residual -= wh * WMS_PER_WH;
+    }
+    portEXIT_CRITICAL (&this->_energy_mux);
+
+    if (wh > 0) {
+
+      addEnergy (static_cast<uint64_t> (wh));
+      return true;
+    }
     return false;
   }
-  return true;
+  else {
+
+    return false;
+  }
+}
+
+// -----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setNominalPower (ZigbeePilotWireMode mode, uint16_t watts) {
+
+  if constexpr (WithMetering) {
+
+    if (mode < PILOTWIRE_MODE_COUNT) {
+
+      this->_nominal_power[mode] = watts;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::enablePowerEstimation (bool enable) {
+
+  if constexpr (WithMetering) {
+
+    this->_power_estimation = enable;
+  }
+}
+
+// -----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::attachPulseMeter (PilotWirePulseMeter *meter) {
+
+  if constexpr (WithMetering) {
+
+    if (meter != nullptr) {
+
+      if (meter->begin() == false) {
+        return false;
+      }
+      // the meter measures both, nothing to estimate or integrate
+      this->_energy_integration = false;
+      this->_power_estimation = false;
+    }
+    this->_pulse_meter = meter;
+    return true;
+  }
+  else {
+
+    return false;
+  }
+}
+
+// -----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::updatePulseMeter() {
+
+  if constexpr (WithMetering) {
+
+    uint32_t mask = 0;
+
+    if (this->_pulse_meter == nullptr || this->_pulse_meter->update() == false) {
+      return true;
+    }
+
+    if (this->_pulse_meter->powerW() != powerW()) {
+
+      this->_instantaneousDemand = i32_to_esp_zb_sint24 (this->_pulse_meter->powerW());
+      mask |= PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_POWER);
+    }
+
+    uint32_t wh = this->_pulse_meter->takeEnergyWh();
+    if (wh != 0) {
+
+      addEnergy (wh);
+      mask |= PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_ENERGY);
+    }
+    return (mask != 0) ? writeAttributes (mask) : true;
+  }
+  else {
+
+    return true;
+  }
 }
 
 // -----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 uint64_t
-ZigbeePilotWireControl::energyWh() const {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::energyWh() const {
+
+  if constexpr (WithMetering) {
+
+    return esp_zb_uint48_to_u64 (this->_summationDelivered);
+  }
+  else {
 
-  return esp_zb_uint48_to_u64 (_summationDelivered);
+    return 0;
+  }
 }
 
 // -----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 int32_t
-ZigbeePilotWireControl::powerW() const {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::powerW() const {
+
+  if constexpr (WithMetering) {
 
-  return esp_zb_sint24_to_i32 (_instantaneousDemand);
+    return esp_zb_sint24_to_i32 (this->_instantaneousDemand);
+  }
+  else {
+
+    return 0;
+  }
 }
 
-// -----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::setMeteringStatus (uint8_t status) {
-
-  _metering_cfg.status = status;
-  esp_zb_lock_acquire (portMAX_DELAY);
-  esp_zb_zcl_status_t ret = esp_zb_zcl_set_attribute_val (
-                              _endpoint,
-                              ESP_ZB_ZCL_CLUSTER_ID_METERING,
-                              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-                              ESP_ZB_ZCL_ATTR_METERING_STATUS_ID,
-                              &_metering_cfg.status,
-                              false // do not check access rights
-                            );
-  esp_zb_lock_release();
-  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setMeteringStatus (uint8_t status) {
+
+  if constexpr (WithMetering) {
+
+    this->_metering_cfg.status = status;
+    return writeAttributes (PILOTWIRE_PENDING_METERING_STATUS);
+  }
+  else {
+
+    return false;
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::trySetMeteringStatus (uint8_t status, TickType_t timeout) {
+
+  if constexpr (WithMetering) {
+
+    this->_metering_cfg.status = status;
+    return tryWriteAttributes (PILOTWIRE_PENDING_METERING_STATUS, timeout);
+  }
+  else {
 
-    log_e ("Failed to set Metering Status: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
     return false;
   }
-  return true;
 }
 
 // ----------------------------------------------------------------------------
 // callback method called when an attribute is set from Zigbee network
 // attributes handled:
 // - Pilot Wire Mode (manufacturer-specific attribute)
+// - Weekly schedule (manufacturer-specific attribute)
 // - On/Off
+// - Thermostat setpoints and system mode
+template <bool WithTemperature, bool WithMetering>
 void
-ZigbeePilotWireControl::zbAttributeSet (const esp_zb_zcl_set_attr_value_message_t *message) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::zbAttributeSet (const esp_zb_zcl_set_attr_value_message_t *message) {
+
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_ATTR_SET, _endpoint, message->attribute.id);
+
+  // Stack context, the updates deferred by the try methods can be written now
+  flushPending();
 
   if (message->info.cluster == PILOT_WIRE_CLUSTER_ID) {
 
     if (message->attribute.id == PILOT_WIRE_MODE_ATTR_ID && message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_U8) {
       uint8_t mode = *reinterpret_cast<uint8_t *> (message->attribute.data.value);
 
-      if (mode != _current_mode) {
-        if (mode == PILOTWIRE_MODE_OFF) {
+      if (_settle_window_ms != 0) {
 
-          // Save current mode when turning off
-          _state_on_mode = _current_mode;
-          _current_state = false;
-          _current_state_changed = true;
-        }
-        else if (_current_mode == PILOTWIRE_MODE_OFF) {
+        settleCommand (PILOTWIRE_CMD_MODE, mode);
+      }
+      else if (_queue_enabled) {
 
-          _current_state = true;
-          _current_state_changed = true;
-        }
+        enqueueCommand (PILOTWIRE_CMD_MODE, mode);
+      }
+      else {
 
-        _current_mode = mode;
-        pilotWireModeChanged();
-        if (_current_state_changed) {
-
-          // _current_state changed, report attribute
-          _current_state_changed = false;
-          log_v ("Updating On/Off attribute to %d", _current_state);
-          esp_zb_zcl_status_t ret;
-          esp_zb_lock_acquire (portMAX_DELAY);
-          ret = esp_zb_zcl_set_attribute_val (
-                  _endpoint,
-                  ESP_ZB_ZCL_CLUSTER_ID_ON_OFF,
-                  ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-                  ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID,
-                  &_current_state,
-                  false
-                );
-          esp_zb_lock_release();
-          if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
-            log_e ("Failed to update On/Off attribute: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
-          }
-        }
+        applyModeCommand (mode);
+      }
+    }
+    else if (message->attribute.id == PILOT_WIRE_SCHEDULE_ATTR_ID && _schedule_enabled &&
+             message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING) {
+
+      if (loadScheduleAttribute (static_cast<const uint8_t *> (message->attribute.data.value))) {
+
+        saveSchedule();
+        applySchedule (true);
+      }
+    }
+    else if (message->attribute.id == PILOT_WIRE_HISTORY_OFFSET_ATTR_ID && _history_enabled &&
+             message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_U16) {
+
+      _history_offset = *reinterpret_cast<uint16_t *> (message->attribute.data.value);
+      publishHistory (_history_offset);
+    }
+    else if (message->attribute.id == PILOT_WIRE_DELTA_BLOCK_ATTR_ID && _delta_block != nullptr &&
+             message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING) {
+
+      receiveDeltaBlock (static_cast<const uint8_t *> (message->attribute.data.value));
+    }
+    else if ( (message->attribute.id == PILOT_WIRE_BUDGET_ATTR_ID || message->attribute.id == PILOT_WIRE_HOUSE_POWER_ATTR_ID) &&
+              _budget_enabled && message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_S32) {
+      int32_t value = *reinterpret_cast<int32_t *> (message->attribute.data.value);
+
+      if (message->attribute.id == PILOT_WIRE_BUDGET_ATTR_ID) {
+
+        _power_budget = (value > 0) ? value : 0;
+      }
+      else {
+
+        _house_power = value;
+        _house_power_us = esp_timer_get_time();
+      }
+    }
+    else {
+
+      log_w ("Received message ignored. Attribute ID: 0x%04X not supported for Pilot Wire Control", message->attribute.id);
+    }
+  }
+  else if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ON_OFF) {
+
+    if (message->attribute.id == ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID && message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_BOOL) {
+      bool state = *reinterpret_cast<bool *> (message->attribute.data.value);
+
+      if (_settle_window_ms != 0) {
+
+        settleCommand (PILOTWIRE_CMD_ON_OFF, state);
+      }
+      else if (_queue_enabled) {
+
+        enqueueCommand (PILOTWIRE_CMD_ON_OFF, state);
+      }
+      else {
+
+        applyOnOffCommand (state);
+      }
+    }
+    else {
+
+      log_w ("Received message ignored. Attribute ID: 0x%04X not supported for On/Off", message->attribute.id);
+    }
+  }
+  else if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT && _thermostat_enabled) {
+
+    if (message->attribute.id == ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID &&
+        message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_S16) {
+
+      _occupied_setpoint = *reinterpret_cast<int16_t *> (message->attribute.data.value);
+      runThermostat();
+    }
+    else if (message->attribute.id == ESP_ZB_ZCL_ATTR_THERMOSTAT_UNOCCUPIED_HEATING_SETPOINT_ID &&
+             message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_S16) {
+
+      _unoccupied_setpoint = *reinterpret_cast<int16_t *> (message->attribute.data.value);
+      runThermostat();
+    }
+    else if (message->attribute.id == ESP_ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID &&
+             message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM) {
+
+      applySystemMode (*reinterpret_cast<uint8_t *> (message->attribute.data.value));
+    }
+    else {
+
+      log_w ("Received message ignored. Attribute ID: 0x%04X not supported for Thermostat", message->attribute.id);
+    }
+  }
+  else {
+
+    log_w ("Received message ignored. Cluster ID: 0x%04X not supported for Pilot Wire Control", message->info.cluster);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, applies a Pilot Wire mode received from the Zigbee network
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::applyModeCommand (uint8_t mode) {
+
+  if (mode != _current_mode) {
+    if (mode == PILOTWIRE_MODE_OFF) {
+
+      // Save current mode when turning off
+      _state_on_mode = _current_mode;
+      _current_state = false;
+      _current_state_changed = true;
+    }
+    else if (_current_mode == PILOTWIRE_MODE_OFF) {
+
+      _current_state = true;
+      _current_state_changed = true;
+    }
+
+    _current_mode = mode;
+    pilotWireModeChanged();
+    if (_current_state_changed) {
+
+      // _current_state changed, report attribute
+      _current_state_changed = false;
+      log_v ("Updating On/Off attribute to %d", _current_state);
+      esp_zb_zcl_status_t ret;
+      zbLock();
+      ret = esp_zb_zcl_set_attribute_val (
+              _endpoint,
+              ESP_ZB_ZCL_CLUSTER_ID_ON_OFF,
+              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+              ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID,
+              &_current_state,
+              false
+            );
+      zbUnlock();
+      if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+        _diag.attributeSetFailures++;
+        log_e ("Failed to update On/Off attribute: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
       }
+    }
+    if (_status_enabled) {
+      updateStatus();
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, applies an On/Off state received from the Zigbee network
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::applyOnOffCommand (bool state) {
+
+  if (state != _current_state) {
+
+    log_v ("On/Off attribute changed to %d", state);
+    _current_state = state;
+
+    if (state) {
+      // new state is ON, restore previous mode
+      _current_mode = _state_on_mode;
+    }
+    else  {
+      // new state is OFF, save current mode
+      _state_on_mode = _current_mode;
+      _current_mode = PILOTWIRE_MODE_OFF;
+    }
+    pilotWireModeChanged();
+
+    // _current_mode changed, report attribute
+    log_v ("Updating Pilot Wire mode attribute to %d", _current_mode);
+    esp_zb_zcl_status_t ret;
+    zbLock();
+    ret = esp_zb_zcl_set_manufacturer_attribute_val (
+            _endpoint,
+            PILOT_WIRE_CLUSTER_ID,
+            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+            PILOT_WIRE_MANUF_CODE,
+            PILOT_WIRE_MODE_ATTR_ID,
+            &_current_mode,
+            false
+          );
+    zbUnlock();
+    if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+      _diag.attributeSetFailures++;
+      log_e ("Failed to update Pilot Wire mode attribute: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+    }
+    if (_status_enabled) {
+      updateStatus();
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, called with the Zigbee lock held when the command queue is enabled,
+// the lock keeps a single producer at a time
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::enqueueCommand (uint8_t type, uint8_t value, uint8_t arg) {
+  PilotWireCommand cmd = { esp_timer_get_time(), type, value, arg };
+
+  if (_queue->ring.push (cmd)) {
+
+    _queue->stats.enqueued++;
+  }
+  else {
+
+    // The command is lost, process() will resynchronize with the stack attributes
+    _queue->stats.overflows++;
+    _queue->resync = true;
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setSettleWindow (uint32_t windowMs) {
+
+  // keeps the Zigbee stack task out of zbAttributeSet() while the window is drained
+  zbLock();
+  _settle_window_ms = windowMs;
+  if (windowMs == 0 && _settle_timer != nullptr) {
+
+    // the writes are applied immediately from now on, a pending window is closed first
+    esp_timer_stop (_settle_timer);
+    closeSettleWindow();
+  }
+  zbUnlock();
+}
+
+// ----------------------------------------------------------------------------
+// private method, called from the Zigbee stack task when the settle window is enabled
+// the first write opens the window, the next ones only update the target mode
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::settleCommand (uint8_t type, uint8_t value) {
+
+  if (_settle_timer == nullptr) {
+    const esp_timer_create_args_t args = {
+      .callback = settleTimerCallback,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "pw_settle",
+      .skip_unhandled_events = true
+    };
+
+    if (esp_timer_create (&args, &_settle_timer) != ESP_OK) {
+
+      log_e ("Failed to create the settle timer, write applied immediately");
+      _settle_timer = nullptr;
+      if (type == PILOTWIRE_CMD_MODE) {
+
+        applyModeCommand (value);
+      }
+      else {
+
+        applyOnOffCommand (value != 0);
+      }
+      return;
+    }
+  }
+
+  portENTER_CRITICAL (&_settle_mux);
+  bool open = _settle_open;
+  if (open == false) {
+
+    _settle_open = true;
+    _settle_count = 0;
+    _settle_mode = _current_mode;
+    _settle_on_mode = (_current_mode != PILOTWIRE_MODE_OFF) ? _current_mode : _state_on_mode;
+  }
+  else {
+
+    _settle_stats.absorbed++;
+  }
+  _settle_count++;
+
+  // same transitions as applyModeCommand() and applyOnOffCommand()
+  uint8_t mode = _settle_mode;
+  if (type == PILOTWIRE_CMD_MODE) {
+
+    mode = value;
+  }
+  else if (value == 0) {
+
+    mode = PILOTWIRE_MODE_OFF;
+  }
+  else if (mode == PILOTWIRE_MODE_OFF) {
+
+    mode = _settle_on_mode;
+  }
+  if (mode == PILOTWIRE_MODE_OFF && _settle_mode != PILOTWIRE_MODE_OFF) {
+
+    _settle_on_mode = _settle_mode;
+  }
+  _settle_mode = mode;
+  portEXIT_CRITICAL (&_settle_mux);
+
+  if (open == false) {
+
+    esp_timer_start_once (_settle_timer, static_cast<uint64_t> (_settle_window_ms) * 1000);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private, called from the esp_timer task when the settle window closes
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::settleTimerCallback (void *arg) {
+  ZigbeePilotWireControlT *ep = static_cast<ZigbeePilotWireControlT *> (arg);
+
+  // the Zigbee stack task may push in the queue too if the window was just disabled
+  ep->zbLock();
+  ep->closeSettleWindow();
+  ep->zbUnlock();
+}
+
+// ----------------------------------------------------------------------------
+// private method, called with the Zigbee lock held, hands the final mode of a
+// pending settle window to process() or to the Zigbee stack task
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::closeSettleWindow() {
+  uint8_t mode, on_mode;
+
+  portENTER_CRITICAL (&_settle_mux);
+  bool open = _settle_open;
+  mode = _settle_mode;
+  on_mode = _settle_on_mode;
+  if (open) {
+
+    _settle_open = false;
+    _settle_stats.windows++;
+  }
+  portEXIT_CRITICAL (&_settle_mux);
+
+  if (open == false) {
+
+    // already closed by setSettleWindow (0)
+    return;
+  }
+
+  log_d ("EP %d settle window closed, %d writes, mode %d", _endpoint, _settle_count, mode);
+  if (_queue_enabled) {
+
+    enqueueCommand (PILOTWIRE_CMD_SETTLED, mode, on_mode);
+  }
+  else {
+
+    // the callback, NVS and the output run in the Zigbee stack task, not under this lock
+    portENTER_CRITICAL (&_settle_mux);
+    _settled_pending = true;
+    _settled_mode = mode;
+    _settled_on_mode = on_mode;
+    portEXIT_CRITICAL (&_settle_mux);
+    postStackWork();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, applies the final mode of a settle window
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::applySettledCommand (uint8_t mode, uint8_t onMode) {
+
+  applyModeCommand (mode);
+  if (mode == PILOTWIRE_MODE_OFF) {
+
+    // applyModeCommand() saved the mode before the window, an On write must
+    // restore the last mode of the window (Comfort, Eco, Off then On restores Eco)
+    _state_on_mode = onMode;
+  }
+
+  // the stack holds the last value written to each attribute, which may not be the applied state
+  _current_state_changed = true;
+  updatePilotModeAndOnOff();
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::enableCommandQueue (bool enable) {
+
+  if (enable && _queue == nullptr) {
+
+    // the queue is allocated before the stack task can see the flag
+    _queue = new QueueState();
+  }
+  _queue_enabled = enable;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+size_t
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::process (size_t max) {
+  PilotWireCommand cmd;
+  size_t count = 0;
+
+  while (_queue != nullptr && count < max && _queue->ring.pop (cmd)) {
+    uint32_t latency = static_cast<uint32_t> (esp_timer_get_time() - cmd.timestamp_us);
+
+    if (cmd.type == PILOTWIRE_CMD_MODE) {
+
+      applyModeCommand (cmd.value);
+    }
+    else if (cmd.type == PILOTWIRE_CMD_ON_OFF) {
+
+      applyOnOffCommand (cmd.value != 0);
+    }
+    else {
+
+      applySettledCommand (cmd.value, cmd.arg);
+    }
+
+    if (_queue->stats.dispatched == 0 || latency < _queue->stats.latencyMinUs) {
+      _queue->stats.latencyMinUs = latency;
+    }
+    if (latency > _queue->stats.latencyMaxUs) {
+      _queue->stats.latencyMaxUs = latency;
+    }
+    _queue->latencySumUs += latency;
+    _queue->stats.dispatched++;
+    _queue->stats.latencyAvgUs = static_cast<uint32_t> (_queue->latencySumUs / _queue->stats.dispatched);
+    count++;
+  }
+
+  uint8_t mode = _local_pending.exchange (PilotWireSchedule::Hold);
+  if (mode != PilotWireSchedule::Hold) {
+
+    setPilotWireMode (static_cast<ZigbeePilotWireMode> (mode));
+    count++;
+  }
+
+  if (_queue != nullptr && _queue->resync && _queue->ring.empty()) {
+    esp_zb_zcl_attr_t *attr;
+
+    mode = _current_mode;
+    // Some commands were lost, the last written mode is the one of the stack attribute
+    _queue->resync = false;
+    zbLock();
+    attr = esp_zb_zcl_get_manufacturer_attribute (_endpoint, PILOT_WIRE_CLUSTER_ID,
+                                                  ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                  PILOT_WIRE_MODE_ATTR_ID, PILOT_WIRE_MANUF_CODE);
+    if (attr != nullptr && attr->data_p != nullptr) {
+
+      mode = *static_cast<uint8_t *> (attr->data_p);
+    }
+    zbUnlock();
+    log_w ("Command queue overflow, resynchronizing mode to %d", mode);
+    applyModeCommand (mode);
+  }
+  return count;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::resetQueueStats() {
+
+  if (_queue != nullptr) {
+
+    _queue->stats = {};
+    _queue->latencySumUs = 0;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, loads the value written in the schedule attribute
+// value is a ZCL octet string, its first byte is the length
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::loadScheduleAttribute (const uint8_t *value) {
+  uint8_t len = value[0];
+
+  if (len == PilotWireSchedule::Size) {
+
+    if (_schedule->week.load (&value[1], len)) {
+      return true;
+    }
+  }
+  else if (len == 1 + PilotWireSchedule::DayBytes && value[1] < 7) {
+    uint8_t week[PilotWireSchedule::Size];
+
+    // one day only, the attribute is published again with the whole week
+    memcpy (week, _schedule->week.data(), sizeof (week));
+    memcpy (&week[value[1] * PilotWireSchedule::DayBytes], &value[2], PilotWireSchedule::DayBytes);
+    if (_schedule->week.load (week, sizeof (week))) {
+
+      _schedule->attrDirty = true;
+      return true;
+    }
+  }
+  log_w ("Invalid weekly schedule received (%d bytes)", len);
+  _schedule->attrDirty = true;
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// private method, writes the schedule in NVS
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::saveSchedule() {
+  char key[8];
+
+  if (_store == nullptr) {
+    return false;
+  }
+  snprintf (key, sizeof (key), "sch%u", _endpoint);
+  return _store->putBlob (key, _schedule->week.data(), PilotWireSchedule::Size);
+}
+
+// ----------------------------------------------------------------------------
+// private method, copies the schedule in the attribute of the Zigbee stack
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::publishScheduleAttribute() {
+  esp_zb_zcl_status_t ret;
+
+  _schedule->attrDirty = false;
+  _schedule->attr[0] = PilotWireSchedule::Size;
+  memcpy (&_schedule->attr[1], _schedule->week.data(), PilotWireSchedule::Size);
+  zbLock();
+  ret = esp_zb_zcl_set_manufacturer_attribute_val (
+          _endpoint,
+          PILOT_WIRE_CLUSTER_ID,
+          ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+          PILOT_WIRE_MANUF_CODE,
+          PILOT_WIRE_SCHEDULE_ATTR_ID,
+          _schedule->attr,
+          false
+        );
+  zbUnlock();
+  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+    _diag.attributeSetFailures++;
+    log_e ("Failed to update schedule attribute: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::enableSchedule (bool enable) {
+
+  if (enable && _schedule == nullptr) {
+
+    _schedule = new ScheduleState();
+    _schedule->last = PilotWireSchedule::Hold;
+  }
+  _schedule_enabled = enable;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setSchedule (const PilotWireSchedule &schedule) {
+
+  if (_schedule == nullptr) {
+
+    log_e ("Weekly schedule not enabled on EP %d", _endpoint);
+    return false;
+  }
+  _schedule->week = schedule;
+  _schedule->attrDirty = true;
+  if (_schedule_timer != nullptr) {
+
+    // the endpoint is started, the attribute can be updated now
+    publishScheduleAttribute();
+  }
+  applySchedule (true);
+  return saveSchedule();
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::syncScheduleTime() {
+  struct tm utc = getTime();
+  int32_t tz_offset = getTimezone();
+
+  // getTime() converts the Zigbee time with the C library, TZ is not set, so it is UTC
+  if (utc.tm_year < 120) {
+
+    log_w ("Failed to read the time from the coordinator");
+    return false;
+  }
+  setScheduleTime (mktime (&utc), tz_offset);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setScheduleTime (time_t utc, int32_t tzOffset) {
+
+  if (_schedule == nullptr) {
+
+    log_e ("Weekly schedule not enabled on EP %d", _endpoint);
+    return;
+  }
+  portENTER_CRITICAL (&_schedule_mux);
+  _schedule->timeBase = utc;
+  _schedule->timeBaseUs = esp_timer_get_time();
+  _schedule->tzOffset = tzOffset;
+  portEXIT_CRITICAL (&_schedule_mux);
+  log_i ("Schedule clock set to %lld (UTC%+ld s)", static_cast<long long> (utc), static_cast<long> (tzOffset));
+  applySchedule (true);
+}
+
+// ----------------------------------------------------------------------------
+// private method, changes the mode when the scheduled slot changes
+// force is true to apply the current slot even if it did not change
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::applySchedule (bool force) {
+  time_t local;
+  struct tm tm;
+  uint8_t mode;
+
+  if (_schedule_enabled == false) {
+    return;
+  }
+
+  if (_schedule->attrDirty && _schedule_timer != nullptr) {
+
+    publishScheduleAttribute();
+  }
+
+  portENTER_CRITICAL (&_schedule_mux);
+  local = _schedule->timeBase;
+  if (local != 0) {
+
+    local += (esp_timer_get_time() - _schedule->timeBaseUs) / 1000000 + _schedule->tzOffset;
+  }
+  portEXIT_CRITICAL (&_schedule_mux);
+  if (local == 0) {
+    return;
+  }
+
+  gmtime_r (&local, &tm);
+  mode = _schedule->week.at (tm);
+  if (mode == _schedule->last && force == false) {
+    return;
+  }
+  _schedule->last = mode;
+  if (mode == PilotWireSchedule::Hold || mode == _current_mode) {
+    return;
+  }
+
+  log_i ("Scheduled mode %d at %02d:%02d", mode, tm.tm_hour, tm.tm_min);
+  applyLocalMode (mode);
+}
+
+// ----------------------------------------------------------------------------
+// Modes selected by the thermostat, from the highest to the lowest heating demand
+static const ZigbeePilotWireMode ThermostatSteps[] = {
+  PILOTWIRE_MODE_COMFORT,
+  PILOTWIRE_MODE_COMFORT_MINUS_1,
+  PILOTWIRE_MODE_COMFORT_MINUS_2,
+  PILOTWIRE_MODE_ECO
+};
+static const int8_t ThermostatLevels = sizeof (ThermostatSteps) / sizeof (ThermostatSteps[0]);
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setHeatingSetpoints (float occupied, float unoccupied) {
+  esp_zb_zcl_status_t ret1, ret2;
+
+  _occupied_setpoint = zb_float_to_s16 (occupied);
+  _unoccupied_setpoint = zb_float_to_s16 (unoccupied);
+  if (_thermostat_enabled == false) {
+    return true;
+  }
+
+  zbLock();
+  ret1 = esp_zb_zcl_set_attribute_val (_endpoint, ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                       ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID, &_occupied_setpoint, false);
+  ret2 = esp_zb_zcl_set_attribute_val (_endpoint, ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                       ESP_ZB_ZCL_ATTR_THERMOSTAT_UNOCCUPIED_HEATING_SETPOINT_ID, &_unoccupied_setpoint, false);
+  zbUnlock();
+  runThermostat();
+  if (ret1 != ESP_ZB_ZCL_STATUS_SUCCESS || ret2 != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+    _diag.attributeSetFailures++;
+    log_e ("Failed to set heating setpoints");
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setPowerBudget (int32_t budget_w) {
+  esp_zb_zcl_status_t ret;
+
+  _power_budget = (budget_w > 0) ? budget_w : 0;
+  if (_budget_enabled == false) {
+    return true;
+  }
+
+  zbLock();
+  ret = esp_zb_zcl_set_manufacturer_attribute_val (
+          _endpoint,
+          PILOT_WIRE_CLUSTER_ID,
+          ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+          PILOT_WIRE_MANUF_CODE,
+          PILOT_WIRE_BUDGET_ATTR_ID,
+          &_power_budget,
+          false
+        );
+  zbUnlock();
+  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+    _diag.attributeSetFailures++;
+    log_e ("Failed to set power budget: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setHousePowerW (int32_t power_w) {
+  esp_zb_zcl_status_t ret;
+
+  _house_power = power_w;
+  _house_power_us = esp_timer_get_time();
+  if (_budget_enabled == false) {
+    return true;
+  }
+
+  zbLock();
+  ret = esp_zb_zcl_set_manufacturer_attribute_val (
+          _endpoint,
+          PILOT_WIRE_CLUSTER_ID,
+          ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+          PILOT_WIRE_MANUF_CODE,
+          PILOT_WIRE_HOUSE_POWER_ATTR_ID,
+          &_house_power,
+          false
+        );
+  zbUnlock();
+  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+    _diag.attributeSetFailures++;
+    log_e ("Failed to set house power: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+int32_t
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::housePowerW() const {
+
+  if (_house_power_us == 0 ||
+      esp_timer_get_time() - _house_power_us > static_cast<int64_t> (PILOT_WIRE_HOUSE_POWER_TIMEOUT_MS) * 1000) {
+    return -1;
+  }
+  return _house_power;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setSystemMode (uint8_t mode) {
+  esp_zb_zcl_status_t ret = ESP_ZB_ZCL_STATUS_SUCCESS;
+
+  if (_thermostat_enabled) {
+
+    zbLock();
+    ret = esp_zb_zcl_set_attribute_val (_endpoint, ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                        ESP_ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID, &mode, false);
+    zbUnlock();
+  }
+  applySystemMode (mode);
+  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+    _diag.attributeSetFailures++;
+    log_e ("Failed to set thermostat system mode: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setOccupied (bool occupied) {
+
+  _occupancy = occupied ? 1 : 0;
+  if (_thermostat_enabled) {
+
+    zbLock();
+    esp_zb_zcl_set_attribute_val (_endpoint, ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                  ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPANCY_ID, &_occupancy, false);
+    zbUnlock();
+  }
+  runThermostat();
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setThermostatBand (float step, float hysteresis) {
+
+  _thermostat_step = (step >= 0.01f) ? zb_float_to_s16 (step) : 1;
+  _thermostat_hysteresis = (hysteresis >= 0.0f) ? zb_float_to_s16 (hysteresis) : 0;
+}
+
+// ----------------------------------------------------------------------------
+// private method, called when the system mode changes
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::applySystemMode (uint8_t mode) {
+
+  _system_mode = mode;
+  _thermostat_level = -1; // the next evaluation applies its step
+  if (mode == ESP_ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF) {
+
+    applyLocalMode (PILOTWIRE_MODE_OFF);
+  }
+  else {
+
+    runThermostat();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, step of the thermostat for a temperature excess in 0.01 °C
+template <bool WithTemperature, bool WithMetering>
+int8_t
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::thermostatLevel (int32_t excess) const {
+
+  if (excess < 0) {
+    return 0;
+  }
+  int32_t level = excess / _thermostat_step + 1;
+  return (level < ThermostatLevels) ? level : ThermostatLevels - 1;
+}
+
+// ----------------------------------------------------------------------------
+// private method, hysteresis controller, changes the mode when the step changes
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::runThermostat() {
+
+  if (_thermostat_enabled == false || isnan (temperature()) ||
+      _system_mode == ESP_ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF) {
+    return;
+  }
+
+  int32_t setpoint = _occupancy ? _occupied_setpoint : _unoccupied_setpoint;
+  int32_t excess = zb_float_to_s16 (temperature()) - setpoint;
+  int8_t level = thermostatLevel (excess);
+
+  if (_thermostat_level >= 0) {
+
+    // the step only changes when the temperature crossed its boundary by the hysteresis
+    if (level > _thermostat_level) {
+
+      level = thermostatLevel (excess - _thermostat_hysteresis);
+      if (level <= _thermostat_level) {
+        return;
+      }
+    }
+    else if (level < _thermostat_level) {
+
+      level = thermostatLevel (excess + _thermostat_hysteresis);
+      if (level >= _thermostat_level) {
+        return;
+      }
+    }
+    else {
+      return;
+    }
+  }
+
+  _thermostat_level = level;
+  _heating_demand = static_cast<uint8_t> ( (ThermostatLevels - 1 - level) * 100 / (ThermostatLevels - 1));
+  zbLock();
+  esp_zb_zcl_set_attribute_val (_endpoint, ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                ESP_ZB_ZCL_ATTR_THERMOSTAT_PI_HEATING_DEMAND_ID, &_heating_demand, false);
+  zbUnlock();
+  log_i ("Thermostat step %d, %d.%02d C for setpoint %d.%02d C", level,
+         static_cast<int> (excess + setpoint) / 100, abs (static_cast<int> (excess + setpoint)) % 100,
+         static_cast<int> (setpoint) / 100, abs (static_cast<int> (setpoint)) % 100);
+  if (ThermostatSteps[level] != _current_mode) {
+
+    applyLocalMode (ThermostatSteps[level]);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, hands a mode decided on the device (schedule, thermostat) to
+// process() or to the Zigbee stack task, it may be called from the esp_timer task
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::applyLocalMode (uint8_t mode) {
+
+  _local_pending = mode;
+  if (_queue_enabled == false) {
+
+    postStackWork();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, schedules runStackWork() in the Zigbee stack task
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::postStackWork() {
+
+  if (_stack_work_posted.exchange (true)) {
+    // the alarm is pending and runs the new work too
+    return;
+  }
+
+  if (Zigbee.started() && zbLock (0)) {
+
+    esp_zb_scheduler_alarm (stackAlarmCallback, _endpoint, 0);
+    zbUnlock();
+    return;
+  }
+
+  // the lock is busy or the stack is not running yet, retried by a timer
+  if (_stack_retry_timer == nullptr) {
+    const esp_timer_create_args_t args = {
+      .callback = stackRetryTimerCallback,
+      .arg = this,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "pw_stack",
+      .skip_unhandled_events = true
+    };
+
+    if (esp_timer_create (&args, &_stack_retry_timer) != ESP_OK) {
+
+      log_e ("Failed to create the stack retry timer, EP %d work delayed", _endpoint);
+      _stack_retry_timer = nullptr;
+      _stack_work_posted = false;
+      return;
+    }
+  }
+  esp_timer_start_once (_stack_retry_timer, PILOT_WIRE_STACK_RETRY_MS * 1000ULL);
+}
+
+// ----------------------------------------------------------------------------
+// private, called from the esp_timer task until the work is handed to the Zigbee stack task
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::stackRetryTimerCallback (void *arg) {
+  ZigbeePilotWireControlT *ep = static_cast<ZigbeePilotWireControlT *> (arg);
+
+  if (Zigbee.started() && ep->zbLock (0)) {
+
+    esp_zb_scheduler_alarm (stackAlarmCallback, ep->_endpoint, 0);
+    ep->zbUnlock();
+  }
+  else {
+
+    esp_timer_start_once (ep->_stack_retry_timer, PILOT_WIRE_STACK_RETRY_MS * 1000ULL);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private, called from the Zigbee stack task, the alarm only carries the endpoint number
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::stackAlarmCallback (uint8_t endpoint) {
+  ZigbeePilotWireControlT *ep;
+
+  portENTER_CRITICAL (&_endpoints_mux);
+  for (ep = _first_endpoint; ep != nullptr && ep->_endpoint != endpoint; ep = ep->_next_endpoint) {
+  }
+  portEXIT_CRITICAL (&_endpoints_mux);
+
+  if (ep != nullptr) {
+
+    ep->runStackWork();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, called from the Zigbee stack task, applies the work handed by the other tasks
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::runStackWork() {
+  bool settled;
+  uint8_t settled_mode, settled_on_mode;
+
+  // the work posted from now on needs a new alarm
+  _stack_work_posted = false;
+
+  portENTER_CRITICAL (&_settle_mux);
+  settled = _settled_pending;
+  settled_mode = _settled_mode;
+  settled_on_mode = _settled_on_mode;
+  _settled_pending = false;
+  portEXIT_CRITICAL (&_settle_mux);
+  if (settled) {
+
+    applySettledCommand (settled_mode, settled_on_mode);
+  }
+
+  uint8_t mode = _local_pending.exchange (PilotWireSchedule::Hold);
+  if (mode != PilotWireSchedule::Hold) {
+
+    setPilotWireMode (static_cast<ZigbeePilotWireMode> (mode));
+  }
+
+  flushPending (portMAX_DELAY);
+}
+
+// ----------------------------------------------------------------------------
+// private, called from the esp_timer task
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::scheduleTimerCallback (void *arg) {
+
+  static_cast<ZigbeePilotWireControlT *> (arg)->applySchedule (false);
+}
+
+// ----------------------------------------------------------------------------
+// private, called from the esp_timer task
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::historyTimerCallback (void *arg) {
+
+  static_cast<ZigbeePilotWireControlT *> (arg)->sampleHistory();
+}
+
+// ----------------------------------------------------------------------------
+// private method, adds a sample to the history, publishes the last hour when it is closed
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::sampleHistory() {
+  int16_t temp = PilotWireHistory::NoTemperature;
+  bool closed;
+
+  if (temperatureEnabled() && !isnan (temperature())) {
+
+    temp = zb_float_to_s16 (temperature());
+  }
+
+  portENTER_CRITICAL (&_history_mux);
+  closed = _history->sample (_current_mode, powerW(), temp, energyWh());
+  portEXIT_CRITICAL (&_history_mux);
+
+  if (closed && _history_offset == 0) {
+
+    publishHistory (0);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, updates the history chunk attribute from an offset in hours
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::publishHistory (uint16_t offset) {
+  uint8_t chunk[1 + PILOT_WIRE_HISTORY_CHUNK]; // ZCL octet string, length first
+  esp_zb_zcl_status_t ret;
+
+  if (_history == nullptr) {
+    return false;
+  }
+
+  portENTER_CRITICAL (&_history_mux);
+  chunk[0] = static_cast<uint8_t> (_history->encodeChunk (offset, &chunk[1], PILOT_WIRE_HISTORY_CHUNK));
+  portEXIT_CRITICAL (&_history_mux);
+
+  zbLock();
+  ret = esp_zb_zcl_set_manufacturer_attribute_val (
+          _endpoint,
+          PILOT_WIRE_CLUSTER_ID,
+          ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+          PILOT_WIRE_MANUF_CODE,
+          PILOT_WIRE_HISTORY_ATTR_ID,
+          chunk,
+          false
+        );
+  zbUnlock();
+  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+    _diag.attributeSetFailures++;
+    log_e ("Failed to update history attribute: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// private method, called from the Zigbee stack task, keeps the block for updateDeltaOta()
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::receiveDeltaBlock (const uint8_t *value) {
+  uint8_t len = value[0];
+  uint32_t offset;
+
+  if (len <= 4 || len > 4 + PILOT_WIRE_DELTA_BLOCK) {
+
+    log_w ("Invalid delta block received (%d bytes)", len);
+    return;
+  }
+  if (_delta_ready.load (std::memory_order_acquire)) {
+
+    // the previous block is not written yet, the server sends it again from the offset
+    log_w ("Delta block dropped, the previous one is pending");
+    return;
+  }
+
+  offset = value[1] | (value[2] << 8) | (value[3] << 16) | (static_cast<uint32_t> (value[4]) << 24);
+  if (offset != 0 && (offset != _delta_offset || _delta_status != 0)) {
+
+    // repeated or out of sequence
+    log_d ("Delta block at %lu ignored, next at %lu", (unsigned long) offset, (unsigned long) _delta_offset);
+    return;
+  }
+  _delta_block->offset = offset;
+  _delta_block->len = len - 4;
+  memcpy (_delta_block->data, &value[5], len - 4);
+  _delta_ready.store (true, std::memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::updateDeltaOta() {
+
+  if (_delta_block == nullptr || _delta_ready.load (std::memory_order_acquire) == false) {
+    return _delta_status == 0 || _delta_status == PILOT_WIRE_DELTA_DONE;
+  }
+
+  if (_delta_block->offset == 0) {
+
+    // a new patch
+    _delta_patcher->begin();
+    _delta_offset = 0;
+    _delta_status = 0;
+    log_i ("EP %d delta OTA started", _endpoint);
+  }
+  if (_delta_patcher->write (_delta_block->data, _delta_block->len)) {
+
+    _delta_offset += _delta_block->len;
+    if (_delta_patcher->finished()) {
+
+      _delta_status = PILOT_WIRE_DELTA_DONE;
+      log_i ("EP %d delta OTA done, %lu bytes written", _endpoint, (unsigned long) _delta_patcher->written());
+    }
+  }
+  else {
+
+    _delta_status = _delta_patcher->error();
+    log_e ("EP %d delta OTA failed at %lu: error %d", _endpoint, (unsigned long) _delta_offset, _delta_status);
+  }
+  _delta_ready.store (false, std::memory_order_release);
+  bool status = publishDeltaOta();
+  return status && (_delta_status == 0 || _delta_status == PILOT_WIRE_DELTA_DONE);
+}
+
+// ----------------------------------------------------------------------------
+// private method, writes the offset and the status of the delta in the stack
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::publishDeltaOta() {
+  esp_zb_zcl_status_t ret;
+
+  zbLock();
+  ret = esp_zb_zcl_set_manufacturer_attribute_val (_endpoint, PILOT_WIRE_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                   PILOT_WIRE_MANUF_CODE, PILOT_WIRE_DELTA_STATUS_ATTR_ID, &_delta_status, false);
+  if (ret == ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+    // the offset last, the server sends the next block when it moves
+    ret = esp_zb_zcl_set_manufacturer_attribute_val (_endpoint, PILOT_WIRE_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                     PILOT_WIRE_MANUF_CODE, PILOT_WIRE_DELTA_OFFSET_ATTR_ID, &_delta_offset, false);
+  }
+  zbUnlock();
+  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+    _diag.attributeSetFailures++;
+    log_e ("Failed to update delta OTA attributes: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// private method, writes the packed status attribute if the snapshot changed
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::updateStatus() {
+  uint8_t status[1 + PILOT_WIRE_STATUS_SIZE]; // ZCL octet string, length first
+  uint8_t flags = _current_state ? 0x01 : 0x00;
+  int16_t temp = static_cast<int16_t> (0x8000); // ZCL invalid measurement
+  int32_t demand = 0;
+  uint64_t summation = 0;
+  esp_zb_zcl_status_t ret;
+
+  if (_status_enabled == false) {
+    return false;
+  }
+
+  if (temperatureEnabled() && !isnan (temperature())) {
+
+    temp = zb_float_to_s16 (temperature());
+    flags |= 0x02;
+  }
+  if constexpr (WithMetering) {
+
+    if (this->_metering_enabled) {
+
+      demand = static_cast<int32_t> (this->_instantaneousDemand.low) | (static_cast<int32_t> (this->_instantaneousDemand.high) << 16);
+      summation = static_cast<uint64_t> (this->_summationDelivered.low) | (static_cast<uint64_t> (this->_summationDelivered.high) << 32);
+      flags |= 0x04;
+    }
+  }
+
+  status[0] = PILOT_WIRE_STATUS_SIZE;
+  status[1] = PILOT_WIRE_STATUS_VERSION;
+  status[2] = flags;
+  status[3] = _current_mode;
+  status[4] = static_cast<uint8_t> (temp);
+  status[5] = static_cast<uint8_t> (temp >> 8);
+  for (uint8_t i = 0; i < 3; i++) {
+
+    status[6 + i] = static_cast<uint8_t> (demand >> (8 * i));
+  }
+  for (uint8_t i = 0; i < 6; i++) {
+
+    status[9 + i] = static_cast<uint8_t> (summation >> (8 * i));
+  }
+
+  if (memcmp (status, _status_attr, sizeof (status)) == 0) {
+    return true;
+  }
+  memcpy (_status_attr, status, sizeof (status));
+
+  zbLock();
+  ret = esp_zb_zcl_set_manufacturer_attribute_val (
+          _endpoint,
+          PILOT_WIRE_CLUSTER_ID,
+          ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+          PILOT_WIRE_MANUF_CODE,
+          PILOT_WIRE_STATUS_ATTR_ID,
+          _status_attr,
+          false
+        );
+  zbUnlock();
+  if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+    _diag.attributeSetFailures++;
+    log_e ("Failed to update status attribute: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportStatus() {
+
+  if (_status_enabled == false) {
+
+    log_w ("Status attribute not enabled");
+    return false;
+  }
+  zbLock();
+  updateStatus();
+  esp_err_t ret = sendReport (PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_STATUS_ATTR_ID, PILOT_WIRE_MANUF_CODE);
+  zbUnlock();
+  return ret == ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+uint8_t
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::readHistory (uint16_t offset, PilotWireHistoryRecord *records, uint8_t n) {
+  uint8_t count;
+
+  if (_history == nullptr) {
+    return 0;
+  }
+  portENTER_CRITICAL (&_history_mux);
+  count = _history->read (offset, records, n);
+  portEXIT_CRITICAL (&_history_mux);
+  return count;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+uint8_t
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::energyProfile (uint16_t offset, uint8_t periods, uint32_t *intervals) {
+  uint8_t count;
+
+  if (_history == nullptr) {
+    return 0;
+  }
+  portENTER_CRITICAL (&_history_mux);
+  count = _history->profile (offset, periods, intervals);
+  portEXIT_CRITICAL (&_history_mux);
+  return count;
+}
+
+// ----------------------------------------------------------------------------
+// Called whenever Pilot Wire mode changes
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::pilotWireModeChanged() {
+  log_i ("Pilot Wire mode changed to %d", _current_mode);
+
+  // Save current mode persistently in NVS, written later by the store
+  if (_store != nullptr) {
+
+    _store->setMode (_store_slot, _current_mode);
+  }
+  _current_state = (_current_mode != PILOTWIRE_MODE_OFF);
+
+  if (_output != nullptr) {
+
+    _output->setMode (static_cast<ZigbeePilotWireMode> (_current_mode));
+  }
+
+  if (isPowerEstimationEnabled() && meteringEnabled()) {
+    int32_t nominal = nominalPower (static_cast<ZigbeePilotWireMode> (_current_mode));
+
+    if (powerW() != nominal) {
+
+      setPowerW (nominal);
+    }
+  }
+
+  invokeModeCallbacks();
+  if (_on_mode_change == nullptr && _on_endpoint_mode_change == nullptr && _output == nullptr) {
+
+    log_w ("No callback function set for pilot wire mode change");
+  }
+}
+
+// ----------------------------------------------------------------------------
+// private method, calls the mode change callbacks and measures them
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::invokeModeCallbacks() {
+
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_CALLBACK_ENTER, _endpoint, _current_mode);
+  int64_t t = esp_timer_get_time();
+  if (_on_mode_change) {
+
+    _on_mode_change (static_cast<ZigbeePilotWireMode> (_current_mode));
+  }
+  if (_on_endpoint_mode_change) {
+
+    _on_endpoint_mode_change (_endpoint, static_cast<ZigbeePilotWireMode> (_current_mode));
+  }
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_CALLBACK_EXIT, _endpoint, _current_mode);
+  if (_on_mode_change || _on_endpoint_mode_change) {
+
+    t = esp_timer_get_time() - t;
+    if (t > _diag.callbackMaxUs) {
+      _diag.callbackMaxUs = static_cast<uint32_t> (t);
+    }
+    _callback_total_us += t;
+    _callback_count++;
+    _diag.callbackAvgUs = static_cast<uint32_t> (_callback_total_us / _callback_count);
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setPilotWireMode (ZigbeePilotWireMode mode) {
+
+  if (mode != _current_mode) {
+
+    if (mode == PILOTWIRE_MODE_OFF) {
+
+      // Save current mode when turning off
+      _state_on_mode = _current_mode;
+      _current_state = false;
+      _current_state_changed = true;
+    }
+    else if (_current_mode == PILOTWIRE_MODE_OFF) {
+
+      _current_state = true;
+      _current_state_changed = true;
+    }
+
+    _current_mode = mode;
+    return reportAttributes();
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setTemperature (float temperature) {
+
+  if constexpr (WithTemperature) {
+
+    if (this->_temperature_enabled) {
+
+      this->_temperature_value = temperature;
+      bool status = writeAttributes (PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_TEMPERATURE));
+      runThermostat();
+      return status;
+    }
+    log_w ("Temperature measurement cluster not enabled");
+    return false;
+  }
+  else {
+
+    return false;
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::trySetTemperature (float temperature, TickType_t timeout) {
+
+  if constexpr (WithTemperature) {
+
+    if (this->_temperature_enabled) {
+
+      this->_temperature_value = temperature;
+      return tryWriteAttributes (PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_TEMPERATURE), timeout);
+    }
+    log_w ("Temperature measurement cluster not enabled");
+    return false;
+  }
+  else {
+
+    return false;
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setTemperatureFilter (PilotWireFilter::Type type, uint8_t param, uint8_t thresholdPercent) {
+
+  if constexpr (WithTemperature) {
+
+    this->_temperature_filter.begin (type, param);
+    this->_temperature_threshold = thresholdPercent;
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::pushTemperature (float sample) {
+
+  if constexpr (WithTemperature) {
+
+    if (this->_temperature_enabled == false) {
+
+      log_w ("Temperature measurement cluster not enabled");
+      return false;
+    }
+    if (isnan (sample)) {
+      return false;
+    }
+
+    this->_temperature_samples++;
+    int32_t filtered = this->_temperature_filter.push (lroundf (sample * 100.0f));
+    int32_t threshold = (static_cast<int32_t> (this->_temperature_delta) * this->_temperature_threshold) / 100;
+    if (threshold < 1) {
+      threshold = 1;
+    }
+    this->_temperature_value = static_cast<float> (filtered) / 100.0f;
+
+    // the lock is only taken when the filtered value moved enough
+    if (this->_temperature_written != ESP_ZB_ZCL_TEMP_MEASUREMENT_MEASURED_VALUE_DEFAULT &&
+        abs (filtered - this->_temperature_written) < threshold) {
+      return true;
+    }
+    bool status = writeAttributes (PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_TEMPERATURE));
+    runThermostat();
+    return status;
+  }
+  else {
+
+    return false;
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::tryReportAttributes (uint32_t mask, TickType_t timeout) {
+
+  if (zbLock (timeout)) {
+    ZigbeePilotWireReportStatus st;
+
+    flushPendingLocked();
+    bool status = reportBatchLocked (mask, false, st);
+    zbUnlock();
+    return status;
+  }
+
+  _pending_reports.fetch_or (mask & PILOTWIRE_ATTR_ALL);
+  _deferred_stats.deferred++;
+  postStackWork();
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// private method, writes the attributes of the mask with the values of the members
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::writeAttributes (uint32_t mask) {
+
+  zbLock();
+  // the values written now are no longer pending
+  _pending.fetch_and (~mask);
+  bool status = writeAttributesLocked (mask);
+  zbUnlock();
+  return status;
+}
+
+// ----------------------------------------------------------------------------
+// private method, writes the attributes if the lock is available before timeout,
+// parks them in the pending mask otherwise
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::tryWriteAttributes (uint32_t mask, TickType_t timeout) {
+
+  if (zbLock (timeout)) {
+
+    _pending.fetch_and (~mask);
+    bool status = writeAttributesLocked (mask);
+    flushPendingLocked();
+    zbUnlock();
+    return status;
+  }
+
+  // the member holds the latest value, a pending older value is superseded
+  uint32_t superseded = _pending.fetch_or (mask) & mask;
+  for (; superseded != 0; superseded &= superseded - 1) {
+    _deferred_stats.dropped++;
+  }
+  _deferred_stats.deferred++;
+  log_v ("Zigbee lock busy, attributes 0x%02X deferred", mask);
+  postStackWork();
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// private method, the Zigbee lock must be held
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::writeAttributesLocked (uint32_t mask) {
+  esp_zb_zcl_status_t ret;
+  bool status = true;
+
+  if constexpr (WithTemperature) {
+
+    if (mask & PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_TEMPERATURE)) {
+      int16_t zb_temperature = zb_float_to_s16 (this->_temperature_value);
+
+      log_d ("Setting temperature to %d", zb_temperature);
+      ret = esp_zb_zcl_set_attribute_val (
+              _endpoint, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, &zb_temperature, false
+            );
+      this->_temperature_writes++;
+      if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+        _diag.attributeSetFailures++;
+        log_e ("Failed to set temperature: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+        status = false;
+      }
+      else {
+        this->_temperature_written = zb_temperature;
+      }
+
+      if (_thermostat_enabled) {
+
+        ret = esp_zb_zcl_set_attribute_val (
+                _endpoint, ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                ESP_ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID, &zb_temperature, false
+              );
+        if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+          _diag.attributeSetFailures++;
+          log_e ("Failed to set thermostat local temperature: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+          status = false;
+        }
+      }
+    }
+  }
+
+  if constexpr (WithMetering) {
+
+    if (mask & PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_ENERGY)) {
+
+      ret = esp_zb_zcl_set_attribute_val (
+              _endpoint,
+              ESP_ZB_ZCL_CLUSTER_ID_METERING,
+              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+              ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID,
+              &this->_summationDelivered,
+              false // do not check access rights
+            );
+      if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+        _diag.attributeSetFailures++;
+        log_e ("Failed to set CurrentSummationDelivered: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+        status = false;
+      }
+    }
+
+    if (mask & PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_POWER)) {
+
+      ret = esp_zb_zcl_set_attribute_val (
+              _endpoint,
+              ESP_ZB_ZCL_CLUSTER_ID_METERING,
+              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+              ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID,
+              &this->_instantaneousDemand,
+              false // do not check access rights
+            );
+      if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+        _diag.attributeSetFailures++;
+        log_e ("Failed to set InstantaneousDemand: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+        status = false;
+      }
+    }
+
+    if (mask & PILOTWIRE_PENDING_METERING_STATUS) {
+
+      ret = esp_zb_zcl_set_attribute_val (
+              _endpoint,
+              ESP_ZB_ZCL_CLUSTER_ID_METERING,
+              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+              ESP_ZB_ZCL_ATTR_METERING_STATUS_ID,
+              &this->_metering_cfg.status,
+              false // do not check access rights
+            );
+      if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+
+        _diag.attributeSetFailures++;
+        log_e ("Failed to set Metering Status: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
+        status = false;
+      }
+    }
+  }
+
+  if (_status_enabled && (mask & PILOTWIRE_ATTR_ALL) && updateStatus() == false) {
+    status = false;
+  }
+  return status;
+}
+
+// ----------------------------------------------------------------------------
+// protected method, the Zigbee lock must be held
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::flushPendingLocked() {
+  uint32_t writes = _pending.exchange (0);
+  uint32_t reports = _pending_reports.exchange (0);
+  bool status = true;
+
+  if (writes != 0) {
+
+    status = writeAttributesLocked (writes);
+    for (; writes != 0; writes &= writes - 1) {
+      _deferred_stats.flushed++;
+    }
+  }
+  if (reports != 0) {
+    ZigbeePilotWireReportStatus st;
+
+    if (reportBatchLocked (reports, false, st) == false) {
+      status = false;
+    }
+    _deferred_stats.flushed++;
+  }
+  return status;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::flushPending (TickType_t timeout) {
+
+  if (_pending.load() == 0 && _pending_reports.load() == 0) {
+    return true;
+  }
+  if (zbLock (timeout) == false) {
+    return false;
+  }
+  bool status = flushPendingLocked();
+  zbUnlock();
+  return status;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::resetDeferredStats() {
+
+  _deferred_stats = {};
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setTemperatureReporting (uint16_t min_interval, uint16_t max_interval, float delta) {
+
+  if (temperatureEnabled()) {
+
+    // delta in 0.01 °C
+    return setReportingProfile (PILOTWIRE_ATTR_TEMPERATURE, min_interval, max_interval,
+                                static_cast<uint16_t> (delta * 100.0f + 0.5f));
+  }
+  log_w ("Temperature measurement cluster not enabled");
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+float
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::temperatureMin() const {
+
+  if constexpr (WithTemperature) {
+
+    return zb_s16_to_float (this->_temperature_cfg.min_value);
+  }
+  else {
+
+    return NAN;
+  }
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+float
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::temperatureMax() const {
+
+  if constexpr (WithTemperature) {
+
+    return zb_s16_to_float (this->_temperature_cfg.max_value);
+  }
+  else {
+
+    return NAN;
+  }
+}
+// -----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setEnergyWhReporting (uint16_t min_interval, uint16_t max_interval, float delta) {
+
+  if (meteringEnabled()) {
+
+    return setReportingProfile (PILOTWIRE_ATTR_ENERGY, min_interval, max_interval,
+                                static_cast<uint16_t> (delta + 0.5f));
+  }
+
+  log_w ("Metering cluster not enabled on this endpoint");
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setPowerWReporting (uint16_t min_interval, uint16_t max_interval, float delta) {
+  if (meteringEnabled()) {
+
+    return setReportingProfile (PILOTWIRE_ATTR_POWER, min_interval, max_interval,
+                                static_cast<uint16_t> (delta + 0.5f));
+  }
+
+  log_w ("Metering cluster not enabled on this endpoint");
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setReportingProfile (ZigbeePilotWireAttribute attr,
+    uint16_t min_interval, uint16_t max_interval, uint16_t delta) {
+
+  if (attr >= PILOTWIRE_ATTR_COUNT) {
+    return false;
+  }
 
-    }
-    else {
+  _reporting[attr] = { min_interval, max_interval, delta };
+  _reporting_mask |= PILOTWIRE_ATTR_BIT (attr);
+  if (attr == PILOTWIRE_ATTR_TEMPERATURE) {
 
-      log_w ("Received message ignored. Attribute ID: 0x%04X not supported for Pilot Wire Control", message->attribute.id);
+    if constexpr (WithTemperature) {
+      this->_temperature_delta = delta;
     }
   }
-  else if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ON_OFF) {
+  saveReporting();
 
-    if (message->attribute.id == ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID && message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_BOOL) {
-      bool state = *reinterpret_cast<bool *> (message->attribute.data.value);
+  if (Zigbee.started()) {
 
-      if (state != _current_state) {
+    // the new profile replaces the one restored by begin(), if still pending
+    _reporting_pending &= ~PILOTWIRE_ATTR_BIT (attr);
+    return applyReporting (attr);
+  }
+  // the stack does not accept it yet, applied by the first report
+  _reporting_pending |= PILOTWIRE_ATTR_BIT (attr);
+  return true;
+}
 
-        log_v ("On/Off attribute changed to %d", state);
-        _current_state = state;
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportingProfile (ZigbeePilotWireAttribute attr,
+    ZigbeePilotWireReportingProfile &profile) const {
 
-        if (state) {
-          // new state is ON, restore previous mode
-          _current_mode = _state_on_mode;
-        }
-        else  {
-          // new state is OFF, save current mode
-          _state_on_mode = _current_mode;
-          _current_mode = PILOTWIRE_MODE_OFF;
-        }
-        pilotWireModeChanged();
-
-        // _current_mode changed, report attribute
-        log_v ("Updating Pilot Wire mode attribute to %d", _current_mode);
-        esp_zb_zcl_status_t ret;
-        esp_zb_lock_acquire (portMAX_DELAY);
-        ret = esp_zb_zcl_set_manufacturer_attribute_val (
-                _endpoint,
-                PILOT_WIRE_CLUSTER_ID,
-                ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-                PILOT_WIRE_MANUF_CODE,
-                PILOT_WIRE_MODE_ATTR_ID,
-                &_current_mode,
-                false
-              );
-        esp_zb_lock_release();
-        if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
-          log_e ("Failed to update Pilot Wire mode attribute: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
-        }
-      }
-    }
-    else {
+  if (attr >= PILOTWIRE_ATTR_COUNT || (_reporting_mask & PILOTWIRE_ATTR_BIT (attr)) == 0) {
+    return false;
+  }
+  profile = _reporting[attr];
+  return true;
+}
 
-      log_w ("Received message ignored. Attribute ID: 0x%04X not supported for On/Off", message->attribute.id);
-    }
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+size_t
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::exportReporting (uint8_t *buffer, size_t size) const {
+  size_t len = 0;
+
+  if (size < PILOT_WIRE_REPORTING_SIZE) {
+    return 0;
   }
-  else {
 
-    log_w ("Received message ignored. Cluster ID: 0x%04X not supported for Pilot Wire Control", message->info.cluster);
+  buffer[len++] = ReportingVersion;
+  buffer[len++] = _reporting_mask;
+  for (uint8_t i = 0; i < PILOTWIRE_ATTR_COUNT; i++) {
+    const uint16_t values[3] = { _reporting[i].minInterval, _reporting[i].maxInterval, _reporting[i].delta };
+
+    for (uint16_t v : values) {
+
+      buffer[len++] = static_cast<uint8_t> (v);
+      buffer[len++] = static_cast<uint8_t> (v >> 8);
+    }
   }
+  return len;
 }
 
 // ----------------------------------------------------------------------------
-// Called whenever Pilot Wire mode changes
-void
-ZigbeePilotWireControl::pilotWireModeChanged() {
-  log_i ("Pilot Wire mode changed to %d", _current_mode);
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::importReporting (const uint8_t *buffer, size_t size) {
 
-  // Save current mode persistently in NVS
-  _prefs.putInt ("mode", _current_mode);
-  _current_state = (_current_mode != PILOTWIRE_MODE_OFF);
+  if (size != PILOT_WIRE_REPORTING_SIZE || buffer[0] != ReportingVersion ||
+      (buffer[1] & ~PILOTWIRE_ATTR_ALL) != 0) {
 
-  if (_on_mode_change) {
+    log_e ("Invalid reporting table");
+    return false;
+  }
 
-    _on_mode_change (static_cast<ZigbeePilotWireMode> (_current_mode));
+  const uint8_t *p = &buffer[2];
+  for (uint8_t i = 0; i < PILOTWIRE_ATTR_COUNT; i++, p += 6) {
+
+    _reporting[i].minInterval = p[0] | (p[1] << 8);
+    _reporting[i].maxInterval = p[2] | (p[3] << 8);
+    _reporting[i].delta = p[4] | (p[5] << 8);
   }
-  else {
+  _reporting_mask = buffer[1];
+  if constexpr (WithTemperature) {
 
-    log_w ("No callback function set for pilot wire mode change");
+    if (_reporting_mask & PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_TEMPERATURE)) {
+      this->_temperature_delta = _reporting[PILOTWIRE_ATTR_TEMPERATURE].delta;
+    }
+  }
+  saveReporting();
+
+  _reporting_pending = _reporting_mask;
+  if (Zigbee.started()) {
+
+    zbLock();
+    bool status = applyReportingLocked();
+    zbUnlock();
+    return status;
   }
+  return true;
 }
 
 // ----------------------------------------------------------------------------
+// private method, restores the reporting table from NVS, the attributes
+// configured by the application before begin() are kept
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::setPilotWireMode (ZigbeePilotWireMode mode) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::loadReporting() {
+  uint8_t record[PILOT_WIRE_REPORTING_SIZE];
+  char key[8];
 
-  if (mode != _current_mode) {
+  if (_store == nullptr) {
+    return false;
+  }
 
-    if (mode == PILOTWIRE_MODE_OFF) {
+  snprintf (key, sizeof (key), "rep%u", _endpoint);
+  if (_store->getBlob (key, record, sizeof (record)) == false || record[0] != ReportingVersion) {
+    return saveReporting();
+  }
 
-      // Save current mode when turning off
-      _state_on_mode = _current_mode;
-      _current_state = false;
-      _current_state_changed = true;
-    }
-    else if (_current_mode == PILOTWIRE_MODE_OFF) {
+  uint8_t restored = record[1] & ~_reporting_mask & PILOTWIRE_ATTR_ALL;
+  const uint8_t *p = &record[2];
+  for (uint8_t i = 0; i < PILOTWIRE_ATTR_COUNT; i++, p += 6) {
 
-      _current_state = true;
-      _current_state_changed = true;
+    if (restored & PILOTWIRE_ATTR_BIT (i)) {
+
+      _reporting[i].minInterval = p[0] | (p[1] << 8);
+      _reporting[i].maxInterval = p[2] | (p[3] << 8);
+      _reporting[i].delta = p[4] | (p[5] << 8);
     }
+  }
+  _reporting_mask |= restored;
+  _reporting_pending |= restored;
+  if constexpr (WithTemperature) {
 
-    _current_mode = mode;
-    return reportAttributes();
+    if (restored & PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_TEMPERATURE)) {
+      this->_temperature_delta = _reporting[PILOTWIRE_ATTR_TEMPERATURE].delta;
+    }
   }
-  return true;
+  log_i ("Restored reporting table from NVS (mask 0x%02X)", restored);
+  return saveReporting();
 }
 
 // ----------------------------------------------------------------------------
+// private method, writes the reporting table to NVS if it changed
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::setTemperature (float temperature) {
-  if (_temperature_enabled) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::saveReporting() {
+  uint8_t record[PILOT_WIRE_REPORTING_SIZE];
+  uint8_t stored[PILOT_WIRE_REPORTING_SIZE];
+  char key[8];
 
-    esp_zb_zcl_status_t ret = ESP_ZB_ZCL_STATUS_SUCCESS;
-    int16_t zb_temperature = zb_float_to_s16 (temperature);
-    log_v ("Updating temperature sensor value...");
-    /* Update temperature sensor measured value */
-    log_d ("Setting temperature to %d", zb_temperature);
-    esp_zb_lock_acquire (portMAX_DELAY);
-    ret = esp_zb_zcl_set_attribute_val (
-            _endpoint, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, &zb_temperature, false
-          );
-    esp_zb_lock_release();
-    if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
-      log_e ("Failed to set temperature: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
-      return false;
-    }
+  if (_store == nullptr || _reporting_mask == 0) {
+    return false;
+  }
+
+  exportReporting (record, sizeof (record));
+  snprintf (key, sizeof (key), "rep%u", _endpoint);
+  if (_store->getBlob (key, stored, sizeof (stored)) && memcmp (stored, record, sizeof (record)) == 0) {
+    // same table, no flash write
     return true;
   }
-  log_w ("Temperature measurement cluster not enabled");
-  return false;
+  return _store->putBlob (key, record, sizeof (record));
 }
 
 // ----------------------------------------------------------------------------
+// private method, applies the configuration of an attribute to the stack
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::setTemperatureReporting (uint16_t min_interval, uint16_t max_interval, float delta) {
-
-  if (_temperature_enabled) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::applyReporting (uint8_t attr) {
 
-    return  setReporting (ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
-                          ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID,
-                          min_interval, max_interval, delta * 100.0f); // delta in 0.01 °C;
+  if ( (attr == PILOTWIRE_ATTR_TEMPERATURE && temperatureEnabled() == false) ||
+       ( (attr == PILOTWIRE_ATTR_ENERGY || attr == PILOTWIRE_ATTR_POWER) && meteringEnabled() == false)) {
+    // the cluster is not on this endpoint, nothing to configure
+    return true;
   }
-  log_w ("Temperature measurement cluster not enabled");
-  return true;
+  ZigbeePilotWireReportingProfile profile = _reporting[attr];
+  uint8_t level = (_governor != nullptr) ? _governor->stats.level : 0;
+  if (level != 0 && (GovernedAttributes & PILOTWIRE_ATTR_BIT (attr))) {
+    uint32_t min_interval = static_cast<uint32_t> ( (profile.minInterval != 0) ? profile.minInterval : 1) << level;
+    uint32_t delta = static_cast<uint32_t> (profile.delta) << level;
+
+    // widened by the governor, the maximum interval stays above the minimum one
+    profile.minInterval = (min_interval < 0xFFFE) ? min_interval : 0xFFFE;
+    profile.delta = (delta < 0xFFFF) ? delta : 0xFFFF;
+    if (profile.maxInterval != 0 && profile.maxInterval < profile.minInterval) {
+      profile.maxInterval = profile.minInterval;
+    }
+  }
+  return setReporting (ReportTargets[attr].cluster_id, ReportTargets[attr].attr_id,
+                       profile.minInterval, profile.maxInterval, profile.delta,
+                       ReportTargets[attr].manuf_code);
 }
 
 // ----------------------------------------------------------------------------
-float
-ZigbeePilotWireControl::temperatureMin() const {
-  return zb_s16_to_float (_temperature_cfg.min_value);
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::enableReportingGovernor (bool enable) {
+
+  if (_governor == nullptr) {
+
+    if (enable == false) {
+      return;
+    }
+    // the window is allocated before the stack task can see the flag
+    _governor = new GovernorState();
+  }
+  _governor_enabled = enable;
+  _governor->windowUs = 0;
+  _governor->sent = _governor->failed = 0;
+  if (enable == false && _governor->stats.level != 0) {
+
+    // back to the reporting table
+    _governor->stats.level = 0;
+    _reporting_pending |= _reporting_mask & GovernedAttributes;
+    if (Zigbee.started()) {
+
+      zbLock();
+      applyReportingLocked();
+      zbUnlock();
+    }
+  }
 }
 
 // ----------------------------------------------------------------------------
-float
-ZigbeePilotWireControl::temperatureMax() const {
-  return zb_s16_to_float (_temperature_cfg.max_value);
-}
-// -----------------------------------------------------------------------------
-bool
-ZigbeePilotWireControl::setEnergyWhReporting (uint16_t min_interval, uint16_t max_interval, float delta) {
+// private method, closes the window when it is elapsed and changes the level,
+// the Zigbee lock must be held by the caller
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::governReports (int64_t now) {
 
-  if (_metering_enabled) {
+  if (_governor->windowUs == 0) {
 
-    return setReporting (ESP_ZB_ZCL_CLUSTER_ID_METERING,
-                         ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID,
-                         min_interval, max_interval, delta);
+    _governor->windowUs = now;
+    return;
+  }
+  if (now - _governor->windowUs < static_cast<int64_t> (PILOT_WIRE_GOVERNOR_WINDOW_MS) * 1000) {
+    return;
   }
 
-  log_w ("Metering cluster not enabled on this endpoint");
-  return true;
+  // only what the window observed: the reports sent and the ones the stack refused
+  uint32_t failed = _governor->failed;
+  uint32_t airtime = _governor->sent + failed;
+  bool congested = (airtime >= 3 && failed * 100 >= airtime * PILOT_WIRE_GOVERNOR_FAILURE_PCT) ||
+                   airtime > _governor_budget;
+  uint8_t level = _governor->stats.level;
+
+  if (congested) {
+
+    if (level < PILOT_WIRE_GOVERNOR_MAX_LEVEL) {
+
+      level++;
+      _governor->stats.backoffs++;
+    }
+  }
+  else if (level > 0 && failed == 0) {
+
+    level--;
+    _governor->stats.recoveries++;
+  }
+
+  _governor->stats.airtime = (airtime < 0xFFFF) ? airtime : 0xFFFF;
+  _governor->windowUs = now;
+  _governor->sent = _governor->failed = 0;
+  if (level != _governor->stats.level) {
+
+    log_i ("EP %d reporting governor level %d -> %d (airtime %lu, %lu failed)", _endpoint,
+           _governor->stats.level, level, (unsigned long) airtime, (unsigned long) failed);
+    _governor->stats.level = level;
+    _reporting_pending |= _reporting_mask & GovernedAttributes;
+    applyReportingLocked();
+  }
 }
 
-// -----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// private method, applies the pending configurations in one batch,
+// the Zigbee lock must be held by the caller
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::setPowerWReporting (uint16_t min_interval, uint16_t max_interval, float delta) {
-  if (_metering_enabled) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::applyReportingLocked() {
+  bool status = true;
 
-    return setReporting (ESP_ZB_ZCL_CLUSTER_ID_METERING,
-                         ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID,
-                         min_interval, max_interval, delta);
-  }
+  for (uint8_t i = 0; i < PILOTWIRE_ATTR_COUNT; i++) {
 
-  log_w ("Metering cluster not enabled on this endpoint");
-  return true;
+    if (_reporting_pending & PILOTWIRE_ATTR_BIT (i)) {
+
+      if (applyReporting (i)) {
+
+        _reporting_pending &= ~PILOTWIRE_ATTR_BIT (i);
+      }
+      else {
+
+        status = false;
+      }
+    }
+  }
+  return status;
 }
 
 // ----------------------------------------------------------------------------
 // protected method with manuf_code parameter
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::setReporting (uint16_t cluster_id, uint16_t attr_id,
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::setReporting (uint16_t cluster_id, uint16_t attr_id,
                                       uint16_t min_interval, uint16_t max_interval, float delta, uint16_t manuf_code) {
   esp_err_t ret;
   esp_zb_zcl_reporting_info_t reporting_info;
@@ -767,9 +3471,9 @@ ZigbeePilotWireControl::setReporting (uint16_t cluster_id, uint16_t attr_id,
   reporting_info.dst.profile_id = ESP_ZB_AF_HA_PROFILE_ID;
   reporting_info.manuf_code = manuf_code;
 
-  esp_zb_lock_acquire (portMAX_DELAY);
+  zbLock();
   ret = esp_zb_zcl_update_reporting_info (&reporting_info);
-  esp_zb_lock_release();
+  zbUnlock();
 
   if (ret != ESP_OK) {
     log_e ("Failed to set reporting cluster 0x%04X: 0x%x: %s", cluster_id, ret, esp_err_to_name (ret));
@@ -779,10 +3483,11 @@ ZigbeePilotWireControl::setReporting (uint16_t cluster_id, uint16_t attr_id,
 }
 
 // ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::reportTemperature() {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportTemperature() {
 
-  if (_temperature_enabled) {
+  if (temperatureEnabled()) {
     return reportAttribute (ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
                             ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID);
   }
@@ -791,10 +3496,11 @@ ZigbeePilotWireControl::reportTemperature() {
 }
 
 // ---------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::reportEnergyWh() {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportEnergyWh() {
 
-  if (_metering_enabled) {
+  if (meteringEnabled()) {
     return reportAttribute (ESP_ZB_ZCL_CLUSTER_ID_METERING,
                             ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID);
   }
@@ -803,10 +3509,11 @@ ZigbeePilotWireControl::reportEnergyWh() {
 }
 
 // ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::reportPowerW() {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportPowerW() {
 
-  if (_metering_enabled) {
+  if (meteringEnabled()) {
     return reportAttribute (ESP_ZB_ZCL_CLUSTER_ID_METERING,
                             ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID);
   }
@@ -815,16 +3522,25 @@ ZigbeePilotWireControl::reportPowerW() {
 }
 
 // ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::reportPilotModeAndOnOff () {
-  esp_zb_zcl_status_t ret;
-  bool status = true;
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportPilotModeAndOnOff () {
 
   pilotWireModeChanged();
+  return updatePilotModeAndOnOff();
+}
+
+// ----------------------------------------------------------------------------
+// private method, updates the Pilot Wire mode and On/Off attributes in the Zigbee stack
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::updatePilotModeAndOnOff () {
+  esp_zb_zcl_status_t ret;
+  bool status = true;
 
   // Report Pilot Wire mode attribute
   log_v ("Reporting Pilot Wire mode attribute: %d", _current_mode);
-  esp_zb_lock_acquire (portMAX_DELAY);
+  zbLock();
   ret = esp_zb_zcl_set_manufacturer_attribute_val (
           _endpoint,
           PILOT_WIRE_CLUSTER_ID,
@@ -834,8 +3550,9 @@ ZigbeePilotWireControl::reportPilotModeAndOnOff () {
           &_current_mode,
           false
         );
-  esp_zb_lock_release();
+  zbUnlock();
   if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+    _diag.attributeSetFailures++;
     log_e ("Failed to update Pilot Wire mode attribute: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
     status = false;
   }
@@ -846,7 +3563,7 @@ ZigbeePilotWireControl::reportPilotModeAndOnOff () {
     // _current_state changed, report attribute
     _current_state_changed = false;
     log_v ("Updating On/Off attribute to %d", _current_state);
-    esp_zb_lock_acquire (portMAX_DELAY);
+    zbLock();
     ret = esp_zb_zcl_set_attribute_val (
             _endpoint,
             ESP_ZB_ZCL_CLUSTER_ID_ON_OFF,
@@ -855,46 +3572,299 @@ ZigbeePilotWireControl::reportPilotModeAndOnOff () {
             &_current_state,
             false
           );
-    esp_zb_lock_release();
+    zbUnlock();
     if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+      _diag.attributeSetFailures++;
       log_e ("Failed to update On/Off attribute: 0x%x: %s", ret, esp_zb_zcl_status_to_name (ret));
       status = false;
     }
   }
+  if (_status_enabled && updateStatus() == false) {
+    status = false;
+  }
 
   return status;
 }
 
 // ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::reportAttributes() {
-  esp_zb_zcl_status_t ret;
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportAttributes() {
 
-  bool status = reportPilotModeAndOnOff();
+  // The callback is invoked outside of the Zigbee lock
+  pilotWireModeChanged();
 
-  if (_temperature_enabled) {
-    if (reportTemperature() == false) {
-      status = false;
-    }
+  zbLock();
+  bool status = reportAttributesLocked();
+  zbUnlock();
+  return status;
+}
+
+// ----------------------------------------------------------------------------
+// protected method, the Zigbee lock must be held by the caller
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportAttributesLocked() {
+  ZigbeePilotWireReportStatus st;
+
+  bool status = flushPendingLocked();
+  if (updatePilotModeAndOnOff() == false) {
+    status = false;
+  }
+  if (_reporting_pending != 0 && applyReportingLocked() == false) {
+    status = false;
   }
 
-  if (_metering_enabled) {
-    if (reportEnergyWh() == false) {
-      status = false;
+  // The Pilot Wire mode and On/Off attributes are reported by the stack on change
+  if (reportBatchLocked (PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_TEMPERATURE) |
+                         PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_ENERGY) |
+                         PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_POWER), false, st) == false) {
+    status = false;
+  }
+  if (_status_enabled && reportStatus() == false) {
+    status = false;
+  }
+  if (_diag_enabled) {
+
+    updateDiagnostics();
+  }
+  if (status && _boot_stats.joinUs == 0) {
+
+    // first report accepted by the stack, the device is on the network
+    _boot_stats.joinUs = static_cast<uint32_t> (esp_timer_get_time());
+  }
+  return status;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+void
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::enableDiagnostics (bool enable) {
+
+  if (enable && _diag_attr == nullptr) {
+
+    _diag_attr = new uint32_t[PILOT_WIRE_DIAG_COUNT]();
+  }
+  _diag_enabled = enable;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+ZigbeePilotWireDiagnostics
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::diagnostics() const {
+  ZigbeePilotWireDiagnostics diag = _diag;
+
+  diag.lockWaitTotalMs = static_cast<uint32_t> (_lock_wait_total_us / 1000);
+  diag.lockWaitMaxUs = _lock_wait_max_us;
+  diag.nvsWrites = nvsCommitCount();
+  diag.writesAbsorbed = _settle_stats.absorbed;
+  return diag;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::updateDiagnostics() {
+  ZigbeePilotWireDiagnostics diag = diagnostics();
+  uint32_t values[PILOT_WIRE_DIAG_COUNT];
+  bool status = true;
+
+  if (_diag_enabled == false) {
+    return false;
+  }
+
+  memcpy (values, &diag, sizeof (values));
+  zbLock();
+  for (uint16_t i = 0; i < PILOT_WIRE_DIAG_COUNT; i++) {
+
+    if (values[i] != _diag_attr[i]) {
+      esp_zb_zcl_status_t ret;
+
+      _diag_attr[i] = values[i];
+      ret = esp_zb_zcl_set_manufacturer_attribute_val (
+              _endpoint,
+              PILOT_WIRE_CLUSTER_ID,
+              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+              PILOT_WIRE_MANUF_CODE,
+              PILOT_WIRE_DIAG_ATTR_ID + i,
+              &_diag_attr[i],
+              false
+            );
+      if (ret != ESP_ZB_ZCL_STATUS_SUCCESS) {
+        log_w ("Failed to update diagnostics attribute 0x%04X: 0x%x: %s", PILOT_WIRE_DIAG_ATTR_ID + i, ret, esp_zb_zcl_status_to_name (ret));
+        status = false;
+      }
     }
-    if (reportPowerW() == false) {
-      status = false;
+  }
+  zbUnlock();
+  return status;
+}
+
+// ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportAttributes (uint32_t mask, ZigbeePilotWireReportStatus *status, bool changedOnly) {
+  ZigbeePilotWireReportStatus st;
+
+  zbLock();
+  bool ret = reportBatchLocked (mask, changedOnly, st);
+  zbUnlock();
+
+  if (status != nullptr) {
+    *status = st;
+  }
+  return ret;
+}
+
+// ----------------------------------------------------------------------------
+// protected method, the Zigbee lock must be held by the caller
+template <bool WithTemperature, bool WithMetering>
+bool
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportBatchLocked (uint32_t mask, bool changedOnly, ZigbeePilotWireReportStatus &st) {
+
+  int64_t now = esp_timer_get_time();
+
+  st.sent = st.failed = st.skipped = 0;
+  if (_governor_enabled) {
+
+    governReports (now);
+  }
+  for (uint8_t attr = 0; attr < PILOTWIRE_ATTR_COUNT; attr++) {
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    if (mask & PILOTWIRE_ATTR_BIT (attr)) {
+
+      if (_governor != nullptr && _governor->stats.level != 0 && (GovernedAttributes & PILOTWIRE_ATTR_BIT (attr)) &&
+          (_reporting_mask & PILOTWIRE_ATTR_BIT (attr)) && _governor->lastUs[attr] != 0 &&
+          now - _governor->lastUs[attr] < (static_cast<int64_t> (_reporting[attr].minInterval) << _governor->stats.level) * 1000000) {
+
+        // low-priority report throttled by the governor
+        _governor->stats.throttled++;
+        st.skipped++;
+      }
+      else if ( (attr == PILOTWIRE_ATTR_TEMPERATURE && temperatureEnabled() == false) ||
+           ( (attr == PILOTWIRE_ATTR_ENERGY || attr == PILOTWIRE_ATTR_POWER) && meteringEnabled() == false)) {
+
+        ret = ESP_ERR_NOT_SUPPORTED;
+      }
+      else {
+        uint64_t value = attributeSnapshot (attr);
+
+        if (changedOnly && (_reported_mask & PILOTWIRE_ATTR_BIT (attr)) && _last_reported[attr] == value) {
+
+          st.skipped++;
+        }
+        else {
+
+          ret = sendReport (ReportTargets[attr].cluster_id, ReportTargets[attr].attr_id, ReportTargets[attr].manuf_code);
+          if (ret == ESP_OK) {
+
+            _last_reported[attr] = value;
+            _reported_mask |= PILOTWIRE_ATTR_BIT (attr);
+            if (_governor != nullptr) {
+              _governor->lastUs[attr] = now;
+            }
+            st.sent++;
+          }
+          else {
+
+            st.failed++;
+          }
+        }
+      }
     }
+    st.status[attr] = ret;
   }
 
-  return status;
+  log_v ("Batched report on EP %d: %d sent, %d failed, %d skipped", _endpoint, st.sent, st.failed, st.skipped);
+  return st.failed == 0;
+}
+
+// ----------------------------------------------------------------------------
+// protected method, current value of an attribute, used to skip unchanged reports
+template <bool WithTemperature, bool WithMetering>
+uint64_t
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::attributeSnapshot (uint8_t attr) const {
+
+  switch (attr) {
+    case PILOTWIRE_ATTR_MODE:
+      return _current_mode;
+    case PILOTWIRE_ATTR_ON_OFF:
+      return _current_state;
+    case PILOTWIRE_ATTR_TEMPERATURE:
+      return static_cast<uint16_t> (zb_float_to_s16 (temperature()));
+    case PILOTWIRE_ATTR_ENERGY:
+      return energyWh();
+    case PILOTWIRE_ATTR_POWER:
+      return static_cast<uint32_t> (powerW());
+    default:
+      return 0;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// protected method
+// The Zigbee lock is a recursive mutex, this wrapper only acquires it once per task
+// so that nested calls (e.g. a reporting pass over several endpoints) cost a single acquisition.
+bool
+ZigbeePilotWireLock::zbLock (TickType_t timeout) {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+  if (_lock_owner == self) {
+
+    _lock_depth++;
+    return true;
+  }
+
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_LOCK_REQUEST);
+  int64_t t = esp_timer_get_time();
+  if (esp_zb_lock_acquire (timeout) == false) {
+    return false;
+  }
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_LOCK_ACQUIRED);
+  t = esp_timer_get_time() - t;
+  _lock_owner = self;
+  _lock_depth = 1;
+  _lock_count++;
+  _lock_wait_total_us += t;
+  if (t > _lock_wait_max_us) {
+    _lock_wait_max_us = static_cast<uint32_t> (t);
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// protected method
+void
+ZigbeePilotWireLock::zbUnlock() {
+
+  if (--_lock_depth == 0) {
+
+    _lock_owner = nullptr;
+    PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_LOCK_RELEASE);
+    esp_zb_lock_release();
+  }
 }
 
 // ----------------------------------------------------------------------------
 // protected method
+template <bool WithTemperature, bool WithMetering>
 bool
-ZigbeePilotWireControl::reportAttribute (uint16_t cluster_id, uint16_t attr_id,
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::reportAttribute (uint16_t cluster_id, uint16_t attr_id,
                                          uint16_t manuf_code) {
+
+  zbLock();
+  esp_err_t ret = sendReport (cluster_id, attr_id, manuf_code);
+  zbUnlock();
+
+  return ret == ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+// protected method, the Zigbee lock must be held by the caller
+template <bool WithTemperature, bool WithMetering>
+esp_err_t
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::sendReport (uint16_t cluster_id, uint16_t attr_id, uint16_t manuf_code) {
   /* Send report attributes command */
   esp_zb_zcl_report_attr_cmd_t report_attr_cmd;
   report_attr_cmd.address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT;
@@ -904,22 +3874,37 @@ ZigbeePilotWireControl::reportAttribute (uint16_t cluster_id, uint16_t attr_id,
   report_attr_cmd.zcl_basic_cmd.src_endpoint = _endpoint;
   report_attr_cmd.manuf_code = manuf_code;
 
-  esp_zb_lock_acquire (portMAX_DELAY);
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_REPORT_BEGIN, _endpoint, attr_id);
   esp_err_t ret = esp_zb_zcl_report_attr_cmd_req (&report_attr_cmd);
-  esp_zb_lock_release();
+  PILOT_WIRE_TRACE_EVENT (PILOTWIRE_TRACE_REPORT_END, _endpoint, attr_id);
 
   if (ret != ESP_OK) {
+    _diag.reportsFailed++;
+    if (_governor_enabled) {
+      if (_governor->failed < 0xFFFF) {
+        _governor->failed++;
+      }
+      governReports (esp_timer_get_time());
+    }
     log_e ("Failed to send attribute report: 0x%x: %s", ret, esp_err_to_name (ret));
-    return false;
+    return ret;
+  }
+  _diag.reportsSent++;
+  if (_governor_enabled) {
+    if (_governor->sent < 0xFFFF) {
+      _governor->sent++;
+    }
+    governReports (esp_timer_get_time());
   }
 
   log_v ("Attribute report sent for cluster 0x%04X attr 0x%04X", cluster_id, attr_id);
-  return true;
+  return ESP_OK;
 }
 
 // ----------------------------------------------------------------------------
+template <bool WithTemperature, bool WithMetering>
 void
-ZigbeePilotWireControl::printClusterInfo (Print &out) {
+ZigbeePilotWireControlT<WithTemperature, WithMetering>::printClusterInfo (Print &out) {
   esp_zb_cluster_list_t *cluster_list = _cluster_list;
   int count = 0;
 
@@ -951,3 +3936,15 @@ ZigbeePilotWireControl::printClusterInfo (Print &out) {
   }
   out.printf ("Total Clusters: %d\n", count);
 }
+
+template <bool WithTemperature, bool WithMetering>
+ZigbeePilotWireControlT<WithTemperature, WithMetering> *ZigbeePilotWireControlT<WithTemperature, WithMetering>::_first_endpoint = nullptr;
+
+template <bool WithTemperature, bool WithMetering>
+portMUX_TYPE ZigbeePilotWireControlT<WithTemperature, WithMetering>::_endpoints_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Every combination is instantiated, the unused ones are discarded by the linker
+template class ZigbeePilotWireControlT<false, false>;
+template class ZigbeePilotWireControlT<true, false>;
+template class ZigbeePilotWireControlT<false, true>;
+template class ZigbeePilotWireControlT<true, true>;
@@ -12,7 +12,18 @@
 
 #include <ZigbeeEP.h>
 #include <ha/esp_zigbee_ha_standard.h>
-#include <Preferences.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "PilotWireMode.h"
+#include "PilotWireOutput.h"
+#include "PilotWireStore.h"
+#include "PilotWireRing.h"
+#include "PilotWireSchedule.h"
+#include "PilotWireTrace.h"
+#include "PilotWireFilter.h"
+#include "PilotWirePulseMeter.h"
+#include "PilotWireHistory.h"
+#include "PilotWirePatch.h"
 
 /**
    @brief Manufacturer name for the Pilot Wire Control device.
@@ -48,112 +59,953 @@
 #define PILOT_WIRE_MANUF_CODE   0x1234
 #endif
 
+/**
+   @brief Image type of the firmware requested by the OTA Upgrade client.
+*/
+#ifndef PILOT_WIRE_OTA_IMAGE_TYPE
+#define PILOT_WIRE_OTA_IMAGE_TYPE  0x1011
+#endif
+
 /**
    @brief Manufacturer-specific cluster ID for the Pilot Wire Control device.
    Must be equal to or greater than 0xFC00 for manufacturer-specific clusters.
 */
 #define PILOT_WIRE_CLUSTER_ID   0xFC00
 
-/**
-   @brief Manufacturer-specific attribute ID for the Pilot Wire mode.
-*/
-#define PILOT_WIRE_MODE_ATTR_ID 0x0000
+/**
+   @brief Manufacturer-specific attribute ID for the Pilot Wire mode.
+*/
+#define PILOT_WIRE_MODE_ATTR_ID 0x0000
+
+/**
+   @brief Manufacturer-specific attribute ID of the packed status.
+   Octet string of PILOT_WIRE_STATUS_SIZE bytes, little endian:
+   version (U8, PILOT_WIRE_STATUS_VERSION), flags (U8, bit 0 On/Off, bit 1 temperature
+   valid, bit 2 metering valid), mode (U8), temperature (S16, 0.01 °C), instantaneous
+   demand (S24) and current summation delivered (U48), the raw values of their clusters.
+   The later versions only append fields.
+*/
+#define PILOT_WIRE_STATUS_ATTR_ID 0x0002
+
+/**
+   @brief Version of the layout of the packed status.
+*/
+#define PILOT_WIRE_STATUS_VERSION 1
+
+/**
+   @brief Size in bytes of the packed status, without the length of the octet string.
+*/
+#define PILOT_WIRE_STATUS_SIZE 14
+
+/**
+   @brief Manufacturer-specific attribute ID for the weekly schedule.
+   Octet string holding the PilotWireSchedule::Size bytes of the packed week,
+   or a day index (0 is Sunday) followed by the PilotWireSchedule::DayBytes bytes of this day.
+*/
+#define PILOT_WIRE_SCHEDULE_ATTR_ID 0x0001
+
+/**
+   @brief First manufacturer-specific attribute ID of the performance counters.
+   The counters are U32 attributes, in the order of ZigbeePilotWireDiagnostics.
+*/
+#define PILOT_WIRE_DIAG_ATTR_ID 0x0100
+
+/**
+   @brief Manufacturer-specific attribute ID of the whole-house power budget.
+   S32 in watts, 0 if there is no budget.
+*/
+#define PILOT_WIRE_BUDGET_ATTR_ID 0x0200
+
+/**
+   @brief Manufacturer-specific attribute ID of the whole-house power.
+   S32 in watts, written by the coordinator or a house meter, usually to a group.
+*/
+#define PILOT_WIRE_HOUSE_POWER_ATTR_ID 0x0201
+
+/**
+   @brief Manufacturer-specific attribute ID of the history chunk.
+   Octet string read-only, encoded by PilotWireHistory::encodeChunk() from the offset attribute.
+*/
+#define PILOT_WIRE_HISTORY_ATTR_ID 0x0300
+
+/**
+   @brief Manufacturer-specific attribute ID of the offset of the history chunk.
+   U16 in hours, 0 for the last closed hour, a write updates the history chunk.
+*/
+#define PILOT_WIRE_HISTORY_OFFSET_ATTR_ID 0x0301
+
+/**
+   @brief Manufacturer-specific attribute ID of the blocks of a delta OTA image.
+   Octet string written by the server: the offset of the block in the patch (U32 LE)
+   followed by 1 to PILOT_WIRE_DELTA_BLOCK bytes of the patch, see enableDeltaOta().
+*/
+#define PILOT_WIRE_DELTA_BLOCK_ATTR_ID 0x0400
+
+/**
+   @brief Manufacturer-specific attribute ID of the offset of the next delta block.
+   U32 read-only, the number of bytes of the patch accepted by the device.
+*/
+#define PILOT_WIRE_DELTA_OFFSET_ATTR_ID 0x0401
+
+/**
+   @brief Manufacturer-specific attribute ID of the status of the delta OTA image.
+   U8 read-only, 0 while the patch is received, PILOT_WIRE_DELTA_DONE when the new
+   firmware is rebuilt and verified, the PilotWirePatcher::Error of a failed patch.
+*/
+#define PILOT_WIRE_DELTA_STATUS_ATTR_ID 0x0402
+
+/**
+   @brief Value of the delta status attribute when the new firmware is ready.
+*/
+#define PILOT_WIRE_DELTA_DONE 0xFF
+
+/**
+   @brief Maximum size in bytes of the patch data of a delta block, it fits an unfragmented write.
+*/
+#ifndef PILOT_WIRE_DELTA_BLOCK
+#define PILOT_WIRE_DELTA_BLOCK  48
+#endif
+
+/**
+   @brief Period in milliseconds of the samples of the history, PILOT_WIRE_HISTORY_SAMPLES make an hour.
+*/
+#ifndef PILOT_WIRE_HISTORY_PERIOD_MS
+#define PILOT_WIRE_HISTORY_PERIOD_MS  60000
+#endif
+
+/**
+   @brief Time in milliseconds after which the whole-house power is considered stale.
+*/
+#ifndef PILOT_WIRE_HOUSE_POWER_TIMEOUT_MS
+#define PILOT_WIRE_HOUSE_POWER_TIMEOUT_MS  300000
+#endif
+
+/**
+   @brief Period in milliseconds of the evaluation of the weekly schedule.
+*/
+#ifndef PILOT_WIRE_SCHEDULE_PERIOD_MS
+#define PILOT_WIRE_SCHEDULE_PERIOD_MS  30000
+#endif
+
+/**
+   @brief Delay in milliseconds before work is handed again to the Zigbee stack task,
+   when the Zigbee lock was busy or the stack was not started.
+*/
+#ifndef PILOT_WIRE_STACK_RETRY_MS
+#define PILOT_WIRE_STACK_RETRY_MS  20
+#endif
+
+/**
+   @brief Enum representing the reportable attributes of the endpoint.
+   Used to select the attributes of a batched report and to index the status of each attribute.
+*/
+enum ZigbeePilotWireAttribute : uint8_t {
+  PILOTWIRE_ATTR_MODE = 0,    ///< Pilot Wire mode (manufacturer-specific cluster)
+  PILOTWIRE_ATTR_ON_OFF,      ///< On/Off
+  PILOTWIRE_ATTR_TEMPERATURE, ///< Temperature measured value
+  PILOTWIRE_ATTR_ENERGY,      ///< Metering current summation delivered
+  PILOTWIRE_ATTR_POWER,       ///< Metering instantaneous demand
+  PILOTWIRE_ATTR_COUNT        ///< Number of reportable attributes
+};
+
+/**
+   @brief Bit mask of an attribute in a batched report.
+*/
+#define PILOTWIRE_ATTR_BIT(attr) (1U << (attr))
+
+/**
+   @brief Bit mask selecting all the reportable attributes.
+*/
+#define PILOTWIRE_ATTR_ALL  ((1U << PILOTWIRE_ATTR_COUNT) - 1)
+
+/**
+   @brief Result of a batched report.
+*/
+struct ZigbeePilotWireReportStatus {
+  /**
+     @brief Status of each attribute, indexed by ZigbeePilotWireAttribute.
+     ESP_OK if the report was sent, ESP_ERR_NOT_SUPPORTED if the cluster is not enabled,
+     ESP_ERR_INVALID_STATE if the attribute was not requested or skipped because
+     its value did not change, or the error returned by the Zigbee stack.
+  */
+  esp_err_t status[PILOTWIRE_ATTR_COUNT];
+  uint8_t sent;    ///< Number of reports sent
+  uint8_t failed;  ///< Number of reports that failed
+  uint8_t skipped; ///< Number of reports skipped because the value did not change
+};
+
+/**
+   @brief Reporting configuration of an attribute.
+*/
+struct ZigbeePilotWireReportingProfile {
+  uint16_t minInterval; ///< Shortest time between reports in seconds
+  uint16_t maxInterval; ///< Longest time between reports in seconds
+  uint16_t delta;       ///< Change triggering a report, in the unit of the attribute (0.01 °C, Wh, W)
+};
+
+/**
+   @brief Size in bytes of the exported reporting table.
+   A version byte, the mask of the configured attributes and, for each
+   ZigbeePilotWireAttribute, the minimum and maximum intervals and the delta (U16 LE).
+*/
+#define PILOT_WIRE_REPORTING_SIZE  (2 + PILOTWIRE_ATTR_COUNT * 6)
+
+/**
+   @brief Evaluation window of the reporting governor in milliseconds.
+*/
+#ifndef PILOT_WIRE_GOVERNOR_WINDOW_MS
+#define PILOT_WIRE_GOVERNOR_WINDOW_MS  60000
+#endif
+
+/**
+   @brief Default airtime budget of the reporting governor, in reports per window and per endpoint.
+*/
+#ifndef PILOT_WIRE_GOVERNOR_BUDGET
+#define PILOT_WIRE_GOVERNOR_BUDGET  12
+#endif
+
+/**
+   @brief Failure rate in percent of the reports of a window which makes the governor back off.
+*/
+#ifndef PILOT_WIRE_GOVERNOR_FAILURE_PCT
+#define PILOT_WIRE_GOVERNOR_FAILURE_PCT  20
+#endif
+
+/**
+   @brief Maximum back-off level of the governor, the intervals and deltas are multiplied by 2^level.
+*/
+#ifndef PILOT_WIRE_GOVERNOR_MAX_LEVEL
+#define PILOT_WIRE_GOVERNOR_MAX_LEVEL  4
+#endif
+
+/**
+   @brief Statistics of the reporting governor.
+*/
+struct ZigbeePilotWireGovernorStats {
+  uint8_t level;       ///< Current back-off level, 0 when the reporting is not widened
+  uint16_t airtime;    ///< Reports of the last window, sent or refused by the stack
+  uint32_t backoffs;   ///< Number of level increases
+  uint32_t recoveries; ///< Number of level decreases
+  uint32_t throttled;  ///< Number of low-priority reports skipped by reportAttributes()
+};
+
+/**
+   @brief Statistics of the updates deferred by the try methods.
+*/
+struct ZigbeePilotWireDeferredStats {
+  uint32_t deferred; ///< Number of updates parked because the Zigbee lock was busy
+  uint32_t dropped;  ///< Number of parked values overwritten by a newer value before being written
+  uint32_t flushed;  ///< Number of parked updates written to the Zigbee stack
+};
+
+/**
+   @brief Capacity of the inbound command queue, must be a power of two.
+*/
+#ifndef PILOT_WIRE_QUEUE_SIZE
+#define PILOT_WIRE_QUEUE_SIZE  8
+#endif
+
+/**
+   @brief Statistics of the inbound command queue.
+*/
+struct ZigbeePilotWireQueueStats {
+  uint32_t enqueued;     ///< Number of commands pushed by the Zigbee stack task
+  uint32_t dispatched;   ///< Number of commands dispatched by process()
+  uint32_t overflows;    ///< Number of commands lost because the queue was full
+  uint32_t latencyMinUs; ///< Minimum enqueue-to-dispatch latency in microseconds
+  uint32_t latencyMaxUs; ///< Maximum enqueue-to-dispatch latency in microseconds
+  uint32_t latencyAvgUs; ///< Average enqueue-to-dispatch latency in microseconds
+};
+
+/**
+   @brief Default settle window of the inbound mode and On/Off writes in milliseconds, 0 to apply each write.
+*/
+#ifndef PILOT_WIRE_SETTLE_MS
+#define PILOT_WIRE_SETTLE_MS  0
+#endif
+
+/**
+   @brief Statistics of the settle window of the inbound writes.
+*/
+struct ZigbeePilotWireSettleStats {
+  uint32_t windows;  ///< Number of settle windows closed, each applies one state
+  uint32_t absorbed; ///< Number of writes superseded by a later write of the same window
+};
+
+/**
+   @brief Performance counters of an endpoint.
+   All the fields are 32-bit counters, published in this order from PILOT_WIRE_DIAG_ATTR_ID.
+*/
+struct ZigbeePilotWireDiagnostics {
+  uint32_t reportsSent;          ///< Number of attribute reports sent
+  uint32_t reportsFailed;        ///< Number of attribute reports that failed
+  uint32_t attributeSetFailures; ///< Number of attribute updates refused by the Zigbee stack
+  uint32_t lockWaitTotalMs;      ///< Total time spent waiting for the Zigbee lock, all endpoints, in milliseconds
+  uint32_t lockWaitMaxUs;        ///< Maximum time spent waiting for the Zigbee lock, all endpoints, in microseconds
+  uint32_t nvsWrites;            ///< Number of NVS writes of the shared store
+  uint32_t callbackMaxUs;        ///< Maximum execution time of the mode change callback in microseconds
+  uint32_t callbackAvgUs;        ///< Average execution time of the mode change callback in microseconds
+  uint32_t writesAbsorbed;       ///< Number of inbound mode and On/Off writes superseded in a settle window
+};
+
+/**
+   @brief Cost of the construction of the endpoint by begin().
+*/
+struct ZigbeePilotWireBeginStats {
+  uint32_t durationUs;       ///< Time spent in begin() in microseconds
+  uint32_t heapUsed;         ///< Heap allocated during begin() in bytes
+  uint32_t largestBlockDrop; ///< Decrease of the largest free heap block in bytes, a fragmentation hint
+  uint16_t attributes;       ///< Attributes added or completed from the descriptor tables
+};
+
+/**
+   @brief Startup phases of the endpoint, in microseconds since reset.
+   A phase not reached yet is 0.
+*/
+struct ZigbeePilotWireBootStats {
+  uint32_t restoreUs; ///< End of restore(), the heater is driven with the saved mode
+  uint32_t beginUs;   ///< End of begin(), the clusters are created
+  uint32_t joinUs;    ///< First report accepted by the stack, the device is on the network
+};
+
+/**
+   @brief Number of counters in ZigbeePilotWireDiagnostics.
+*/
+#define PILOT_WIRE_DIAG_COUNT (sizeof (ZigbeePilotWireDiagnostics) / sizeof (uint32_t))
+
+/**
+   @brief Zigbee lock shared by all the Pilot Wire endpoints.
+   The lock is recursive within a task and its statistics are common to all
+   the endpoints, whatever their clusters.
+*/
+class ZigbeePilotWireLock {
+  public:
+    /**
+       @brief Get the number of Zigbee lock acquisitions done by the library.
+       Nested acquisitions in the same task are not counted, the difference of two
+       readings around an operation gives its cost in lock acquisitions.
+    */
+    static uint32_t zbLockCount() {
+      return _lock_count;
+    }
+
+  protected:
+    template <bool, bool> friend class ZigbeePilotWireBankT;
+
+    static bool zbLock (TickType_t timeout = portMAX_DELAY);
+    static void zbUnlock();
+
+    static TaskHandle_t _lock_owner;
+    static uint16_t _lock_depth;
+    static uint32_t _lock_count;
+    static uint64_t _lock_wait_total_us;
+    static uint32_t _lock_wait_max_us;
+};
+
+/**
+   @brief Storage of the temperature measurement cluster (0x0402), empty when disabled.
+*/
+template <bool Enabled> class ZigbeePilotWireTemperature {
+  protected:
+    ZigbeePilotWireTemperature (float, float) {}
+};
+
+template <> class ZigbeePilotWireTemperature<true> {
+  protected:
+    ZigbeePilotWireTemperature (float tempMin, float tempMax);
+
+    bool _temperature_enabled;
+    esp_zb_temperature_meas_cluster_cfg_t _temperature_cfg;
+    float _temperature_value;
+    PilotWireFilter _temperature_filter;
+    uint16_t _temperature_delta;       // reporting delta in 0.01 °C, 0 if not set
+    uint8_t _temperature_threshold;    // percentage of the reporting delta
+    int16_t _temperature_written;      // last value written in the stack attribute
+    uint32_t _temperature_samples;
+    uint32_t _temperature_writes;
+};
+
+/**
+   @brief Storage of the simple metering cluster (0x0702), empty when disabled.
+*/
+template <bool Enabled> class ZigbeePilotWireMetering {
+  protected:
+    ZigbeePilotWireMetering (uint32_t) {}
+};
+
+template <> class ZigbeePilotWireMetering<true> {
+  protected:
+    ZigbeePilotWireMetering (uint32_t meteringMultiplier);
+
+    bool _metering_enabled;
+    esp_zb_uint48_t _summationDelivered;
+    esp_zb_int24_t _instantaneousDemand;
+    esp_zb_uint24_t _multiplier;
+    esp_zb_uint24_t _divisor;
+    esp_zb_metering_cluster_cfg_t _metering_cfg;
+
+    // On-device energy integrator
+    bool _energy_integration;
+    bool _power_estimation;
+    uint32_t _energy_last_ms;
+    int64_t _energy_residual; // W.ms not yet added to the summation
+    portMUX_TYPE _energy_mux; // integrator and summation, used by the application and the Zigbee task
+    uint16_t _nominal_power[PILOTWIRE_MODE_COUNT];
+    PilotWirePulseMeter *_pulse_meter;
+};
+
+/**
+   @brief Class template representing a Zigbee Pilot Wire Control endpoint.
+   This class extends the ZigbeeEP class to implement a custom cluster
+   for controlling pilot-wire electric heaters via Zigbee.
+
+   The optional clusters are selected at compile time: when a parameter is false,
+   the members of the cluster and the code that creates, updates and reports it
+   are not built, the corresponding setters return false and the getters return
+   NAN or 0. The attribute slots of the reporting tables and the storage of the
+   features enabled at run time are kept.
+   @tparam WithTemperature true to build the temperature measurement cluster (0x0402).
+   @tparam WithMetering true to build the simple metering cluster (0x0702).
+*/
+template <bool WithTemperature, bool WithMetering>
+class ZigbeePilotWireControlT : public ZigbeeEP, public ZigbeePilotWireLock,
+  protected ZigbeePilotWireTemperature<WithTemperature>,
+  protected ZigbeePilotWireMetering<WithMetering> {
+  public:
+    /**
+       @brief Constructor for ZigbeePilotWireControl.
+
+       Temperature measurement and metering clusters are disabled.
+       You must call begin() after constructing the object to initialize the endpoint.
+       @param endpoint The Zigbee endpoint number to use for this device.
+    */
+    ZigbeePilotWireControlT (uint8_t endpoint);
+
+    /**
+       @brief Constructor for ZigbeePilotWireControl with temperature measurement.
+       This constructor enables the temperature measurement cluster.
+       The metering cluster is disabled.
+       You must call begin(float currentTemperature) after constructing the object to initialize the endpoint.
+       @param endpoint The Zigbee endpoint number to use for this device.
+       @param tempMin The minimum temperature value for the temperature measurement cluster in degrees Celsius.
+       @param tempMax The maximum temperature value for the temperature measurement cluster in degrees Celsius.
+    */
+    ZigbeePilotWireControlT (uint8_t endpoint, float tempMin, float tempMax);
+
+    /**
+       @brief Constructor for ZigbeePilotWireControl with metering.
+       This constructor enables the metering cluster.
+       The temperature measurement cluster is disabled.
+       You must call begin() after constructing the object to initialize the endpoint.
+       @param endpoint The Zigbee endpoint number to use for this device.
+       @param meteringMultiplier The multiplier value for the metering cluster, must be non-zero to enable metering.
+        This value must be updated whis begin(uint32_t meteringMultiplier).
+    */
+    ZigbeePilotWireControlT (uint8_t endpoint, uint32_t meteringMultiplier);
+
+    /**
+        @brief Constructor for ZigbeePilotWireControl with temperature measurement and metering.
+       This constructor enables both the temperature measurement and metering clusters.
+       You must call begin(float currentTemperature) after constructing the object to initialize the endpoint.
+       @param endpoint The Zigbee endpoint number to use for this device.
+       @param tempMin The minimum temperature value for the temperature measurement cluster in degrees Celsius.
+       @param tempMax The maximum temperature value for the temperature measurement cluster in degrees Celsius.
+       @param meteringMultiplier The multiplier value for the metering cluster, must be non-zero to enable metering.
+        This value must be updated whis begin(float currentTemperature, uint32_t meteringMultiplier).
+    */
+    ZigbeePilotWireControlT (uint8_t endpoint, float tempMin, float tempMax, uint32_t meteringMultiplier);
+
+    /**
+       @brief Set a callback function to be called when the Pilot Wire mode changes.
+       This function must be called to register a callback that will be invoked before
+       to call begin().
+       @param callback A function pointer to the callback function.
+       The callback function should have the following signature:
+       void callback(ZigbeePilotWireMode mode);
+       The mode parameter will contain the new Pilot Wire mode.
+       This function is used to notify the application of mode changes.
+       @warning This is the only place where the mode change, after the zigbee network is
+       established, the user must use setPilotWireMode() to change mode.
+    */
+    void onPilotWireModeChange (void (*callback) (ZigbeePilotWireMode mode)) {
+      _on_mode_change = callback;
+    }
+
+    /**
+       @brief Set a callback function, receiving the endpoint number, to be called when the Pilot Wire mode changes.
+       This is useful when several endpoints share the same callback (see ZigbeePilotWireBank).
+       @param callback A function pointer to the callback function.
+       The callback function should have the following signature:
+       void callback(uint8_t endpoint, ZigbeePilotWireMode mode);
+    */
+    void onPilotWireModeChange (void (*callback) (uint8_t endpoint, ZigbeePilotWireMode mode)) {
+      _on_endpoint_mode_change = callback;
+    }
+
+    /**
+       @brief Attach a pilot wire signal generator driven by the mode changes.
+       The output is set to the new mode before the callback is invoked,
+       so the heater can be driven without any code in the application.
+       @param output The signal generator, nullptr to detach it. It must be started with PilotWireOutput::begin().
+    */
+    void setOutput (PilotWireOutput *output) {
+      _output = output;
+    }
+
+    /**
+       @brief Get the attached pilot wire signal generator.
+       @return the signal generator, nullptr if none is attached.
+    */
+    PilotWireOutput *output() const {
+      return _output;
+    }
+
+    /**
+       @brief Enable or disable the inbound command queue.
+       By default, mode and On/Off changes received from the Zigbee network are
+       applied in the Zigbee stack task: the callback, the NVS update and the
+       attribute updates run before the stack can process the next frame.
+       When the queue is enabled, these changes are pushed in a bounded lock-free
+       queue and applied when the application calls process() from its own task,
+       so a slow callback can never stall the Zigbee stack. The modes selected by
+       the schedule and the thermostat are applied the same way, in the stack task
+       or by process(). The queue is allocated when it is first enabled.
+       @param enable true to enable the queue, false to apply changes in the Zigbee stack task.
+    */
+    void enableCommandQueue (bool enable);
+
+    /**
+       @brief Check if the inbound command queue is enabled.
+    */
+    bool isCommandQueueEnabled() const {
+      return _queue_enabled;
+    }
+
+    /**
+       @brief Get the number of inbound commands waiting to be processed.
+       @return the number of commands in the queue.
+    */
+    size_t poll() const {
+      return (_queue != nullptr) ? _queue->ring.size() : 0;
+    }
+
+    /**
+       @brief Apply the inbound commands waiting in the queue.
+       This method must be called periodically from the application task (e.g. in loop())
+       when the command queue is enabled. The callback is invoked from the calling task.
+       If commands were lost because the queue was full, the mode is resynchronized
+       with the last value written by the Zigbee network.
+       @param max The maximum number of commands to apply.
+       @return the number of commands applied.
+    */
+    size_t process (size_t max = PILOT_WIRE_QUEUE_SIZE);
+
+    /**
+       @brief Get the statistics of the inbound command queue.
+    */
+    const ZigbeePilotWireQueueStats &queueStats() const {
+      static const ZigbeePilotWireQueueStats None = {};
+      return (_queue != nullptr) ? _queue->stats : None;
+    }
+
+    /**
+       @brief Reset the statistics of the inbound command queue.
+    */
+    void resetQueueStats();
+
+    /**
+       @brief Set the settle window of the inbound mode and On/Off writes.
+       A burst of writes to the mode and On/Off attributes (a scene replayed, an
+       automation fighting a user, a group retransmission) is coalesced: the first
+       write opens the window, the following ones only update the target, and the
+       final state is applied once when the window closes, with a single callback,
+       NVS write and report. The mode and On/Off attributes are then rewritten so
+       they agree with the applied state. The window closes in the esp_timer task,
+       the final state is applied by process() with the command queue, otherwise
+       in the Zigbee stack task. The changes decided on the device (schedule,
+       thermostat, setPilotWireMode()) are not delayed.
+       @param windowMs The window in milliseconds, 0 to apply each write immediately,
+       a pending window is then closed and its final state applied.
+    */
+    void setSettleWindow (uint32_t windowMs);
+
+    /**
+       @brief Get the settle window of the inbound writes in milliseconds.
+    */
+    uint32_t settleWindow() const {
+      return _settle_window_ms;
+    }
+
+    /**
+       @brief Get the statistics of the settle window.
+    */
+    const ZigbeePilotWireSettleStats &settleStats() const {
+      return _settle_stats;
+    }
+
+    /**
+       @brief Enable or disable the performance counters over Zigbee.
+       When enabled, begin() adds the Diagnostics cluster (0x0B05) to the endpoint
+       and the counters of ZigbeePilotWireDiagnostics as read-only manufacturer-specific
+       attributes of the Pilot Wire cluster, from PILOT_WIRE_DIAG_ATTR_ID. The attributes
+       are refreshed by reportAttributes() and updateDiagnostics(), so a coordinator can
+       poll the health of the device without a serial cable.
+       The counters themselves are always maintained, only the copies of the attributes
+       are allocated when the counters are first published.
+       @param enable true to publish the counters, false otherwise.
+       @note This method must be called before begin().
+    */
+    void enableDiagnostics (bool enable);
+
+    /**
+       @brief Check if the performance counters are published over Zigbee.
+    */
+    bool isDiagnosticsEnabled() const {
+      return _diag_enabled;
+    }
+
+    /**
+       @brief Get the performance counters.
+    */
+    ZigbeePilotWireDiagnostics diagnostics() const;
+
+    /**
+       @brief Copy the performance counters in the attributes of the Zigbee stack.
+       Only the counters that changed are updated.
+       @return true if the attributes are up to date, false otherwise.
+    */
+    bool updateDiagnostics();
+
+    /**
+       @brief Enable or disable the on-device thermostat.
+       When enabled, begin() adds the Thermostat cluster (0x0201) to the endpoint, with
+       the occupied and unoccupied heating setpoints, the occupancy and the system mode.
+       Each new temperature (setTemperature(), pushTemperature()) runs a hysteresis
+       controller which selects the mode from the excess of temperature over the setpoint:
+       - below the setpoint: Comfort
+       - from 0 to 1 step above: Comfort-1
+       - from 1 to 2 steps above: Comfort-2
+       - beyond: Eco
+       .
+       The mode only changes when the step changes, so the coordinator only pushes setpoints.
+       The selected mode is applied in the Zigbee stack task, or by process() with the
+       command queue, not in the task which passed the temperature.
+       A system mode Off sets the mode to Off and stops the controller.
+       @param enable true to enable the thermostat, false to disable.
+       @note This method must be called before begin().
+    */
+    void enableThermostat (bool enable) {
+      _thermostat_enabled = enable;
+    }
+
+    /**
+       @brief Check if the on-device thermostat is enabled.
+    */
+    bool isThermostatEnabled() const {
+      return _thermostat_enabled;
+    }
+
+    /**
+       @brief Set the heating setpoints of the thermostat.
+       @param occupied The setpoint when the room is occupied, in degrees Celsius.
+       @param unoccupied The setpoint when the room is unoccupied, in degrees Celsius.
+       @return true if the setpoints were set successfully, false otherwise.
+    */
+    bool setHeatingSetpoints (float occupied, float unoccupied);
+
+    /**
+       @brief Get the heating setpoint when the room is occupied, in degrees Celsius.
+    */
+    float occupiedHeatingSetpoint() const {
+      return static_cast<float> (_occupied_setpoint) / 100.0f;
+    }
+
+    /**
+       @brief Get the heating setpoint when the room is unoccupied, in degrees Celsius.
+    */
+    float unoccupiedHeatingSetpoint() const {
+      return static_cast<float> (_unoccupied_setpoint) / 100.0f;
+    }
+
+    /**
+       @brief Set the system mode of the thermostat.
+       @param mode ESP_ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF, ESP_ZB_ZCL_THERMOSTAT_SYSTEM_MODE_HEAT...
+       @return true if the system mode was set successfully, false otherwise.
+    */
+    bool setSystemMode (uint8_t mode);
+
+    /**
+       @brief Get the system mode of the thermostat.
+    */
+    uint8_t systemMode() const {
+      return _system_mode;
+    }
+
+    /**
+       @brief Set the occupancy of the room, which selects the setpoint.
+       @param occupied true if the room is occupied.
+    */
+    void setOccupied (bool occupied);
+
+    /**
+       @brief Set the temperature band of the thermostat steps.
+       @param step The width of the Comfort-1 and Comfort-2 steps in degrees Celsius (0.5 by default).
+       @param hysteresis The hysteresis around each boundary in degrees Celsius (0.2 by default).
+    */
+    void setThermostatBand (float step, float hysteresis);
+
+    /**
+       @brief Enable or disable the power budget attributes.
+       When enabled, begin() adds the whole-house power budget and the whole-house
+       power attributes to the Pilot Wire cluster. Both are usually written to a group,
+       so a single frame updates all the modules, and are used by PilotWireLoadManager
+       to shed the zones locally.
+       @param enable true to add the attributes, false otherwise.
+       @note This method must be called before begin().
+    */
+    void enablePowerBudget (bool enable) {
+      _budget_enabled = enable;
+    }
+
+    /**
+       @brief Check if the power budget attributes are enabled.
+    */
+    bool isPowerBudgetEnabled() const {
+      return _budget_enabled;
+    }
+
+    /**
+       @brief Set the whole-house power budget.
+       @param budget_w The budget in watts (W), 0 for no budget.
+       @return true if the budget was set successfully, false otherwise.
+    */
+    bool setPowerBudget (int32_t budget_w);
+
+    /**
+       @brief Get the whole-house power budget in watts (W), 0 if there is no budget.
+    */
+    int32_t powerBudget() const {
+      return _power_budget;
+    }
+
+    /**
+       @brief Set the whole-house power, when it is measured on the device.
+       @param power_w The power in watts (W).
+       @return true if the power was set successfully, false otherwise.
+    */
+    bool setHousePowerW (int32_t power_w);
+
+    /**
+       @brief Get the whole-house power.
+       @return the power in watts (W), -1 if it was never received or is older than PILOT_WIRE_HOUSE_POWER_TIMEOUT_MS.
+    */
+    int32_t housePowerW() const;
+
+    /**
+       @brief Enable or disable the on-device telemetry history.
+       When enabled, begin() allocates a PilotWireHistory, samples the mode, the power,
+       the temperature and the energy every PILOT_WIRE_HISTORY_PERIOD_MS and adds the
+       history chunk and offset attributes to the Pilot Wire cluster. After an outage,
+       the coordinator backfills the missing hours by writing the offset and reading
+       the chunk, several hours per read.
+       @param enable true to enable the history, false to disable.
+       @note This method must be called before begin().
+    */
+    void enableHistory (bool enable) {
+      _history_enabled = enable;
+    }
+
+    /**
+       @brief Check if the on-device telemetry history is enabled.
+    */
+    bool isHistoryEnabled() const {
+      return _history_enabled;
+    }
+
+    /**
+       @brief Read hours of history, the most recent first.
+       @param offset Number of most recent hours to skip.
+       @param records Destination of the records.
+       @param n Maximum number of records to read.
+       @return the number of records read, 0 if the history is not enabled.
+    */
+    uint8_t readHistory (uint16_t offset, PilotWireHistoryRecord *records, uint8_t n);
+
+    /**
+       @brief Get the energy per hour in the layout of the Metering GetProfile response.
+       The Arduino Zigbee core does not forward the GetProfile command to the endpoint,
+       this method gives the intervals to an application handling it.
+       @param offset Number of most recent hours to skip.
+       @param periods Maximum number of intervals.
+       @param intervals Destination of the energy of each hour in Wh, the most recent first.
+       @return the number of intervals written, 0 if the history is not enabled.
+    */
+    uint8_t energyProfile (uint16_t offset, uint8_t periods, uint32_t *intervals);
+
+    /**
+       @brief Enable or disable the packed status attribute.
+       When enabled, begin() adds the status attribute (PILOT_WIRE_STATUS_ATTR_ID) to the
+       Pilot Wire cluster: a versioned snapshot of the mode, the On/Off state, the
+       temperature, the instantaneous demand and the summation, kept up to date with
+       them. A coordinator refreshes the whole device with a single read, and
+       reportAttributes() sends it in a single report after the others.
+       @param enable true to publish the packed status, false otherwise.
+       @note This method must be called before begin().
+    */
+    void enableStatusAttribute (bool enable) {
+      _status_enabled = enable;
+    }
+
+    /**
+       @brief Check if the packed status attribute is enabled.
+    */
+    bool isStatusAttributeEnabled() const {
+      return _status_enabled;
+    }
+
+    /**
+       @brief Enable or disable the Groups and Scenes server clusters.
+       When enabled, begin() adds the Groups (0x0004) and Scenes (0x0005) clusters to the
+       endpoint: a mode write or an On/Off command sent to a group reaches every member
+       in a single groupcast frame. The scenes only store and recall the On/Off state,
+       an On restoring the last mode before Off. The Arduino Zigbee core does not forward
+       the recall of the other extension fields, so a scene cannot select a pilot wire
+       mode: write the mode attribute to the group instead.
+       @param enable true to add the Groups and Scenes clusters, false otherwise.
+       @note This method must be called before begin().
+    */
+    void enableGroups (bool enable) {
+      _groups_enabled = enable;
+    }
+
+    /**
+       @brief Check if the Groups and Scenes clusters are enabled.
+    */
+    bool isGroupsEnabled() const {
+      return _groups_enabled;
+    }
+
+    /**
+       @brief Send the packed status in a single report.
+       @return true if the report was sent, false if the attribute is not enabled or the report failed.
+    */
+    bool reportStatus();
+
+    /**
+       @brief Enable the OTA Upgrade client cluster.
+       When enabled, begin() adds the OTA Upgrade client cluster (0x0019) to the endpoint,
+       with the manufacturer code PILOT_WIRE_MANUF_CODE and the image type
+       PILOT_WIRE_OTA_IMAGE_TYPE. The images are downloaded and flashed by the Zigbee
+       core, requestOTAUpdate() asks the server for a new one. The Zigbee core writes the
+       blocks of this cluster straight to the update partition, a delta image is brought
+       by the attributes of enableDeltaOta().
+       @param fileVersion The version of the running firmware.
+       @param hwVersion The hardware version of the module.
+       @note This method must be called before begin(), on a single endpoint of the device.
+    */
+    void enableOta (uint32_t fileVersion, uint16_t hwVersion = 1) {
+      _ota_enabled = true;
+      _ota_file_version = fileVersion;
+      _ota_hw_version = hwVersion;
+    }
 
-/**
-   @brief Enum representing the different Pilot Wire modes.
-   These modes correspond to standard pilot wire control modes for electric heaters.
-*/
-enum ZigbeePilotWireMode : uint8_t {
-  PILOTWIRE_MODE_OFF = 0, ///< Heater Off
-  PILOTWIRE_MODE_COMFORT, ///< Comfort Mode
-  PILOTWIRE_MODE_ECO, ///< Eco Mode
-  PILOTWIRE_MODE_FROST_PROTECTION, ///< Frost Protection Mode
-  PILOTWIRE_MODE_COMFORT_MINUS_1, ///< Comfort Minus 1 Mode
-  PILOTWIRE_MODE_COMFORT_MINUS_2 ///< Comfort Minus 2 Mode
-};
+    /**
+       @brief Check if the OTA Upgrade client cluster is enabled.
+    */
+    bool isOtaEnabled() const {
+      return _ota_enabled;
+    }
 
-/**
-   @brief Minimum and maximum values for ZigbeePilotWireMode enum.
-   These constants can be used for validation or iteration over the enum values.
-*/
-const ZigbeePilotWireMode PILOTWIRE_MODE_MIN = PILOTWIRE_MODE_OFF;
+    /**
+       @brief Enable the transfer of delta OTA images.
+       When enabled, begin() adds the delta block, offset and status attributes to the
+       Pilot Wire cluster. The server writes the patch built by extras/tools/pilot_wire_delta.py
+       in blocks, each with its offset in the patch (PILOT_WIRE_DELTA_BLOCK_ATTR_ID), and
+       sends the next block once the offset attribute reached its end. A block at offset 0
+       starts a new patch, a block at another offset is ignored. The blocks are received in
+       the Zigbee stack task and written to flash by updateDeltaOta(), from the application task.
+       @param patcher The patcher rebuilding the new firmware, usually from a
+       PilotWirePartitionSource to a PilotWireOtaTarget.
+       @note This method must be called before begin(), on a single endpoint of the device.
+    */
+    void enableDeltaOta (PilotWirePatcher *patcher) {
+      _delta_patcher = patcher;
+    }
 
-/**
-   @brief Maximum value for ZigbeePilotWireMode enum.
-   This constant can be used for validation or iteration over the enum values.
-*/
-const ZigbeePilotWireMode PILOTWIRE_MODE_MAX = PILOTWIRE_MODE_COMFORT_MINUS_2;
+    /**
+       @brief Feed the received delta block to the patcher.
+       Should be called from loop(), the server waits for the offset attribute before
+       sending the next block. Restart the device when deltaOtaStatus() is PILOT_WIRE_DELTA_DONE.
+       @return false if the patch failed or its attributes could not be updated, true otherwise.
+    */
+    bool updateDeltaOta();
 
-/**
-   @brief Total number of modes defined in ZigbeePilotWireMode enum.
-   This constant can be used for validation or iteration over the enum values.
-*/
-const uint8_t PILOTWIRE_MODE_COUNT = (PILOTWIRE_MODE_COMFORT_MINUS_2 - PILOTWIRE_MODE_OFF + 1);
+    /**
+       @brief Get the status of the delta OTA image, see PILOT_WIRE_DELTA_STATUS_ATTR_ID.
+    */
+    uint8_t deltaOtaStatus() const {
+      return _delta_status;
+    }
 
-/**
-   @brief Class representing a Zigbee Pilot Wire Control endpoint.
-   This class extends the ZigbeeEP class to implement a custom cluster
-   for controlling pilot-wire electric heaters via Zigbee.
-*/
-class ZigbeePilotWireControl : public ZigbeeEP {
-  public:
     /**
-       @brief Constructor for ZigbeePilotWireControl.
+       @brief Enable or disable the on-device weekly schedule.
+       When enabled, begin() adds the schedule attribute to the Pilot Wire cluster and
+       the Time cluster to the endpoint, and restores the schedule saved in NVS.
+       The schedule is evaluated every PILOT_WIRE_SCHEDULE_PERIOD_MS, the mode is only
+       changed when the scheduled slot changes, so a manual change is kept until the
+       next transition of the program. The mode is applied in the Zigbee stack task,
+       or by process() with the command queue. The schedule and its clock are allocated
+       when the schedule is first enabled.
+       @param enable true to enable the schedule, false to disable.
+       @note This method must be called before begin().
+    */
+    void enableSchedule (bool enable);
 
-       Temperature measurement and metering clusters are disabled.
-       You must call begin() after constructing the object to initialize the endpoint.
-       @param endpoint The Zigbee endpoint number to use for this device.
+    /**
+       @brief Check if the on-device weekly schedule is enabled.
     */
-    ZigbeePilotWireControl (uint8_t endpoint);
+    bool isScheduleEnabled() const {
+      return _schedule_enabled;
+    }
 
     /**
-       @brief Constructor for ZigbeePilotWireControl with temperature measurement.
-       This constructor enables the temperature measurement cluster.
-       The metering cluster is disabled.
-       You must call begin(float currentTemperature) after constructing the object to initialize the endpoint.
-       @param endpoint The Zigbee endpoint number to use for this device.
-       @param tempMin The minimum temperature value for the temperature measurement cluster in degrees Celsius.
-       @param tempMax The maximum temperature value for the temperature measurement cluster in degrees Celsius.
+       @brief Get the weekly schedule.
     */
-    ZigbeePilotWireControl (uint8_t endpoint, float tempMin, float tempMax);
+    const PilotWireSchedule &schedule() const {
+      static const PilotWireSchedule None;
+      return (_schedule != nullptr) ? _schedule->week : None;
+    }
 
     /**
-       @brief Constructor for ZigbeePilotWireControl with metering.
-       This constructor enables the metering cluster.
-       The temperature measurement cluster is disabled.
-       You must call begin() after constructing the object to initialize the endpoint.
-       @param endpoint The Zigbee endpoint number to use for this device.
-       @param meteringMultiplier The multiplier value for the metering cluster, must be non-zero to enable metering.
-        This value must be updated whis begin(uint32_t meteringMultiplier).
+       @brief Replace the weekly schedule.
+       The schedule is saved in NVS, published in the schedule attribute and evaluated immediately.
+       @param schedule The new schedule.
+       @return true if the schedule was saved, false otherwise or if the schedule is not enabled.
     */
-    ZigbeePilotWireControl (uint8_t endpoint, uint32_t meteringMultiplier);
+    bool setSchedule (const PilotWireSchedule &schedule);
 
     /**
-        @brief Constructor for ZigbeePilotWireControl with temperature measurement and metering.
-       This constructor enables both the temperature measurement and metering clusters.
-       You must call begin(float currentTemperature) after constructing the object to initialize the endpoint.
-       @param endpoint The Zigbee endpoint number to use for this device.
-       @param tempMin The minimum temperature value for the temperature measurement cluster in degrees Celsius.
-       @param tempMax The maximum temperature value for the temperature measurement cluster in degrees Celsius.
-       @param meteringMultiplier The multiplier value for the metering cluster, must be non-zero to enable metering.
-        This value must be updated whis begin(float currentTemperature, uint32_t meteringMultiplier).
+       @brief Synchronize the schedule clock with the Time cluster of the coordinator.
+       This method sends a read request and waits for the response, it must be called
+       from the application task after the device joined the network, and then from
+       time to time (e.g. once a day) to compensate the drift of the local clock.
+       @return true if the clock was synchronized, false otherwise.
     */
-    ZigbeePilotWireControl (uint8_t endpoint, float tempMin, float tempMax, uint32_t meteringMultiplier);
+    bool syncScheduleTime();
 
     /**
-       @brief Set a callback function to be called when the Pilot Wire mode changes.
-       This function must be called to register a callback that will be invoked before
-       to call begin().
-       @param callback A function pointer to the callback function.
-       The callback function should have the following signature:
-       void callback(ZigbeePilotWireMode mode);
-       The mode parameter will contain the new Pilot Wire mode.
-       This function is used to notify the application of mode changes.
-       @warning This is the only place where the mode change, after the zigbee network is
-       established, the user must use setPilotWireMode() to change mode.
+       @brief Set the schedule clock from another time source (e.g. SNTP).
+       @param utc The current UTC time.
+       @param tzOffset The offset of the local time from UTC in seconds.
+       @note The schedule must be enabled.
     */
-    void onPilotWireModeChange (void (*callback) (ZigbeePilotWireMode mode)) {
-      _on_mode_change = callback;
+    void setScheduleTime (time_t utc, int32_t tzOffset);
+
+    /**
+       @brief Check if the schedule clock was set.
+    */
+    bool isScheduleTimeValid() const {
+      return _schedule != nullptr && _schedule->timeBase != 0;
     }
 
     /**
@@ -165,6 +1017,16 @@ class ZigbeePilotWireControl : public ZigbeeEP {
     */
     bool begin ();
 
+    /**
+       @brief Restore the saved mode and drive the heater before the Zigbee network is up.
+       Reads the mode stored in NVS and calls the output driver and the mode change
+       callbacks right away, without waiting for the Zigbee stack to start and join
+       the network, which takes seconds. The attributes are updated later by begin().
+       @return true if a mode was restored, false if NVS is disabled or cannot be opened.
+       @note Call it in setup() after the callbacks are set and before begin().
+    */
+    bool restore();
+
     /**
        @brief Initialize the ZigbeePilotWireControl endpoint with temperature measurement.
        This method sets up the necessary clusters for Pilot Wire Control,
@@ -248,7 +1110,61 @@ class ZigbeePilotWireControl : public ZigbeeEP {
        @return The current temperature value in degrees Celsius.
     */
     float temperature() const {
-      return _temperature_value;
+      if constexpr (WithTemperature) {
+        return this->_temperature_value;
+      }
+      return NAN;
+    }
+
+    /**
+       @brief Set the temperature value without blocking the calling task.
+       If the Zigbee lock cannot be acquired before timeout, the value is parked in
+       a pending slot, a newer value replaces the parked one, and it is written later
+       from the Zigbee stack task (see flushPending()).
+       @param temperature The temperature value in degrees Celsius.
+       @param timeout The maximum time to wait for the Zigbee lock, in ticks.
+       @return true if the value was written or parked, false otherwise.
+    */
+    bool trySetTemperature (float temperature, TickType_t timeout = 0);
+
+    /**
+       @brief Configure the temperature acquisition pipeline fed by pushTemperature().
+       @param type The filter type, see PilotWireFilter.
+       @param param The window of the median filter or the shift of the EMA (factor 1/2^shift).
+       @param thresholdPercent The filtered value is written to the Zigbee stack only when it
+       moves by more than this percentage of the delta set by setTemperatureReporting(),
+       or by 0.01 degree if no delta was set.
+    */
+    void setTemperatureFilter (PilotWireFilter::Type type, uint8_t param, uint8_t thresholdPercent = 50);
+
+    /**
+       @brief Push a raw temperature sample in the acquisition pipeline.
+       Samples can be pushed at a high rate: they are filtered in fixed-point and the
+       Zigbee lock is only taken when the filtered value moves by the threshold
+       set with setTemperatureFilter().
+       @param sample The raw temperature in degrees Celsius, NAN samples are ignored.
+       @return true if the sample was accepted, false otherwise.
+    */
+    bool pushTemperature (float sample);
+
+    /**
+       @brief Get the number of samples pushed in the temperature pipeline.
+    */
+    uint32_t temperatureSampleCount() const {
+      if constexpr (WithTemperature) {
+        return this->_temperature_samples;
+      }
+      return 0;
+    }
+
+    /**
+       @brief Get the number of temperature attribute writes to the Zigbee stack.
+    */
+    uint32_t temperatureWriteCount() const {
+      if constexpr (WithTemperature) {
+        return this->_temperature_writes;
+      }
+      return 0;
     }
 
     /**
@@ -288,6 +1204,15 @@ class ZigbeePilotWireControl : public ZigbeeEP {
     */
     bool setEnergyWh (uint64_t summation_wh);
 
+    /**
+       @brief Set the summation delivered attribute without blocking the calling task.
+       See trySetTemperature() for the behavior when the Zigbee lock is busy.
+       @param summation_wh The total energy delivered in watt-hours (Wh).
+       @param timeout The maximum time to wait for the Zigbee lock, in ticks.
+       @return true if the value was written or parked, false otherwise.
+    */
+    bool trySetEnergyWh (uint64_t summation_wh, TickType_t timeout = 0);
+
     /**
        @brief Get the current summation delivered value.
        @return The current summation delivered value in watt-hours (Wh).
@@ -318,6 +1243,15 @@ class ZigbeePilotWireControl : public ZigbeeEP {
     */
     bool setPowerW (int32_t demand_w);
 
+    /**
+       @brief Set the electric power attribute without blocking the calling task.
+       See trySetTemperature() for the behavior when the Zigbee lock is busy.
+       @param demand_w The instantaneous power demand in watts (W).
+       @param timeout The maximum time to wait for the Zigbee lock, in ticks.
+       @return true if the value was written or parked, false otherwise.
+    */
+    bool trySetPowerW (int32_t demand_w, TickType_t timeout = 0);
+
     /**
        @brief Get the current electric power value.
        @return The current electric power value in watts (W).
@@ -341,6 +1275,169 @@ class ZigbeePilotWireControl : public ZigbeeEP {
     */
     bool setPowerWReporting (uint16_t min_interval, uint16_t max_interval, float delta);
 
+    /**
+       @brief Set the reporting configuration of an attribute.
+       The reporting table covers all the reportable attributes, it is saved in NVS
+       as a single record when it changes and restored by begin(). The configuration
+       is applied to the Zigbee stack immediately once the stack is started. Before,
+       and for the table restored by begin(), it is applied in one batch by the first
+       reportAttributes().
+       The setTemperatureReporting(), setEnergyWhReporting() and setPowerWReporting()
+       methods are shortcuts to this method.
+       @param attr The attribute.
+       @param min_interval The minimum reporting interval in seconds.
+       @param max_interval The maximum reporting interval in seconds.
+       @param delta The change triggering a report, in the unit of the attribute (0.01 °C, Wh, W).
+       @return true if the configuration was set successfully, false otherwise.
+    */
+    bool setReportingProfile (ZigbeePilotWireAttribute attr, uint16_t min_interval, uint16_t max_interval, uint16_t delta);
+
+    /**
+       @brief Get the reporting configuration of an attribute.
+       @param attr The attribute.
+       @param profile The configuration, unchanged if the attribute is not configured.
+       @return true if the attribute is configured, false if the stack defaults are used.
+    */
+    bool reportingProfile (ZigbeePilotWireAttribute attr, ZigbeePilotWireReportingProfile &profile) const;
+
+    /**
+       @brief Export the reporting table, e.g. to copy it to other devices.
+       @param buffer Destination of PILOT_WIRE_REPORTING_SIZE bytes.
+       @param size The size of the buffer.
+       @return the number of bytes written, 0 if the buffer is too small.
+    */
+    size_t exportReporting (uint8_t *buffer, size_t size) const;
+
+    /**
+       @brief Import a reporting table exported by exportReporting().
+       The table replaces the current one, it is saved and applied as by setReportingProfile().
+       @param buffer The exported table.
+       @param size The size of the table.
+       @return true if the table was imported, false if it is invalid.
+    */
+    bool importReporting (const uint8_t *buffer, size_t size);
+
+    /**
+       @brief Enable or disable the reporting governor.
+       The governor counts the reports of the endpoint over windows of PILOT_WIRE_GOVERNOR_WINDOW_MS:
+       the reports sent by the library and the ones the stack refused (queue full, timeout).
+       When more than PILOT_WIRE_GOVERNOR_FAILURE_PCT % of the reports
+       fail or the airtime budget is exceeded, the minimum interval and the delta of the
+       temperature, energy and power attributes are doubled, up to PILOT_WIRE_GOVERNOR_MAX_LEVEL
+       times, and reportAttributes() skips their reports sent sooner than the widened interval.
+       A window within the budget and without failure steps back one level. The pilot wire mode and On/Off reports are never delayed.
+       The window and the statistics are allocated when the governor is first enabled.
+       @param enable true to enable the governor, false to disable and restore the reporting table.
+    */
+    void enableReportingGovernor (bool enable);
+
+    /**
+       @brief Check if the reporting governor is enabled.
+    */
+    bool isReportingGovernorEnabled() const {
+      return _governor_enabled;
+    }
+
+    /**
+       @brief Set the airtime budget of the reporting governor.
+       @param reports The number of reports allowed per window.
+    */
+    void setReportingBudget (uint16_t reports) {
+      _governor_budget = reports;
+    }
+
+    /**
+       @brief Get the statistics of the reporting governor.
+    */
+    const ZigbeePilotWireGovernorStats &governorStats() const {
+      static const ZigbeePilotWireGovernorStats None = {};
+      return (_governor != nullptr) ? _governor->stats : None;
+    }
+
+    /**
+       @brief Enable or disable the on-device energy integrator.
+       When enabled, the instantaneous demand is integrated over time in a fixed-point
+       accumulator with a resolution of 1 W.ms, and the summation delivered attribute
+       is only updated when a whole Wh is crossed. setPowerW() integrates the previous
+       power before changing it, so the application only has to call integrateEnergy()
+       periodically and does not need to compute the energy itself.
+       @param enable true to enable the integrator, false to disable.
+    */
+    void enableEnergyIntegration (bool enable);
+
+    /**
+       @brief Check if the on-device energy integrator is enabled.
+    */
+    bool isEnergyIntegrationEnabled() const {
+      if constexpr (WithMetering) {
+        return this->_energy_integration;
+      }
+      return false;
+    }
+
+    /**
+       @brief Integrate the instantaneous demand since the last call.
+       The elapsed time is computed from millis() and handles its wrap-around,
+       this method must be called at least once every 49 days.
+       @return true if the summation delivered is up to date, false if the attribute update failed.
+    */
+    bool integrateEnergy();
+
+    /**
+       @brief Set the nominal power of the heater in a mode.
+       Used to estimate the instantaneous demand when no meter is fitted.
+       @param mode The Pilot Wire mode.
+       @param watts The average power drawn by the heater in this mode, in watts (W).
+    */
+    void setNominalPower (ZigbeePilotWireMode mode, uint16_t watts);
+
+    /**
+       @brief Get the nominal power of the heater in a mode.
+       @return the nominal power in watts (W).
+    */
+    uint16_t nominalPower (ZigbeePilotWireMode mode) const {
+      if constexpr (WithMetering) {
+        return (mode < PILOTWIRE_MODE_COUNT) ? this->_nominal_power[mode] : 0;
+      }
+      return 0;
+    }
+
+    /**
+       @brief Enable or disable the estimation of the power from the nominal power table.
+       When enabled, the instantaneous demand follows the nominal power of the current mode.
+       Combined with enableEnergyIntegration(), the endpoint provides power and energy
+       without any meter.
+       @param enable true to enable the estimation, false to disable.
+    */
+    void enablePowerEstimation (bool enable);
+
+    /**
+       @brief Check if the estimation of the power from the nominal power table is enabled.
+    */
+    bool isPowerEstimationEnabled() const {
+      if constexpr (WithMetering) {
+        return this->_power_estimation;
+      }
+      return false;
+    }
+
+    /**
+       @brief Attach a pulse meter measuring the power and the energy.
+       The meter is started, the power estimation and the energy integrator are disabled.
+       The summation delivered continues from its current value (e.g. restored from NVS).
+       @param meter The pulse meter, nullptr to detach it.
+       @return true if the meter was started successfully, false otherwise.
+    */
+    bool attachPulseMeter (PilotWirePulseMeter *meter);
+
+    /**
+       @brief Update the power and energy attributes from the pulse meter.
+       Should be called from loop(), the attributes are only written when the
+       measurement window of the meter is elapsed and their value changed.
+       @return true if the attributes are up to date, false if an attribute update failed.
+    */
+    bool updatePulseMeter();
+
     /**
        @brief Set the metering status attribute in the metering cluster.
        @param status The metering status (bitmap U8 in ZCL).
@@ -356,12 +1453,24 @@ class ZigbeePilotWireControl : public ZigbeeEP {
     */
     bool setMeteringStatus (uint8_t status);
 
+    /**
+       @brief Set the metering status attribute without blocking the calling task.
+       See trySetTemperature() for the behavior when the Zigbee lock is busy.
+       @param status The metering status (bitmap U8 in ZCL).
+       @param timeout The maximum time to wait for the Zigbee lock, in ticks.
+       @return true if the value was written or parked, false otherwise.
+    */
+    bool trySetMeteringStatus (uint8_t status, TickType_t timeout = 0);
+
     /**
        @brief Get the current metering status value.
        @return The current metering status (bitmap U8 in ZCL).
     */
     uint8_t meteringStatus() const {
-      return _metering_cfg.status;
+      if constexpr (WithMetering) {
+        return this->_metering_cfg.status;
+      }
+      return 0;
     }
 
     /**
@@ -372,16 +1481,67 @@ class ZigbeePilotWireControl : public ZigbeeEP {
     */
     bool reportAttributes();
 
+    /**
+       @brief Report several attributes to the Zigbee network in a single pass.
+       The Zigbee lock is acquired once for the whole batch. The Zigbee stack
+       sends one report frame per attribute, so the attributes whose value did
+       not change since their last report can be skipped to save airtime.
+       Unlike reportAttributes(), this method does not invoke the mode change callback.
+       @param mask The attributes to report, a combination of PILOTWIRE_ATTR_BIT() values.
+       @param status If not nullptr, receives the status of each attribute.
+       @param changedOnly If true, skip the attributes whose value did not change since their last report.
+       @return true if all the requested attributes were reported or skipped, false otherwise.
+    */
+    bool reportAttributes (uint32_t mask, ZigbeePilotWireReportStatus *status = nullptr, bool changedOnly = false);
+
+    /**
+       @brief Report several attributes without blocking the calling task.
+       If the Zigbee lock cannot be acquired before timeout, the reports are parked
+       and sent later from the Zigbee stack task (see flushPending()).
+       @param mask The attributes to report, a combination of PILOTWIRE_ATTR_BIT() values.
+       @param timeout The maximum time to wait for the Zigbee lock, in ticks.
+       @return true if the attributes were reported or parked, false otherwise.
+    */
+    bool tryReportAttributes (uint32_t mask, TickType_t timeout = 0);
+
+    /**
+       @brief Write the updates parked by the try methods.
+       Parked updates are written by an alarm of the Zigbee stack task scheduled when
+       they are parked, so they converge even if the application loop stalls. They are
+       also written when the Zigbee network writes an attribute of the endpoint, by the
+       next successful try method, by reportAttributes() or by this method.
+       @param timeout The maximum time to wait for the Zigbee lock, in ticks.
+       @return true if no update is pending after the call, false otherwise.
+    */
+    bool flushPending (TickType_t timeout = portMAX_DELAY);
+
+    /**
+       @brief Get the attributes with a parked update.
+       @return a combination of PILOTWIRE_ATTR_BIT() values, the metering status uses the bit PILOTWIRE_ATTR_COUNT.
+    */
+    uint32_t pendingUpdates() const {
+      return _pending.load();
+    }
+
+    /**
+       @brief Get the statistics of the updates deferred by the try methods.
+    */
+    const ZigbeePilotWireDeferredStats &deferredStats() const {
+      return _deferred_stats;
+    }
+
+    /**
+       @brief Reset the statistics of the updates deferred by the try methods.
+    */
+    void resetDeferredStats();
+
     /**
        @brief Enable or disable restore mode.
        When restore mode is enabled, the Pilot Wire mode is restored from NVS on startup.
        @param enable true to enable restore mode, false to disable.
        @note This setting is persisted in NVS.
     */
-    void enableNvs (bool enable) {
-      _nvs_enabled = enable;
-      _prefs.putBool ("restore", enable);
-    }
+    void enableNvs (bool enable);
 
     /**
        @brief Check if restore mode is enabled.
@@ -391,21 +1551,54 @@ class ZigbeePilotWireControl : public ZigbeeEP {
       return _nvs_enabled;
     }
 
+    /**
+       @brief Set the delays before pending changes are committed to NVS.
+       The mode, restore flag and energy summation are packed in a single NVS record.
+       Changes are written by a deferred timer, so that several changes during
+       the delay cost a single flash write.
+       @param modeDelayMs Delay in milliseconds before a mode or restore flag change is written,
+        0 to write immediately. Defaults to PILOT_WIRE_NVS_MODE_DELAY_MS.
+       @param summationDelayMs Delay in milliseconds before an energy summation change is written,
+        0 to write immediately. Defaults to PILOT_WIRE_NVS_SUMMATION_DELAY_MS.
+    */
+    void setNvsCommitDelay (uint32_t modeDelayMs, uint32_t summationDelayMs);
+
+    /**
+       @brief Write pending changes to NVS immediately.
+       This method should be called from a power-fail hook (e.g. a supply voltage
+       monitoring interrupt deferred to a task). Pending changes are also written
+       when the system restarts with ESP.restart().
+       @return true if NVS is up to date, false if the write failed.
+    */
+    bool commitNvs() {
+      return (_store != nullptr) ? _store->commit() : false;
+    }
+
+    /**
+       @brief Get the number of NVS commits done since begin().
+    */
+    uint32_t nvsCommitCount() const {
+      return (_store != nullptr) ? _store->commitCount() : 0;
+    }
+
+    /**
+       @brief Get the number of bytes written in NVS since begin().
+    */
+    uint32_t nvsBytesWritten() const {
+      return (_store != nullptr) ? _store->bytesWritten() : 0;
+    }
+
     /**
        @brief Destructor for ZigbeePilotWireControl.
        Cleans up resources and ends NVS preferences.
     */
-    ~ZigbeePilotWireControl() {
-      end();
-    }
+    ~ZigbeePilotWireControlT();
 
     /**
        @brief End the ZigbeePilotWireControl and clean up resources.
        This method should be called to properly release resources used by the ZigbeePilotWireControl instance.
     */
-    void end() {
-      _prefs.end();
-    }
+    void end();
 
     /**
        @brief Print the cluster information of the ZigbeePilotWireControl endpoint.
@@ -414,38 +1607,296 @@ class ZigbeePilotWireControl : public ZigbeeEP {
     */
     void printClusterInfo (Print &out = Serial);
 
+    /**
+       @brief Print the hot-path trace recorded when the library is built with PILOT_WIRE_TRACE=1.
+       The trace is shared by all the endpoints, see PilotWireTrace.
+       @param out The Print object to output the trace to. Defaults to Serial.
+       @param events The maximum number of events to print, 0 for the statistics only.
+    */
+    static void printTrace (Print &out = Serial, uint16_t events = 32) {
+      PilotWireTrace::print (out, events);
+    }
+
+    /**
+       @brief Get the cost of the last call to begin().
+       The attributes of the clusters are described by constant tables consumed by
+       a single builder, these figures show the time and the heap it took.
+    */
+    ZigbeePilotWireBeginStats beginStats() const {
+      return _begin_stats;
+    }
+
+    /**
+       @brief Get the time since reset at the end of each startup phase.
+    */
+    ZigbeePilotWireBootStats bootStats() const {
+      return _boot_stats;
+    }
+
   protected:
+    template <bool, bool> friend class ZigbeePilotWireBankT;
+
+    /**
+       @brief Descriptor of the attributes added to a cluster by buildAttributes().
+       A null storage only completes the access of an attribute created with the cluster.
+    */
+    struct AttributeDesc {
+      uint16_t id;      ///< First attribute ID
+      uint8_t type;     ///< ZCL type, ESP_ZB_ZCL_ATTR_TYPE_xxx
+      uint8_t access;   ///< ESP_ZB_ZCL_ATTR_ACCESS_xxx
+      uint8_t count;    ///< Number of consecutive attributes
+      void * (*storage) (ZigbeePilotWireControlT *ep, uint8_t index); ///< Value of the attribute id + index
+    };
+
+    bool buildAttributes (esp_zb_attribute_list_t *list, uint16_t cluster_id, uint16_t manuf_code,
+                          const AttributeDesc *table, size_t count);
+    template <size_t N> bool buildAttributes (esp_zb_attribute_list_t *list, uint16_t cluster_id, uint16_t manuf_code,
+                                              const AttributeDesc (&table) [N]) {
+      return buildAttributes (list, cluster_id, manuf_code, table, N);
+    }
+    bool reportAttributesLocked();
+    bool flushPendingLocked();
+    bool reportBatchLocked (uint32_t mask, bool changedOnly, ZigbeePilotWireReportStatus &st);
+    esp_err_t sendReport (uint16_t cluster_id, uint16_t attr_id, uint16_t manuf_code);
+    uint64_t attributeSnapshot (uint8_t attr) const;
     void zbAttributeSet (const esp_zb_zcl_set_attr_value_message_t *message) override;
     bool setReporting (uint16_t cluster_id, uint16_t attr_id,
                        uint16_t min_interval, uint16_t max_interval, float delta,
                        uint16_t manuf_code = ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC);
     bool reportAttribute (uint16_t cluster_id, uint16_t attr_id, uint16_t manuf_code = ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC);
+    bool loadReporting();
+    bool saveReporting();
+    bool applyReporting (uint8_t attr);
+    bool applyReportingLocked();
+    void governReports (int64_t now);
     bool createPilotWireCluster();
+    bool createScheduleSupport();
+    bool createHistorySupport();
+    bool createDiagnosticsCluster();
+    bool createThermostatCluster();
     bool createTemperatureMeasurementCluster (float currentTemperature);
     bool createMeteringCluster (int32_t currentPower, uint32_t meteringMultiplier);
 
   private:
+    // Runtime state of the optional clusters, always false when they are not built
+    bool temperatureEnabled() const {
+      if constexpr (WithTemperature) {
+        return this->_temperature_enabled;
+      }
+      return false;
+    }
+
+    bool meteringEnabled() const {
+      if constexpr (WithMetering) {
+        return this->_metering_enabled;
+      }
+      return false;
+    }
+
     void pilotWireModeChanged();
+    void invokeModeCallbacks();
+    bool openStore();
+    void updateBeginStats();
+    bool updatePilotModeAndOnOff();
+    void applyModeCommand (uint8_t mode);
+    void applyOnOffCommand (bool state);
+    void enqueueCommand (uint8_t type, uint8_t value, uint8_t arg = 0);
+    void settleCommand (uint8_t type, uint8_t value);
+    void closeSettleWindow();
+    void applySettledCommand (uint8_t mode, uint8_t onMode);
+    static void settleTimerCallback (void *arg);
+    bool writeAttributes (uint32_t mask);
+    bool tryWriteAttributes (uint32_t mask, TickType_t timeout);
+    bool writeAttributesLocked (uint32_t mask);
+    void storeEnergy (uint64_t summation_wh);
+    void addEnergy (uint64_t wh);
+    bool accumulateEnergy();
+    bool loadScheduleAttribute (const uint8_t *value);
+    bool publishScheduleAttribute();
+    bool saveSchedule();
+    void applySchedule (bool force);
+    void applyLocalMode (uint8_t mode);
+    void postStackWork();
+    void runStackWork();
+    static void stackAlarmCallback (uint8_t endpoint);
+    static void stackRetryTimerCallback (void *arg);
+    void applySystemMode (uint8_t mode);
+    int8_t thermostatLevel (int32_t excess) const;
+    void runThermostat();
+    static void scheduleTimerCallback (void *arg);
+    static void historyTimerCallback (void *arg);
+    void sampleHistory();
+    bool publishHistory (uint16_t offset);
+    void receiveDeltaBlock (const uint8_t *value);
+    bool publishDeltaOta();
+    bool updateStatus();
+
+    // Pending bit of the metering status, after the ZigbeePilotWireAttribute bits
+    static constexpr uint32_t PILOTWIRE_PENDING_METERING_STATUS = PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_COUNT);
+
+    enum : uint8_t {
+      PILOTWIRE_CMD_MODE = 0,
+      PILOTWIRE_CMD_ON_OFF,
+      PILOTWIRE_CMD_SETTLED  // final mode of a settle window
+    };
+
+    struct PilotWireCommand {
+      int64_t timestamp_us;
+      uint8_t type;
+      uint8_t value;
+      uint8_t arg; // SETTLED: mode restored by the next On write
+    };
 
     uint8_t _current_mode;
     uint8_t _state_on_mode;
     void (*_on_mode_change) (ZigbeePilotWireMode mode);
+    void (*_on_endpoint_mode_change) (uint8_t endpoint, ZigbeePilotWireMode mode);
+    PilotWireOutput *_output;
 
     bool _current_state;
     bool _current_state_changed;
     bool _nvs_enabled;
-    Preferences _prefs;
+    PilotWireStore *_store;
+    int _store_slot;
 
-    bool _temperature_enabled;
-    esp_zb_temperature_meas_cluster_cfg_t _temperature_cfg;
-    float _temperature_value;
+    uint64_t _last_reported[PILOTWIRE_ATTR_COUNT];
+    uint8_t _reported_mask;
+
+    // Inbound command queue, filled by the Zigbee stack task, drained by process()
+    struct QueueState {
+      PilotWireRing<PilotWireCommand, PILOT_WIRE_QUEUE_SIZE> ring;
+      ZigbeePilotWireQueueStats stats;
+      uint64_t latencySumUs;
+      volatile bool resync;
+    };
+    volatile bool _queue_enabled;
+    QueueState *_queue; // allocated by enableCommandQueue(), kept until the destructor
+
+    // Settle window of the inbound writes, filled by the Zigbee stack task, closed by the esp_timer task
+    uint32_t _settle_window_ms;
+    esp_timer_handle_t _settle_timer;
+    bool _settle_open;
+    uint8_t _settle_mode;  // mode resulting from the writes of the window
+    uint8_t _settle_on_mode; // mode restored by an On write of the window
+    uint8_t _settle_count; // writes received in the window
+    ZigbeePilotWireSettleStats _settle_stats;
+    bool _settled_pending;    // final state of a closed window, applied by the Zigbee stack task
+    uint8_t _settled_mode;
+    uint8_t _settled_on_mode;
+    portMUX_TYPE _settle_mux;
+
+    // On-device weekly schedule
+    struct ScheduleState {
+      PilotWireSchedule week;
+      uint8_t attr[1 + PilotWireSchedule::Size]; // ZCL octet string, length first
+      volatile bool attrDirty;
+      uint8_t last;
+      time_t timeBase;   // UTC time at timeBaseUs
+      int64_t timeBaseUs;
+      int32_t tzOffset;
+    };
+    bool _schedule_enabled;
+    ScheduleState *_schedule; // allocated by enableSchedule(), kept until the destructor
+    esp_timer_handle_t _schedule_timer;
+    portMUX_TYPE _schedule_mux;
+
+    // Reporting table, indexed by ZigbeePilotWireAttribute
+    ZigbeePilotWireReportingProfile _reporting[PILOTWIRE_ATTR_COUNT];
+    uint8_t _reporting_mask;    // configured attributes
+    uint8_t _reporting_pending; // configured attributes not applied to the stack yet
+
+    // Reporting governor, the window counts the reports sent and failed
+    struct GovernorState {
+      int64_t windowUs;
+      uint16_t sent;
+      uint16_t failed;
+      int64_t lastUs[PILOTWIRE_ATTR_COUNT]; // time of the last report of each attribute
+      ZigbeePilotWireGovernorStats stats;
+    };
+    bool _governor_enabled;
+    uint16_t _governor_budget;
+    GovernorState *_governor; // allocated by enableReportingGovernor(), kept until the destructor
+
+    // On-device telemetry history, allocated by begin() when enabled
+    bool _history_enabled;
+    PilotWireHistory *_history;
+    uint16_t _history_offset;
+    esp_timer_handle_t _history_timer;
+    portMUX_TYPE _history_mux;
+
+    // Packed status, ZCL octet string, length first
+    bool _status_enabled;
+    uint8_t _status_attr[1 + PILOT_WIRE_STATUS_SIZE];
+
+    bool _groups_enabled;
+
+    // OTA Upgrade client
+    bool _ota_enabled;
+    uint32_t _ota_file_version;
+    uint16_t _ota_hw_version;
+
+    // Delta OTA, a block written by the server waits in _delta_block for updateDeltaOta()
+    struct DeltaBlock {
+      uint32_t offset;
+      uint8_t len;
+      uint8_t data[PILOT_WIRE_DELTA_BLOCK];
+    };
+    PilotWirePatcher *_delta_patcher;
+    DeltaBlock *_delta_block;       // allocated by begin()
+    std::atomic<bool> _delta_ready; // _delta_block holds a block to write
+    uint32_t _delta_offset;         // bytes of the patch accepted
+    uint8_t _delta_status;
+
+    // Whole-house power budget
+    bool _budget_enabled;
+    int32_t _power_budget;
+    int32_t _house_power;
+    int64_t _house_power_us; // time of the last update of _house_power
+
+    // Performance counters
+    bool _diag_enabled;
+    ZigbeePilotWireDiagnostics _diag;
+    uint32_t *_diag_attr; // values of the stack attributes, allocated by enableDiagnostics()
+    uint32_t _callback_count;
+    uint64_t _callback_total_us;
+
+    // Updates deferred by the try methods, the values are in the members
+    std::atomic<uint32_t> _pending;
+    std::atomic<uint32_t> _pending_reports;
+    ZigbeePilotWireDeferredStats _deferred_stats;
+
+    std::atomic<uint8_t> _local_pending; // mode decided on the device, PilotWireSchedule::Hold if none
+
+    // Work handed to the Zigbee stack task with esp_zb_scheduler_alarm() by the other tasks
+    std::atomic<bool> _stack_work_posted;
+    esp_timer_handle_t _stack_retry_timer;
+    ZigbeePilotWireControlT *_next_endpoint; // endpoints of the instantiation, searched by the alarm
+    static ZigbeePilotWireControlT *_first_endpoint;
+    static portMUX_TYPE _endpoints_mux;
+
+    // On-device thermostat, temperatures in 0.01 °C
+    bool _thermostat_enabled;
+    int16_t _occupied_setpoint;
+    int16_t _unoccupied_setpoint;
+    uint8_t _system_mode;
+    uint8_t _occupancy;
+    uint8_t _heating_demand;
+    int16_t _thermostat_step;
+    int16_t _thermostat_hysteresis;
+    int8_t _thermostat_level; // index in the thermostat steps, -1 if not evaluated
+
+    ZigbeePilotWireBeginStats _begin_stats;
+    int64_t _begin_start_us;
+    size_t _begin_free_heap;
+    size_t _begin_largest_block;
+    ZigbeePilotWireBootStats _boot_stats;
 
-    // Member variables for Simple Metering cluster (0x0702)
-    bool _metering_enabled;
-    esp_zb_metering_cluster_cfg_t _metering_cfg;
-    esp_zb_uint48_t _summationDelivered;
-    esp_zb_uint24_t _multiplier;
-    esp_zb_uint24_t _divisor;
-    esp_zb_int24_t _instantaneousDemand;
 };
 
+/**
+   @brief Endpoint with the temperature measurement and metering clusters, the
+   clusters actually used are still selected by the constructor.
+   This is the class of the previous versions of the library.
+*/
+using ZigbeePilotWireControl = ZigbeePilotWireControlT<true, true>;
+
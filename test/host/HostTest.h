@@ -0,0 +1,57 @@
+/// @file HostTest.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Minimal checks of the host tests, a test program returns testResult()
+/// from main() so that ctest sees the failures.
+#pragma once
+
+#include <stdio.h>
+
+static int testFailures = 0;
+static int testChecks = 0;
+
+/**
+   @brief Check a condition, the test goes on if it is false.
+*/
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    testChecks++;                                                     \
+    if (!(cond)) {                                                    \
+      printf ("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      testFailures++;                                                 \
+    }                                                                 \
+  } while (0)
+
+/**
+   @brief Check that two integer values are equal, both are printed if not.
+*/
+#define CHECK_EQ(a, b)                                                           \
+  do {                                                                           \
+    long long va_ = static_cast<long long> (a), vb_ = static_cast<long long> (b); \
+    testChecks++;                                                                \
+    if (va_ != vb_) {                                                            \
+      printf ("%s:%d: check failed: %s == %s (%lld != %lld)\n",                  \
+              __FILE__, __LINE__, #a, #b, va_, vb_);                             \
+      testFailures++;                                                            \
+    }                                                                            \
+  } while (0)
+
+/**
+   @brief Run a test function and print its name.
+*/
+#define RUN_TEST(test)           \
+  do {                           \
+    printf ("%s\n", #test);      \
+    test();                      \
+  } while (0)
+
+/**
+   @brief Print the summary of the checks, the exit status of the test program.
+*/
+static inline int
+testResult() {
+
+  printf ("%d checks, %d failures\n", testChecks, testFailures);
+  return testFailures == 0 ? 0 : 1;
+}
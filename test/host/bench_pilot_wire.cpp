@@ -0,0 +1,198 @@
+/// @file bench_pilot_wire.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host version of extras/tests/PilotWireBenchmark: the hot paths of the
+/// ZigbeePilotWireControl class are run against the stand-ins of the Zigbee
+/// stack, the times are those of the host and only give trends, the numbers of
+/// Zigbee locks and NVS writes per operation are those of the target and are
+/// checked against budgets, so that a regression fails the test.
+#include <Zigbee.h>
+#include <ZigbeePilotWireControl.h>
+#include <PilotWireHost.h>
+#include <chrono>
+
+const uint16_t ZbeeEndPoint = 1;
+const uint16_t Iterations = 100;
+
+// Gives access to the dispatch method called by the Zigbee stack
+class BenchPilotWireControl : public ZigbeePilotWireControl {
+  public:
+    BenchPilotWireControl (uint8_t endpoint, float tempMin, float tempMax, uint32_t meteringMultiplier) :
+      ZigbeePilotWireControl (endpoint, tempMin, tempMax, meteringMultiplier) {}
+
+    void writeMode (uint8_t mode) {
+      esp_zb_zcl_set_attr_value_message_t message = {};
+
+      message.info.status = ESP_ZB_ZCL_STATUS_SUCCESS;
+      message.info.dst_endpoint = _endpoint;
+      message.info.cluster = PILOT_WIRE_CLUSTER_ID;
+      message.attribute.id = PILOT_WIRE_MODE_ATTR_ID;
+      message.attribute.data.type = ESP_ZB_ZCL_ATTR_TYPE_U8;
+      message.attribute.data.size = sizeof (mode);
+      message.attribute.data.value = &mode;
+      zbAttributeSet (&message);
+    }
+};
+
+BenchPilotWireControl zbPilot (ZbeeEndPoint, -10.0f, 80.0f, 1);
+
+struct BenchResult {
+  uint32_t count;
+  int64_t sumNs;
+  int64_t maxNs;
+  uint32_t locks;
+  uint32_t nvsWrites;
+  uint32_t reports;
+};
+
+// Upper bounds of the costs per operation, in the unit of the counters
+struct BenchBudget {
+  float locks;
+  float nvsWrites;
+  float reports;
+};
+
+static int failures = 0;
+
+// Runs an operation Iterations times and records its cost
+template<typename F> BenchResult
+bench (F operation) {
+  BenchResult r = {};
+  uint32_t locks = ZigbeePilotWireControl::zbLockCount();
+  uint32_t nvs = hostNvsWrites();
+
+  hostClearReports();
+  for (uint16_t i = 0; i < Iterations; i++) {
+    auto t0 = std::chrono::steady_clock::now();
+
+    operation (i);
+    int64_t t = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now() - t0).count();
+    r.sumNs += t;
+    if (t > r.maxNs) {
+      r.maxNs = t;
+    }
+    r.count++;
+  }
+  r.locks = ZigbeePilotWireControl::zbLockCount() - locks;
+  r.nvsWrites = hostNvsWrites() - nvs;
+  r.reports = hostReportCount();
+  return r;
+}
+
+void
+printResult (const char *name, const BenchResult &r, const BenchBudget &budget) {
+  float locks = (float) r.locks / r.count;
+  float nvs = (float) r.nvsWrites / r.count;
+  float reports = (float) r.reports / r.count;
+  bool ok = locks <= budget.locks && nvs <= budget.nvsWrites && reports <= budget.reports;
+
+  printf ("%-28s %6lu %9.2f %9.2f %9.2f %8.2f %10.2f  %s\n", name,
+          (unsigned long) r.count,
+          r.sumNs / 1000.0 / r.count,
+          r.maxNs / 1000.0,
+          locks, nvs, reports, ok ? "ok" : "OVER BUDGET");
+  if (!ok) {
+
+    printf ("  budget: %.2f locks/op, %.2f nvs/op, %.2f reports/op\n", budget.locks, budget.nvsWrites, budget.reports);
+    failures++;
+  }
+}
+
+uint8_t
+alternateMode (uint16_t i) {
+  return (i & 1) ? PILOTWIRE_MODE_ECO : PILOTWIRE_MODE_COMFORT;
+}
+
+void
+runBenchmarks() {
+  BenchResult r;
+  ZigbeePilotWireBeginStats b = zbPilot.beginStats();
+
+  printf ("begin(): %u attributes\n", b.attributes);
+  printf ("%-28s %6s %9s %9s %9s %8s %10s\n", "operation", "n", "avg us", "max us", "locks/op", "nvs/op", "reports/op");
+
+  zbPilot.setNvsCommitDelay (0, 0);
+  r = bench ([] (uint16_t i) {
+    zbPilot.writeMode (alternateMode (i));
+  });
+  printResult ("set mode (write-through)", r, { 0.05f, 1, 0 });
+
+  zbPilot.setNvsCommitDelay (PILOT_WIRE_NVS_MODE_DELAY_MS, PILOT_WIRE_NVS_SUMMATION_DELAY_MS);
+  r = bench ([] (uint16_t i) {
+    zbPilot.writeMode (alternateMode (i));
+  });
+  printResult ("set mode (deferred)", r, { 0, 0, 0 });
+
+  // the deferred modes are coalesced in one write when the delay expires
+  uint32_t nvs = hostNvsWrites();
+  hostAdvanceMs (PILOT_WIRE_NVS_MODE_DELAY_MS);
+  printf ("%-28s %6u writes\n", "deferred commit", (unsigned) (hostNvsWrites() - nvs));
+  if (hostNvsWrites() - nvs != 1) {
+    failures++;
+  }
+
+  zbPilot.enableCommandQueue (true);
+  r = bench ([] (uint16_t i) {
+    zbPilot.writeMode (alternateMode (i));
+    zbPilot.process();
+  });
+  printResult ("set mode (queued)", r, { 0, 0, 0 });
+  zbPilot.enableCommandQueue (false);
+
+  r = bench ([] (uint16_t i) {
+    zbPilot.setPilotWireMode (static_cast<ZigbeePilotWireMode> (alternateMode (i)));
+  });
+  printResult ("setPilotWireMode()", r, { 1, 0, 3 });
+
+  r = bench ([] (uint16_t) {
+    zbPilot.reportAttributes();
+  });
+  printResult ("reportAttributes()", r, { 1, 0, 3 });
+
+  r = bench ([] (uint16_t) {
+    zbPilot.reportAttributes (PILOTWIRE_ATTR_ALL);
+  });
+  printResult ("reportAttributes(all)", r, { 1, 0, 5 });
+
+  r = bench ([] (uint16_t) {
+    zbPilot.reportAttributes (PILOTWIRE_ATTR_ALL, nullptr, true);
+  });
+  printResult ("reportAttributes(changed)", r, { 1, 0, 0 });
+
+  r = bench ([] (uint16_t i) {
+    zbPilot.setPowerW (1000 + i);
+    zbPilot.integrateEnergy();
+  });
+  printResult ("setPowerW() + integrate", r, { 1, 0, 0 });
+
+  nvs = hostNvsWrites();
+  zbPilot.commitNvs();
+  printf ("NVS: %lu commits, %lu bytes written, %lu writes on the last commit\n",
+          (unsigned long) zbPilot.nvsCommitCount(), (unsigned long) zbPilot.nvsBytesWritten(),
+          (unsigned long) (hostNvsWrites() - nvs));
+}
+
+void
+setPilotWire (ZigbeePilotWireMode) {
+  // nothing to do, only the cost of the library is measured
+}
+
+int
+main() {
+
+  hostNvsErase();
+  zbPilot.onPilotWireModeChange (setPilotWire);
+  zbPilot.begin (20.0f, 0);
+  zbPilot.enableEnergyIntegration (true);
+  Zigbee.addEndpoint (&zbPilot);
+  Zigbee.begin (ZIGBEE_ROUTER);
+
+  runBenchmarks();
+  if (failures != 0) {
+
+    printf ("%d operations over budget\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,51 @@
+/// @file Arduino.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the Arduino core used by the library.
+/// millis() and micros() read the simulated clock of esp_timer_get_time(),
+/// delay() advances it, the GPIO levels are kept in memory.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <freertos/FreeRTOS.h>
+#include <esp32-hal-log.h>
+
+#define LOW     0x0
+#define HIGH    0x1
+#define INPUT   0x01
+#define OUTPUT  0x03
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write (uint8_t c) = 0;
+    size_t write (const char *str);
+    size_t print (const char *str);
+    size_t println (const char *str = "");
+    size_t printf (const char *format, ...);
+};
+
+/**
+   @brief Serial port written to stdout.
+*/
+class HostSerial : public Print {
+  public:
+    void begin (unsigned long) {}
+    size_t write (uint8_t c) override;
+    using Print::write;
+};
+
+extern HostSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay (uint32_t ms);
+void pinMode (uint8_t pin, uint8_t mode);
+void digitalWrite (uint8_t pin, uint8_t val);
+int digitalRead (uint8_t pin);
@@ -0,0 +1,450 @@
+/// @file Host.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-ins of the Arduino core, FreeRTOS, esp_timer and ESP-IDF system APIs.
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <esp_mac.h>
+#include <esp_cpu.h>
+#include <esp_heap_caps.h>
+#include <freertos/task.h>
+#include "PilotWireHost.h"
+#include <stdarg.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct esp_timer {
+  esp_timer_create_args_t args;
+  int64_t deadline_us;
+  uint64_t period_us;
+  bool active;
+};
+
+static int64_t s_now_us = 0;
+static uint32_t s_timer_callbacks = 0;
+static uint8_t s_mac[8] = { 0x40, 0x4C, 0xCA, 0xFF, 0xFE, 0x00, 0x00, 0x01 };
+static uint8_t s_pins[64];
+static int s_log_level = ARDUHAL_LOG_LEVEL_ERROR;
+
+// The objects are never destroyed, they outlive the static objects of the
+// programs, e.g. an endpoint declared as a global variable.
+
+// ----------------------------------------------------------------------------
+static std::recursive_mutex &
+critical() {
+  static std::recursive_mutex *object = new std::recursive_mutex();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+static std::recursive_mutex &
+timerMutex() {
+  static std::recursive_mutex *object = new std::recursive_mutex();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+static std::vector<esp_timer *> &
+timers() {
+  static std::vector<esp_timer *> *object = new std::vector<esp_timer *>();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+static std::vector<shutdown_handler_t> &
+shutdownHandlers() {
+  static std::vector<shutdown_handler_t> *object = new std::vector<shutdown_handler_t>();
+
+  return *object;
+}
+
+HostSerial Serial;
+
+// FreeRTOS ---------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+void
+vPortEnterCritical (portMUX_TYPE *mux) {
+
+  critical().lock();
+  mux->count++;
+}
+
+// ----------------------------------------------------------------------------
+void
+vPortExitCritical (portMUX_TYPE *mux) {
+
+  mux->count--;
+  critical().unlock();
+}
+
+// ----------------------------------------------------------------------------
+TaskHandle_t
+xTaskGetCurrentTaskHandle (void) {
+  static thread_local uint8_t task;
+
+  return &task;
+}
+
+// ----------------------------------------------------------------------------
+void
+vTaskDelay (TickType_t ticks) {
+
+  hostAdvance (static_cast<int64_t> (ticks) * portTICK_PERIOD_MS * 1000);
+}
+
+// esp_timer ----------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+int64_t
+esp_timer_get_time (void) {
+  std::lock_guard<std::recursive_mutex> lock (timerMutex());
+
+  return s_now_us;
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_timer_create (const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+
+  if (args == nullptr || args->callback == nullptr || handle == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::recursive_mutex> lock (timerMutex());
+  *handle = new esp_timer { *args, 0, 0, false };
+  timers().push_back (*handle);
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_timer_start_once (esp_timer_handle_t timer, uint64_t timeout_us) {
+  std::lock_guard<std::recursive_mutex> lock (timerMutex());
+
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->deadline_us = s_now_us + static_cast<int64_t> (timeout_us);
+  timer->period_us = 0;
+  timer->active = true;
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_timer_start_periodic (esp_timer_handle_t timer, uint64_t period_us) {
+  std::lock_guard<std::recursive_mutex> lock (timerMutex());
+
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->deadline_us = s_now_us + static_cast<int64_t> (period_us);
+  timer->period_us = period_us;
+  timer->active = true;
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_timer_stop (esp_timer_handle_t timer) {
+  std::lock_guard<std::recursive_mutex> lock (timerMutex());
+
+  if (timer->active == false) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->active = false;
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_timer_delete (esp_timer_handle_t timer) {
+  std::lock_guard<std::recursive_mutex> lock (timerMutex());
+
+  if (timer->active) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  for (auto it = timers().begin(); it != timers().end(); ++it) {
+
+    if (*it == timer) {
+
+      timers().erase (it);
+      break;
+    }
+  }
+  delete timer;
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+bool
+esp_timer_is_active (esp_timer_handle_t timer) {
+  std::lock_guard<std::recursive_mutex> lock (timerMutex());
+
+  return timer->active;
+}
+
+// ----------------------------------------------------------------------------
+void
+hostAdvance (int64_t us) {
+  int64_t end;
+
+  {
+    std::lock_guard<std::recursive_mutex> lock (timerMutex());
+    end = s_now_us + us;
+  }
+
+  for (;;) {
+    esp_timer_cb_t callback = nullptr;
+    void *arg = nullptr;
+
+    {
+      std::lock_guard<std::recursive_mutex> lock (timerMutex());
+      esp_timer *next = nullptr;
+
+      for (esp_timer *t : timers()) {
+
+        if (t->active && t->deadline_us <= end && (next == nullptr || t->deadline_us < next->deadline_us)) {
+          next = t;
+        }
+      }
+      if (next == nullptr) {
+
+        s_now_us = end;
+        return;
+      }
+
+      if (next->deadline_us > s_now_us) {
+        s_now_us = next->deadline_us;
+      }
+      if (next->period_us != 0) {
+
+        next->deadline_us += next->period_us;
+      }
+      else {
+
+        next->active = false;
+      }
+      callback = next->args.callback;
+      arg = next->args.arg;
+      s_timer_callbacks++;
+    }
+
+    // as the esp_timer task, without the lock so the callback can use the timers
+    callback (arg);
+  }
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+hostTimerCallbacks() {
+
+  return s_timer_callbacks;
+}
+
+// System -------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_register_shutdown_handler (shutdown_handler_t handler) {
+
+  shutdownHandlers().push_back (handler);
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+void
+esp_restart (void) {
+
+  hostShutdown();
+}
+
+// ----------------------------------------------------------------------------
+void
+hostShutdown() {
+
+  for (shutdown_handler_t handler : shutdownHandlers()) {
+
+    handler();
+  }
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_read_mac (uint8_t *mac, esp_mac_type_t type) {
+
+  memcpy (mac, s_mac, (type == ESP_MAC_IEEE802154) ? 8 : 6);
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+void
+hostSetMac (const uint8_t mac[8]) {
+
+  memcpy (s_mac, mac, sizeof (s_mac));
+}
+
+// ----------------------------------------------------------------------------
+const char *
+esp_err_to_name (esp_err_t code) {
+
+  switch (code) {
+    case ESP_OK:
+      return "ESP_OK";
+    case ESP_FAIL:
+      return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+      return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+      return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+      return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND:
+      return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+      return "ESP_ERR_NOT_SUPPORTED";
+    default:
+      return "UNKNOWN ERROR";
+  }
+}
+
+// ----------------------------------------------------------------------------
+esp_cpu_cycle_count_t
+esp_cpu_get_cycle_count (void) {
+
+  return static_cast<esp_cpu_cycle_count_t> (std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+// ----------------------------------------------------------------------------
+size_t
+heap_caps_get_free_size (uint32_t) {
+
+  return 256 * 1024;
+}
+
+// ----------------------------------------------------------------------------
+size_t
+heap_caps_get_largest_free_block (uint32_t) {
+
+  return 128 * 1024;
+}
+
+// Arduino ------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+unsigned long
+millis() {
+
+  return static_cast<unsigned long> (esp_timer_get_time() / 1000);
+}
+
+// ----------------------------------------------------------------------------
+unsigned long
+micros() {
+
+  return static_cast<unsigned long> (esp_timer_get_time());
+}
+
+// ----------------------------------------------------------------------------
+void
+delay (uint32_t ms) {
+
+  hostAdvance (static_cast<int64_t> (ms) * 1000);
+}
+
+// ----------------------------------------------------------------------------
+void
+pinMode (uint8_t, uint8_t) {
+}
+
+// ----------------------------------------------------------------------------
+void
+digitalWrite (uint8_t pin, uint8_t val) {
+
+  if (pin < sizeof (s_pins)) {
+
+    s_pins[pin] = val;
+  }
+}
+
+// ----------------------------------------------------------------------------
+int
+digitalRead (uint8_t pin) {
+
+  return (pin < sizeof (s_pins)) ? s_pins[pin] : LOW;
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Print::write (const char *str) {
+  size_t n = 0;
+
+  while (*str != '\0') {
+
+    n += write (static_cast<uint8_t> (*str++));
+  }
+  return n;
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Print::print (const char *str) {
+
+  return write (str);
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Print::println (const char *str) {
+
+  return write (str) + write ("\r\n");
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Print::printf (const char *format, ...) {
+  char buffer[256];
+  va_list args;
+
+  va_start (args, format);
+  vsnprintf (buffer, sizeof (buffer), format, args);
+  va_end (args);
+  return write (buffer);
+}
+
+// ----------------------------------------------------------------------------
+size_t
+HostSerial::write (uint8_t c) {
+
+  return (fputc (c, stdout) == EOF) ? 0 : 1;
+}
+
+// ----------------------------------------------------------------------------
+void
+hostLog (int level, const char *format, ...) {
+  static const char Letters[] = "NEWIDV";
+  va_list args;
+
+  if (level > s_log_level) {
+    return;
+  }
+  fprintf (stderr, "[%c] ", Letters[level]);
+  va_start (args, format);
+  vfprintf (stderr, format, args);
+  va_end (args);
+  fputc ('\n', stderr);
+}
+
+// ----------------------------------------------------------------------------
+void
+hostSetLogLevel (int level) {
+
+  s_log_level = level;
+}
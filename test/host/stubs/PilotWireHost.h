@@ -0,0 +1,142 @@
+/// @file PilotWireHost.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Control of the host stand-ins of the ESP32 and Arduino APIs, used by the
+/// host tests and benchmarks to drive the simulated clock, inspect what the
+/// library sent to the stack and wrote in NVS, and inject failures.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Simulated clock --------------------------------------------------------------
+
+/**
+   @brief Advance the simulated clock, the callbacks of the timers that expire
+   run in the calling thread, in the order of their deadlines.
+*/
+void hostAdvance (int64_t us);
+
+/**
+   @brief Advance the simulated clock in milliseconds.
+*/
+inline void hostAdvanceMs (uint32_t ms) {
+  hostAdvance (static_cast<int64_t> (ms) * 1000);
+}
+
+/**
+   @brief Number of esp_timer callbacks run since the start of the process.
+*/
+uint32_t hostTimerCallbacks();
+
+/**
+   @brief Set the UTC time returned by ZigbeeEP::getTime().
+*/
+void hostSetTime (time_t utc);
+
+// Logs -------------------------------------------------------------------------
+
+/**
+   @brief Set the level of the log_x() macros printed on stderr, ARDUHAL_LOG_LEVEL_ERROR by default.
+*/
+void hostSetLogLevel (int level);
+
+// NVS --------------------------------------------------------------------------
+
+/**
+   @brief Erase all the Preferences namespaces, as a blank flash.
+*/
+void hostNvsErase();
+
+/**
+   @brief Number of successful Preferences writes (put*) since the start of the process.
+*/
+uint32_t hostNvsWrites();
+
+/**
+   @brief Make the Preferences writes fail, e.g. a full NVS partition.
+*/
+void hostNvsFailWrites (bool fail);
+
+/**
+   @brief Real time spent in each Preferences write, to widen the races between tasks.
+*/
+void hostNvsSetWriteDuration (uint32_t us);
+
+// System -----------------------------------------------------------------------
+
+/**
+   @brief Run the handlers registered with esp_register_shutdown_handler(), as esp_restart().
+*/
+void hostShutdown();
+
+/**
+   @brief Set the IEEE 802.15.4 MAC returned by esp_read_mac().
+*/
+void hostSetMac (const uint8_t mac[8]);
+
+// Zigbee stack -----------------------------------------------------------------
+
+/**
+   @brief Report sent with esp_zb_zcl_report_attr_cmd_req().
+*/
+struct HostReport {
+  uint8_t endpoint;
+  uint16_t cluster;
+  uint16_t attribute;
+  uint16_t manufCode;
+};
+
+/**
+   @brief Number of reports sent since the last call to hostClearReports().
+*/
+size_t hostReportCount();
+
+/**
+   @brief Get a report sent since the last call to hostClearReports(), 0 is the oldest.
+*/
+const HostReport &hostReport (size_t index);
+
+/**
+   @brief Forget the reports sent.
+*/
+void hostClearReports();
+
+/**
+   @brief Make esp_zb_zcl_report_attr_cmd_req() fail, e.g. a full APS queue.
+*/
+void hostFailReports (bool fail);
+
+/**
+   @brief Number of esp_zb_lock_acquire() calls since the start of the process.
+*/
+uint32_t hostZbLockCount();
+
+/**
+   @brief Number of attribute values set in the stack since the start of the process.
+*/
+uint32_t hostAttributeWrites();
+
+/**
+   @brief Number of reporting configurations passed to esp_zb_zcl_update_reporting_info().
+*/
+uint32_t hostReportingUpdates();
+
+/**
+   @brief Number of esp_zb_scheduler_alarm() callbacks run since the start of the process.
+   The alarms run on the simulated clock, see hostAdvance().
+*/
+uint32_t hostStackAlarms();
+
+/**
+   @brief Check if the calling code runs in an alarm of the scheduler, as in the Zigbee stack task.
+*/
+bool hostInStackTask();
+
+/**
+   @brief Deliver an attribute write received from the network to the endpoint,
+   in the stack task: the Zigbee lock is held and hostInStackTask() is true.
+*/
+void hostStackWrite (uint8_t endpoint, uint16_t cluster, uint16_t attribute, uint8_t type, void *value, uint16_t size);
@@ -0,0 +1,274 @@
+/// @file Preferences.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the Arduino Preferences class, the namespaces are kept in memory.
+#include <Preferences.h>
+#include "PilotWireHost.h"
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t>> Namespace;
+
+static std::atomic<uint32_t> s_nvs_writes (0);
+static std::atomic<bool> s_nvs_fail (false);
+static std::atomic<uint32_t> s_nvs_write_us (0);
+
+// The objects are never destroyed, they outlive the static objects of the
+// programs, e.g. an endpoint declared as a global variable.
+
+// ----------------------------------------------------------------------------
+static std::mutex &
+nvsMutex() {
+  static std::mutex *object = new std::mutex();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+static std::map<std::string, Namespace> &
+nvs() {
+  static std::map<std::string, Namespace> *object = new std::map<std::string, Namespace>();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+Preferences::Preferences() :
+  _started (false), _read_only (false) {
+
+  _name[0] = '\0';
+}
+
+// ----------------------------------------------------------------------------
+Preferences::~Preferences() {
+
+  end();
+}
+
+// ----------------------------------------------------------------------------
+bool
+Preferences::begin (const char *name, bool readOnly, const char *) {
+
+  if (_started || name == nullptr || strlen (name) >= sizeof (_name)) {
+    return false;
+  }
+  strcpy (_name, name);
+  _read_only = readOnly;
+  _started = true;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+void
+Preferences::end() {
+
+  _started = false;
+}
+
+// ----------------------------------------------------------------------------
+bool
+Preferences::clear() {
+
+  if (_started == false || _read_only) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock (nvsMutex());
+  nvs()[_name].clear();
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool
+Preferences::remove (const char *key) {
+
+  if (_started == false || _read_only) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock (nvsMutex());
+  return nvs()[_name].erase (key) != 0;
+}
+
+// ----------------------------------------------------------------------------
+bool
+Preferences::isKey (const char *key) {
+
+  return getBytesLength (key) != 0;
+}
+
+// ----------------------------------------------------------------------------
+// private
+size_t
+Preferences::put (const char *key, const void *value, size_t len) {
+
+  if (_started == false || _read_only || key == nullptr || strlen (key) > 15 || s_nvs_fail) {
+    return 0;
+  }
+
+  // the flash write, outside the lock as the tasks do not wait for each other before it
+  uint32_t us = s_nvs_write_us;
+  if (us != 0) {
+
+    std::this_thread::sleep_for (std::chrono::microseconds (us));
+  }
+
+  std::lock_guard<std::mutex> lock (nvsMutex());
+  const uint8_t *p = static_cast<const uint8_t *> (value);
+  nvs()[_name][key].assign (p, p + len);
+  s_nvs_writes++;
+  return len;
+}
+
+// ----------------------------------------------------------------------------
+// private, returns the length of the value if it fits in len, 0 otherwise
+size_t
+Preferences::get (const char *key, void *value, size_t len) {
+
+  if (_started == false || key == nullptr) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock (nvsMutex());
+  Namespace &ns = nvs()[_name];
+  auto it = ns.find (key);
+  if (it == ns.end() || it->second.size() > len) {
+    return 0;
+  }
+  memcpy (value, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Preferences::putUChar (const char *key, uint8_t value) {
+
+  return put (key, &value, sizeof (value));
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Preferences::putBool (const char *key, bool value) {
+
+  return putUChar (key, value ? 1 : 0);
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Preferences::putInt (const char *key, int32_t value) {
+
+  return put (key, &value, sizeof (value));
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Preferences::putUInt (const char *key, uint32_t value) {
+
+  return put (key, &value, sizeof (value));
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Preferences::putULong64 (const char *key, uint64_t value) {
+
+  return put (key, &value, sizeof (value));
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Preferences::putBytes (const char *key, const void *value, size_t len) {
+
+  return (value != nullptr && len != 0) ? put (key, value, len) : 0;
+}
+
+// ----------------------------------------------------------------------------
+uint8_t
+Preferences::getUChar (const char *key, uint8_t defaultValue) {
+  uint8_t value;
+
+  return (get (key, &value, sizeof (value)) == sizeof (value)) ? value : defaultValue;
+}
+
+// ----------------------------------------------------------------------------
+bool
+Preferences::getBool (const char *key, bool defaultValue) {
+
+  return getUChar (key, defaultValue ? 1 : 0) != 0;
+}
+
+// ----------------------------------------------------------------------------
+int32_t
+Preferences::getInt (const char *key, int32_t defaultValue) {
+  int32_t value;
+
+  return (get (key, &value, sizeof (value)) == sizeof (value)) ? value : defaultValue;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+Preferences::getUInt (const char *key, uint32_t defaultValue) {
+  uint32_t value;
+
+  return (get (key, &value, sizeof (value)) == sizeof (value)) ? value : defaultValue;
+}
+
+// ----------------------------------------------------------------------------
+uint64_t
+Preferences::getULong64 (const char *key, uint64_t defaultValue) {
+  uint64_t value;
+
+  return (get (key, &value, sizeof (value)) == sizeof (value)) ? value : defaultValue;
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Preferences::getBytesLength (const char *key) {
+
+  if (_started == false || key == nullptr) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock (nvsMutex());
+  Namespace &ns = nvs()[_name];
+  auto it = ns.find (key);
+  return (it == ns.end()) ? 0 : it->second.size();
+}
+
+// ----------------------------------------------------------------------------
+size_t
+Preferences::getBytes (const char *key, void *buf, size_t maxLen) {
+
+  return get (key, buf, maxLen);
+}
+
+// ----------------------------------------------------------------------------
+void
+hostNvsErase() {
+  std::lock_guard<std::mutex> lock (nvsMutex());
+
+  nvs().clear();
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+hostNvsWrites() {
+
+  return s_nvs_writes;
+}
+
+// ----------------------------------------------------------------------------
+void
+hostNvsFailWrites (bool fail) {
+
+  s_nvs_fail = fail;
+}
+
+// ----------------------------------------------------------------------------
+void
+hostNvsSetWriteDuration (uint32_t us) {
+
+  s_nvs_write_us = us;
+}
@@ -0,0 +1,47 @@
+/// @file Preferences.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the Arduino Preferences class.
+/// The namespaces live in memory for the whole process, so a second Preferences
+/// opened on a namespace reads what the first one wrote, as after a reboot.
+/// The writes are counted and can be made to fail, see PilotWireHost.h.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Preferences {
+  public:
+    Preferences();
+    ~Preferences();
+
+    bool begin (const char *name, bool readOnly = false, const char *partition_label = nullptr);
+    void end();
+    bool clear();
+    bool remove (const char *key);
+    bool isKey (const char *key);
+
+    size_t putUChar (const char *key, uint8_t value);
+    size_t putBool (const char *key, bool value);
+    size_t putInt (const char *key, int32_t value);
+    size_t putUInt (const char *key, uint32_t value);
+    size_t putULong64 (const char *key, uint64_t value);
+    size_t putBytes (const char *key, const void *value, size_t len);
+
+    uint8_t getUChar (const char *key, uint8_t defaultValue = 0);
+    bool getBool (const char *key, bool defaultValue = false);
+    int32_t getInt (const char *key, int32_t defaultValue = 0);
+    uint32_t getUInt (const char *key, uint32_t defaultValue = 0);
+    uint64_t getULong64 (const char *key, uint64_t defaultValue = 0);
+    size_t getBytesLength (const char *key);
+    size_t getBytes (const char *key, void *buf, size_t maxLen);
+
+  private:
+    size_t put (const char *key, const void *value, size_t len);
+    size_t get (const char *key, void *value, size_t len);
+
+    char _name[16];
+    bool _started;
+    bool _read_only;
+};
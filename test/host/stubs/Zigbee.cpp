@@ -0,0 +1,784 @@
+/// @file Zigbee.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-ins of the Arduino Zigbee classes and of the esp-zigbee-lib
+/// attribute, report and lock functions.
+#include <ZigbeeCore.h>
+#include <esp_timer.h>
+#include "PilotWireHost.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+ZigbeeCore Zigbee;
+
+static std::atomic<uint32_t> s_lock_count (0);
+static bool s_fail_reports = false;
+static uint32_t s_attribute_writes = 0;
+static uint32_t s_reporting_updates = 0;
+static time_t s_time = 0;
+static uint32_t s_stack_alarms = 0;
+static thread_local bool s_in_stack = false;
+
+// The objects are never destroyed, they outlive the static objects of the
+// programs, e.g. an endpoint declared as a global variable.
+
+// ----------------------------------------------------------------------------
+static std::recursive_timed_mutex &
+zbLock() {
+  static std::recursive_timed_mutex *object = new std::recursive_timed_mutex();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+static std::map<uint8_t, esp_zb_cluster_list_t *> &
+endpoints() {
+  static std::map<uint8_t, esp_zb_cluster_list_t *> *object = new std::map<uint8_t, esp_zb_cluster_list_t *>();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+static std::map<uint8_t, ZigbeeEP *> &
+handlers() {
+  static std::map<uint8_t, ZigbeeEP *> *object = new std::map<uint8_t, ZigbeeEP *>();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+static std::map<const esp_zb_zcl_attr_t *, size_t> &
+capacity() {
+  static std::map<const esp_zb_zcl_attr_t *, size_t> *object = new std::map<const esp_zb_zcl_attr_t *, size_t>();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+static std::vector<HostReport> &
+reports() {
+  static std::vector<HostReport> *object = new std::vector<HostReport>();
+
+  return *object;
+}
+
+// ----------------------------------------------------------------------------
+// size of a value of a type, the strings start with their length
+static size_t
+valueSize (uint8_t type, const void *value) {
+
+  switch (type) {
+    case ESP_ZB_ZCL_ATTR_TYPE_NULL:
+      return 0;
+    case ESP_ZB_ZCL_ATTR_TYPE_8BIT:
+    case ESP_ZB_ZCL_ATTR_TYPE_BOOL:
+    case ESP_ZB_ZCL_ATTR_TYPE_8BITMAP:
+    case ESP_ZB_ZCL_ATTR_TYPE_U8:
+    case ESP_ZB_ZCL_ATTR_TYPE_S8:
+    case ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM:
+      return 1;
+    case ESP_ZB_ZCL_ATTR_TYPE_16BIT:
+    case ESP_ZB_ZCL_ATTR_TYPE_16BITMAP:
+    case ESP_ZB_ZCL_ATTR_TYPE_U16:
+    case ESP_ZB_ZCL_ATTR_TYPE_S16:
+    case ESP_ZB_ZCL_ATTR_TYPE_16BIT_ENUM:
+      return 2;
+    case ESP_ZB_ZCL_ATTR_TYPE_U24:
+    case ESP_ZB_ZCL_ATTR_TYPE_S24:
+      return 3;
+    case ESP_ZB_ZCL_ATTR_TYPE_U32:
+    case ESP_ZB_ZCL_ATTR_TYPE_S32:
+    case ESP_ZB_ZCL_ATTR_TYPE_UTC_TIME:
+      return 4;
+    case ESP_ZB_ZCL_ATTR_TYPE_U48:
+      return 6;
+    case ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING:
+    case ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING:
+      return (value != nullptr) ? 1 + *static_cast<const uint8_t *> (value) : 1;
+    default:
+      return 0;
+  }
+}
+
+// ----------------------------------------------------------------------------
+static esp_zb_attribute_list_t *
+appendAttribute (esp_zb_attribute_list_t *list, uint16_t attr_id, uint16_t manuf_code,
+                 uint8_t type, uint8_t access, const void *value) {
+  esp_zb_attribute_list_t *node = new esp_zb_attribute_list_t();
+  size_t size = valueSize (type, value);
+
+  node->attribute.id = attr_id;
+  node->attribute.type = type;
+  node->attribute.access = access;
+  node->attribute.manuf_code = manuf_code;
+  node->attribute.data_p = nullptr;
+  node->cluster_id = list->cluster_id;
+  if (size != 0) {
+
+    // the stack keeps its own copy of the initial value
+    node->attribute.data_p = calloc (1, size);
+    if (value != nullptr) {
+      memcpy (node->attribute.data_p, value, size);
+    }
+    capacity()[&node->attribute] = size;
+  }
+
+  while (list->next != nullptr) {
+    list = list->next;
+  }
+  list->next = node;
+  return node;
+}
+
+// ----------------------------------------------------------------------------
+static esp_zb_zcl_attr_t *
+findAttribute (uint8_t endpoint, uint16_t cluster_id, uint8_t role, uint16_t attr_id, uint16_t manuf_code) {
+  auto ep = endpoints().find (endpoint);
+
+  if (ep == endpoints().end()) {
+    return nullptr;
+  }
+  for (esp_zb_cluster_list_t *c = ep->second; c != nullptr; c = c->next) {
+
+    if (c->cluster.attr_list == nullptr || c->cluster.cluster_id != cluster_id || (c->cluster.role_mask & role) == 0) {
+      continue;
+    }
+    for (esp_zb_attribute_list_t *a = c->cluster.attr_list; a != nullptr; a = a->next) {
+
+      // the stack does not find a manufacturer attribute without its code, nor the reverse
+      if (a->attribute.type != ESP_ZB_ZCL_ATTR_TYPE_NULL && a->attribute.id == attr_id &&
+          a->attribute.manuf_code == manuf_code) {
+        return &a->attribute;
+      }
+    }
+  }
+  return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+static esp_zb_zcl_status_t
+setAttribute (uint8_t endpoint, uint16_t cluster_id, uint8_t role, uint16_t manuf_code, uint16_t attr_id, const void *value) {
+  esp_zb_zcl_attr_t *attr = findAttribute (endpoint, cluster_id, role, attr_id, manuf_code);
+
+  if (attr == nullptr || attr->data_p == nullptr) {
+    return ESP_ZB_ZCL_STATUS_UNSUP_ATTRIB;
+  }
+  size_t size = valueSize (attr->type, value);
+  if (size > capacity()[attr]) {
+    return ESP_ZB_ZCL_STATUS_INVALID_VALUE;
+  }
+  memcpy (attr->data_p, value, size);
+  s_attribute_writes++;
+  return ESP_ZB_ZCL_STATUS_SUCCESS;
+}
+
+// ----------------------------------------------------------------------------
+static esp_err_t
+addCluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  if (cluster_list == nullptr || attr_list == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (cluster_list->cluster.attr_list == nullptr) {
+
+    // the head of the list holds the first cluster
+    cluster_list->cluster = { attr_list->cluster_id, role_mask, attr_list };
+    return ESP_OK;
+  }
+
+  esp_zb_cluster_list_t *node = new esp_zb_cluster_list_t();
+  node->cluster = { attr_list->cluster_id, role_mask, attr_list };
+  while (cluster_list->next != nullptr) {
+    cluster_list = cluster_list->next;
+  }
+  cluster_list->next = node;
+  return ESP_OK;
+}
+
+// Lock ---------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+bool
+esp_zb_lock_acquire (TickType_t block_ticks) {
+
+  s_lock_count++;
+  if (block_ticks == portMAX_DELAY) {
+
+    zbLock().lock();
+    return true;
+  }
+  return zbLock().try_lock_for (std::chrono::milliseconds (block_ticks * portTICK_PERIOD_MS));
+}
+
+// ----------------------------------------------------------------------------
+void
+esp_zb_lock_release (void) {
+
+  zbLock().unlock();
+}
+
+// Scheduler ----------------------------------------------------------------------
+
+struct HostAlarm {
+  esp_zb_callback_t callback;
+  uint8_t param;
+  esp_timer_handle_t timer;
+};
+
+// ----------------------------------------------------------------------------
+static void
+alarmTimerCallback (void *arg) {
+  HostAlarm *alarm = static_cast<HostAlarm *> (arg);
+
+  // as the stack task, which holds the lock while it runs the alarms
+  zbLock().lock();
+  s_in_stack = true;
+  s_stack_alarms++;
+  alarm->callback (alarm->param);
+  s_in_stack = false;
+  zbLock().unlock();
+
+  esp_timer_delete (alarm->timer);
+  delete alarm;
+}
+
+// ----------------------------------------------------------------------------
+void
+esp_zb_scheduler_alarm (esp_zb_callback_t cb, uint8_t param, uint32_t time) {
+  HostAlarm *alarm = new HostAlarm { cb, param, nullptr };
+  const esp_timer_create_args_t args = {
+    .callback = alarmTimerCallback,
+    .arg = alarm,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "zb_alarm",
+    .skip_unhandled_events = false
+  };
+
+  esp_timer_create (&args, &alarm->timer);
+  esp_timer_start_once (alarm->timer, static_cast<uint64_t> (time) * 1000);
+}
+
+// Clusters -----------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+esp_zb_cluster_list_t *
+esp_zb_zcl_cluster_list_create (void) {
+
+  return new esp_zb_cluster_list_t();
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_zcl_attr_list_create (uint16_t cluster_id) {
+  esp_zb_attribute_list_t *list = new esp_zb_attribute_list_t();
+
+  // the head of the list is not an attribute
+  list->attribute.id = 0xFFFF;
+  list->attribute.type = ESP_ZB_ZCL_ATTR_TYPE_NULL;
+  list->attribute.manuf_code = ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC;
+  list->cluster_id = cluster_id;
+  return list;
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_basic_cluster_create (void *) {
+  esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create (ESP_ZB_ZCL_CLUSTER_ID_BASIC);
+  uint8_t zcl_version = 8;
+  uint8_t power_source = 1;
+
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_BASIC, 0x0000, ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &zcl_version);
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_BASIC, 0x0007, ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &power_source);
+  return list;
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_identify_cluster_create (void *) {
+  esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create (ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY);
+  uint16_t identify_time = 0;
+
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY, 0x0000, ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &identify_time);
+  return list;
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_groups_cluster_create (void *) {
+  esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create (ESP_ZB_ZCL_CLUSTER_ID_GROUPS);
+  uint8_t name_support = 0;
+
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_GROUPS, 0x0000, ESP_ZB_ZCL_ATTR_TYPE_8BITMAP, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &name_support);
+  return list;
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_scenes_cluster_create (void *) {
+  esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create (ESP_ZB_ZCL_CLUSTER_ID_SCENES);
+  uint8_t zero8 = 0;
+  uint16_t zero16 = 0;
+  bool scene_valid = false;
+
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_SCENES, 0x0000, ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &zero8);
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_SCENES, 0x0001, ESP_ZB_ZCL_ATTR_TYPE_U8, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &zero8);
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_SCENES, 0x0002, ESP_ZB_ZCL_ATTR_TYPE_U16, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &zero16);
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_SCENES, 0x0003, ESP_ZB_ZCL_ATTR_TYPE_BOOL, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &scene_valid);
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_SCENES, 0x0004, ESP_ZB_ZCL_ATTR_TYPE_8BITMAP, ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &zero8);
+  return list;
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_on_off_cluster_create (void *) {
+  esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create (ESP_ZB_ZCL_CLUSTER_ID_ON_OFF);
+  bool on_off = false;
+
+  esp_zb_cluster_add_attr (list, ESP_ZB_ZCL_CLUSTER_ID_ON_OFF, ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID, ESP_ZB_ZCL_ATTR_TYPE_BOOL,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING | ESP_ZB_ZCL_ATTR_ACCESS_SCENE, &on_off);
+  return list;
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_diagnostics_cluster_create (void *) {
+
+  return esp_zb_zcl_attr_list_create (ESP_ZB_ZCL_CLUSTER_ID_DIAGNOSTICS);
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_temperature_meas_cluster_create (esp_zb_temperature_meas_cluster_cfg_t *cfg) {
+  esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create (ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT);
+  const uint16_t id = ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT;
+
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &cfg->measured_value);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MIN_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &cfg->min_value);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MAX_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &cfg->max_value);
+  return list;
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_metering_cluster_create (esp_zb_metering_cluster_cfg_t *cfg) {
+  esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create (ESP_ZB_ZCL_CLUSTER_ID_METERING);
+  const uint16_t id = ESP_ZB_ZCL_CLUSTER_ID_METERING;
+
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID, ESP_ZB_ZCL_ATTR_TYPE_U48,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &cfg->current_summation_delivered);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_METERING_STATUS_ID, ESP_ZB_ZCL_ATTR_TYPE_8BITMAP,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &cfg->status);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_METERING_UNIT_OF_MEASURE_ID, ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &cfg->uint_of_measure);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_METERING_SUMMATION_FORMATTING_ID, ESP_ZB_ZCL_ATTR_TYPE_8BITMAP,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &cfg->summation_formatting);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_METERING_METERING_DEVICE_TYPE_ID, ESP_ZB_ZCL_ATTR_TYPE_8BITMAP,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &cfg->metering_device_type);
+  return list;
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_attribute_list_t *
+esp_zb_thermostat_cluster_create (esp_zb_thermostat_cluster_cfg_t *cfg) {
+  esp_zb_attribute_list_t *list = esp_zb_zcl_attr_list_create (ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT);
+  const uint16_t id = ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT;
+
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &cfg->local_temperature);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &cfg->occupied_cooling_setpoint);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &cfg->occupied_heating_setpoint);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_THERMOSTAT_CONTROL_SEQUENCE_OF_OPERATION_ID, ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &cfg->control_sequence_of_operation);
+  esp_zb_cluster_add_attr (list, id, ESP_ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID, ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM,
+                           ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &cfg->system_mode);
+  return list;
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_add_attr (esp_zb_attribute_list_t *attr_list, uint16_t cluster_id, uint16_t attr_id,
+                         uint8_t attr_type, uint8_t attr_access, void *value_p) {
+
+  if (attr_list == nullptr || attr_list->cluster_id != cluster_id) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  appendAttribute (attr_list, attr_id, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC, attr_type, attr_access, value_p);
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_add_manufacturer_attr (esp_zb_attribute_list_t *attr_list, uint16_t cluster_id, uint16_t attr_id,
+                                      uint16_t manuf_code, uint8_t attr_type, uint8_t attr_access, void *value_p) {
+
+  if (attr_list == nullptr || attr_list->cluster_id != cluster_id) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  appendAttribute (attr_list, attr_id, manuf_code, attr_type, attr_access | ESP_ZB_ZCL_ATTR_MANUF_SPEC, value_p);
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_basic_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_identify_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_groups_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_scenes_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_on_off_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_diagnostics_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_temperature_meas_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_metering_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_thermostat_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_cluster_list_add_custom_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask) {
+
+  return addCluster (cluster_list, attr_list, role_mask);
+}
+
+// Attributes and reports ---------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+esp_zb_zcl_status_t
+esp_zb_zcl_set_attribute_val (uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                              uint16_t attr_id, void *value_p, bool) {
+
+  return setAttribute (endpoint, cluster_id, cluster_role, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC, attr_id, value_p);
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_zcl_status_t
+esp_zb_zcl_set_manufacturer_attribute_val (uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                           uint16_t manuf_code, uint16_t attr_id, void *value_p, bool) {
+
+  return setAttribute (endpoint, cluster_id, cluster_role, manuf_code, attr_id, value_p);
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_zcl_attr_t *
+esp_zb_zcl_get_attribute (uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role, uint16_t attr_id) {
+
+  return findAttribute (endpoint, cluster_id, cluster_role, attr_id, ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC);
+}
+
+// ----------------------------------------------------------------------------
+esp_zb_zcl_attr_t *
+esp_zb_zcl_get_manufacturer_attribute (uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                       uint16_t attr_id, uint16_t manuf_code) {
+
+  return findAttribute (endpoint, cluster_id, cluster_role, attr_id, manuf_code);
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_zcl_report_attr_cmd_req (esp_zb_zcl_report_attr_cmd_t *cmd_req) {
+  uint16_t manuf_code = cmd_req->manuf_code;
+
+  if (s_fail_reports) {
+    return ESP_FAIL;
+  }
+  if (manuf_code == 0) {
+
+    // the field is ignored for a standard attribute
+    manuf_code = ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC;
+  }
+  if (findAttribute (cmd_req->zcl_basic_cmd.src_endpoint, cmd_req->clusterID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                     cmd_req->attributeID, manuf_code) == nullptr) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  reports().push_back ({ cmd_req->zcl_basic_cmd.src_endpoint, cmd_req->clusterID, cmd_req->attributeID, cmd_req->manuf_code });
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+esp_err_t
+esp_zb_zcl_update_reporting_info (esp_zb_zcl_reporting_info_t *config) {
+
+  if (findAttribute (config->ep, config->cluster_id, config->cluster_role, config->attr_id,
+                     (config->manuf_code == 0) ? (uint16_t) ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC : config->manuf_code) == nullptr) {
+    return ESP_ERR_NOT_FOUND;
+  }
+  s_reporting_updates++;
+  return ESP_OK;
+}
+
+// ----------------------------------------------------------------------------
+const char *
+esp_zb_zcl_status_to_name (esp_zb_zcl_status_t status) {
+
+  switch (status) {
+    case ESP_ZB_ZCL_STATUS_SUCCESS:
+      return "Success";
+    case ESP_ZB_ZCL_STATUS_UNSUP_ATTRIB:
+      return "Unsupported attribute";
+    case ESP_ZB_ZCL_STATUS_INVALID_VALUE:
+      return "Invalid value";
+    case ESP_ZB_ZCL_STATUS_INVALID_TYPE:
+      return "Invalid type";
+    default:
+      return "Failure";
+  }
+}
+
+// Arduino classes ----------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+ZigbeeEP::ZigbeeEP (uint8_t endpoint) :
+  _endpoint (endpoint), _device_id (ESP_ZB_HA_ON_OFF_OUTPUT_DEVICE_ID), _ep_config(), _cluster_list (nullptr) {
+}
+
+// ----------------------------------------------------------------------------
+ZigbeeEP::~ZigbeeEP() {
+  auto it = endpoints().find (_endpoint);
+  auto handler = handlers().find (_endpoint);
+
+  if (it != endpoints().end() && it->second == _cluster_list) {
+
+    endpoints().erase (it);
+  }
+  if (handler != handlers().end() && handler->second == this) {
+
+    handlers().erase (handler);
+  }
+}
+
+// ----------------------------------------------------------------------------
+bool
+ZigbeeEP::setManufacturerAndModel (const char *name, const char *model) {
+
+  return name != nullptr && model != nullptr;
+}
+
+// ----------------------------------------------------------------------------
+bool
+ZigbeeEP::addTimeCluster (tm, int32_t) {
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+struct tm
+ZigbeeEP::getTime (uint8_t, int32_t, esp_zb_ieee_addr_t) {
+  struct tm t;
+  time_t now = s_time + static_cast<time_t> (esp_timer_get_time() / 1000000);
+
+  gmtime_r (&now, &t);
+  return t;
+}
+
+// ----------------------------------------------------------------------------
+int32_t
+ZigbeeEP::getTimezone (uint8_t, int32_t, esp_zb_ieee_addr_t) {
+
+  return 0;
+}
+
+// ----------------------------------------------------------------------------
+bool
+ZigbeeEP::addOTAClient (uint32_t, uint32_t, uint16_t,
+                        uint16_t, uint16_t, uint8_t) {
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+void
+ZigbeeEP::requestOTAUpdate() {
+}
+
+// ----------------------------------------------------------------------------
+void
+ZigbeeEP::zbIdentify (const esp_zb_zcl_set_attr_value_message_t *) {
+}
+
+// ----------------------------------------------------------------------------
+bool
+ZigbeeCore::begin (zigbee_role_t, bool) {
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool
+ZigbeeCore::addEndpoint (ZigbeeEP *ep) {
+
+  if (ep == nullptr || ep->_cluster_list == nullptr) {
+    return false;
+  }
+  endpoints()[ep->_endpoint] = ep->_cluster_list;
+  handlers()[ep->_endpoint] = ep;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool
+ZigbeeCore::connected() {
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+bool
+ZigbeeCore::started() {
+
+  return true;
+}
+
+// Host control -------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+size_t
+hostReportCount() {
+
+  return reports().size();
+}
+
+// ----------------------------------------------------------------------------
+const HostReport &
+hostReport (size_t index) {
+
+  return reports().at (index);
+}
+
+// ----------------------------------------------------------------------------
+void
+hostClearReports() {
+
+  reports().clear();
+}
+
+// ----------------------------------------------------------------------------
+void
+hostFailReports (bool fail) {
+
+  s_fail_reports = fail;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+hostZbLockCount() {
+
+  return s_lock_count;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+hostAttributeWrites() {
+
+  return s_attribute_writes;
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+hostReportingUpdates() {
+
+  return s_reporting_updates;
+}
+
+// ----------------------------------------------------------------------------
+void
+hostSetTime (time_t utc) {
+
+  s_time = utc - static_cast<time_t> (esp_timer_get_time() / 1000000);
+}
+
+// ----------------------------------------------------------------------------
+uint32_t
+hostStackAlarms() {
+
+  return s_stack_alarms;
+}
+
+// ----------------------------------------------------------------------------
+bool
+hostInStackTask() {
+
+  return s_in_stack;
+}
+
+// ----------------------------------------------------------------------------
+void
+hostStackWrite (uint8_t endpoint, uint16_t cluster, uint16_t attribute, uint8_t type, void *value, uint16_t size) {
+  auto ep = handlers().find (endpoint);
+  esp_zb_zcl_set_attr_value_message_t message = {};
+
+  if (ep == handlers().end()) {
+    return;
+  }
+  message.info.status = ESP_ZB_ZCL_STATUS_SUCCESS;
+  message.info.dst_endpoint = endpoint;
+  message.info.cluster = cluster;
+  message.attribute.id = attribute;
+  message.attribute.data.type = type;
+  message.attribute.data.size = size;
+  message.attribute.data.value = value;
+
+  zbLock().lock();
+  s_in_stack = true;
+  ep->second->zbAttributeSet (&message);
+  s_in_stack = false;
+  zbLock().unlock();
+}
@@ -0,0 +1,6 @@
+/// @file Zigbee.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+#pragma once
+
+#include "ZigbeeCore.h"
@@ -0,0 +1,25 @@
+/// @file ZigbeeCore.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the Arduino Zigbee core. addEndpoint() registers the
+/// cluster list of an endpoint in the attribute store of esp_zb_zcl_*().
+#pragma once
+
+#include "ZigbeeEP.h"
+
+typedef enum {
+  ZIGBEE_COORDINATOR = 0,
+  ZIGBEE_ROUTER = 1,
+  ZIGBEE_END_DEVICE = 2
+} zigbee_role_t;
+
+class ZigbeeCore {
+  public:
+    bool begin (zigbee_role_t role = ZIGBEE_END_DEVICE, bool erase_nvs = false);
+    bool addEndpoint (ZigbeeEP *ep);
+    bool connected();
+    bool started();
+};
+
+extern ZigbeeCore Zigbee;
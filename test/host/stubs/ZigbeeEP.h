@@ -0,0 +1,41 @@
+/// @file ZigbeeEP.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the Arduino Zigbee endpoint base class, reduced to the
+/// members used by the library. The time is the one set by hostSetTime().
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+#include <ha/esp_zigbee_ha_standard.h>
+
+class ZigbeeEP {
+  public:
+    ZigbeeEP (uint8_t endpoint = 10);
+    virtual ~ZigbeeEP();
+
+    uint8_t getEndpoint() {
+      return _endpoint;
+    }
+
+    bool setManufacturerAndModel (const char *name, const char *model);
+    bool addTimeCluster (tm time = {}, int32_t gmt_offset = 0);
+    struct tm getTime (uint8_t endpoint = 1, int32_t short_addr = 0x0000, esp_zb_ieee_addr_t ieee_addr = {0});
+    int32_t getTimezone (uint8_t endpoint = 1, int32_t short_addr = 0x0000, esp_zb_ieee_addr_t ieee_addr = {0});
+    bool addOTAClient (uint32_t file_version, uint32_t downloaded_file_ver, uint16_t hw_version,
+                       uint16_t manufacturer = 0x1001, uint16_t image_type = 0x1011, uint8_t max_data_size = 223);
+    void requestOTAUpdate();
+
+    virtual void zbAttributeSet (const esp_zb_zcl_set_attr_value_message_t *) {}
+    virtual void zbAttributeRead (uint16_t, const esp_zb_zcl_attribute_t *, uint8_t) {}
+    virtual void zbIdentify (const esp_zb_zcl_set_attr_value_message_t *message);
+
+    friend class ZigbeeCore;
+
+  protected:
+    uint8_t _endpoint;
+    esp_zb_ha_standard_devices_t _device_id;
+    esp_zb_endpoint_config_t _ep_config;
+    esp_zb_cluster_list_t *_cluster_list;
+};
@@ -0,0 +1,25 @@
+/// @file esp32-hal-log.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the Arduino log macros, printed on stderr up to the
+/// level set by hostSetLogLevel(), errors only by default.
+#pragma once
+
+#include <stdio.h>
+
+#define ARDUHAL_LOG_LEVEL_NONE     0
+#define ARDUHAL_LOG_LEVEL_ERROR    1
+#define ARDUHAL_LOG_LEVEL_WARN     2
+#define ARDUHAL_LOG_LEVEL_INFO     3
+#define ARDUHAL_LOG_LEVEL_DEBUG    4
+#define ARDUHAL_LOG_LEVEL_VERBOSE  5
+
+// no format checking, the library prints uint64_t with %llu as on the target
+void hostLog (int level, const char *format, ...);
+
+#define log_e(format, ...)  hostLog (ARDUHAL_LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#define log_w(format, ...)  hostLog (ARDUHAL_LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#define log_i(format, ...)  hostLog (ARDUHAL_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define log_d(format, ...)  hostLog (ARDUHAL_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define log_v(format, ...)  hostLog (ARDUHAL_LOG_LEVEL_VERBOSE, format, ##__VA_ARGS__)
@@ -0,0 +1,15 @@
+/// @file esp_heap_caps.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in, the heap is reported as a fixed size.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+#define MALLOC_CAP_8BIT     (1 << 2)
+
+size_t heap_caps_get_free_size (uint32_t caps);
+size_t heap_caps_get_largest_free_block (uint32_t caps);
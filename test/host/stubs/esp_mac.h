@@ -0,0 +1,20 @@
+/// @file esp_mac.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the MAC address API, see hostSetMac().
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+  ESP_MAC_WIFI_STA,
+  ESP_MAC_WIFI_SOFTAP,
+  ESP_MAC_BT,
+  ESP_MAC_ETH,
+  ESP_MAC_IEEE802154,
+  ESP_MAC_BASE
+} esp_mac_type_t;
+
+esp_err_t esp_read_mac (uint8_t *mac, esp_mac_type_t type);
@@ -0,0 +1,14 @@
+/// @file esp_system.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the ESP-IDF system API, hostShutdown() runs the shutdown handlers.
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t) (void);
+
+esp_err_t esp_register_shutdown_handler (shutdown_handler_t handler);
+void esp_restart (void);
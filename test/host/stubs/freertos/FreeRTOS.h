@@ -0,0 +1,34 @@
+/// @file FreeRTOS.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the FreeRTOS definitions used by the library.
+/// A critical section takes a process-wide recursive mutex, like a single core
+/// ESP32-C6 masking the interrupts.
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define portMAX_DELAY       0xFFFFFFFFUL
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (ms))
+#define pdTRUE              1
+#define pdFALSE             0
+
+typedef struct {
+  uint32_t owner;
+  uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED  { 0, 0 }
+
+void vPortEnterCritical (portMUX_TYPE *mux);
+void vPortExitCritical (portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)  vPortEnterCritical (mux)
+#define portEXIT_CRITICAL(mux)   vPortExitCritical (mux)
+#define taskENTER_CRITICAL(mux)  vPortEnterCritical (mux)
+#define taskEXIT_CRITICAL(mux)   vPortExitCritical (mux)
@@ -0,0 +1,13 @@
+/// @file task.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the FreeRTOS task API, a task is a thread.
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+TaskHandle_t xTaskGetCurrentTaskHandle (void);
+void vTaskDelay (TickType_t ticks);
@@ -0,0 +1,352 @@
+/// @file esp_zigbee_ha_standard.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the esp-zigbee-lib API used by the library.
+/// The clusters are linked lists of attributes as in the SDK, the values are
+/// copied when an attribute is added. The attributes of the registered
+/// endpoints are set and read by esp_zb_zcl_*(), which check the manufacturer
+/// code like the stack. The reports and the reporting configuration are
+/// recorded, see PilotWireHost.h. The alarms of the scheduler run on the
+/// simulated clock with the Zigbee lock held, as in the stack task.
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef uint8_t esp_zb_ieee_addr_t[8];
+
+typedef enum {
+  ESP_ZB_HA_ON_OFF_OUTPUT_DEVICE_ID = 0x0002,
+  ESP_ZB_HA_SMART_PLUG_DEVICE_ID = 0x0051,
+  ESP_ZB_HA_THERMOSTAT_DEVICE_ID = 0x0301
+} esp_zb_ha_standard_devices_t;
+
+#define ESP_ZB_AF_HA_PROFILE_ID  0x0104
+
+typedef struct {
+  uint8_t endpoint;
+  uint16_t app_profile_id;
+  uint16_t app_device_id;
+  uint32_t app_device_version;
+} esp_zb_endpoint_config_t;
+
+// Attributes and clusters ---------------------------------------------------
+typedef struct esp_zb_zcl_attr_s {
+  uint16_t id;
+  uint8_t type;
+  uint8_t access;
+  uint16_t manuf_code;
+  void *data_p;
+} esp_zb_zcl_attr_t;
+
+typedef struct esp_zb_attribute_list_s {
+  esp_zb_zcl_attr_t attribute;
+  uint16_t cluster_id;
+  struct esp_zb_attribute_list_s *next;
+} esp_zb_attribute_list_t;
+
+typedef struct esp_zb_zcl_cluster_s {
+  uint16_t cluster_id;
+  uint8_t role_mask;
+  esp_zb_attribute_list_t *attr_list;
+} esp_zb_zcl_cluster_t;
+
+typedef struct esp_zb_cluster_list_s {
+  esp_zb_zcl_cluster_t cluster;
+  struct esp_zb_cluster_list_s *next;
+} esp_zb_cluster_list_t;
+
+typedef struct {
+  uint32_t low;
+  uint16_t high;
+} __attribute__ ( (packed)) esp_zb_uint48_t;
+
+typedef struct {
+  uint16_t low;
+  uint8_t high;
+} __attribute__ ( (packed)) esp_zb_uint24_t;
+
+typedef struct {
+  uint16_t low;
+  int8_t high;
+} __attribute__ ( (packed)) esp_zb_int24_t;
+
+typedef enum {
+  ESP_ZB_ZCL_STATUS_SUCCESS = 0x00,
+  ESP_ZB_ZCL_STATUS_FAIL = 0x01,
+  ESP_ZB_ZCL_STATUS_UNSUP_ATTRIB = 0x86,
+  ESP_ZB_ZCL_STATUS_INVALID_VALUE = 0x87,
+  ESP_ZB_ZCL_STATUS_INVALID_TYPE = 0x8D
+} esp_zb_zcl_status_t;
+
+const char *esp_zb_zcl_status_to_name (esp_zb_zcl_status_t status);
+
+enum {
+  ESP_ZB_ZCL_CLUSTER_SERVER_ROLE = 0x01,
+  ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE = 0x02
+};
+
+enum {
+  ESP_ZB_ZCL_ATTR_NON_MANUFACTURER_SPECIFIC = 0xFFFF
+};
+
+enum {
+  ESP_ZB_ZCL_ATTR_TYPE_NULL = 0x00,
+  ESP_ZB_ZCL_ATTR_TYPE_8BIT = 0x08,
+  ESP_ZB_ZCL_ATTR_TYPE_16BIT = 0x09,
+  ESP_ZB_ZCL_ATTR_TYPE_BOOL = 0x10,
+  ESP_ZB_ZCL_ATTR_TYPE_8BITMAP = 0x18,
+  ESP_ZB_ZCL_ATTR_TYPE_16BITMAP = 0x19,
+  ESP_ZB_ZCL_ATTR_TYPE_U8 = 0x20,
+  ESP_ZB_ZCL_ATTR_TYPE_U16 = 0x21,
+  ESP_ZB_ZCL_ATTR_TYPE_U24 = 0x22,
+  ESP_ZB_ZCL_ATTR_TYPE_U32 = 0x23,
+  ESP_ZB_ZCL_ATTR_TYPE_U48 = 0x25,
+  ESP_ZB_ZCL_ATTR_TYPE_S8 = 0x28,
+  ESP_ZB_ZCL_ATTR_TYPE_S16 = 0x29,
+  ESP_ZB_ZCL_ATTR_TYPE_S24 = 0x2A,
+  ESP_ZB_ZCL_ATTR_TYPE_S32 = 0x2B,
+  ESP_ZB_ZCL_ATTR_TYPE_8BIT_ENUM = 0x30,
+  ESP_ZB_ZCL_ATTR_TYPE_16BIT_ENUM = 0x31,
+  ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING = 0x41,
+  ESP_ZB_ZCL_ATTR_TYPE_CHAR_STRING = 0x42,
+  ESP_ZB_ZCL_ATTR_TYPE_UTC_TIME = 0xE2
+};
+
+enum {
+  ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY = 0x01,
+  ESP_ZB_ZCL_ATTR_ACCESS_WRITE_ONLY = 0x02,
+  ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE = 0x03,
+  ESP_ZB_ZCL_ATTR_ACCESS_REPORTING = 0x04,
+  ESP_ZB_ZCL_ATTR_ACCESS_SCENE = 0x10,
+  ESP_ZB_ZCL_ATTR_MANUF_SPEC = 0x20
+};
+
+// Clusters and attributes used by the library ----------------------------------
+enum {
+  ESP_ZB_ZCL_CLUSTER_ID_BASIC = 0x0000,
+  ESP_ZB_ZCL_CLUSTER_ID_IDENTIFY = 0x0003,
+  ESP_ZB_ZCL_CLUSTER_ID_GROUPS = 0x0004,
+  ESP_ZB_ZCL_CLUSTER_ID_SCENES = 0x0005,
+  ESP_ZB_ZCL_CLUSTER_ID_ON_OFF = 0x0006,
+  ESP_ZB_ZCL_CLUSTER_ID_TIME = 0x000A,
+  ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE = 0x0019,
+  ESP_ZB_ZCL_CLUSTER_ID_THERMOSTAT = 0x0201,
+  ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT = 0x0402,
+  ESP_ZB_ZCL_CLUSTER_ID_METERING = 0x0702,
+  ESP_ZB_ZCL_CLUSTER_ID_DIAGNOSTICS = 0x0B05
+};
+
+enum {
+  ESP_ZB_ZCL_ATTR_ON_OFF_ON_OFF_ID = 0x0000
+};
+
+enum {
+  ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID = 0x0000,
+  ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MIN_VALUE_ID = 0x0001,
+  ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MAX_VALUE_ID = 0x0002
+};
+
+#define ESP_ZB_ZCL_TEMP_MEASUREMENT_MEASURED_VALUE_DEFAULT  ((int16_t) 0x8000)
+
+enum {
+  ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID = 0x0000,
+  ESP_ZB_ZCL_ATTR_METERING_STATUS_ID = 0x0200,
+  ESP_ZB_ZCL_ATTR_METERING_UNIT_OF_MEASURE_ID = 0x0300,
+  ESP_ZB_ZCL_ATTR_METERING_MULTIPLIER_ID = 0x0301,
+  ESP_ZB_ZCL_ATTR_METERING_DIVISOR_ID = 0x0302,
+  ESP_ZB_ZCL_ATTR_METERING_SUMMATION_FORMATTING_ID = 0x0303,
+  ESP_ZB_ZCL_ATTR_METERING_DEMAND_FORMATTING_ID = 0x0304,
+  ESP_ZB_ZCL_ATTR_METERING_METERING_DEVICE_TYPE_ID = 0x0306,
+  ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID = 0x0400
+};
+
+#define ESP_ZB_ZCL_METERING_STATUS_DEFAULT_VALUE  0x00
+#define ESP_ZB_ZCL_METERING_UNIT_KW_KWH_BINARY    0x00
+#define ESP_ZB_ZCL_METERING_ELECTRIC_METERING     0x00
+#define ESP_ZB_ZCL_METERING_FORMATTING_SET(suppress, left, right)  \
+  ((uint8_t) (((suppress) ? 0x80 : 0) | (((left) & 0x0F) << 3) | ((right) & 0x07)))
+
+enum {
+  ESP_ZB_ZCL_ATTR_THERMOSTAT_LOCAL_TEMPERATURE_ID = 0x0000,
+  ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPANCY_ID = 0x0002,
+  ESP_ZB_ZCL_ATTR_THERMOSTAT_PI_HEATING_DEMAND_ID = 0x0008,
+  ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_COOLING_SETPOINT_ID = 0x0011,
+  ESP_ZB_ZCL_ATTR_THERMOSTAT_OCCUPIED_HEATING_SETPOINT_ID = 0x0012,
+  ESP_ZB_ZCL_ATTR_THERMOSTAT_UNOCCUPIED_HEATING_SETPOINT_ID = 0x0014,
+  ESP_ZB_ZCL_ATTR_THERMOSTAT_CONTROL_SEQUENCE_OF_OPERATION_ID = 0x001B,
+  ESP_ZB_ZCL_ATTR_THERMOSTAT_SYSTEM_MODE_ID = 0x001C
+};
+
+enum {
+  ESP_ZB_ZCL_THERMOSTAT_SYSTEM_MODE_OFF = 0x00,
+  ESP_ZB_ZCL_THERMOSTAT_SYSTEM_MODE_AUTO = 0x01,
+  ESP_ZB_ZCL_THERMOSTAT_SYSTEM_MODE_HEAT = 0x04
+};
+
+enum {
+  ESP_ZB_ZCL_THERMOSTAT_CONTROL_SEQ_OF_OPERATION_HEATING_ONLY = 0x02
+};
+
+typedef struct {
+  int16_t measured_value;
+  int16_t min_value;
+  int16_t max_value;
+} esp_zb_temperature_meas_cluster_cfg_t;
+
+typedef struct {
+  esp_zb_uint48_t current_summation_delivered;
+  uint8_t status;
+  uint8_t uint_of_measure;
+  uint8_t summation_formatting;
+  uint8_t metering_device_type;
+} esp_zb_metering_cluster_cfg_t;
+
+typedef struct {
+  int16_t local_temperature;
+  int16_t occupied_cooling_setpoint;
+  int16_t occupied_heating_setpoint;
+  uint8_t control_sequence_of_operation;
+  uint8_t system_mode;
+} esp_zb_thermostat_cluster_cfg_t;
+
+// Commands ---------------------------------------------------------------------
+typedef enum {
+  ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV = 0x00,
+  ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI = 0x01
+} esp_zb_zcl_cmd_direction_t;
+
+typedef enum {
+  ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT = 0x00,
+  ESP_ZB_APS_ADDR_MODE_16_GROUP_ENDP_NOT_PRESENT = 0x01,
+  ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT = 0x02
+} esp_zb_aps_address_mode_t;
+
+typedef union {
+  uint16_t addr_short;
+  esp_zb_ieee_addr_t addr_long;
+} esp_zb_addr_u;
+
+typedef struct {
+  esp_zb_addr_u dst_addr_u;
+  uint8_t dst_endpoint;
+  uint8_t src_endpoint;
+} esp_zb_zcl_basic_cmd_t;
+
+typedef struct {
+  esp_zb_zcl_basic_cmd_t zcl_basic_cmd;
+  esp_zb_aps_address_mode_t address_mode;
+  uint16_t clusterID;
+  uint16_t attributeID;
+  uint8_t direction;
+  uint8_t dis_defalut_resp;
+  uint16_t manuf_code;
+} esp_zb_zcl_report_attr_cmd_t;
+
+typedef struct {
+  uint8_t type;
+  uint16_t size;
+  void *value;
+} esp_zb_zcl_attribute_data_t;
+
+typedef struct {
+  uint16_t id;
+  esp_zb_zcl_attribute_data_t data;
+} esp_zb_zcl_attribute_t;
+
+typedef struct {
+  esp_zb_zcl_status_t status;
+  uint8_t dst_endpoint;
+  uint16_t cluster;
+} esp_zb_device_cb_common_info_t;
+
+typedef struct {
+  esp_zb_device_cb_common_info_t info;
+  esp_zb_zcl_attribute_t attribute;
+} esp_zb_zcl_set_attr_value_message_t;
+
+typedef union {
+  uint8_t u8;
+  uint16_t u16;
+  uint32_t u32;
+  int16_t s16;
+  uint8_t data_buf[8];
+} esp_zb_zcl_attr_var_t;
+
+typedef struct {
+  uint8_t direction;
+  uint8_t ep;
+  uint16_t cluster_id;
+  uint8_t cluster_role;
+  uint16_t attr_id;
+  uint8_t flags;
+  uint64_t run_time;
+  union {
+    struct {
+      uint16_t min_interval;
+      uint16_t max_interval;
+      esp_zb_zcl_attr_var_t delta;
+      esp_zb_zcl_attr_var_t reported_value;
+      uint16_t def_min_interval;
+      uint16_t def_max_interval;
+    } send_info;
+    struct {
+      uint16_t timeout;
+    } recv_info;
+  } u;
+  struct {
+    uint16_t short_addr;
+    uint8_t endpoint;
+    uint16_t profile_id;
+  } dst;
+  uint16_t manuf_code;
+} esp_zb_zcl_reporting_info_t;
+
+typedef void (*esp_zb_callback_t) (uint8_t param);
+
+// Functions --------------------------------------------------------------------
+bool esp_zb_lock_acquire (TickType_t block_ticks);
+void esp_zb_lock_release (void);
+void esp_zb_scheduler_alarm (esp_zb_callback_t cb, uint8_t param, uint32_t time);
+
+esp_zb_cluster_list_t *esp_zb_zcl_cluster_list_create (void);
+esp_zb_attribute_list_t *esp_zb_zcl_attr_list_create (uint16_t cluster_id);
+esp_zb_attribute_list_t *esp_zb_basic_cluster_create (void *cfg);
+esp_zb_attribute_list_t *esp_zb_identify_cluster_create (void *cfg);
+esp_zb_attribute_list_t *esp_zb_groups_cluster_create (void *cfg);
+esp_zb_attribute_list_t *esp_zb_scenes_cluster_create (void *cfg);
+esp_zb_attribute_list_t *esp_zb_on_off_cluster_create (void *cfg);
+esp_zb_attribute_list_t *esp_zb_diagnostics_cluster_create (void *cfg);
+esp_zb_attribute_list_t *esp_zb_temperature_meas_cluster_create (esp_zb_temperature_meas_cluster_cfg_t *cfg);
+esp_zb_attribute_list_t *esp_zb_metering_cluster_create (esp_zb_metering_cluster_cfg_t *cfg);
+esp_zb_attribute_list_t *esp_zb_thermostat_cluster_create (esp_zb_thermostat_cluster_cfg_t *cfg);
+
+esp_err_t esp_zb_cluster_add_attr (esp_zb_attribute_list_t *attr_list, uint16_t cluster_id, uint16_t attr_id,
+                                   uint8_t attr_type, uint8_t attr_access, void *value_p);
+esp_err_t esp_zb_cluster_add_manufacturer_attr (esp_zb_attribute_list_t *attr_list, uint16_t cluster_id, uint16_t attr_id,
+                                                uint16_t manuf_code, uint8_t attr_type, uint8_t attr_access, void *value_p);
+
+esp_err_t esp_zb_cluster_list_add_basic_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_identify_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_groups_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_scenes_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_on_off_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_diagnostics_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_temperature_meas_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_metering_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_thermostat_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+esp_err_t esp_zb_cluster_list_add_custom_cluster (esp_zb_cluster_list_t *cluster_list, esp_zb_attribute_list_t *attr_list, uint8_t role_mask);
+
+esp_zb_zcl_status_t esp_zb_zcl_set_attribute_val (uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                  uint16_t attr_id, void *value_p, bool check);
+esp_zb_zcl_status_t esp_zb_zcl_set_manufacturer_attribute_val (uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                               uint16_t manuf_code, uint16_t attr_id, void *value_p, bool check);
+esp_zb_zcl_attr_t *esp_zb_zcl_get_attribute (uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role, uint16_t attr_id);
+esp_zb_zcl_attr_t *esp_zb_zcl_get_manufacturer_attribute (uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                          uint16_t attr_id, uint16_t manuf_code);
+
+esp_err_t esp_zb_zcl_report_attr_cmd_req (esp_zb_zcl_report_attr_cmd_t *cmd_req);
+esp_err_t esp_zb_zcl_update_reporting_info (esp_zb_zcl_reporting_info_t *config);
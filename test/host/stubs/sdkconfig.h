@@ -0,0 +1,8 @@
+/// @file sdkconfig.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in of the ESP-IDF configuration.
+#pragma once
+
+#define CONFIG_ZB_ENABLED  1
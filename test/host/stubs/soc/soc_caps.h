@@ -0,0 +1,8 @@
+/// @file soc_caps.h
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Host stand-in, the host has no pulse counter peripheral.
+#pragma once
+
+#define SOC_PCNT_SUPPORTED  0
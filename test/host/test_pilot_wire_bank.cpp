@@ -0,0 +1,108 @@
+/// @file test_pilot_wire_bank.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Clusters of the zones of ZigbeePilotWireBankT: the metering of each zone
+/// with the default instantiation, none with ZigbeePilotWireBankT<false, false>,
+/// the Groups and Scenes clusters only on the zones which enable them, and the
+/// measured power of the zones used by PilotWireLoadManager.
+#include <Zigbee.h>
+#include <ZigbeePilotWireBank.h>
+#include <PilotWireLoadManager.h>
+#include <PilotWireHost.h>
+#include "HostTest.h"
+
+// The endpoints stay registered in the Zigbee core until the end of the program
+static ZigbeePilotWireBank metered (10, 3, NAN, NAN, 1);
+static ZigbeePilotWireBankT<false, false> bare (20, 2);
+static ZigbeePilotWireBank managed (30, 2, NAN, NAN, 1);
+
+static bool
+hasMetering (uint8_t endpoint) {
+
+  return esp_zb_zcl_get_attribute (endpoint, ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                   ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID) != nullptr;
+}
+
+static bool
+hasGroups (uint8_t endpoint) {
+
+  return esp_zb_zcl_get_attribute (endpoint, ESP_ZB_ZCL_CLUSTER_ID_GROUPS, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x0000) != nullptr &&
+         esp_zb_zcl_get_attribute (endpoint, ESP_ZB_ZCL_CLUSTER_ID_SCENES, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x0000) != nullptr;
+}
+
+// ----------------------------------------------------------------------------
+static void
+testMeteredZones() {
+
+  // the Groups and Scenes clusters are opt-in, zone by zone
+  metered[0].enableGroups (true);
+  CHECK (metered.begin());
+  CHECK (metered.addEndpoints());
+  for (uint8_t i = 0; i < metered.count(); i++) {
+
+    CHECK (hasMetering (10 + i));
+    CHECK (hasGroups (10 + i) == (i == 0));
+    CHECK (metered[i].setPowerW (100 * (i + 1)));
+  }
+  for (uint8_t i = 0; i < metered.count(); i++) {
+
+    CHECK_EQ (metered[i].powerW(), 100 * (i + 1));
+  }
+}
+
+// ----------------------------------------------------------------------------
+static void
+testBareZones() {
+
+  CHECK (bare.begin());
+  CHECK (bare.addEndpoints());
+  for (uint8_t i = 0; i < bare.count(); i++) {
+
+    CHECK (hasMetering (20 + i) == false);
+    CHECK (hasGroups (20 + i) == false);
+    CHECK (bare[i].setPowerW (100) == false);
+    CHECK_EQ (bare[i].powerW(), 0);
+  }
+}
+
+// ----------------------------------------------------------------------------
+static void
+testLoadManagerPower() {
+  const uint8_t ieee[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  PilotWireSimBackend sim[2];
+  PilotWireOutput output[2] = { PilotWireOutput (sim[0]), PilotWireOutput (sim[1]) };
+  PilotWireLoadManager loads;
+
+  managed[0].enablePowerBudget (true);
+  CHECK (managed.begin());
+  CHECK (managed.addEndpoints());
+  loads.begin (ieee);
+  loads.setStaggerWindow (0);
+  for (uint8_t i = 0; i < managed.count(); i++) {
+
+    output[i].begin (PILOTWIRE_MODE_OFF);
+    managed[i].setOutput (&output[i]);
+    CHECK_EQ (loads.addZone (managed[i], 2000), i);
+    CHECK (managed[i].setPilotWireMode (PILOTWIRE_MODE_COMFORT));
+    CHECK (managed[i].setPowerW (300));
+  }
+  CHECK (managed[0].setPowerBudget (1000));
+
+  // the measured power of the zones is under the budget, their rated power is not
+  loads.update (1000000);
+  CHECK_EQ (loads.stats().loadW, 600);
+  CHECK_EQ (loads.stats().shedZones, 0);
+  CHECK_EQ (loads.appliedMode (0), PILOTWIRE_MODE_COMFORT);
+  CHECK_EQ (loads.appliedMode (1), PILOTWIRE_MODE_COMFORT);
+}
+
+int
+main() {
+
+  hostNvsErase();
+  RUN_TEST (testMeteredZones);
+  RUN_TEST (testBareZones);
+  RUN_TEST (testLoadManagerPower);
+  return testResult();
+}
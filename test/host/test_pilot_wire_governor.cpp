@@ -0,0 +1,98 @@
+/// @file test_pilot_wire_governor.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Decisions of the reporting governor, taken from the reports of each window
+/// only: the failures and the reports over the budget back off, a window within
+/// the budget and without failure steps back, whatever the reporting table.
+#include <Zigbee.h>
+#include <ZigbeePilotWireControl.h>
+#include <PilotWireHost.h>
+#include "HostTest.h"
+
+// The endpoints stay registered in the Zigbee core until the end of the program
+static ZigbeePilotWireControlT<true, false> governed (50, -10.0f, 40.0f);
+
+static const uint32_t TemperatureBit = PILOTWIRE_ATTR_BIT (PILOTWIRE_ATTR_TEMPERATURE);
+
+// ----------------------------------------------------------------------------
+// sends count reports, then closes the window with one more report,
+// which is the first one of the next window
+static void
+runWindow (uint8_t count) {
+
+  for (uint8_t i = 0; i < count; i++) {
+    governed.reportAttributes (TemperatureBit);
+  }
+  hostAdvanceMs (PILOT_WIRE_GOVERNOR_WINDOW_MS);
+  governed.reportAttributes (TemperatureBit);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testFailedReports() {
+
+  governed.enableReportingGovernor (true);
+  governed.setReportingBudget (4);
+  CHECK (governed.begin (20.0f));
+  CHECK (Zigbee.addEndpoint (&governed));
+
+  // the first report opens the window, 2 of its 3 reports are refused by the stack
+  governed.reportAttributes (TemperatureBit);
+  hostSetLogLevel (ARDUHAL_LOG_LEVEL_NONE);
+  hostFailReports (true);
+  governed.reportAttributes (TemperatureBit);
+  governed.reportAttributes (TemperatureBit);
+  hostFailReports (false);
+  hostSetLogLevel (ARDUHAL_LOG_LEVEL_ERROR);
+  hostAdvanceMs (PILOT_WIRE_GOVERNOR_WINDOW_MS);
+  governed.reportAttributes (TemperatureBit);
+  CHECK_EQ (governed.governorStats().level, 1);
+  CHECK_EQ (governed.governorStats().backoffs, 1);
+  CHECK_EQ (governed.governorStats().airtime, 3);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testRecovery() {
+
+  // one report in the window, within the budget
+  runWindow (0);
+  CHECK_EQ (governed.governorStats().level, 0);
+  CHECK_EQ (governed.governorStats().recoveries, 1);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testBudget() {
+  uint32_t recoveries = governed.governorStats().recoveries;
+
+  // 6 reports in the window, over the budget of 4
+  runWindow (5);
+  CHECK_EQ (governed.governorStats().level, 1);
+  CHECK_EQ (governed.governorStats().airtime, 6);
+
+  // the level only follows the reports of the windows, not the reporting table
+  for (uint8_t level = 1; level < PILOT_WIRE_GOVERNOR_MAX_LEVEL; level++) {
+    runWindow (5);
+  }
+  runWindow (5);
+  CHECK_EQ (governed.governorStats().level, PILOT_WIRE_GOVERNOR_MAX_LEVEL);
+  for (uint8_t level = 0; level < PILOT_WIRE_GOVERNOR_MAX_LEVEL; level++) {
+    runWindow (2);
+  }
+  CHECK_EQ (governed.governorStats().level, 0);
+  CHECK_EQ (governed.governorStats().recoveries, recoveries + PILOT_WIRE_GOVERNOR_MAX_LEVEL);
+}
+
+int
+main() {
+
+  hostNvsErase();
+  // esp_timer never reads 0 on the target, a window opened at 0 would not be seen
+  hostAdvanceMs (1);
+  RUN_TEST (testFailedReports);
+  RUN_TEST (testRecovery);
+  RUN_TEST (testBudget);
+  return testResult();
+}
@@ -0,0 +1,192 @@
+/// @file test_pilot_wire_output.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Waveform of PilotWireOutput driven by PilotWireSimBackend: levels of the
+/// steady modes, timing of the Comfort-1 and Comfort-2 pulses, cycle offset,
+/// mode changes and jitter of the scheduled edges.
+#include <PilotWireOutput.h>
+#include "HostTest.h"
+
+const int64_t Second = 1000000;
+const int64_t Period = static_cast<int64_t> (PILOT_WIRE_CYCLE_PERIOD_MS) * 1000;
+const int64_t Pulse1 = static_cast<int64_t> (PILOT_WIRE_COMFORT_MINUS_1_PULSE_MS) * 1000;
+const int64_t Pulse2 = static_cast<int64_t> (PILOT_WIRE_COMFORT_MINUS_2_PULSE_MS) * 1000;
+
+// true if the full wave is applied, as during a comfort pulse
+static bool
+fullWave (const PilotWireSimBackend &sim) {
+
+  return sim.positive() && sim.negative();
+}
+
+// true if no signal is applied, as in Comfort
+static bool
+noSignal (const PilotWireSimBackend &sim) {
+
+  return !sim.positive() && !sim.negative();
+}
+
+// ----------------------------------------------------------------------------
+static void
+testSteadyModes() {
+  PilotWireSimBackend sim;
+  PilotWireOutput output (sim);
+
+  output.begin (PILOTWIRE_MODE_COMFORT);
+  CHECK (noSignal (sim));
+
+  output.setMode (PILOTWIRE_MODE_ECO);
+  CHECK (fullWave (sim));
+
+  output.setMode (PILOTWIRE_MODE_FROST_PROTECTION);
+  CHECK (!sim.positive() && sim.negative());
+
+  output.setMode (PILOTWIRE_MODE_OFF);
+  CHECK (sim.positive() && !sim.negative());
+  CHECK (output.positive() == sim.positive() && output.negative() == sim.negative());
+
+  // a steady mode schedules no edge
+  uint32_t transitions = sim.transitions();
+  sim.advance (3 * Period);
+  CHECK_EQ (sim.transitions(), transitions);
+  CHECK_EQ (output.jitterStats().count, 0);
+}
+
+// ----------------------------------------------------------------------------
+static void
+checkCycles (ZigbeePilotWireMode mode, int64_t pulse) {
+  PilotWireSimBackend sim;
+  PilotWireOutput output (sim);
+
+  output.begin (mode);
+  for (int cycle = 0; cycle < 4; cycle++) {
+
+    // the cycle starts with the comfort pulse, which ends on time to the microsecond
+    CHECK (fullWave (sim));
+    sim.advance (pulse - 1);
+    CHECK (fullWave (sim));
+    sim.advance (1);
+    CHECK (noSignal (sim));
+
+    // no signal until the next cycle
+    sim.advance (Period - pulse - 1);
+    CHECK (noSignal (sim));
+    sim.advance (1);
+  }
+  CHECK (fullWave (sim));
+
+  // two edges per cycle, all dispatched without delay
+  CHECK_EQ (output.jitterStats().count, 8);
+  CHECK_EQ (output.jitterStats().maxUs, 0);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testComfortCycles() {
+
+  checkCycles (PILOTWIRE_MODE_COMFORT_MINUS_1, Pulse1);
+  checkCycles (PILOTWIRE_MODE_COMFORT_MINUS_2, Pulse2);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testCycleOffset() {
+  PilotWireSimBackend sim;
+  PilotWireOutput output (sim);
+  const int64_t offset = 100 * Second;
+
+  // the offset is modulo the period
+  output.setCycleOffset (PILOT_WIRE_CYCLE_PERIOD_MS + 100000UL);
+  CHECK_EQ (output.cycleOffset(), 100000UL);
+
+  // the output starts 100 s into its cycle, the next pulse is 200 s later
+  output.begin (PILOTWIRE_MODE_COMFORT_MINUS_1);
+  CHECK (noSignal (sim));
+  sim.advance (Period - offset - 1);
+  CHECK (noSignal (sim));
+  sim.advance (1);
+  CHECK (fullWave (sim));
+  sim.advance (Pulse1);
+  CHECK (noSignal (sim));
+}
+
+// ----------------------------------------------------------------------------
+static void
+testModeChange() {
+  PilotWireSimBackend sim;
+  PilotWireOutput output (sim);
+
+  output.begin (PILOTWIRE_MODE_COMFORT_MINUS_1);
+  sim.advance (100 * Second);
+  CHECK (noSignal (sim));
+
+  // a new cycle starts with its comfort pulse
+  output.setMode (PILOTWIRE_MODE_COMFORT_MINUS_2);
+  CHECK (fullWave (sim));
+  sim.advance (Pulse2 - 1);
+  CHECK (fullWave (sim));
+  sim.advance (1);
+  CHECK (noSignal (sim));
+
+  // setting the same mode does not restart the cycle
+  output.setMode (PILOTWIRE_MODE_COMFORT_MINUS_2);
+  CHECK (noSignal (sim));
+
+  // a steady mode cancels the pending edge
+  output.setMode (PILOTWIRE_MODE_FROST_PROTECTION);
+  uint32_t transitions = sim.transitions();
+  sim.advance (2 * Period);
+  CHECK_EQ (sim.transitions(), transitions);
+  CHECK (!sim.positive() && sim.negative());
+
+  // no signal and no edge once stopped
+  output.setMode (PILOTWIRE_MODE_COMFORT_MINUS_1);
+  output.end();
+  CHECK (noSignal (sim));
+  transitions = sim.transitions();
+  sim.advance (2 * Period);
+  CHECK_EQ (sim.transitions(), transitions);
+
+  // the mode is kept, and applied by the next begin()
+  output.setMode (PILOTWIRE_MODE_ECO);
+  CHECK (noSignal (sim));
+  output.begin (output.mode());
+  CHECK (fullWave (sim));
+}
+
+// ----------------------------------------------------------------------------
+static void
+testJitter() {
+  PilotWireSimBackend sim;
+  PilotWireOutput output (sim);
+  const int64_t latency = 250;
+
+  output.begin (PILOTWIRE_MODE_COMFORT_MINUS_1);
+  sim.advance (3 * Period + latency, latency);
+
+  // each edge is late, the cycle does not drift: the pulses start on the period
+  PilotWireJitterStats stats = output.jitterStats();
+  CHECK_EQ (stats.count, 6);
+  CHECK_EQ (stats.minUs, latency);
+  CHECK_EQ (stats.maxUs, latency);
+  CHECK_EQ (stats.avgUs, latency);
+  CHECK (fullWave (sim));
+  sim.advance (Pulse1);
+  CHECK (noSignal (sim));
+
+  output.resetJitterStats();
+  CHECK_EQ (output.jitterStats().count, 0);
+  CHECK_EQ (output.jitterStats().avgUs, 0);
+}
+
+int
+main() {
+
+  RUN_TEST (testSteadyModes);
+  RUN_TEST (testComfortCycles);
+  RUN_TEST (testCycleOffset);
+  RUN_TEST (testModeChange);
+  RUN_TEST (testJitter);
+  return testResult();
+}
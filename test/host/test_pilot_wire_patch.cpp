@@ -0,0 +1,458 @@
+/// @file test_pilot_wire_patch.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// PilotWirePatcher on images in memory: round trips pushed in chunks of any
+/// size, then corrupt and truncated patch streams, which must never commit
+/// the target, and a patch written in blocks to the delta attributes of an
+/// endpoint.
+#include <Zigbee.h>
+#include <ZigbeePilotWireControl.h>
+#include <PilotWireHost.h>
+#include <string.h>
+#include <vector>
+#include "HostTest.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// Source image in memory, the reads can be made to fail
+class MemorySource : public PilotWirePatchSource {
+  public:
+    explicit MemorySource (const Bytes &image) : image (image), failRead (false) {}
+
+    bool begin() override {
+      return true;
+    }
+
+    uint32_t size() override {
+      return image.size();
+    }
+
+    bool read (uint32_t offset, uint8_t *data, size_t len) override {
+      if (failRead || offset + len > image.size()) {
+        return false;
+      }
+      memcpy (data, &image[offset], len);
+      return true;
+    }
+
+    Bytes image;
+    bool failRead;
+};
+
+// Target image in memory, records how it was closed
+class MemoryTarget : public PilotWirePatchTarget {
+  public:
+    MemoryTarget() : size (0), finished (false), aborted (false), failWrite (false) {}
+
+    bool begin (uint32_t size) override {
+      this->size = size;
+      image.clear();
+      finished = aborted = false;
+      return true;
+    }
+
+    bool write (const uint8_t *data, size_t len) override {
+      if (failWrite) {
+        return false;
+      }
+      image.insert (image.end(), data, data + len);
+      return true;
+    }
+
+    bool finish() override {
+      finished = true;
+      return true;
+    }
+
+    void abort() override {
+      aborted = true;
+    }
+
+    Bytes image;
+    uint32_t size;
+    bool finished;
+    bool aborted;
+    bool failWrite;
+};
+
+// Builds a patch as extras/tools/pilot_wire_delta.py
+class PatchBuilder {
+  public:
+    PatchBuilder() : _copy_end (0) {}
+
+    PatchBuilder &copy (uint32_t offset, uint32_t length) {
+      int32_t delta = static_cast<int32_t> (offset - _copy_end);
+
+      _ops.push_back (0x01);
+      varint ( (static_cast<uint32_t> (delta) << 1) ^ static_cast<uint32_t> (delta >> 31));
+      varint (length);
+      _copy_end = offset + length;
+      return *this;
+    }
+
+    PatchBuilder &add (const Bytes &literal) {
+      _ops.push_back (0x02);
+      varint (literal.size());
+      _ops.insert (_ops.end(), literal.begin(), literal.end());
+      return *this;
+    }
+
+    PatchBuilder &fill (uint32_t length, uint32_t value) {
+      _ops.push_back (0x03);
+      varint (length);
+      varint (value);
+      return *this;
+    }
+
+    PatchBuilder &raw (uint8_t byte) {
+      _ops.push_back (byte);
+      return *this;
+    }
+
+    // the header and the operations, terminated by End
+    Bytes build (const Bytes &source, const Bytes &target) const {
+      Bytes patch = { 'P', 'W', 'D', '1' };
+
+      putU32 (patch, source.size());
+      putU32 (patch, source.empty() ? 0 : PilotWirePatcher::crc32 (0, source.data(), source.size()));
+      putU32 (patch, target.size());
+      putU32 (patch, PilotWirePatcher::crc32 (0, target.data(), target.size()));
+      patch.insert (patch.end(), _ops.begin(), _ops.end());
+      patch.push_back (0x00);
+      return patch;
+    }
+
+  private:
+    void varint (uint32_t value) {
+      while (value >= 0x80) {
+        _ops.push_back ( (value & 0x7F) | 0x80);
+        value >>= 7;
+      }
+      _ops.push_back (value);
+    }
+
+    static void putU32 (Bytes &out, uint32_t value) {
+      for (int i = 0; i < 4; i++) {
+        out.push_back (value >> (8 * i));
+      }
+    }
+
+    Bytes _ops;
+    uint32_t _copy_end;
+};
+
+// Pushes a patch in chunks, returns false at the first failed write
+static bool
+push (PilotWirePatcher &patcher, const Bytes &patch, size_t chunk, size_t len = SIZE_MAX) {
+
+  if (len > patch.size()) {
+    len = patch.size();
+  }
+  for (size_t i = 0; i < len; i += chunk) {
+
+    if (patcher.write (&patch[i], (chunk < len - i) ? chunk : len - i) == false) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Source of the tests: code-like bytes and erased flash
+static Bytes
+sourceImage() {
+  Bytes image (2000);
+
+  for (size_t i = 0; i < image.size(); i++) {
+    image[i] = (i < 1500) ? static_cast<uint8_t> (i * 7 + (i >> 5)) : 0xFF;
+  }
+  return image;
+}
+
+// Target of the tests: a block inserted, a block moved backward, a run of zeros
+static void
+targetImage (const Bytes &source, Bytes &target, PatchBuilder &builder) {
+  Bytes literal = { 0xDE, 0xAD, 0xBE, 0xEF, 0x01 };
+
+  target.assign (source.begin(), source.begin() + 600);
+  target.insert (target.end(), literal.begin(), literal.end());
+  target.insert (target.end(), source.begin() + 600, source.begin() + 1500);
+  target.insert (target.end(), source.begin() + 100, source.begin() + 400);
+  target.insert (target.end(), 700, 0x00);
+  builder.copy (0, 600).add (literal).copy (600, 900).copy (100, 300).fill (700, 0x00);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testCrc() {
+  const uint8_t check[] = "123456789";
+
+  // the check value of the CRC-32 of zlib, also computed in two parts
+  CHECK_EQ (PilotWirePatcher::crc32 (0, check, 9), 0xCBF43926UL);
+  CHECK_EQ (PilotWirePatcher::crc32 (PilotWirePatcher::crc32 (0, check, 4), check + 4, 5), 0xCBF43926UL);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testRoundTrip() {
+  const size_t chunks[] = { 1, 7, 20, 64, 4096 };
+  MemorySource source (sourceImage());
+  Bytes image;
+  PatchBuilder builder;
+
+  targetImage (source.image, image, builder);
+  Bytes patch = builder.build (source.image, image);
+  CHECK (patch.size() < image.size() / 50);
+
+  for (size_t chunk : chunks) {
+    MemoryTarget target;
+    PilotWirePatcher patcher (source, target);
+
+    CHECK (push (patcher, patch, chunk));
+    CHECK (patcher.finished());
+    CHECK_EQ (patcher.error(), PilotWirePatcher::None);
+    CHECK_EQ (patcher.written(), image.size());
+    CHECK_EQ (patcher.targetSize(), image.size());
+    CHECK (target.finished && !target.aborted);
+    CHECK (target.image == image);
+
+    // the padding of the last OTA block is ignored
+    const uint8_t padding[8] = {};
+    CHECK (patcher.write (padding, sizeof (padding)));
+    CHECK (patcher.finished());
+  }
+}
+
+// ----------------------------------------------------------------------------
+static void
+testWithoutSource() {
+  MemorySource source (Bytes {});
+  MemoryTarget target;
+  PilotWirePatcher patcher (source, target);
+  Bytes image (1000, 0xFF);
+  Bytes literal = { 1, 2, 3 };
+
+  // a run-length compressed full image
+  image.insert (image.begin(), literal.begin(), literal.end());
+  Bytes patch = PatchBuilder().add (literal).fill (1000, 0xFF).build (Bytes {}, image);
+
+  CHECK (push (patcher, patch, 16));
+  CHECK (patcher.finished());
+  CHECK (target.image == image);
+}
+
+// Applies a bad patch, the target must be dropped and never committed
+static void
+checkRejected (MemorySource &source, const Bytes &patch, PilotWirePatcher::Error error) {
+  MemoryTarget target;
+  PilotWirePatcher patcher (source, target);
+
+  CHECK (push (patcher, patch, 13) == false);
+  CHECK_EQ (patcher.error(), error);
+  CHECK (!patcher.finished());
+  CHECK (!target.finished);
+
+  // the failure is final
+  CHECK (patcher.write (patch.data(), 1) == false);
+
+  // begin() restarts a patch
+  patcher.begin();
+  CHECK_EQ (patcher.error(), PilotWirePatcher::None);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testCorrupt() {
+  MemorySource source (sourceImage());
+  Bytes image;
+  PatchBuilder builder;
+
+  targetImage (source.image, image, builder);
+  Bytes good = builder.build (source.image, image);
+  Bytes patch;
+
+  patch = good;
+  patch[3] = '2';
+  checkRejected (source, patch, PilotWirePatcher::BadHeader);
+
+  // another firmware
+  patch = good;
+  patch[8] ^= 0x01;
+  checkRejected (source, patch, PilotWirePatcher::SourceMismatch);
+  MemorySource shorter (Bytes (source.image.begin(), source.image.end() - 1));
+  checkRejected (shorter, good, PilotWirePatcher::SourceMismatch);
+
+  // a bit flipped in the target CRC, or in a literal
+  patch = good;
+  patch[16] ^= 0x80;
+  checkRejected (source, patch, PilotWirePatcher::TargetMismatch);
+  patch = good;
+  for (size_t i = PilotWirePatcher::HeaderSize; i + 4 < patch.size(); i++) {
+
+    if (patch[i] == 0xDE && patch[i + 1] == 0xAD) {
+      patch[i + 2] ^= 0x10;
+      break;
+    }
+  }
+  checkRejected (source, patch, PilotWirePatcher::TargetMismatch);
+
+  // unknown opcode
+  checkRejected (source, PatchBuilder().copy (0, 10).raw (0x07).build (source.image, image), PilotWirePatcher::Corrupt);
+
+  // copy out of the source
+  checkRejected (source, PatchBuilder().copy (1990, 11).build (source.image, image), PilotWirePatcher::Corrupt);
+  checkRejected (source, PatchBuilder().copy (0, 10).copy (0xFFFFFFF0UL, 10).build (source.image, image),
+                 PilotWirePatcher::Corrupt);
+
+  // more bytes than the target
+  checkRejected (source, PatchBuilder().fill (image.size() + 1, 0).build (source.image, image), PilotWirePatcher::Corrupt);
+  checkRejected (source, PatchBuilder().add (Bytes (10)).build (source.image, Bytes (9)), PilotWirePatcher::Corrupt);
+
+  // fill value out of a byte, varint longer than 32 bits
+  checkRejected (source, PatchBuilder().fill (10, 0x100).build (source.image, image), PilotWirePatcher::Corrupt);
+  checkRejected (source, PatchBuilder().raw (0x03).raw (0x80).raw (0x80).raw (0x80).raw (0x80).raw (0x80).raw (0x01)
+                 .build (source.image, image), PilotWirePatcher::Corrupt);
+
+  // End before the whole target
+  checkRejected (source, PatchBuilder().copy (0, 600).build (source.image, image), PilotWirePatcher::TargetMismatch);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testTruncated() {
+  MemorySource source (sourceImage());
+  Bytes image;
+  PatchBuilder builder;
+
+  targetImage (source.image, image, builder);
+  Bytes patch = builder.build (source.image, image);
+
+  // every prefix of the patch, cut in the header, an opcode, a varint or a literal
+  for (size_t len = 0; len < patch.size(); len++) {
+    MemoryTarget target;
+    PilotWirePatcher patcher (source, target);
+
+    CHECK (push (patcher, patch, 5, len));
+    CHECK (!patcher.finished());
+    CHECK_EQ (patcher.error(), PilotWirePatcher::None);
+    CHECK (!target.finished);
+
+    // the incomplete target is dropped when the next patch starts
+    patcher.begin();
+    CHECK (target.aborted == (len >= PilotWirePatcher::HeaderSize));
+  }
+}
+
+// ----------------------------------------------------------------------------
+static void
+testIoErrors() {
+  MemorySource source (sourceImage());
+  Bytes image;
+  PatchBuilder builder;
+
+  targetImage (source.image, image, builder);
+  Bytes patch = builder.build (source.image, image);
+
+  source.failRead = true;
+  checkRejected (source, patch, PilotWirePatcher::ReadError);
+  source.failRead = false;
+
+  MemoryTarget target;
+  PilotWirePatcher patcher (source, target);
+  target.failWrite = true;
+  CHECK (push (patcher, patch, 64) == false);
+  CHECK_EQ (patcher.error(), PilotWirePatcher::WriteError);
+  CHECK (target.aborted && !target.finished);
+}
+
+// ----------------------------------------------------------------------------
+// writes a delta block as the OTA server, in the Zigbee stack task
+static void
+writeBlock (const Bytes &patch, uint32_t offset, size_t len) {
+  uint8_t value[1 + 4 + PILOT_WIRE_DELTA_BLOCK];
+
+  value[0] = 4 + len;
+  for (int i = 0; i < 4; i++) {
+    value[1 + i] = offset >> (8 * i);
+  }
+  memcpy (&value[5], &patch[offset], len);
+  hostStackWrite (70, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_DELTA_BLOCK_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+                  value, sizeof (value));
+}
+
+// ----------------------------------------------------------------------------
+// the offset of the next block, as read by the OTA server
+static uint32_t
+deltaOffset() {
+  esp_zb_zcl_attr_t *attr = esp_zb_zcl_get_manufacturer_attribute (70, PILOT_WIRE_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                            PILOT_WIRE_DELTA_OFFSET_ATTR_ID, PILOT_WIRE_MANUF_CODE);
+
+  return (attr != nullptr) ? *static_cast<uint32_t *> (attr->data_p) : UINT32_MAX;
+}
+
+// ----------------------------------------------------------------------------
+static void
+testDeltaAttributes() {
+  static ZigbeePilotWireControlT<false, false> ep (70);
+  const size_t block = 16; // the patch takes several blocks
+  MemorySource source (sourceImage());
+  MemoryTarget target;
+  PilotWirePatcher patcher (source, target);
+  Bytes image;
+  PatchBuilder builder;
+
+  targetImage (source.image, image, builder);
+  Bytes patch = builder.build (source.image, image);
+
+  ep.enableDeltaOta (&patcher);
+  CHECK (ep.begin());
+  CHECK (Zigbee.addEndpoint (&ep));
+  CHECK_EQ (deltaOffset(), 0);
+
+  // the server sends the next block when the offset moved, a repeated block is ignored
+  writeBlock (patch, 0, block);
+  CHECK (ep.updateDeltaOta());
+  CHECK_EQ (deltaOffset(), block);
+  writeBlock (patch, block + 1, 1);
+  CHECK (ep.updateDeltaOta());
+  CHECK_EQ (deltaOffset(), block);
+  while (deltaOffset() < patch.size()) {
+    uint32_t offset = deltaOffset();
+    size_t len = patch.size() - offset;
+
+    writeBlock (patch, offset, (len < block) ? len : block);
+    CHECK (ep.updateDeltaOta());
+    if (deltaOffset() == offset) {
+      break;
+    }
+  }
+  CHECK_EQ (deltaOffset(), patch.size());
+  CHECK_EQ (ep.deltaOtaStatus(), PILOT_WIRE_DELTA_DONE);
+  CHECK (target.finished);
+  CHECK (target.image == image);
+
+  // a block at offset 0 starts again, a corrupt patch is reported
+  Bytes corrupt = patch;
+  corrupt[0] = 'X';
+  writeBlock (corrupt, 0, block);
+  CHECK (ep.updateDeltaOta());
+  CHECK_EQ (ep.deltaOtaStatus(), 0);
+  writeBlock (corrupt, block, block);
+  hostSetLogLevel (ARDUHAL_LOG_LEVEL_NONE);
+  CHECK (ep.updateDeltaOta() == false);
+  hostSetLogLevel (ARDUHAL_LOG_LEVEL_ERROR);
+  CHECK_EQ (ep.deltaOtaStatus(), PilotWirePatcher::BadHeader);
+}
+
+int
+main() {
+
+  RUN_TEST (testCrc);
+  RUN_TEST (testRoundTrip);
+  RUN_TEST (testWithoutSource);
+  RUN_TEST (testCorrupt);
+  RUN_TEST (testTruncated);
+  RUN_TEST (testIoErrors);
+  RUN_TEST (testDeltaAttributes);
+  return testResult();
+}
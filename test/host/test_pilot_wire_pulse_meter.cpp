@@ -0,0 +1,187 @@
+/// @file test_pilot_wire_pulse_meter.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Conversion of the pulses of PilotWireSimPulseSource to power and energy by
+/// PilotWirePulseMeter, alone and attached to the metering cluster of a
+/// ZigbeePilotWireControl.
+#include <Zigbee.h>
+#include <ZigbeePilotWireControl.h>
+#include <PilotWireHost.h>
+#include "HostTest.h"
+
+const int64_t Second = 1000000;
+const int64_t Hour = 3600 * Second;
+const float WsPerPulse = 1.2f; // 1 kHz at 1200 W
+
+// ----------------------------------------------------------------------------
+static void
+testWindow() {
+  PilotWireSimPulseSource source;
+  PilotWirePulseMeter meter (source, WsPerPulse);
+
+  CHECK (meter.begin());
+  source.setFrequency (1000.0f);
+
+  // no power before the window is elapsed
+  source.advance (PILOT_WIRE_PULSE_WINDOW_MS * 1000 - 1);
+  CHECK (meter.update() == false);
+  CHECK_EQ (meter.powerW(), 0);
+
+  source.advance (1);
+  CHECK (meter.update());
+  CHECK_EQ (meter.powerW(), 1200);
+  CHECK_EQ (meter.pulses(), PILOT_WIRE_PULSE_WINDOW_MS);
+
+  // a shorter window
+  meter.setWindow (1000);
+  source.setFrequency (250.0f);
+  source.advance (Second);
+  CHECK (meter.update());
+  CHECK_EQ (meter.powerW(), 300);
+
+  // no pulse, no power
+  source.setFrequency (0);
+  source.advance (Second);
+  CHECK (meter.update());
+  CHECK_EQ (meter.powerW(), 0);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testEnergy() {
+  PilotWireSimPulseSource source;
+  PilotWirePulseMeter meter (source, WsPerPulse);
+  uint32_t wh = 0;
+
+  meter.begin();
+  source.setFrequency (1000.0f);
+  for (int64_t t = 0; t < Hour; t += 10 * Second) {
+
+    source.advance (10 * Second);
+    meter.update();
+    wh += meter.takeEnergyWh();
+  }
+  CHECK_EQ (wh, 1200);
+  CHECK_EQ (meter.takeEnergyWh(), 0);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testLowPower() {
+  PilotWireSimPulseSource source;
+  PilotWirePulseMeter meter (source, WsPerPulse);
+  uint32_t wh = 0;
+
+  // 3.7 W: each window holds a fraction of Wh, kept in the residual
+  meter.begin();
+  source.setFrequency (3.7f / WsPerPulse);
+  for (int i = 0; i < 10 * 360; i++) {
+
+    source.advance (10 * Second);
+    CHECK (meter.update());
+    wh += meter.takeEnergyWh();
+  }
+  CHECK (meter.powerW() >= 3 && meter.powerW() <= 4);
+
+  // no pulse lost in the rounding to Wh
+  uint64_t mws = static_cast<uint64_t> (meter.pulses()) * 1200;
+  CHECK_EQ (wh, mws / 3600000);
+  CHECK (wh >= 36 && wh <= 37);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testWrapAround() {
+  PilotWireSimPulseSource source;
+  PilotWirePulseMeter meter (source, WsPerPulse);
+
+  // the counter wraps around during the window
+  source.inject (0xFFFFFFFFUL - 5000);
+  meter.begin();
+  source.setFrequency (1000.0f);
+  source.advance (10 * Second);
+  CHECK (source.count() < 10000);
+  CHECK (meter.update());
+  CHECK_EQ (meter.powerW(), 1200);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testCalibration() {
+  PilotWireSimPulseSource source;
+  PilotWirePulseMeter meter (source, WsPerPulse);
+
+  meter.setCalibration (0.5f);
+  CHECK (meter.calibration() == 0.5f);
+
+  // a burst of pulses without time: counted at the next window
+  meter.begin();
+  source.inject (7200);
+  source.advance (10 * Second);
+  CHECK (meter.update());
+  CHECK_EQ (meter.powerW(), 360);
+  CHECK_EQ (meter.takeEnergyWh(), 1);
+
+  meter.setCalibration (-1.0f);
+  CHECK (meter.calibration() == 0.0f);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testMeteringCluster() {
+  ZigbeePilotWireControl zbPilot (2, -10.0f, 80.0f, 1);
+  PilotWireSimPulseSource source;
+  PilotWirePulseMeter meter (source, WsPerPulse);
+
+  hostNvsErase();
+  zbPilot.begin (20.0f, 0);
+  Zigbee.addEndpoint (&zbPilot);
+  CHECK (zbPilot.attachPulseMeter (&meter));
+  uint64_t start = zbPilot.energyWh();
+
+  source.setFrequency (1000.0f);
+  for (int64_t t = 0; t < Hour; t += Second) {
+
+    source.advance (Second);
+    CHECK (zbPilot.updatePulseMeter());
+  }
+  CHECK_EQ (zbPilot.powerW(), 1200);
+  CHECK_EQ (zbPilot.energyWh() - start, 1200);
+
+  // the attributes of the stack are up to date
+  esp_zb_zcl_attr_t *attr = esp_zb_zcl_get_attribute (2, ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                            ESP_ZB_ZCL_ATTR_METERING_CURRENT_SUMMATION_DELIVERED_ID);
+  CHECK (attr != nullptr);
+  if (attr != nullptr) {
+    const esp_zb_uint48_t *value = static_cast<const esp_zb_uint48_t *> (attr->data_p);
+
+    CHECK_EQ (value->low + (static_cast<uint64_t> (value->high) << 32), zbPilot.energyWh());
+  }
+  attr = esp_zb_zcl_get_attribute (2, ESP_ZB_ZCL_CLUSTER_ID_METERING, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                   ESP_ZB_ZCL_ATTR_METERING_INSTANTANEOUS_DEMAND_ID);
+  CHECK (attr != nullptr);
+  if (attr != nullptr) {
+    const esp_zb_int24_t *value = static_cast<const esp_zb_int24_t *> (attr->data_p);
+
+    CHECK_EQ (value->low + (static_cast<int32_t> (value->high) << 16), 1200);
+  }
+
+  // detached, the summation no longer moves
+  CHECK (zbPilot.attachPulseMeter (nullptr));
+  source.advance (Hour);
+  CHECK (zbPilot.updatePulseMeter());
+  CHECK_EQ (zbPilot.energyWh() - start, 1200);
+}
+
+int
+main() {
+
+  RUN_TEST (testWindow);
+  RUN_TEST (testEnergy);
+  RUN_TEST (testLowPower);
+  RUN_TEST (testWrapAround);
+  RUN_TEST (testCalibration);
+  RUN_TEST (testMeteringCluster);
+  return testResult();
+}
@@ -0,0 +1,60 @@
+/// @file test_pilot_wire_reporting.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Application of the reporting table to the stack: a profile set while the
+/// stack runs is applied at once, the table restored by begin() is applied in
+/// one batch by the first reportAttributes().
+#include <Zigbee.h>
+#include <ZigbeePilotWireControl.h>
+#include <PilotWireHost.h>
+#include "HostTest.h"
+
+// ----------------------------------------------------------------------------
+static void
+testImmediate() {
+  ZigbeePilotWireControlT<true, false> *ep = new ZigbeePilotWireControlT<true, false> (60, -10.0f, 40.0f);
+  uint32_t updates;
+
+  CHECK (ep->begin (20.0f));
+  CHECK (Zigbee.addEndpoint (ep));
+  updates = hostReportingUpdates();
+
+  // no report is needed, the stack has the configuration when the method returns
+  CHECK (ep->setReportingProfile (PILOTWIRE_ATTR_TEMPERATURE, 10, 300, 20));
+  CHECK_EQ (hostReportingUpdates(), updates + 1);
+  CHECK (ep->setTemperatureReporting (30, 600, 0.5f));
+  CHECK_EQ (hostReportingUpdates(), updates + 2);
+  delete ep;
+}
+
+// ----------------------------------------------------------------------------
+static void
+testRestored() {
+  ZigbeePilotWireControlT<true, false> *ep = new ZigbeePilotWireControlT<true, false> (60, -10.0f, 40.0f);
+  ZigbeePilotWireReportingProfile profile;
+  uint32_t updates = hostReportingUpdates();
+
+  // the table saved by testImmediate() waits for the first report
+  CHECK (ep->begin (20.0f));
+  CHECK (Zigbee.addEndpoint (ep));
+  CHECK (ep->reportingProfile (PILOTWIRE_ATTR_TEMPERATURE, profile));
+  CHECK_EQ (profile.minInterval, 30);
+  CHECK_EQ (profile.maxInterval, 600);
+  CHECK_EQ (hostReportingUpdates(), updates);
+
+  CHECK (ep->reportAttributes());
+  CHECK_EQ (hostReportingUpdates(), updates + 1);
+  CHECK (ep->reportAttributes());
+  CHECK_EQ (hostReportingUpdates(), updates + 1);
+  delete ep;
+}
+
+int
+main() {
+
+  hostNvsErase();
+  RUN_TEST (testImmediate);
+  RUN_TEST (testRestored);
+  return testResult();
+}
@@ -0,0 +1,263 @@
+/// @file test_pilot_wire_store.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Write-behind of PilotWireStore against the Preferences stand-in: changes
+/// coalesced until the commit timer fires, explicit and shutdown commits,
+/// retry after a failed write, and concurrent commits that must leave the
+/// newest records in NVS.
+#include <PilotWireStore.h>
+#include <PilotWireHost.h>
+#include <esp32-hal-log.h>
+#include <thread>
+#include "HostTest.h"
+
+typedef PilotWireStore::Record Record;
+
+// Reads the records stored in NVS, returns their number
+static int
+storedRecords (const char *name, Record *records) {
+  Preferences prefs;
+  int count = 0;
+
+  if (prefs.begin (name, true)) {
+    size_t len = prefs.getBytesLength ("state");
+
+    if (len != 0 && len % sizeof (Record) == 0 && len <= PILOT_WIRE_STORE_MAX_SLOTS * sizeof (Record) &&
+        prefs.getBytes ("state", records, len) == len) {
+      count = len / sizeof (Record);
+    }
+    prefs.end();
+  }
+  return count;
+}
+
+// Record of a slot stored in NVS, zero if there is none
+static Record
+storedRecord (const char *name, int slot) {
+  Record records[PILOT_WIRE_STORE_MAX_SLOTS] = {};
+
+  return (slot < storedRecords (name, records)) ? records[slot] : Record {};
+}
+
+// ----------------------------------------------------------------------------
+static void
+testCoalescing() {
+  PilotWireStore *store = PilotWireStore::acquire ("coalesce");
+
+  CHECK (store != nullptr);
+  int slot = store->attach (1);
+  CHECK_EQ (slot, 0);
+  CHECK (store->commit());
+
+  // ten mode changes within the delay cost one write, when the timer fires
+  uint32_t writes = hostNvsWrites();
+  uint32_t coalesced = store->coalescedCount();
+  for (int i = 0; i < 10; i++) {
+
+    store->setMode (slot, 1 + (i % 5));
+    hostAdvanceMs (100);
+  }
+  CHECK_EQ (hostNvsWrites(), writes);
+  CHECK_EQ (store->dirty(), PilotWireStore::DirtyMode);
+  CHECK_EQ (store->coalescedCount() - coalesced, 9);
+
+  hostAdvanceMs (PILOT_WIRE_NVS_MODE_DELAY_MS - 1000);
+  CHECK_EQ (hostNvsWrites(), writes + 1);
+  CHECK_EQ (store->dirty(), 0);
+  CHECK_EQ (storedRecord ("coalesce", slot).mode, store->mode (slot));
+  CHECK_EQ (storedRecord ("coalesce", slot).endpoint, 1);
+
+  // the summation waits longer, unless a mode change needs an earlier commit
+  store->setSummation (slot, 1234);
+  hostAdvanceMs (PILOT_WIRE_NVS_MODE_DELAY_MS);
+  CHECK_EQ (hostNvsWrites(), writes + 1);
+  store->setRestore (slot, true);
+  hostAdvanceMs (PILOT_WIRE_NVS_MODE_DELAY_MS);
+  CHECK_EQ (hostNvsWrites(), writes + 2);
+  CHECK_EQ (storedRecord ("coalesce", slot).summation, 1234);
+  CHECK_EQ (storedRecord ("coalesce", slot).flags, 0x01);
+
+  // the pending summation is committed after its own delay
+  store->setSummation (slot, 1300);
+  hostAdvanceMs (PILOT_WIRE_NVS_SUMMATION_DELAY_MS - 1);
+  CHECK_EQ (hostNvsWrites(), writes + 2);
+  hostAdvanceMs (1);
+  CHECK_EQ (hostNvsWrites(), writes + 3);
+  CHECK_EQ (storedRecord ("coalesce", slot).summation, 1300);
+
+  // an unchanged value is not written
+  store->setSummation (slot, 1300);
+  CHECK_EQ (store->dirty(), 0);
+  PilotWireStore::release (store);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testWriteThrough() {
+  PilotWireStore *store = PilotWireStore::acquire ("through");
+  int slot = store->attach (1);
+
+  store->setCommitDelay (0, 0);
+  uint32_t writes = hostNvsWrites();
+  uint32_t commits = store->commitCount();
+  store->setMode (slot, 2);
+  store->setSummation (slot, 10);
+  store->setSummation (slot, 11);
+  CHECK_EQ (hostNvsWrites() - writes, 3);
+  CHECK_EQ (store->commitCount() - commits, 3);
+  CHECK_EQ (store->dirty(), 0);
+  CHECK_EQ (storedRecord ("through", slot).summation, 11);
+  PilotWireStore::release (store);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testExplicitCommit() {
+  PilotWireStore *store = PilotWireStore::acquire ("explicit");
+  int slot = store->attach (1);
+
+  store->commit();
+  store->setMode (slot, 3);
+  uint32_t writes = hostNvsWrites();
+  CHECK (store->commit());
+  CHECK_EQ (hostNvsWrites(), writes + 1);
+  CHECK_EQ (storedRecord ("explicit", slot).mode, 3);
+
+  // nothing left for the timer, nor for a second commit
+  hostAdvanceMs (PILOT_WIRE_NVS_MODE_DELAY_MS);
+  CHECK (store->commit());
+  CHECK_EQ (hostNvsWrites(), writes + 1);
+  PilotWireStore::release (store);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testSharedStore() {
+  PilotWireStore *first = PilotWireStore::acquire ("shared");
+  PilotWireStore *second = PilotWireStore::acquire ("shared");
+
+  // one store, one record per endpoint, written together
+  CHECK (first == second);
+  int slot1 = first->attach (1);
+  int slot2 = second->attach (2);
+  CHECK (slot1 != slot2);
+  CHECK_EQ (first->attach (1), slot1);
+  first->setMode (slot1, 4);
+  second->setMode (slot2, 5);
+  PilotWireStore::release (second);
+
+  // released by its last user, the store is committed
+  uint32_t writes = hostNvsWrites();
+  PilotWireStore::release (first);
+  CHECK_EQ (hostNvsWrites(), writes + 1);
+  CHECK_EQ (storedRecord ("shared", slot1).mode, 4);
+  CHECK_EQ (storedRecord ("shared", slot2).mode, 5);
+
+  // reopened, the records are restored
+  PilotWireStore *store = PilotWireStore::acquire ("shared");
+  CHECK_EQ (store->mode (store->attach (2)), 5);
+  CHECK_EQ (store->mode (store->attach (1)), 4);
+  PilotWireStore::release (store);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testShutdown() {
+  PilotWireStore *store = PilotWireStore::acquire ("shutdown");
+  int slot = store->attach (1);
+
+  store->setSummation (slot, 99999);
+  CHECK (storedRecord ("shutdown", slot).summation != 99999);
+
+  // esp_restart() runs the shutdown handler
+  hostShutdown();
+  CHECK_EQ (store->dirty(), 0);
+  CHECK_EQ (storedRecord ("shutdown", slot).summation, 99999);
+  PilotWireStore::release (store);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testRetry() {
+  PilotWireStore *store = PilotWireStore::acquire ("retry");
+  int slot = store->attach (1);
+
+  store->commit();
+  uint32_t commits = store->commitCount();
+
+  // a failed write keeps the records dirty
+  hostSetLogLevel (ARDUHAL_LOG_LEVEL_NONE);
+  hostNvsFailWrites (true);
+  store->setMode (slot, 2);
+  hostAdvanceMs (PILOT_WIRE_NVS_MODE_DELAY_MS);
+  CHECK (store->dirty() != 0);
+  CHECK (store->commit() == false);
+  CHECK_EQ (store->commitCount(), commits);
+  CHECK (storedRecord ("retry", slot).mode != 2);
+
+  // and the next commit writes them
+  hostNvsFailWrites (false);
+  hostSetLogLevel (ARDUHAL_LOG_LEVEL_ERROR);
+  CHECK (store->commit());
+  CHECK_EQ (store->dirty(), 0);
+  CHECK_EQ (store->commitCount(), commits + 1);
+  CHECK_EQ (storedRecord ("retry", slot).mode, 2);
+  PilotWireStore::release (store);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testConcurrentCommits() {
+  PilotWireStore *store = PilotWireStore::acquire ("race");
+  int slot1 = store->attach (1);
+  int slot2 = store->attach (2);
+  const int Updates = 100;
+
+  store->commit();
+  store->setCommitDelay (0, 0);
+
+  // two tasks commit their own slot, each write takes long enough to overlap
+  hostNvsSetWriteDuration (200);
+  uint32_t writes = hostNvsWrites();
+  uint32_t commits = store->commitCount();
+  uint32_t bytes = store->bytesWritten();
+  std::thread task1 ([store, slot1]() {
+    for (int i = 1; i <= Updates; i++) {
+      store->setSummation (slot1, i);
+    }
+  });
+  std::thread task2 ([store, slot2]() {
+    for (int i = 1; i <= Updates; i++) {
+      store->setSummation (slot2, 1000 + i);
+      store->commit();
+    }
+  });
+  task1.join();
+  task2.join();
+  hostNvsSetWriteDuration (0);
+
+  // the last write holds the newest value of both slots
+  CHECK_EQ (store->dirty(), 0);
+  CHECK_EQ (storedRecord ("race", slot1).summation, Updates);
+  CHECK_EQ (storedRecord ("race", slot2).summation, 1000 + Updates);
+
+  // the counters are those of the writes
+  CHECK_EQ (store->commitCount() - commits, hostNvsWrites() - writes);
+  CHECK_EQ (store->bytesWritten() - bytes, (hostNvsWrites() - writes) * 2 * sizeof (Record));
+  PilotWireStore::release (store);
+}
+
+int
+main() {
+
+  hostNvsErase();
+  RUN_TEST (testCoalescing);
+  RUN_TEST (testWriteThrough);
+  RUN_TEST (testExplicitCommit);
+  RUN_TEST (testSharedStore);
+  RUN_TEST (testShutdown);
+  RUN_TEST (testRetry);
+  RUN_TEST (testConcurrentCommits);
+  return testResult();
+}
@@ -0,0 +1,169 @@
+/// @file test_pilot_wire_tasks.cpp
+/// SPDX-License-Identifier: BSD-3-Clause
+/// SPDX-FileCopyrightText: 2025 Pascal JEAN aka epsilonrt
+///
+/// Task of the mode changes decided outside of the Zigbee stack task: the end
+/// of the settle window, the schedule and the thermostat run in esp_timer or in
+/// the application, the mode is applied in an alarm of the stack scheduler.
+/// The updates parked by the try methods are flushed by such an alarm too,
+/// without any call to process() or flushPending().
+#include <Zigbee.h>
+#include <ZigbeePilotWireControl.h>
+#include <PilotWireHost.h>
+#include "HostTest.h"
+#include <atomic>
+#include <thread>
+
+// The endpoints stay registered in the Zigbee core until the end of the program
+static ZigbeePilotWireControlT<false, false> settled (40);
+static ZigbeePilotWireControlT<false, false> scheduled (41);
+static ZigbeePilotWireControlT<true, false> regulated (42, -10.0f, 40.0f);
+static ZigbeePilotWireControlT<false, true> parked (43, 1);
+
+static uint32_t s_changes = 0;
+static uint32_t s_changes_in_stack = 0;
+static ZigbeePilotWireMode s_last_mode = PILOTWIRE_MODE_OFF;
+
+// ----------------------------------------------------------------------------
+static void
+modeChanged (uint8_t, ZigbeePilotWireMode mode) {
+
+  s_changes++;
+  if (hostInStackTask()) {
+    s_changes_in_stack++;
+  }
+  s_last_mode = mode;
+}
+
+// ----------------------------------------------------------------------------
+static void
+testSettleWindow() {
+  uint8_t mode;
+
+  settled.onPilotWireModeChange (modeChanged);
+  settled.setSettleWindow (500);
+  CHECK (settled.begin());
+  CHECK (Zigbee.addEndpoint (&settled));
+  s_changes = s_changes_in_stack = 0;
+
+  mode = PILOTWIRE_MODE_ECO;
+  hostStackWrite (40, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MODE_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U8, &mode, 1);
+  mode = PILOTWIRE_MODE_COMFORT_MINUS_1;
+  hostStackWrite (40, PILOT_WIRE_CLUSTER_ID, PILOT_WIRE_MODE_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U8, &mode, 1);
+  CHECK_EQ (s_changes, 0);
+
+  // the window closes in esp_timer, the final mode is applied in the stack task
+  hostAdvanceMs (500);
+  CHECK_EQ (s_changes, 1);
+  CHECK_EQ (s_changes_in_stack, 1);
+  CHECK_EQ (s_last_mode, PILOTWIRE_MODE_COMFORT_MINUS_1);
+  CHECK_EQ (settled.pilotWireMode(), PILOTWIRE_MODE_COMFORT_MINUS_1);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testSchedule() {
+  PilotWireSchedule schedule;
+  // Thursday 1970-01-01, 10 s before the end of the first slot
+  const time_t utc = PilotWireSchedule::SlotMinutes * 60 - 10;
+
+  // the schedule is only allocated when it is enabled
+  hostSetLogLevel (ARDUHAL_LOG_LEVEL_NONE);
+  CHECK (scheduled.setSchedule (schedule) == false);
+  hostSetLogLevel (ARDUHAL_LOG_LEVEL_ERROR);
+  CHECK (scheduled.isScheduleTimeValid() == false);
+
+  scheduled.onPilotWireModeChange (modeChanged);
+  scheduled.enableSchedule (true);
+  CHECK (scheduled.begin());
+  CHECK (Zigbee.addEndpoint (&scheduled));
+  s_changes = s_changes_in_stack = 0;
+
+  schedule.setSlot (4, 0, PILOTWIRE_MODE_ECO);
+  schedule.setSlot (4, 1, PILOTWIRE_MODE_FROST_PROTECTION);
+  scheduled.setScheduleTime (utc, 0);
+  scheduled.setSchedule (schedule);
+
+  // set from the application, applied in the stack task
+  CHECK_EQ (s_changes, 0);
+  hostAdvance (0);
+  CHECK_EQ (s_changes, 1);
+  CHECK_EQ (s_changes_in_stack, 1);
+  CHECK_EQ (s_last_mode, PILOTWIRE_MODE_ECO);
+
+  // the next slot is evaluated in esp_timer, applied in the stack task
+  hostAdvanceMs (PILOT_WIRE_SCHEDULE_PERIOD_MS);
+  CHECK_EQ (s_changes, 2);
+  CHECK_EQ (s_changes_in_stack, 2);
+  CHECK_EQ (s_last_mode, PILOTWIRE_MODE_FROST_PROTECTION);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testThermostat() {
+
+  regulated.onPilotWireModeChange (modeChanged);
+  regulated.enableThermostat (true);
+  CHECK (regulated.begin (15.0f));
+  CHECK (Zigbee.addEndpoint (&regulated));
+  CHECK (regulated.setHeatingSetpoints (20.0f, 16.0f));
+  hostAdvance (0);
+  s_changes = s_changes_in_stack = 0;
+
+  // the measure is far above the setpoint, the thermostat selects the lowest step
+  CHECK (regulated.setTemperature (30.0f));
+  CHECK_EQ (s_changes, 0);
+  hostAdvance (0);
+  CHECK_EQ (s_changes, 1);
+  CHECK_EQ (s_changes_in_stack, 1);
+  CHECK (s_last_mode != PILOTWIRE_MODE_COMFORT);
+  CHECK_EQ (regulated.pilotWireMode(), s_last_mode);
+}
+
+// ----------------------------------------------------------------------------
+static void
+testParkedFlush() {
+  std::atomic<bool> locked (false);
+  std::atomic<bool> release (false);
+  uint32_t alarms;
+
+  CHECK (parked.begin (static_cast<int32_t> (0)));
+  CHECK (Zigbee.addEndpoint (&parked));
+  hostAdvance (0);
+
+  // the stack task holds the lock, the update is parked
+  std::thread stack ([&] () {
+
+    esp_zb_lock_acquire (portMAX_DELAY);
+    locked = true;
+    while (release == false) {
+      std::this_thread::yield();
+    }
+    esp_zb_lock_release();
+  });
+  while (locked == false) {
+    std::this_thread::yield();
+  }
+  CHECK (parked.trySetPowerW (500));
+  CHECK (parked.pendingUpdates() != 0);
+  release = true;
+  stack.join();
+
+  // no process() and no flushPending(), the alarm of the stack writes the update
+  alarms = hostStackAlarms();
+  hostAdvanceMs (PILOT_WIRE_STACK_RETRY_MS);
+  CHECK (hostStackAlarms() > alarms);
+  CHECK_EQ (parked.pendingUpdates(), 0);
+  CHECK_EQ (parked.powerW(), 500);
+}
+
+int
+main() {
+
+  hostNvsErase();
+  RUN_TEST (testSettleWindow);
+  RUN_TEST (testSchedule);
+  RUN_TEST (testThermostat);
+  RUN_TEST (testParkedFlush);
+  return testResult();
+}